@@ -125,7 +125,7 @@ Map::Map(const string &MapFileName)
 {
 	ERR_TRY;
 
-	common::FileStream File(MapFileName, FM_READ);
+	common::VfsFileStream File(MapFileName);
 	common::CharReader Reader(&File);
 
 	for (uint y = 0; y < MAP_CY; y++)
@@ -231,7 +231,7 @@ GameRpg_pimpl::GameRpg_pimpl() :
 	// Niebo
 	ERR_TRY;
 	{
-		FileStream fs("Game\\Terrain\\RPG Sky.dat", FM_READ);
+		VfsFileStream fs("Game\\Terrain\\RPG Sky.dat");
 		Tokenizer t(&fs, 0);
 		t.Next();
 		m_SkyObj = new engine::ComplexSky(m_Scene.get(), t);
@@ -336,7 +336,7 @@ GameSpace_pimpl::GameSpace_pimpl() :
 	{
 		//engine::SolidSky *sky_obj = new engine::SolidSky(0xFF000000);
 
-		FileStream fs("Game\\Terrain\\Space Sky.dat", FM_READ);
+		VfsFileStream fs("Game\\Terrain\\Space Sky.dat");
 		Tokenizer t(&fs, 0);
 		t.Next();
 		engine::ComplexSky *sky_obj = new engine::ComplexSky(m_Scene.get(), t);
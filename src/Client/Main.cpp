@@ -115,6 +115,16 @@ void Application::OnCreate()
 
 	common::GetLogger().Log(LOG_APPLICATION, "OnCreate");
 
+	// Planista zada - m.in. do rwnolegego generowania terenu
+	common::g_JobScheduler.reset(new common::JobScheduler());
+
+	// Paczki z danymi - pliki lune maj przed nimi pierwszestwo, chyba e wyczono
+	// to w konfiguracji (wersja wydana - bez sprawdzania dysku przy kadym pliku)
+	bool LooseFiles = true;
+	g_Config->GetDataEx("Resources/LooseFiles", &LooseFiles);
+	common::VfsSetLooseOverride(LooseFiles);
+	common::VfsMountPacks(".", "*.pak");
+
 	// Manager zasobw
 	res::g_Manager = new res::ResManager();
 	res::RegisterTypesD3d();
@@ -126,6 +136,9 @@ void Application::OnCreate()
 	res::g_Manager->CreateFromFile("Framework\\Resources.dat");
 	res::g_Manager->CreateFromFile("Game\\Resources.dat");
 	res::g_Manager->CreateFromFile("Engine\\Resources.dat");
+	bool HotReload = false;
+	g_Config->GetDataEx("Resources/HotReload", &HotReload);
+	res::g_Manager->SetHotReload(HotReload);
 
 	// Gfx2D
 	gfx2d::g_SpriteRepository = new gfx2d::SpriteRepository();
@@ -185,6 +198,8 @@ void Application::OnDestroy()
 
 	SAFE_DELETE(gfx2d::g_SpriteRepository);
 	SAFE_DELETE(res::g_Manager);
+	common::g_JobScheduler.reset();
+	common::VfsUnmountAll();
 
 	common::GetLogger().Log(LOG_APPLICATION, "OnDestroy");
 }
@@ -11,11 +11,18 @@
 #include <cctype> // dla tolower, isalnum itp.
 #include <ctime> // dla time potrzebnego w RandomGenerator
 #include <memory.h>
+#ifdef COMMON_SSE2
+	#include <emmintrin.h>
+#endif
 #ifdef WIN32
 	#include <windows.h>
 	#include <float.h> // dla _finite i _isnan
+	#include <intrin.h> // dla __cpuidex i _xgetbv
 #else
 	#include <sys/time.h> // dla gettimeofday
+	#if defined(__i386__) || defined(__x86_64__)
+		#include <cpuid.h> // dla __cpuid_count
+	#endif
 #endif
 
 
@@ -146,6 +153,135 @@ void FillMem(void *Data, size_t NumBytes, uint1 Byte)
 	memset(Data, (int)Byte, NumBytes);
 }
 
+#ifdef COMMON_SSE2
+
+// Zamienia bajty w kadym 16-bitowym sowie
+static inline __m128i SwapBytes16_SSE2(__m128i v)
+{
+	return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+// Odwraca kolejno bajtw w sowach o rozmiarze WordSize, po 16 bajtw na raz.
+// Zwraca liczb przetworzonych bajtw.
+static size_t SwapByteOrder_SSE2(uint1 *Data, size_t WordSize, size_t NumBytes)
+{
+	size_t i = 0;
+	for ( ; i + 16 <= NumBytes; i += 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)&Data[i]);
+		// Najpierw odwrcenie kolejnoci sw 16-bitowych, potem bajtw w kadym z nich
+		if (WordSize == 4)
+		{
+			v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+			v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+		}
+		else if (WordSize == 8)
+		{
+			v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+			v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+		}
+		_mm_storeu_si128((__m128i*)&Data[i], SwapBytes16_SSE2(v));
+	}
+	return i;
+}
+
+#endif
+
+void SwapByteOrder(void *Data, size_t WordSize, size_t WordCount)
+{
+	assert(WordSize == 1 || WordSize == 2 || WordSize == 4 || WordSize == 8);
+	if (WordSize == 1)
+		return;
+
+	uint1 *Bytes = (uint1*)Data;
+	size_t NumBytes = WordSize * WordCount;
+	size_t i = 0;
+#ifdef COMMON_SSE2
+	if (CpuHasFeatures(CPU_FEATURE_SSE2))
+		i = SwapByteOrder_SSE2(Bytes, WordSize, NumBytes);
+#endif
+	for ( ; i < NumBytes; i += WordSize)
+	{
+		for (size_t a = i, b = i + WordSize - 1; a < b; a++, b--)
+		{
+			uint1 Tmp = Bytes[a];
+			Bytes[a] = Bytes[b];
+			Bytes[b] = Tmp;
+		}
+	}
+}
+
+// Wykonuje instrukcj CPUID, Out = { EAX, EBX, ECX, EDX }
+static void CpuId(uint4 Out[4], uint4 Leaf)
+{
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+	int Regs[4];
+	__cpuidex(Regs, (int)Leaf, 0);
+	Out[0] = (uint4)Regs[0]; Out[1] = (uint4)Regs[1]; Out[2] = (uint4)Regs[2]; Out[3] = (uint4)Regs[3];
+#elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+	unsigned a, b, c, d;
+	__cpuid_count(Leaf, 0, a, b, c, d);
+	Out[0] = a; Out[1] = b; Out[2] = c; Out[3] = d;
+#else
+	Out[0] = Out[1] = Out[2] = Out[3] = 0;
+#endif
+}
+
+// Zwraca modsze 32 bity rejestru XCR0 - czyli ktre rejestry system zapisuje przy przeczaniu kontekstu
+static uint4 GetXcr0()
+{
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+	return (uint4)_xgetbv(0);
+#elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+	unsigned a, d;
+	__asm__ __volatile__ ("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+	return a;
+#else
+	return 0;
+#endif
+}
+
+static uint4 DetectCpuFeatures()
+{
+	uint4 R[4];
+	CpuId(R, 0);
+	uint4 MaxLeaf = R[0];
+	if (MaxLeaf < 1)
+		return 0;
+
+	uint4 Features = 0;
+	CpuId(R, 1);
+	if (R[3] & (1 << 25)) Features |= CPU_FEATURE_SSE;
+	if (R[3] & (1 << 26)) Features |= CPU_FEATURE_SSE2;
+	if (R[2] & (1 <<  0)) Features |= CPU_FEATURE_SSE3;
+	if (R[2] & (1 <<  9)) Features |= CPU_FEATURE_SSSE3;
+	if (R[2] & (1 << 19)) Features |= CPU_FEATURE_SSE41;
+	if (R[2] & (1 << 20)) Features |= CPU_FEATURE_SSE42;
+	if (R[2] & (1 <<  1)) Features |= CPU_FEATURE_PCLMUL;
+	if (R[2] & (1 << 23)) Features |= CPU_FEATURE_POPCNT;
+
+	// AVX wymaga te, eby system zapisywa stan rejestrw XMM i YMM (OSXSAVE + bity 1 i 2 w XCR0)
+	bool OsSavesYmm = (R[2] & (1 << 27)) != 0 && (GetXcr0() & 0x06) == 0x06;
+	if (OsSavesYmm && (R[2] & (1 << 28)))
+	{
+		Features |= CPU_FEATURE_AVX;
+		if (MaxLeaf >= 7)
+		{
+			CpuId(R, 7);
+			if (R[1] & (1 << 5)) Features |= CPU_FEATURE_AVX2;
+		}
+	}
+
+	return Features;
+}
+
+uint4 GetCpuFeatures()
+{
+	// Wykrywanie jest deterministyczne, wic nawet jeli kilka wtkw zrobi je na raz, wynik bdzie ten sam.
+	static uint4 Features = DetectCpuFeatures();
+	return Features;
+}
+
 
 //HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
 // acuchy
@@ -1975,6 +2111,114 @@ float RandomGenerator::RandNormal(float sigma)
 		return -z * sigma;
 }
 
+void RandomGenerator::RandFloatArray(float *Out, size_t Count, float min, float max)
+{
+	RandFloatArray(Out, Count);
+	float Range = max - min;
+	for (size_t i = 0; i < Count; i++)
+		Out[i] = Out[i] * Range + min;
+}
+
+// Wyznacza przeksztacenie x -> Mul*x + Add rwnowane Steps krokom generatora
+// x -> Multiplier*x + Increment, skadajc je metod szybkiego potgowania.
+static void CalcLcgJump(uint4 *OutMul, uint4 *OutAdd, uint4 Multiplier, uint4 Increment, uint8 Steps)
+{
+	uint4 Mul = 1, Add = 0;
+	while (Steps > 0)
+	{
+		if (Steps & 1)
+		{
+			Mul = Mul * Multiplier;
+			Add = Add * Multiplier + Increment;
+		}
+		// Przeksztacenie zoone z samym sob
+		Increment = (Multiplier + 1) * Increment;
+		Multiplier = Multiplier * Multiplier;
+		Steps >>= 1;
+	}
+	*OutMul = Mul;
+	*OutAdd = Add;
+}
+
+#ifdef COMMON_SSE2
+
+// Mnoenie 4 liczb 32-bitowych z obciciem wyniku do 32 bitw - SSE2 nie ma _mm_mullo_epi32
+static inline __m128i MulLo32_SSE2(__m128i a, __m128i b)
+{
+	__m128i Even = _mm_mul_epu32(a, b);
+	__m128i Odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+	return _mm_unpacklo_epi32(
+		_mm_shuffle_epi32(Even, _MM_SHUFFLE(0, 0, 2, 0)),
+		_mm_shuffle_epi32(Odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+#endif
+
+void RandomGenerator::RandUintArray(uint4 *Out, size_t Count)
+{
+	size_t i = 0;
+#ifdef COMMON_SSE2
+	if (Count >= 8 && CpuHasFeatures(CPU_FEATURE_SSE2))
+	{
+		// 4 kolejne stany, kady przesuwany o 4 kroki na raz
+		uint4 Mul4, Add4;
+		CalcLcgJump(&Mul4, &Add4, MULTIPLIER, INCREMENT, 4);
+		__m128i MulV = _mm_set1_epi32((int)Mul4), AddV = _mm_set1_epi32((int)Add4);
+		uint4 s1 = m_Seed * MULTIPLIER + INCREMENT;
+		uint4 s2 = s1 * MULTIPLIER + INCREMENT;
+		uint4 s3 = s2 * MULTIPLIER + INCREMENT;
+		uint4 s4 = s3 * MULTIPLIER + INCREMENT;
+		__m128i State = _mm_set_epi32((int)s4, (int)s3, (int)s2, (int)s1);
+		for ( ; i + 4 <= Count; i += 4)
+		{
+			_mm_storeu_si128((__m128i*)&Out[i], State);
+			State = _mm_add_epi32(MulLo32_SSE2(State, MulV), AddV);
+		}
+		m_Seed = Out[i-1];
+	}
+#endif
+	for ( ; i < Count; i++)
+		Out[i] = RandUint();
+}
+
+void RandomGenerator::RandFloatArray(float *Out, size_t Count)
+{
+	// Najpierw liczby cakowite w miejscu wyniku, potem zamiana tak jak w RandFloat
+	uint4 *OutUint = (uint4*)Out;
+	RandUintArray(OutUint, Count);
+	size_t i = 0;
+#ifdef COMMON_SSE2
+	if (CpuHasFeatures(CPU_FEATURE_SSE2))
+	{
+		const __m128i Mantissa = _mm_set1_epi32(0x007FFFFF);
+		const __m128i One = _mm_set1_epi32(0x3F800000);
+		const __m128 OneF = _mm_set1_ps(1.0f);
+		for ( ; i + 4 <= Count; i += 4)
+		{
+			__m128i u = _mm_loadu_si128((const __m128i*)&OutUint[i]);
+			u = _mm_or_si128(_mm_and_si128(u, Mantissa), One);
+			_mm_storeu_ps(&Out[i], _mm_sub_ps(_mm_castsi128_ps(u), OneF));
+		}
+	}
+#endif
+	for ( ; i < Count; i++)
+		Out[i] = absolute_cast<float>(OutUint[i] & 0x007FFFFF | 0x3F800000) - 1.0f;
+}
+
+void RandomGenerator::Discard(uint8 Steps)
+{
+	uint4 Mul, Add;
+	CalcLcgJump(&Mul, &Add, MULTIPLIER, INCREMENT, Steps);
+	m_Seed = m_Seed * Mul + Add;
+}
+
+RandomGenerator RandomGenerator::Split(uint4 StreamIndex, uint4 StreamLength) const
+{
+	RandomGenerator R(m_Seed);
+	R.Discard((uint8)StreamIndex * StreamLength);
+	return R;
+}
+
 RandomGenerator g_Rand;
 
 UniqueGenerator::UniqueGenerator() :
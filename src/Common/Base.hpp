@@ -184,6 +184,51 @@ void CopyMem(void *Out, const void *In, size_t NumBytes);
 bool CompareMem(const void *Data1, const void *Data2, size_t NumBytes);
 // Wypenia pami podanym bajtem
 void FillMem(void *Data, size_t NumBytes, uint1 Byte);
+// Odwraca kolejno bajtw w kadym z WordCount kolejnych sw o rozmiarze WordSize
+// (1, 2, 4 lub 8) - zamiana midzy little endian i big endian. Uywa SSE2, jeli procesor obsuguje.
+void SwapByteOrder(void *Data, size_t WordSize, size_t WordCount);
+
+// Flagi rozszerze zestawu instrukcji procesora zwracane przez GetCpuFeatures
+enum CPU_FEATURE
+{
+	CPU_FEATURE_SSE    = 0x0001,
+	CPU_FEATURE_SSE2   = 0x0002,
+	CPU_FEATURE_SSE3   = 0x0004,
+	CPU_FEATURE_SSSE3  = 0x0008,
+	CPU_FEATURE_SSE41  = 0x0010,
+	CPU_FEATURE_SSE42  = 0x0020,
+	CPU_FEATURE_PCLMUL = 0x0040,
+	CPU_FEATURE_POPCNT = 0x0080,
+	// AVX i AVX2 s zgaszane tylko jeli system operacyjny zapisuje rejestry YMM przy przeczaniu wtkw.
+	CPU_FEATURE_AVX    = 0x0100,
+	CPU_FEATURE_AVX2   = 0x0200
+};
+
+// Zwraca kombinacj flag CPU_FEATURE obsugiwanych przez biecy procesor
+// - Wykrywa tylko raz, przy pierwszym wywoaniu.
+// - Na procesorach innych ni x86 zwraca 0.
+uint4 GetCpuFeatures();
+// Zwraca true, jeli procesor obsuguje wszystkie podane rozszerzenia
+inline bool CpuHasFeatures(uint4 Features) { return (GetCpuFeatures() & Features) == Features; }
+
+// Zdefiniowane, jeli kompilator pozwala uywa funkcji wewntrznych (intrinsics) SSE i SSE2.
+// O tym, czy wolno ich uy, decyduje dopiero GetCpuFeatures w czasie wykonania.
+#if (defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))) || defined(__SSE2__)
+	#define COMMON_SSE2
+#endif
+// Poprzedza definicj funkcji uywajcej instrukcji SSSE3/AVX/AVX2/PCLMULQDQ.
+// Visual C++ nie potrzebuje do tego adnych opcji, GCC wymaga atrybutu target.
+#if defined(COMMON_SSE2) && !defined(_MSC_VER)
+	#define COMMON_SSSE3_FUNCTION  __attribute__((target("ssse3")))
+	#define COMMON_AVX_FUNCTION    __attribute__((target("avx")))
+	#define COMMON_AVX2_FUNCTION   __attribute__((target("avx2")))
+	#define COMMON_PCLMUL_FUNCTION __attribute__((target("pclmul")))
+#else
+	#define COMMON_SSSE3_FUNCTION
+	#define COMMON_AVX_FUNCTION
+	#define COMMON_AVX2_FUNCTION
+	#define COMMON_PCLMUL_FUNCTION
+#endif
 
 
 //HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
@@ -1535,11 +1580,19 @@ inline float WaveformPWM(float x, float DutyCycle)
 Jest przede wszystkim szybki. Nie jest bardzo dobrze losowy. Mona go uywa
 jako deterministycznego tworzc wasne obiekty tej klasy i rcznie je
 naziarniajc.
+
+To generator liniowy kongruentny, wic mona go w czasie logarytmicznym
+przesun o dowoln liczb krokw do przodu (Discard) i podzieli cig na
+rozczne podstrumienie (Split) - np. eby generowa rwnolegle dokadnie to
+samo, co wyszoby sekwencyjnie.
 */
 
 class RandomGenerator
 {
 private:
+	static const uint4 MULTIPLIER = 196314165;
+	static const uint4 INCREMENT = 907633515;
+
 	// Current seed
 	uint4 m_Seed;
 
@@ -1559,7 +1612,7 @@ public:
 	// na podstawie ksiki "Pereki programowania gier", tom III, Dante Treglia
 	uint4 RandUint()
 	{
-		return ( m_Seed = (m_Seed * 196314165 + 907633515) );
+		return ( m_Seed = (m_Seed * MULTIPLIER + INCREMENT) );
 	}
 	// generuje liczb losow w zakresie 0 .. max-1
 	// Uwaga! Wyglda na to e jest problem z RandUint(2) - wychodzi zawsze 0, nie wiem dlaczego.
@@ -1621,6 +1674,20 @@ public:
 	// -2 * sigma .. +2 * sigma : 95%
 	// -3 * sigma .. +3 * sigma : 99.73%
 	float RandNormal(float sigma);
+
+	// Wypeniaj tablic liczbami dokadnie takimi, jakie dayby kolejne wywoania RandUint / RandFloat.
+	// Liczone po 4 na raz z SSE2, jeli procesor obsuguje.
+	void RandUintArray(uint4 *Out, size_t Count);
+	void RandFloatArray(float *Out, size_t Count);
+	void RandFloatArray(float *Out, size_t Count, float min, float max);
+
+	// Przesuwa generator o podan liczb krokw do przodu, tak jakby RandUint
+	// zostao wywoane Steps razy. Czas O(log Steps).
+	void Discard(uint8 Steps);
+	// Zwraca generator podstrumienia o podanym numerze - ustawiony tak, jak ten
+	// generator po StreamIndex * StreamLength krokach. Ten generator si nie zmienia.
+	// Podstrumienie si nie nakadaj, dopki z kadego pobiera si najwyej StreamLength liczb.
+	RandomGenerator Split(uint4 StreamIndex, uint4 StreamLength) const;
 };
 
 // Domylny generator liczb losowych do uywania w wtku gwnym i kiedy nie
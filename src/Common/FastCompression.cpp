@@ -0,0 +1,489 @@
+/*
+ * Kodowanie Windows-1250, koniec wiersza CR+LF, test: Za gl ja
+ * FastCompression - Szybka kompresja z rodziny LZ77
+ * Dokumentacja: Patrz plik doc/FastCompression.txt
+ * Copyleft (C) 2007 Adam Sawicki
+ * Licencja: GNU LGPL
+ * Kontakt: mailto:sawickiap@poczta.onet.pl , http://regedit.gamedev.pl/
+ */
+#include "Base.hpp"
+#include "Error.hpp"
+#include "FastCompression.hpp"
+
+
+namespace common
+{
+
+/*
+Format bloku (jak LZ4): cig sekwencji, kada to:
+- Token: 4 starsze bity = liczba literaw, 4 modsze = dugo dopasowania - 4.
+  Warto 15 oznacza, e cig dalszy jest w kolejnych bajtach (po 255, a do
+  bajtu < 255).
+- Literay
+- uint2 Offset (little endian) - odlego dopasowania wstecz
+- Cig dalszy dugoci dopasowania
+Ostatnia sekwencja ma same literay - po nich koczy si blok.
+*/
+
+// Minimalna dugo dopasowania
+const size_t LZ_MIN_MATCH = 4;
+// Ostatnie bajty bloku zawsze s literaami
+const size_t LZ_LAST_LITERALS = 5;
+// Dopasowanie musi si zaczyna co najmniej tyle przed kocem bloku
+const size_t LZ_MF_LIMIT = 12;
+const size_t LZ_MAX_DISTANCE = 65535;
+// Tablica haszujca ma 2^LZ_HASH_LOG pozycji
+const uint LZ_HASH_LOG = 12;
+const size_t LZ_HASH_SIZE = 1 << LZ_HASH_LOG;
+// Im wiksze, tym pniej przyspiesza si przeskakiwanie danych, w ktrych nie ma dopasowa
+const uint LZ_SKIP_STRENGTH = 6;
+
+static inline uint4 LzRead32(const uint1 *p)
+{
+	uint4 R;
+	memcpy(&R, p, sizeof(R));
+	return R;
+}
+
+static inline uint4 LzHash(const uint1 *p)
+{
+	return (LzRead32(p) * 2654435761U) >> (32 - LZ_HASH_LOG);
+}
+
+// Zapisuje dugo ponad 15 jako cig bajtw 255 i reszt
+static inline uint1 * LzWriteLength(uint1 *Out, size_t Length)
+{
+	while (Length >= 255)
+	{
+		*Out++ = 255;
+		Length -= 255;
+	}
+	*Out++ = (uint1)Length;
+	return Out;
+}
+
+// Zapisuje sekwencj. MatchLength == 0 oznacza ostatni sekwencj - same literay.
+static uint1 * LzWriteSequence(uint1 *Out, const uint1 *Literals, size_t LiteralCount, size_t Offset, size_t MatchLength)
+{
+	uint1 *Token = Out++;
+	*Token = (uint1)(std::min<size_t>(LiteralCount, 15) << 4);
+	if (LiteralCount >= 15)
+		Out = LzWriteLength(Out, LiteralCount - 15);
+	memcpy(Out, Literals, LiteralCount);
+	Out += LiteralCount;
+
+	if (MatchLength > 0)
+	{
+		*Out++ = (uint1)(Offset);
+		*Out++ = (uint1)(Offset >> 8);
+		size_t Code = MatchLength - LZ_MIN_MATCH;
+		*Token |= (uint1)std::min<size_t>(Code, 15);
+		if (Code >= 15)
+			Out = LzWriteLength(Out, Code - 15);
+	}
+	return Out;
+}
+
+// Zwraca liczb takich samych bajtw pod a i b, nie wicej ni MaxLength
+static inline size_t LzCountEqual(const uint1 *a, const uint1 *b, size_t MaxLength)
+{
+	size_t R = 0;
+	while (R + 4 <= MaxLength)
+	{
+		uint4 Diff = LzRead32(a + R) ^ LzRead32(b + R);
+		if (Diff != 0)
+		{
+			// Little endian - pierwszy rny bajt to najmodszy niezerowy
+			while ((Diff & 0xFF) == 0)
+			{
+				Diff >>= 8;
+				R++;
+			}
+			return R;
+		}
+		R += 4;
+	}
+	while (R < MaxLength && a[R] == b[R])
+		R++;
+	return R;
+}
+
+// Kompresuje blok. Table to bufor na LZ_HASH_SIZE pozycji.
+static size_t LzCompress(uint1 *Out, const uint1 *In, size_t Length, uint4 *Table)
+{
+	uint1 *OutBeg = Out;
+	size_t Anchor = 0;
+
+	if (Length > LZ_MF_LIMIT)
+	{
+		size_t MatchLimit = Length - LZ_LAST_LITERALS;
+		size_t SearchLimit = Length - LZ_MF_LIMIT;
+		memset(Table, 0, LZ_HASH_SIZE * sizeof(uint4));
+
+		size_t Pos = 1, Ref = 0;
+		Table[LzHash(In)] = 0;
+
+		for (;;)
+		{
+			// Szukanie dopasowania. Im duej bez skutku, tym wiksze kroki.
+			uint Attempts = 1 << LZ_SKIP_STRENGTH;
+			size_t Step = 1;
+			for (;;)
+			{
+				if (Pos > SearchLimit)
+					goto LastLiterals;
+				uint4 Hash = LzHash(In + Pos);
+				Ref = Table[Hash];
+				Table[Hash] = (uint4)Pos;
+				if (Pos - Ref <= LZ_MAX_DISTANCE && LzRead32(In + Ref) == LzRead32(In + Pos))
+					break;
+				Pos += Step;
+				Step = (Attempts++ >> LZ_SKIP_STRENGTH);
+			}
+
+			// Przeduenie wstecz
+			while (Pos > Anchor && Ref > 0 && In[Pos-1] == In[Ref-1])
+			{
+				Pos--;
+				Ref--;
+			}
+			// Przeduenie w przd
+			size_t MatchLength = LZ_MIN_MATCH + LzCountEqual(In + Pos + LZ_MIN_MATCH, In + Ref + LZ_MIN_MATCH, MatchLimit - Pos - LZ_MIN_MATCH);
+
+			Out = LzWriteSequence(Out, In + Anchor, Pos - Anchor, Pos - Ref, MatchLength);
+			Pos += MatchLength;
+			Anchor = Pos;
+			if (Pos > SearchLimit)
+				break;
+			// Pozycja z wntrza dopasowania poprawia szanse nastpnego
+			Table[LzHash(In + Pos - 2)] = (uint4)(Pos - 2);
+		}
+	}
+
+LastLiterals:
+	Out = LzWriteSequence(Out, In + Anchor, Length - Anchor, 0, 0);
+	return Out - OutBeg;
+}
+
+// Kopiuje bajty o wielokrotnoci 8 w gr. Moe zapisa do 7 B za Out + Length.
+static inline void LzWildCopy(uint1 *Out, const uint1 *In, size_t Length)
+{
+	uint1 *End = Out + Length;
+	do
+	{
+		memcpy(Out, In, 8);
+		Out += 8;
+		In += 8;
+	}
+	while (Out < End);
+}
+
+// Dekompresuje blok. Zwraca false, jeli dane s uszkodzone albo rozmiar si nie zgadza.
+static bool LzDecompress(uint1 *Out, size_t OutLength, const uint1 *In, size_t InLength)
+{
+	const uint1 *InEnd = In + InLength;
+	uint1 *OutBeg = Out;
+	uint1 *OutEnd = Out + OutLength;
+
+	for (;;)
+	{
+		if (In >= InEnd)
+			return false;
+		uint Token = *In++;
+
+		// Literay
+		size_t Count = Token >> 4;
+		if (Count == 15)
+		{
+			uint1 b;
+			do
+			{
+				if (In >= InEnd)
+					return false;
+				b = *In++;
+				Count += b;
+			}
+			while (b == 255);
+		}
+		if (Count > (size_t)(InEnd - In) || Count > (size_t)(OutEnd - Out))
+			return false;
+		if (Count + 8 <= (size_t)(InEnd - In) && Count + 8 <= (size_t)(OutEnd - Out))
+			LzWildCopy(Out, In, Count);
+		else
+			memcpy(Out, In, Count);
+		Out += Count;
+		In += Count;
+
+		// Koniec bloku
+		if (In == InEnd)
+			return (Out == OutEnd);
+
+		// Dopasowanie
+		if (InEnd - In < 2)
+			return false;
+		size_t Offset = In[0] | (In[1] << 8);
+		In += 2;
+		if (Offset == 0 || Offset > (size_t)(Out - OutBeg))
+			return false;
+		Count = Token & 15;
+		if (Count == 15)
+		{
+			uint1 b;
+			do
+			{
+				if (In >= InEnd)
+					return false;
+				b = *In++;
+				Count += b;
+			}
+			while (b == 255);
+		}
+		Count += LZ_MIN_MATCH;
+		if (Count > (size_t)(OutEnd - Out))
+			return false;
+
+		const uint1 *Match = Out - Offset;
+		if (Count + 8 <= (size_t)(OutEnd - Out))
+		{
+			// Krtka odlego to powtarzajcy si wzorzec - jest te powtarzalny co
+			// kad wielokrotno Offset, wic po skopiowaniu bajt po bajcie pierwszej
+			// takiej wielokrotnoci >= 8 mona dalej kopiowa po 8 B.
+			size_t i = 0;
+			if (Offset < 8)
+			{
+				size_t Distance = Offset;
+				while (Distance < 8)
+					Distance += Offset;
+				for (; i < Distance && i < Count; i++)
+					Out[i] = Match[i];
+				Match = Out + i - Distance;
+			}
+			if (i < Count)
+				LzWildCopy(Out + i, Match + (Offset < 8 ? 0 : i), Count - i);
+		}
+		else
+		{
+			for (size_t i = 0; i < Count; i++)
+				Out[i] = Match[i];
+		}
+		Out += Count;
+	}
+}
+
+// Flaga w rozmiarze po kompresji w nagwku bloku - blok nieskompresowany
+const uint4 FAST_STORED_FLAG = 0x80000000;
+
+
+//HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
+// Klasa FastCompressionStream
+
+/*
+Format strumienia: cig blokw, kady to:
+- uint4 RawSize - rozmiar przed kompresj. 0 oznacza koniec strumienia.
+- uint4 PackedSize - rozmiar po kompresji, z flag FAST_STORED_FLAG jeli
+  blok jest zapisany wprost
+- Dane
+*/
+
+class FastCompressionStream_pimpl
+{
+public:
+	Stream *m_Stream;
+	std::vector<uint1> m_InBuf;
+	size_t m_InBufLength;
+	std::vector<uint1> m_OutBuf;
+	std::vector<uint4> m_Table;
+
+	FastCompressionStream_pimpl(Stream *a_Stream);
+	// Kompresuje i zapisuje biecy blok
+	void WriteBlock();
+};
+
+FastCompressionStream_pimpl::FastCompressionStream_pimpl(Stream *a_Stream) :
+	m_Stream(a_Stream),
+	m_InBufLength(0)
+{
+	m_InBuf.resize(FAST_COMPRESSION_BLOCK_SIZE);
+	m_OutBuf.resize(FastCompressionStream::CompressLength(FAST_COMPRESSION_BLOCK_SIZE));
+	m_Table.resize(LZ_HASH_SIZE);
+}
+
+void FastCompressionStream_pimpl::WriteBlock()
+{
+	if (m_InBufLength == 0)
+		return;
+
+	size_t PackedSize = LzCompress(&m_OutBuf[0], &m_InBuf[0], m_InBufLength, &m_Table[0]);
+	m_Stream->WriteEx((uint4)m_InBufLength);
+	// Nie opaca si kompresowa
+	if (PackedSize >= m_InBufLength)
+	{
+		m_Stream->WriteEx((uint4)m_InBufLength | FAST_STORED_FLAG);
+		m_Stream->Write(&m_InBuf[0], m_InBufLength);
+	}
+	else
+	{
+		m_Stream->WriteEx((uint4)PackedSize);
+		m_Stream->Write(&m_OutBuf[0], PackedSize);
+	}
+	m_InBufLength = 0;
+}
+
+FastCompressionStream::FastCompressionStream(Stream *a_Stream) :
+	OverlayStream(a_Stream),
+	pimpl(new FastCompressionStream_pimpl(a_Stream))
+{
+}
+
+FastCompressionStream::~FastCompressionStream()
+{
+	try
+	{
+		pimpl->WriteBlock();
+		pimpl->m_Stream->WriteEx((uint4)0);
+	}
+	catch (...)
+	{
+		assert(0 && "FastCompressionStream.dtor - wyjtek");
+	}
+}
+
+void FastCompressionStream::Write(const void *Data, size_t Size)
+{
+	const uint1 *ByteData = (const uint1*)Data;
+	while (Size > 0)
+	{
+		size_t PartSize = std::min(Size, FAST_COMPRESSION_BLOCK_SIZE - pimpl->m_InBufLength);
+		memcpy(&pimpl->m_InBuf[pimpl->m_InBufLength], ByteData, PartSize);
+		pimpl->m_InBufLength += PartSize;
+		ByteData += PartSize;
+		Size -= PartSize;
+
+		if (pimpl->m_InBufLength == FAST_COMPRESSION_BLOCK_SIZE)
+			pimpl->WriteBlock();
+	}
+}
+
+void FastCompressionStream::Flush()
+{
+	pimpl->WriteBlock();
+}
+
+size_t FastCompressionStream::CompressLength(size_t DataLength)
+{
+	// Najgorszy przypadek - same literay
+	return DataLength + DataLength / 255 + 16;
+}
+
+size_t FastCompressionStream::Compress(void *OutData, const void *Data, size_t DataLength)
+{
+	std::vector<uint4> Table(LZ_HASH_SIZE);
+	return LzCompress((uint1*)OutData, (const uint1*)Data, DataLength, &Table[0]);
+}
+
+
+//HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
+// Klasa FastDecompressionStream
+
+class FastDecompressionStream_pimpl
+{
+public:
+	Stream *m_Stream;
+	std::vector<uint1> m_InBuf;
+	std::vector<uint1> m_OutBuf;
+	size_t m_OutBufLength;
+	size_t m_OutBufPos;
+	// Wczytany zosta znacznik koca
+	bool m_End;
+
+	FastDecompressionStream_pimpl(Stream *a_Stream);
+	// Jeli biecy blok si skoczy, wczytuje nastpny. Zwraca false, jeli to koniec strumienia.
+	bool EnsureBlock();
+};
+
+FastDecompressionStream_pimpl::FastDecompressionStream_pimpl(Stream *a_Stream) :
+	m_Stream(a_Stream),
+	m_OutBufLength(0),
+	m_OutBufPos(0),
+	m_End(false)
+{
+	m_InBuf.resize(FAST_COMPRESSION_BLOCK_SIZE);
+	m_OutBuf.resize(FAST_COMPRESSION_BLOCK_SIZE);
+}
+
+bool FastDecompressionStream_pimpl::EnsureBlock()
+{
+	if (m_OutBufPos < m_OutBufLength)
+		return true;
+	if (m_End)
+		return false;
+
+	uint4 RawSize, PackedSize;
+	m_Stream->ReadEx(&RawSize);
+	if (RawSize == 0)
+	{
+		m_End = true;
+		return false;
+	}
+	m_Stream->ReadEx(&PackedSize);
+	bool Stored = ((PackedSize & FAST_STORED_FLAG) != 0);
+	PackedSize &= ~FAST_STORED_FLAG;
+	if (RawSize > FAST_COMPRESSION_BLOCK_SIZE || PackedSize > FAST_COMPRESSION_BLOCK_SIZE || (Stored && PackedSize != RawSize))
+		throw Error("Bd strumienia dekompresji FastDecompressionStream: Nieprawidowy nagwek bloku.", __FILE__, __LINE__);
+
+	if (Stored)
+		m_Stream->MustRead(&m_OutBuf[0], RawSize);
+	else
+	{
+		m_Stream->MustRead(&m_InBuf[0], PackedSize);
+		if (!LzDecompress(&m_OutBuf[0], RawSize, &m_InBuf[0], PackedSize))
+			throw Error("Bd strumienia dekompresji FastDecompressionStream: Uszkodzone dane.", __FILE__, __LINE__);
+	}
+	m_OutBufLength = RawSize;
+	m_OutBufPos = 0;
+	return true;
+}
+
+FastDecompressionStream::FastDecompressionStream(Stream *a_Stream) :
+	OverlayStream(a_Stream),
+	pimpl(new FastDecompressionStream_pimpl(a_Stream))
+{
+}
+
+FastDecompressionStream::~FastDecompressionStream()
+{
+}
+
+size_t FastDecompressionStream::Read(void *Out, size_t MaxLength)
+{
+	uint1 *ByteOut = (uint1*)Out;
+	size_t Sum = 0, Length;
+	// MaxLength bdzie zmniejszany. Oznacza liczb pozostaych do odczytania bajtw.
+
+	while (MaxLength > 0)
+	{
+		if (!pimpl->EnsureBlock())
+			break;
+
+		Length = std::min(pimpl->m_OutBufLength - pimpl->m_OutBufPos, MaxLength);
+		memcpy(ByteOut, &pimpl->m_OutBuf[pimpl->m_OutBufPos], Length);
+		pimpl->m_OutBufPos += Length;
+		ByteOut += Length;
+		Sum += Length;
+		MaxLength -= Length;
+	}
+
+	return Sum;
+}
+
+bool FastDecompressionStream::End()
+{
+	return !pimpl->EnsureBlock();
+}
+
+bool FastDecompressionStream::Decompress(void *OutData, size_t OutLength, const void *Data, size_t DataLength)
+{
+	return LzDecompress((uint1*)OutData, OutLength, (const uint1*)Data, DataLength);
+}
+
+} // namespace common
@@ -0,0 +1,86 @@
+/*
+ * Kodowanie Windows-1250, koniec wiersza CR+LF, test: Za gl ja
+ * FastCompression - Szybka kompresja z rodziny LZ77
+ * Dokumentacja: Patrz plik doc/FastCompression.txt
+ * Copyleft (C) 2007 Adam Sawicki
+ * Licencja: GNU LGPL
+ * Kontakt: mailto:sawickiap@poczta.onet.pl , http://regedit.gamedev.pl/
+ */
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif
+#ifndef COMMON_FAST_COMPRESSION_H_
+#define COMMON_FAST_COMPRESSION_H_
+
+#include "Stream.hpp"
+
+namespace common
+{
+
+// Rozmiar bloku danych kompresowanego osobno przez FastCompressionStream.
+// Jednoczenie maksymalna odlego dopasowania w kodeku to 64 KB - 1.
+const size_t FAST_COMPRESSION_BLOCK_SIZE = 64*1024;
+
+class FastCompressionStream_pimpl;
+class FastDecompressionStream_pimpl;
+
+/*
+Kompresuje strumie danych szybkim kodekiem LZ77 (format bloku jak w LZ4)
+- Kompresja duo sabsza ni zlib, ale dekompresja kilka razy szybsza.
+- Dane dzielone s na bloki po FAST_COMPRESSION_BLOCK_SIZE B, kady
+  poprzedzony nagwkiem z rozmiarami. Blok, ktrego nie opaca si
+  kompresowa, zapisywany jest wprost.
+- Znacznik koca zapisuje si w destruktorze.
+*/
+class FastCompressionStream : public OverlayStream
+{
+private:
+	scoped_ptr<FastCompressionStream_pimpl> pimpl;
+
+public:
+	FastCompressionStream(Stream *a_Stream);
+	virtual ~FastCompressionStream();
+
+	// ======== Implementacja Stream ========
+	virtual void Write(const void *Data, size_t Size);
+	// Kompresuje i zapisuje niepeny biecy blok. Pogarsza kompresj.
+	virtual void Flush();
+
+	// ======== Statyczne ========
+	// Oblicza maksymalny rozmiar bufora na skompresowane dane (jednego wywoania Compress)
+	static size_t CompressLength(size_t DataLength);
+	// Po prostu kompresuje podane dane jako jeden blok, bez nagwka
+	// Zwraca dugo skompresowanych danych.
+	// - OutData musi by buforem o dugoci conajmniej takiej, jak obliczona przez CompressLength.
+	// - DataLength moe by dowolne, ale dopasowania sigaj najwyej 64 KB wstecz.
+	static size_t Compress(void *OutData, const void *Data, size_t DataLength);
+};
+
+/*
+Dekompresuje strumie zapisany przez FastCompressionStream
+- Uszkodzone dane powoduj wyjtek albo bdne dane (format nie ma sumy
+  kontrolnej), ale nigdy odczyt ani zapis poza bufor.
+*/
+class FastDecompressionStream : public OverlayStream
+{
+private:
+	scoped_ptr<FastDecompressionStream_pimpl> pimpl;
+
+public:
+	FastDecompressionStream(Stream *a_Stream);
+	virtual ~FastDecompressionStream();
+
+	// ======== Implementacja Stream ========
+	virtual size_t Read(void *Out, size_t MaxLength);
+	virtual bool End();
+
+	// ======== Statyczne ========
+	// Po prostu dekompresuje blok zapisany przez FastCompressionStream::Compress
+	// - Rozmiar danych po dekompresji musi by znany - dokadnie tyle zostanie rozkompresowane.
+	// - Jeli dane s uszkodzone albo nie pasuj do rozmiaru, zwraca false.
+	static bool Decompress(void *OutData, size_t OutLength, const void *Data, size_t DataLength);
+};
+
+} // namespace common
+
+#endif
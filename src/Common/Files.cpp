@@ -16,6 +16,7 @@
 		#include <sys/utime.h> // dla utime
 		#include <direct.h> // dla mkdir (Linux ma go w sys/stat.h + sys/types.h)
 	}
+	#define _WIN32_WINNT 0x0600 // dla windows.h dla CancelIoEx
 	#include <windows.h>
 #else
 	extern "C" {
@@ -23,13 +24,23 @@
 		#include <sys/file.h> // dla flock
 		#include <dirent.h>
 		#include <utime.h> // dla utime
+		#include <sys/mman.h> // dla mmap
+		#include <fcntl.h> // dla open
+		#include <unistd.h> // dla close
+		#include <sys/uio.h> // dla writev, readv
+		#include <sys/inotify.h>
+		#include <poll.h>
+		#include <errno.h>
 	}
 #endif
 #include <stack>
+#include <set>
+#include <map>
 
 #include "Error.hpp"
 #include "Files.hpp"
 #include "DateTime.hpp"
+#include "Threads.hpp"
 
 
 namespace common
@@ -121,6 +132,70 @@ namespace common
 		FlushFileBuffers(pimpl->m_File);
 	}
 
+	// Maksymalny rozmiar bufora poredniego WriteV i ReadV
+	static const size_t FILE_GATHER_BUFFER_SIZE = 256*1024;
+
+	void FileStream::WriteV(const STREAM_WRITE_BUF *Bufs, size_t Count)
+	{
+		size_t Size = 0, i;
+		for (i = 0; i < Count; i++)
+			Size += Bufs[i].Size;
+		if (Size == 0)
+			return;
+
+		// WriteFileGather wymaga pliku bez buforowania i kawakw po stronie pamici,
+		// wic kawaki s zbierane w buforze porednim i zapisywane jednym WriteFile.
+		std::vector<char> Buf(std::min(Size, FILE_GATHER_BUFFER_SIZE));
+		size_t BufIndex = 0;
+		for (i = 0; i < Count; i++)
+		{
+			// Duy kawaek - prosto do pliku
+			if (Bufs[i].Size >= Buf.size())
+			{
+				if (BufIndex > 0)
+				{
+					FileStream::Write(&Buf[0], BufIndex);
+					BufIndex = 0;
+				}
+				FileStream::Write(Bufs[i].Data, Bufs[i].Size);
+			}
+			else
+			{
+				if (Bufs[i].Size > Buf.size() - BufIndex)
+				{
+					FileStream::Write(&Buf[0], BufIndex);
+					BufIndex = 0;
+				}
+				memcpy(&Buf[BufIndex], Bufs[i].Data, Bufs[i].Size);
+				BufIndex += Bufs[i].Size;
+			}
+		}
+		if (BufIndex > 0)
+			FileStream::Write(&Buf[0], BufIndex);
+	}
+
+	size_t FileStream::ReadV(const STREAM_READ_BUF *Bufs, size_t Count)
+	{
+		size_t Size = 0, i;
+		for (i = 0; i < Count; i++)
+			Size += Bufs[i].Size;
+		if (Size == 0)
+			return 0;
+		if (Size > FILE_GATHER_BUFFER_SIZE)
+			return Stream::ReadV(Bufs, Count);
+
+		// Jeden ReadFile do bufora poredniego i rozdzielenie na kawaki
+		std::vector<char> Buf(Size);
+		size_t BytesRead = FileStream::Read(&Buf[0], Size), Offset = 0;
+		for (i = 0; i < Count && Offset < BytesRead; i++)
+		{
+			size_t Length = std::min(Bufs[i].Size, BytesRead - Offset);
+			memcpy(Bufs[i].Data, &Buf[Offset], Length);
+			Offset += Length;
+		}
+		return BytesRead;
+	}
+
 	size_t FileStream::GetSize()
 	{
 		return (size_t)GetFileSize(pimpl->m_File, 0);
@@ -180,6 +255,60 @@ namespace common
 		bool m_Lock;
 	};
 
+	// Poniej tylu bajtw WriteV i ReadV id zwykym fwrite/fread przez bufor stdio
+	static const size_t FILE_VECTOR_IO_MIN_SIZE = 64*1024;
+	// Maksymalna liczba kawakw w jednym wywoaniu writev/readv (IOV_MAX w Linuksie)
+	static const int FILE_IOV_MAX = 1024;
+
+	// Wypenia Vec kawakami od BufIndex (pierwszym od bajtu BufOffset), pomijajc puste.
+	// Zwraca liczb wypenionych elementw.
+	template <typename BUF_T>
+	static int FillIovec(struct iovec *Vec, const BUF_T *Bufs, size_t Count, size_t BufIndex, size_t BufOffset)
+	{
+		int VecCount = 0;
+		for (size_t i = BufIndex; i < Count && VecCount < FILE_IOV_MAX; i++)
+		{
+			size_t Offset = (i == BufIndex ? BufOffset : 0);
+			if (Bufs[i].Size > Offset)
+			{
+				Vec[VecCount].iov_base = (char*)Bufs[i].Data + Offset;
+				Vec[VecCount].iov_len = Bufs[i].Size - Offset;
+				VecCount++;
+			}
+		}
+		return VecCount;
+	}
+
+	// Przesuwa BufIndex i BufOffset o Length bajtw
+	template <typename BUF_T>
+	static void AdvanceIovec(const BUF_T *Bufs, size_t *BufIndex, size_t *BufOffset, size_t Length)
+	{
+		while (Length > 0)
+		{
+			size_t Left = Bufs[*BufIndex].Size - *BufOffset;
+			if (Length >= Left)
+			{
+				Length -= Left;
+				(*BufIndex)++;
+				*BufOffset = 0;
+			}
+			else
+			{
+				*BufOffset += Length;
+				Length = 0;
+			}
+		}
+	}
+
+	// Po writev/readv prosto na deskryptorze ustawia na jego pozycj strumie stdio,
+	// ktry pamita pozycj u siebie - inaczej ftell i fseek by si myliy.
+	static void SyncStdioPos(FILE *File)
+	{
+		off_t Pos = lseek(fileno(File), 0, SEEK_CUR);
+		if (Pos >= 0)
+			fseeko(File, Pos, SEEK_SET);
+	}
+
 	FileStream::FileStream(const string &FileName, FILE_MODE FileMode, bool Lock) :
 		pimpl(new File_pimpl)
 	{
@@ -250,6 +379,81 @@ namespace common
 		fflush(pimpl->m_File);
 	}
 
+	void FileStream::WriteV(const STREAM_WRITE_BUF *Bufs, size_t Count)
+	{
+		size_t Size = 0, i;
+		for (i = 0; i < Count; i++)
+			Size += Bufs[i].Size;
+		if (Size < FILE_VECTOR_IO_MIN_SIZE)
+		{
+			Stream::WriteV(Bufs, Count);
+			return;
+		}
+
+		// Najpierw to, co czeka w buforze stdio
+		if (fflush(pimpl->m_File) != 0)
+			throw ErrnoError("Nie mona zapisa do pliku", __FILE__, __LINE__);
+
+		int fd = fileno(pimpl->m_File);
+		struct iovec Vec[FILE_IOV_MAX];
+		size_t BufIndex = 0, BufOffset = 0, Written = 0;
+		while (Written < Size)
+		{
+			int VecCount = FillIovec(Vec, Bufs, Count, BufIndex, BufOffset);
+			ssize_t r = writev(fd, Vec, VecCount);
+			if (r < 0 && errno == EINTR)
+				continue;
+			if (r <= 0)
+			{
+				int ErrorCode = errno;
+				SyncStdioPos(pimpl->m_File);
+				throw ErrnoError(ErrorCode, Format("Nie mona zapisa do pliku - zapisano #/# B") % Written % Size, __FILE__, __LINE__);
+			}
+			Written += (size_t)r;
+			AdvanceIovec(Bufs, &BufIndex, &BufOffset, (size_t)r);
+		}
+
+		SyncStdioPos(pimpl->m_File);
+	}
+
+	size_t FileStream::ReadV(const STREAM_READ_BUF *Bufs, size_t Count)
+	{
+		size_t Size = 0, i;
+		for (i = 0; i < Count; i++)
+			Size += Bufs[i].Size;
+		if (Size < FILE_VECTOR_IO_MIN_SIZE)
+			return Stream::ReadV(Bufs, Count);
+
+		// Odrzuca bufor odczytu stdio, ustawiajc deskryptor na biec pozycj strumienia
+		if (fflush(pimpl->m_File) != 0)
+			throw ErrnoError("Nie mona odczyta z pliku", __FILE__, __LINE__);
+
+		int fd = fileno(pimpl->m_File);
+		struct iovec Vec[FILE_IOV_MAX];
+		size_t BufIndex = 0, BufOffset = 0, BytesRead = 0;
+		while (BytesRead < Size)
+		{
+			int VecCount = FillIovec(Vec, Bufs, Count, BufIndex, BufOffset);
+			ssize_t r = readv(fd, Vec, VecCount);
+			if (r < 0 && errno == EINTR)
+				continue;
+			if (r < 0)
+			{
+				int ErrorCode = errno;
+				SyncStdioPos(pimpl->m_File);
+				throw ErrnoError(ErrorCode, Format("Nie mona odczyta z pliku - odczytano #/# B") % BytesRead % Size, __FILE__, __LINE__);
+			}
+			// Koniec pliku
+			if (r == 0)
+				break;
+			BytesRead += (size_t)r;
+			AdvanceIovec(Bufs, &BufIndex, &BufOffset, (size_t)r);
+		}
+
+		SyncStdioPos(pimpl->m_File);
+		return BytesRead;
+	}
+
 	size_t FileStream::GetSize()
 	{
 		// Wersja 1
@@ -317,6 +521,206 @@ namespace common
 #endif
 
 
+//HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
+// Klasa MappedFileStream
+
+class MappedFile_pimpl
+{
+public:
+	const char *m_Data;
+	size_t m_Size;
+	size_t m_Pos;
+	// Tylko przy CopyToMemory - kopia danych pliku, m_Data wskazuje do niej
+	std::vector<char> m_Copy;
+
+	#ifdef WIN32
+		HANDLE m_File;
+		HANDLE m_Mapping;
+	#endif
+
+	void ThrowViewError(size_t Offset, size_t Length);
+};
+
+void MappedFile_pimpl::ThrowViewError(size_t Offset, size_t Length)
+{
+	throw Error(Format("Widok #..# B wychodzi poza koniec pliku o rozmiarze # B") % Offset % (Offset + Length) % m_Size, __FILE__, __LINE__);
+}
+
+#ifdef WIN32
+
+	MappedFileStream::MappedFileStream(const string &FileName, bool CopyToMemory) :
+		pimpl(new MappedFile_pimpl)
+	{
+		pimpl->m_Data = NULL;
+		pimpl->m_Size = 0;
+		pimpl->m_Pos = 0;
+		pimpl->m_Mapping = NULL;
+
+		pimpl->m_File = CreateFileA(FileName.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+		if (pimpl->m_File == INVALID_HANDLE_VALUE)
+			throw Win32Error("Nie mona otworzy pliku: "+FileName, __FILE__, __LINE__);
+
+		pimpl->m_Size = (size_t)GetFileSize(pimpl->m_File, 0);
+		// Pustego pliku nie da si odwzorowa
+		if (pimpl->m_Size > 0)
+		{
+			pimpl->m_Mapping = CreateFileMappingA(pimpl->m_File, 0, PAGE_READONLY, 0, 0, 0);
+			if (pimpl->m_Mapping == NULL)
+			{
+				CloseHandle(pimpl->m_File);
+				throw Win32Error("Nie mona odwzorowa w pamici pliku: "+FileName, __FILE__, __LINE__);
+			}
+			pimpl->m_Data = (const char*)MapViewOfFile(pimpl->m_Mapping, FILE_MAP_READ, 0, 0, 0);
+			if (pimpl->m_Data == NULL)
+			{
+				CloseHandle(pimpl->m_Mapping);
+				CloseHandle(pimpl->m_File);
+				throw Win32Error("Nie mona odwzorowa w pamici pliku: "+FileName, __FILE__, __LINE__);
+			}
+		}
+
+		if (CopyToMemory)
+		{
+			if (pimpl->m_Data != NULL)
+			{
+				pimpl->m_Copy.assign(pimpl->m_Data, pimpl->m_Data + pimpl->m_Size);
+				UnmapViewOfFile(pimpl->m_Data);
+				CloseHandle(pimpl->m_Mapping);
+				pimpl->m_Mapping = NULL;
+				pimpl->m_Data = &pimpl->m_Copy[0];
+			}
+			CloseHandle(pimpl->m_File);
+			pimpl->m_File = INVALID_HANDLE_VALUE;
+		}
+	}
+
+	MappedFileStream::~MappedFileStream()
+	{
+		if (pimpl->m_Data != NULL && pimpl->m_Copy.empty())
+			UnmapViewOfFile(pimpl->m_Data);
+		if (pimpl->m_Mapping != NULL)
+			CloseHandle(pimpl->m_Mapping);
+		if (pimpl->m_File != INVALID_HANDLE_VALUE)
+			CloseHandle(pimpl->m_File);
+	}
+
+#else
+
+	MappedFileStream::MappedFileStream(const string &FileName, bool CopyToMemory) :
+		pimpl(new MappedFile_pimpl)
+	{
+		pimpl->m_Data = NULL;
+		pimpl->m_Size = 0;
+		pimpl->m_Pos = 0;
+
+		int fd = open(FileName.c_str(), O_RDONLY);
+		if (fd < 0)
+			throw ErrnoError(Format("Nie mona otworzy pliku \"#\"") % FileName, __FILE__, __LINE__);
+
+		struct stat s;
+		if (fstat(fd, &s) != 0)
+		{
+			close(fd);
+			throw ErrnoError(Format("Nie mona odczyta rozmiaru pliku \"#\"") % FileName, __FILE__, __LINE__);
+		}
+		pimpl->m_Size = (size_t)s.st_size;
+
+		// Pustego pliku nie da si odwzorowa
+		if (pimpl->m_Size > 0)
+		{
+			void *Data = mmap(0, pimpl->m_Size, PROT_READ, MAP_SHARED, fd, 0);
+			if (Data == MAP_FAILED)
+			{
+				close(fd);
+				throw ErrnoError(Format("Nie mona odwzorowa w pamici pliku \"#\"") % FileName, __FILE__, __LINE__);
+			}
+			pimpl->m_Data = (const char*)Data;
+		}
+
+		// Odwzorowanie pozostaje wane po zamkniciu deskryptora
+		close(fd);
+
+		if (CopyToMemory && pimpl->m_Data != NULL)
+		{
+			pimpl->m_Copy.assign(pimpl->m_Data, pimpl->m_Data + pimpl->m_Size);
+			munmap(const_cast<char*>(pimpl->m_Data), pimpl->m_Size);
+			pimpl->m_Data = &pimpl->m_Copy[0];
+		}
+	}
+
+	MappedFileStream::~MappedFileStream()
+	{
+		if (pimpl->m_Data != NULL && pimpl->m_Copy.empty())
+			munmap(const_cast<char*>(pimpl->m_Data), pimpl->m_Size);
+	}
+
+#endif
+
+size_t MappedFileStream::Read(void *Data, size_t Size)
+{
+	if (pimpl->m_Pos >= pimpl->m_Size)
+		return 0;
+	size_t BytesRead = std::min(Size, pimpl->m_Size - pimpl->m_Pos);
+	memcpy(Data, pimpl->m_Data + pimpl->m_Pos, BytesRead);
+	pimpl->m_Pos += BytesRead;
+	return BytesRead;
+}
+
+void MappedFileStream::MustRead(void *Data, size_t Size)
+{
+	if (Size == 0) return;
+	memcpy(Data, MustReadView(Size), Size);
+}
+
+size_t MappedFileStream::Skip(size_t MaxLength)
+{
+	if (pimpl->m_Pos >= pimpl->m_Size)
+		return 0;
+	size_t Skipped = std::min(MaxLength, pimpl->m_Size - pimpl->m_Pos);
+	pimpl->m_Pos += Skipped;
+	return Skipped;
+}
+
+bool MappedFileStream::End()
+{
+	return (pimpl->m_Pos >= pimpl->m_Size);
+}
+
+size_t MappedFileStream::GetSize()
+{
+	return pimpl->m_Size;
+}
+
+int MappedFileStream::GetPos()
+{
+	return (int)pimpl->m_Pos;
+}
+
+void MappedFileStream::SetPos(int pos)
+{
+	pimpl->m_Pos = (size_t)pos;
+}
+
+const char * MappedFileStream::GetData()
+{
+	return pimpl->m_Data;
+}
+
+const char * MappedFileStream::GetView(size_t Offset, size_t Length)
+{
+	if (Offset > pimpl->m_Size || Length > pimpl->m_Size - Offset)
+		pimpl->ThrowViewError(Offset, Length);
+	return pimpl->m_Data + Offset;
+}
+
+const char * MappedFileStream::MustReadView(size_t Length)
+{
+	const char *R = GetView(pimpl->m_Pos, Length);
+	pimpl->m_Pos += Length;
+	return R;
+}
+
+
 //HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
 // Klasa DirLister
 
@@ -452,6 +856,691 @@ bool DirLister::ReadNext(string *OutName, FILE_ITEM_TYPE *OutType)
 }
 
 
+//HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
+// Funkcja ScanDirectory
+
+class DirScanner;
+
+class DirScanThread : public Thread
+{
+private:
+	DirScanner *m_Owner;
+
+protected:
+	virtual void Run();
+
+public:
+	DirScanThread(DirScanner *Owner) : m_Owner(Owner) { }
+};
+
+/*
+Wsplny stan przegldania. Katalogi do przejrzenia czekaj na stosie, kady
+wtek zdejmuje jeden, listuje go (z rozmiarami i czasami w tym samym
+przebiegu), wrzuca na stos znalezione podkatalogi i przekazuje elementy do
+callbacka. Koniec, kiedy stos jest pusty i aden wtek nie przeglda katalogu.
+*/
+class DirScanner
+{
+	DECLARE_NO_COPY_CLASS(DirScanner)
+
+private:
+	string m_Mask;
+	uint m_Flags;
+	DirScanCallback *m_Callback;
+
+	Mutex m_Mutex;
+	Cond m_Cond;
+	// Pene cieki katalogw czekajcych na przejrzenie, zakoczone separatorem
+	std::vector<string> m_Stack;
+	// Liczba katalogw na stosie i przegldanych wanie przez wtki
+	uint m_Pending;
+	// Pierwszy bd z ktrego wtku. Jeli niepusty, wtki kocz prac.
+	string m_ErrorMsg;
+
+	// Callback jest wywoywany pod tym muteksem
+	Mutex m_CallbackMutex;
+
+	bool MatchesMask(const char *Name);
+	void AddItem(std::vector<DIR_SCAN_ITEM> *OutItems, const string &Path, FILE_ITEM_TYPE Type);
+	// Listuje jeden katalog
+	void ScanDir(const string &Dir, std::vector<string> *OutSubDirs, std::vector<DIR_SCAN_ITEM> *OutItems);
+
+public:
+	DirScanner(const string &Dir, const string &Mask, uint Flags, DirScanCallback *Callback);
+
+	void ThreadFunc();
+	// Jeli ktry wtek zgosi bd, rzuca go
+	void CheckError();
+};
+
+DirScanner::DirScanner(const string &Dir, const string &Mask, uint Flags, DirScanCallback *Callback) :
+	m_Mask(Mask),
+	m_Flags(Flags),
+	m_Callback(Callback),
+	m_Mutex(0),
+	m_Pending(1),
+	m_CallbackMutex(0)
+{
+	string RootDir;
+	IncludeTrailingPathDelimiter(&RootDir, Dir);
+	m_Stack.push_back(RootDir);
+}
+
+bool DirScanner::MatchesMask(const char *Name)
+{
+	if (m_Mask.empty() || m_Mask == "*")
+		return true;
+	return ValidateWildcard(m_Mask, Name, (m_Flags & DSF_CASE_INSENSITIVE) == 0);
+}
+
+void DirScanner::AddItem(std::vector<DIR_SCAN_ITEM> *OutItems, const string &Path, FILE_ITEM_TYPE Type)
+{
+	OutItems->push_back(DIR_SCAN_ITEM());
+	DIR_SCAN_ITEM &Item = OutItems->back();
+	Item.Path = Path;
+	Item.Type = Type;
+	Item.Size = 0;
+}
+
+#ifdef WIN32
+
+	void DirScanner::ScanDir(const string &Dir, std::vector<string> *OutSubDirs, std::vector<DIR_SCAN_ITEM> *OutItems)
+	{
+		// FindFirstFile od razu zwraca rozmiar i czasy, wic DSF_INFO nic nie kosztuje
+		WIN32_FIND_DATAA FindData;
+		HANDLE Handle = FindFirstFileA((Dir + '*').c_str(), &FindData);
+		if (Handle == INVALID_HANDLE_VALUE)
+		{
+			if (GetLastError() == ERROR_FILE_NOT_FOUND || GetLastError() == ERROR_NO_MORE_FILES)
+				return;
+			throw Win32Error("Nie mona rozpocz listowania katalogu: " + Dir, __FILE__, __LINE__);
+		}
+
+		do
+		{
+			if (strcmp(FindData.cFileName, ".") == 0 || strcmp(FindData.cFileName, "..") == 0)
+				continue;
+
+			bool IsDir = (FindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+			string Path = Dir + FindData.cFileName;
+
+			// Dowizania (reparse point) do katalogw nie s przechodzone
+			if (IsDir && (FindData.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) == 0)
+				OutSubDirs->push_back(Path + DIR_SEP);
+
+			if ((m_Flags & (IsDir ? DSF_DIRS : DSF_FILES)) != 0 && MatchesMask(FindData.cFileName))
+			{
+				AddItem(OutItems, Path, IsDir ? IT_DIR : IT_FILE);
+				if ((m_Flags & DSF_INFO) != 0)
+				{
+					DIR_SCAN_ITEM &Item = OutItems->back();
+					Item.Size = ((uint8)FindData.nFileSizeHigh << 32) | FindData.nFileSizeLow;
+					// FILETIME to setki nanosekund od 1601 roku
+					int8 FileTime = ((int8)FindData.ftLastWriteTime.dwHighDateTime << 32) | FindData.ftLastWriteTime.dwLowDateTime;
+					Item.ModificationTime.m_Time = (FileTime - 116444736000000000) / 10000;
+				}
+			}
+		}
+		while (FindNextFileA(Handle, &FindData) != 0);
+
+		DWORD LastError = GetLastError();
+		FindClose(Handle);
+		if (LastError != ERROR_NO_MORE_FILES)
+		{
+			SetLastError(LastError);
+			throw Win32Error("Nie mona kontynuowa listowania katalogu: " + Dir, __FILE__, __LINE__);
+		}
+	}
+
+#else
+
+	void DirScanner::ScanDir(const string &Dir, std::vector<string> *OutSubDirs, std::vector<DIR_SCAN_ITEM> *OutItems)
+	{
+		DIR *DirHandle = opendir(Dir.c_str());
+		if (DirHandle == NULL)
+			throw ErrnoError("Nie mona rozpocz listowania katalogu: " + Dir, __FILE__, __LINE__);
+		// Deskryptor katalogu dla fstatat - bez rozwizywania caej cieki dla kadego pliku
+		int DirFd = dirfd(DirHandle);
+
+		try
+		{
+			dirent *DirEnt;
+			struct stat S;
+			for (;;)
+			{
+				// Kady wtek ma wasny DIR, wic zwyke readdir wystarcza (readdir_r jest przestarzae).
+				// Koniec od bdu odrnia tylko errno.
+				errno = 0;
+				DirEnt = readdir(DirHandle);
+				if (DirEnt == NULL)
+				{
+					if (errno != 0)
+						throw ErrnoError("Nie mona kontynuowa listowania katalogu: " + Dir, __FILE__, __LINE__);
+					break;
+				}
+				if (strcmp(DirEnt->d_name, ".") == 0 || strcmp(DirEnt->d_name, "..") == 0)
+					continue;
+
+				// Typ zwykle jest w samym wpisie. Niektre systemy plikw go nie podaj, a dowizanie
+				// trzeba rozwiza - dowizanie do katalogu jest katalogiem, jak w Windows.
+				// Wiszce dowizanie jest plikiem.
+				bool IsLink = (DirEnt->d_type == DT_LNK);
+				bool Stated = false, StatOk = false;
+				bool IsDir;
+				if (DirEnt->d_type != DT_UNKNOWN && !IsLink)
+					IsDir = (DirEnt->d_type == DT_DIR);
+				else
+				{
+					Stated = true;
+					StatOk = (fstatat(DirFd, DirEnt->d_name, &S, 0) == 0);
+					IsDir = StatOk && S_ISDIR(S.st_mode);
+					// Przy DT_UNKNOWN nie wiadomo jeszcze, czy to dowizanie
+					if (IsDir && DirEnt->d_type == DT_UNKNOWN)
+					{
+						struct stat LinkS;
+						IsLink = (fstatat(DirFd, DirEnt->d_name, &LinkS, AT_SYMLINK_NOFOLLOW) == 0 && S_ISLNK(LinkS.st_mode));
+					}
+				}
+
+				string Path = Dir + DirEnt->d_name;
+
+				// Dowizania do katalogw nie s przechodzone, jak w Windows
+				if (IsDir && !IsLink)
+					OutSubDirs->push_back(Path + DIR_SEP);
+
+				if ((m_Flags & (IsDir ? DSF_DIRS : DSF_FILES)) != 0 && MatchesMask(DirEnt->d_name))
+				{
+					AddItem(OutItems, Path, IsDir ? IT_DIR : IT_FILE);
+					if ((m_Flags & DSF_INFO) != 0)
+					{
+						DIR_SCAN_ITEM &Item = OutItems->back();
+						// Jak GetFileItemInfo - dowizanie daje informacje o wskazywanym pliku.
+						// Wiszce dowizanie - rozmiar 0 i czas 0.
+						if (!Stated)
+							StatOk = (fstatat(DirFd, DirEnt->d_name, &S, 0) == 0);
+						if (StatOk)
+						{
+							Item.Size = S.st_size;
+							Item.ModificationTime = DATETIME(S.st_mtime);
+						}
+						else
+							Item.ModificationTime = DATETIME((time_t)0);
+					}
+				}
+			}
+		}
+		catch (...)
+		{
+			closedir(DirHandle);
+			throw;
+		}
+
+		closedir(DirHandle);
+	}
+
+#endif
+
+void DirScanner::ThreadFunc()
+{
+	std::vector<string> SubDirs;
+	std::vector<DIR_SCAN_ITEM> Items;
+
+	for (;;)
+	{
+		string Dir;
+		{
+			MUTEX_LOCK(&m_Mutex);
+			while (m_Stack.empty() && m_Pending > 0 && m_ErrorMsg.empty())
+				m_Cond.Wait(&m_Mutex);
+			// Koniec albo bd
+			if (m_Stack.empty() || !m_ErrorMsg.empty())
+				return;
+			Dir.swap(m_Stack.back());
+			m_Stack.pop_back();
+		}
+
+		SubDirs.clear();
+		Items.clear();
+		string ErrorMsg;
+		try
+		{
+			ScanDir(Dir, &SubDirs, &Items);
+
+			if (!Items.empty())
+			{
+				MUTEX_LOCK(&m_CallbackMutex);
+				for (size_t i = 0; i < Items.size(); i++)
+					m_Callback->OnItem(Items[i]);
+			}
+		}
+		catch (const Error &e)
+		{
+			e.GetMessage_(&ErrorMsg);
+			if (ErrorMsg.empty())
+				ErrorMsg = "Nieznany bd";
+		}
+		catch (...)
+		{
+			// eby wyjtek nie wylecia poza wtek
+			ErrorMsg = "Nieznany bd";
+		}
+
+		{
+			MUTEX_LOCK(&m_Mutex);
+			for (size_t i = 0; i < SubDirs.size(); i++)
+				m_Stack.push_back(SubDirs[i]);
+			m_Pending += SubDirs.size();
+			m_Pending--;
+			if (!ErrorMsg.empty() && m_ErrorMsg.empty())
+				m_ErrorMsg = ErrorMsg;
+			// Budzi czekajce wtki, jeli jest dla nich praca albo trzeba skoczy
+			if (!SubDirs.empty() || m_Pending == 0 || !m_ErrorMsg.empty())
+				m_Cond.Broadcast();
+		}
+	}
+}
+
+void DirScanner::CheckError()
+{
+	if (!m_ErrorMsg.empty())
+		throw Error("Bd przegldania katalogu: " + m_ErrorMsg, __FILE__, __LINE__);
+}
+
+void DirScanThread::Run()
+{
+	m_Owner->ThreadFunc();
+}
+
+class VectorDirScanCallback : public DirScanCallback
+{
+private:
+	std::vector<DIR_SCAN_ITEM> *m_Out;
+
+public:
+	VectorDirScanCallback(std::vector<DIR_SCAN_ITEM> *Out) : m_Out(Out) { }
+	virtual void OnItem(const DIR_SCAN_ITEM &Item) { m_Out->push_back(Item); }
+};
+
+void ScanDirectory(const string &Dir, const string &Mask, uint Flags, DirScanCallback *Callback, uint ThreadCount)
+{
+	if (ThreadCount == 0)
+		ThreadCount = GetCpuCount();
+
+	DirScanner Scanner(Dir, Mask, Flags, Callback);
+
+	// Wtek wywoujcy te przeglda
+	std::vector<DirScanThread*> Threads;
+	for (uint i = 1; i < ThreadCount; i++)
+	{
+		DirScanThread *T = new DirScanThread(&Scanner);
+		try
+		{
+			T->Start();
+		}
+		catch (...)
+		{
+			// Nie udao si uruchomi wtku - wystarcz te, ktre ju s
+			delete T;
+			break;
+		}
+		Threads.push_back(T);
+	}
+
+	Scanner.ThreadFunc();
+
+	for (size_t i = 0; i < Threads.size(); i++)
+	{
+		Threads[i]->Join();
+		delete Threads[i];
+	}
+
+	Scanner.CheckError();
+}
+
+void ScanDirectory(std::vector<DIR_SCAN_ITEM> *Out, const string &Dir, const string &Mask, uint Flags, uint ThreadCount)
+{
+	VectorDirScanCallback Callback(Out);
+	ScanDirectory(Dir, Mask, Flags, &Callback, ThreadCount);
+}
+
+
+//HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
+// Klasa FileWatcher
+
+class FileWatcherThread : public Thread
+{
+private:
+	FileWatcher_pimpl *m_Owner;
+
+protected:
+	virtual void Run();
+
+public:
+	FileWatcherThread(FileWatcher_pimpl *Owner) : m_Owner(Owner) { }
+};
+
+class FileWatcher_pimpl
+{
+	DECLARE_NO_COPY_CLASS(FileWatcher_pimpl)
+
+private:
+	#ifdef WIN32
+		struct DIR_WATCH
+		{
+			string Dir;
+			HANDLE Handle;
+			OVERLAPPED Overlapped;
+			// Musi by wyrwnany do DWORD
+			DWORD Buf[16*1024];
+		};
+
+		HANDLE m_Port;
+		std::vector<DIR_WATCH*> m_Dirs;
+		// Ustawiana w destruktorze - wtek przestaje ponawia odczyt
+		bool m_Stopping;
+		// Liczba zleconych odczytw, ktrych zakoczenie jeszcze nie przyszo do portu.
+		// Do tego czasu system moe pisa do ich OVERLAPPED i buforw.
+		uint m_PendingReads;
+
+		// Zleca asynchroniczne odczytanie nastpnej porcji zmian
+		bool IssueRead(DIR_WATCH *Watch);
+	#else
+		int m_Fd;
+		// Zapis do tego potoku budzi wtek, eby si zakoczy
+		int m_StopPipe[2];
+		// Deskryptor obserwowania => katalog (zakoczony separatorem)
+		std::map<int, string> m_Dirs;
+	#endif
+
+	scoped_ptr<FileWatcherThread> m_Thread;
+
+	// Chroni m_Dirs i m_Changes
+	Mutex m_Mutex;
+	std::set<string> m_Changes;
+	// Czy m_Changes jest niepuste. Czytana bez muteksu, eby GetChanges nic nie kosztowao,
+	// kiedy nic si nie zmienio.
+	volatile bool m_HasChanges;
+
+	void AddChange(const string &Path);
+
+public:
+	FileWatcher_pimpl();
+	~FileWatcher_pimpl();
+
+	void AddDir(const string &Dir);
+	bool GetChanges(STRING_VECTOR *Out);
+	void ThreadFunc();
+};
+
+void FileWatcher_pimpl::AddChange(const string &Path)
+{
+	MUTEX_LOCK(&m_Mutex);
+	m_Changes.insert(Path);
+	m_HasChanges = true;
+}
+
+bool FileWatcher_pimpl::GetChanges(STRING_VECTOR *Out)
+{
+	if (!m_HasChanges)
+		return false;
+
+	MUTEX_LOCK(&m_Mutex);
+	Out->insert(Out->end(), m_Changes.begin(), m_Changes.end());
+	bool R = !m_Changes.empty();
+	m_Changes.clear();
+	m_HasChanges = false;
+	return R;
+}
+
+#ifdef WIN32
+
+	FileWatcher_pimpl::FileWatcher_pimpl() :
+		m_Stopping(false),
+		m_PendingReads(0),
+		m_Mutex(0),
+		m_HasChanges(false)
+	{
+		m_Port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
+		if (m_Port == NULL)
+			throw Win32Error("Nie mona utworzy portu zakoczenia dla FileWatcher", __FILE__, __LINE__);
+		m_Thread.reset(new FileWatcherThread(this));
+		m_Thread->Start();
+	}
+
+	FileWatcher_pimpl::~FileWatcher_pimpl()
+	{
+		// Anulowanie przerywa oczekujce odczyty, ale ich zakoczenia mog przyj do portu
+		// w dowolnej kolejnoci wzgldem pakietu zatrzymujcego. Wtek koczy si dopiero,
+		// kiedy przyszy wszystkie - wtedy system ju nie pisze do buforw.
+		{
+			MUTEX_LOCK(&m_Mutex);
+			m_Stopping = true;
+			for (size_t i = 0; i < m_Dirs.size(); i++)
+				CancelIoEx(m_Dirs[i]->Handle, NULL);
+		}
+		PostQueuedCompletionStatus(m_Port, 0, 0, NULL);
+		m_Thread->Join();
+
+		for (size_t i = 0; i < m_Dirs.size(); i++)
+		{
+			CloseHandle(m_Dirs[i]->Handle);
+			delete m_Dirs[i];
+		}
+		CloseHandle(m_Port);
+	}
+
+	bool FileWatcher_pimpl::IssueRead(DIR_WATCH *Watch)
+	{
+		ZeroMemory(&Watch->Overlapped, sizeof(Watch->Overlapped));
+		return ReadDirectoryChangesW(
+			Watch->Handle, Watch->Buf, sizeof(Watch->Buf), FALSE,
+			FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME,
+			NULL, &Watch->Overlapped, NULL) != 0;
+	}
+
+	void FileWatcher_pimpl::AddDir(const string &Dir)
+	{
+		string DirWithSep;
+		IncludeTrailingPathDelimiter(&DirWithSep, Dir);
+
+		MUTEX_LOCK(&m_Mutex);
+
+		for (size_t i = 0; i < m_Dirs.size(); i++)
+			if (m_Dirs[i]->Dir == DirWithSep)
+				return;
+
+		HANDLE Handle = CreateFileA(
+			DirWithSep.c_str(), FILE_LIST_DIRECTORY,
+			FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+			OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+		if (Handle == INVALID_HANDLE_VALUE)
+			throw Win32Error("Nie mona otworzy katalogu do obserwowania: " + Dir, __FILE__, __LINE__);
+
+		DIR_WATCH *Watch = new DIR_WATCH;
+		Watch->Dir = DirWithSep;
+		Watch->Handle = Handle;
+
+		if (CreateIoCompletionPort(Handle, m_Port, (ULONG_PTR)Watch, 0) == NULL || !IssueRead(Watch))
+		{
+			CloseHandle(Handle);
+			delete Watch;
+			throw Win32Error("Nie mona rozpocz obserwowania katalogu: " + Dir, __FILE__, __LINE__);
+		}
+
+		m_Dirs.push_back(Watch);
+		m_PendingReads++;
+	}
+
+	void FileWatcher_pimpl::ThreadFunc()
+	{
+		for (;;)
+		{
+			DWORD Bytes;
+			ULONG_PTR Key;
+			OVERLAPPED *Overlapped;
+			BOOL Ok = GetQueuedCompletionStatus(m_Port, &Bytes, &Key, &Overlapped, INFINITE);
+			// Pakiet zatrzymujcy
+			if (Key == 0)
+			{
+				MUTEX_LOCK(&m_Mutex);
+				if (m_PendingReads == 0)
+					break;
+				continue;
+			}
+
+			DIR_WATCH *Watch = (DIR_WATCH*)Key;
+			// Bytes == 0 to przepenienie bufora systemowego - te zmiany przepady
+			if (Ok && Bytes > 0)
+			{
+				const char *Ptr = (const char*)Watch->Buf;
+				for (;;)
+				{
+					const FILE_NOTIFY_INFORMATION *Info = (const FILE_NOTIFY_INFORMATION*)Ptr;
+					if (Info->Action == FILE_ACTION_MODIFIED || Info->Action == FILE_ACTION_ADDED || Info->Action == FILE_ACTION_RENAMED_NEW_NAME)
+					{
+						char Name[MAX_PATH];
+						int Len = WideCharToMultiByte(CP_ACP, 0, Info->FileName, Info->FileNameLength / sizeof(WCHAR), Name, MAX_PATH, NULL, NULL);
+						if (Len > 0)
+							AddChange(Watch->Dir + string(Name, Len));
+					}
+					if (Info->NextEntryOffset == 0)
+						break;
+					Ptr += Info->NextEntryOffset;
+				}
+			}
+
+			MUTEX_LOCK(&m_Mutex);
+			m_PendingReads--;
+			if (m_Stopping)
+			{
+				if (m_PendingReads == 0)
+					break;
+			}
+			else if (IssueRead(Watch))
+				m_PendingReads++;
+		}
+	}
+
+#else
+
+	FileWatcher_pimpl::FileWatcher_pimpl() :
+		m_Mutex(0),
+		m_HasChanges(false)
+	{
+		m_Fd = inotify_init();
+		if (m_Fd < 0)
+			throw ErrnoError("Nie mona zainicjalizowa inotify", __FILE__, __LINE__);
+		if (pipe(m_StopPipe) != 0)
+		{
+			close(m_Fd);
+			throw ErrnoError("Nie mona utworzy potoku dla FileWatcher", __FILE__, __LINE__);
+		}
+		m_Thread.reset(new FileWatcherThread(this));
+		m_Thread->Start();
+	}
+
+	FileWatcher_pimpl::~FileWatcher_pimpl()
+	{
+		char Byte = 0;
+		write(m_StopPipe[1], &Byte, 1);
+		m_Thread->Join();
+
+		close(m_StopPipe[0]);
+		close(m_StopPipe[1]);
+		// Zamknicie deskryptora inotify usuwa wszystkie obserwowania
+		close(m_Fd);
+	}
+
+	void FileWatcher_pimpl::AddDir(const string &Dir)
+	{
+		string DirWithSep;
+		IncludeTrailingPathDelimiter(&DirWithSep, Dir);
+
+		// IN_CLOSE_WRITE zamiast IN_MODIFY - jeden raz po zapisie caego pliku, a nie przy kadym write
+		int Wd = inotify_add_watch(m_Fd, DirWithSep.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_ONLYDIR);
+		if (Wd < 0)
+			throw ErrnoError("Nie mona rozpocz obserwowania katalogu: " + Dir, __FILE__, __LINE__);
+
+		MUTEX_LOCK(&m_Mutex);
+		// Ten sam katalog dostaje ten sam deskryptor, wic nic si nie podwaja
+		m_Dirs[Wd] = DirWithSep;
+	}
+
+	void FileWatcher_pimpl::ThreadFunc()
+	{
+		// Wyrwnany do struktury zdarzenia
+		struct inotify_event Buf[4096 / sizeof(struct inotify_event) + 1];
+
+		for (;;)
+		{
+			pollfd Fds[2];
+			Fds[0].fd = m_Fd;
+			Fds[0].events = POLLIN;
+			Fds[1].fd = m_StopPipe[0];
+			Fds[1].events = POLLIN;
+			if (poll(Fds, 2, -1) < 0)
+			{
+				if (errno == EINTR)
+					continue;
+				break;
+			}
+			if (Fds[1].revents != 0)
+				break;
+			if ((Fds[0].revents & POLLIN) == 0)
+				continue;
+
+			ssize_t Len = read(m_Fd, Buf, sizeof(Buf));
+			if (Len <= 0)
+				continue;
+
+			const char *Ptr = (const char*)Buf, *End = Ptr + Len;
+			while (Ptr < End)
+			{
+				const struct inotify_event *Event = (const struct inotify_event*)Ptr;
+				if (Event->len > 0 && (Event->mask & IN_ISDIR) == 0)
+				{
+					string Dir;
+					{
+						MUTEX_LOCK(&m_Mutex);
+						std::map<int, string>::iterator it = m_Dirs.find(Event->wd);
+						if (it != m_Dirs.end())
+							Dir = it->second;
+					}
+					if (!Dir.empty())
+						AddChange(Dir + Event->name);
+				}
+				Ptr += sizeof(struct inotify_event) + Event->len;
+			}
+		}
+	}
+
+#endif
+
+void FileWatcherThread::Run()
+{
+	m_Owner->ThreadFunc();
+}
+
+FileWatcher::FileWatcher() :
+	pimpl(new FileWatcher_pimpl)
+{
+}
+
+FileWatcher::~FileWatcher()
+{
+}
+
+void FileWatcher::AddDir(const string &Dir)
+{
+	pimpl->AddDir(Dir);
+}
+
+bool FileWatcher::GetChanges(STRING_VECTOR *Out)
+{
+	return pimpl->GetChanges(Out);
+}
+
+
 //HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
 // Funkcje globalne
 
@@ -13,13 +13,12 @@
 #define COMMON_FILES_H_
 
 #include "Stream.hpp"
+#include "DateTime.hpp"
 
 
 namespace common
 {
 
-struct DATETIME;
-
 // Rodzaj elementu systemu plikw
 enum FILE_ITEM_TYPE
 {
@@ -78,6 +77,10 @@ public:
 	virtual void Write(const void *Data, size_t Size);
 	virtual size_t Read(void *Data, size_t Size);
 	virtual void Flush();
+	// Due porcje danych id jednym wywoaniem systemowym (writev/readv, a pod
+	// Windows przez bufor poredni), mae - przez zwyky Write/Read.
+	virtual void WriteV(const STREAM_WRITE_BUF *Bufs, size_t Count);
+	virtual size_t ReadV(const STREAM_READ_BUF *Bufs, size_t Count);
 	virtual size_t GetSize();
 	virtual int GetPos();
 	virtual void SetPos(int pos);
@@ -88,6 +91,55 @@ public:
 	virtual bool End();
 };
 
+class MappedFile_pimpl;
+
+// Strumie plikowy tylko do odczytu, oparty na odwzorowaniu pliku w pamici (memory-mapped file)
+/*
+- Cay plik jest odwzorowany w pamici na czas ycia obiektu. Odczyt to kopiowanie
+  z pamici, bez wywoa systemowych.
+- Oprcz zwykego odczytu udostpnia widoki - wskaniki prosto do danych pliku,
+  bez kopiowania. S wane do zniszczenia obiektu. Nie musz by wyrwnane.
+- Dopki obiekt istnieje, pliku nie naley modyfikowa.
+- CopyToMemory = true: dane s kopiowane do pamici, a plik zamykany jeszcze
+  w konstruktorze. Odwzorowanego pliku w Windows nie da si nadpisa ani
+  zastpi innym, wic tak trzeba otwiera pliki trzymane dugo, a
+  przeadowywane na gorco po zmianie.
+*/
+class MappedFileStream : public SeekableStream
+{
+private:
+	scoped_ptr<MappedFile_pimpl> pimpl;
+
+public:
+	MappedFileStream(const string &FileName, bool CopyToMemory = false);
+	virtual ~MappedFileStream();
+
+	// ======== Implementacja Stream ========
+	virtual size_t Read(void *Data, size_t Size);
+	virtual void MustRead(void *Data, size_t Size);
+	virtual size_t Skip(size_t MaxLength);
+	virtual bool End();
+
+	// ======== Implementacja SeekableStream ========
+	virtual size_t GetSize();
+	virtual int GetPos();
+	virtual void SetPos(int pos);
+
+	// ======== Widoki ========
+	// Zwraca wskanik do pocztku danych pliku
+	// Jeli plik jest pusty, zwraca NULL.
+	const char * GetData();
+	// Zwraca wskanik do Length bajtw od pozycji Offset.
+	// Jeli wychodz poza koniec pliku, zgasza bd.
+	const char * GetView(size_t Offset, size_t Length);
+	// Zwraca wskanik do Length bajtw od biecej pozycji i przesuwa kursor za nie.
+	// Jeli wychodz poza koniec pliku, zgasza bd.
+	const char * MustReadView(size_t Length);
+	// Tak samo, ale dla tablicy Count elementw typu T
+	template <typename T>
+	const T * MustReadView(size_t Count) { return (const T*)MustReadView(Count * sizeof(T)); }
+};
+
 class DirLister_pimpl;
 
 // Klasa do listowania zawartoci katalogu.
@@ -109,6 +161,87 @@ public:
 	bool ReadNext(string *OutName, FILE_ITEM_TYPE *OutType);
 };
 
+// Element znaleziony przez ScanDirectory
+struct DIR_SCAN_ITEM
+{
+	// Pena cieka - katalog podany do ScanDirectory, separator i cieka wzgldna
+	string Path;
+	// IT_DIR lub IT_FILE
+	FILE_ITEM_TYPE Type;
+	// Tylko z flag DSF_INFO, inaczej 0. Dla katalogw niezdefiniowany.
+	uint8 Size;
+	// Tylko z flag DSF_INFO, inaczej niezdefiniowany
+	DATETIME ModificationTime;
+};
+
+// Flagi bitowe dla ScanDirectory. czy operatorem |
+enum DIR_SCAN_FLAGS
+{
+	// Zwracaj pliki
+	DSF_FILES            = 0x01,
+	// Zwracaj katalogi
+	DSF_DIRS             = 0x02,
+	// Pobieraj rozmiar i czas modyfikacji - w tym samym przebiegu co listowanie
+	DSF_INFO             = 0x04,
+	// Maska bez rozrniania wielkoci liter
+	DSF_CASE_INSENSITIVE = 0x08,
+};
+
+// Interfejs odbierajcy elementy znalezione przez ScanDirectory
+class DirScanCallback
+{
+public:
+	virtual ~DirScanCallback() { }
+	// Wywoywana z rnych wtkw, ale nigdy z dwch na raz - nie musi by wielowtkowo bezpieczna.
+	virtual void OnItem(const DIR_SCAN_ITEM &Item) = 0;
+};
+
+// Rekurencyjnie przeglda podany katalog i wszystkie jego podkatalogi
+/*
+- Podkatalogi s rozdzielane midzy ThreadCount wtkw (wliczajc wywoujcy).
+  0 oznacza tyle, ile procesorw (GetCpuCount).
+- Mask to maska nazwy elementu (nie cieki) dla ValidateWildcard, np. "*.qmsh".
+  Pusta albo "*" przepuszcza wszystko. Podkatalogi s przegldane niezalenie od maski.
+- Kolejno zwracanych elementw jest niezdefiniowana. Sam Dir nie jest zwracany.
+- Dowizania symboliczne do katalogw s zwracane jako IT_DIR, ale nie s
+  przechodzone (eby nie zaptli si na dowizaniu do katalogu nadrzdnego).
+- Bd w ktrymkolwiek wtku przerywa przegldanie i jest rzucany jako wyjtek.
+*/
+void ScanDirectory(const string &Dir, const string &Mask, uint Flags, DirScanCallback *Callback, uint ThreadCount = 0);
+// Wersja dopisujca znalezione elementy do wektora
+void ScanDirectory(std::vector<DIR_SCAN_ITEM> *Out, const string &Dir, const string &Mask, uint Flags, uint ThreadCount = 0);
+
+class FileWatcher_pimpl;
+
+// Obserwuje zmiany plikw w wybranych katalogach
+/*
+- Linux: inotify, Windows: ReadDirectoryChangesW z portem zakoczenia (IOCP).
+- Zdarzenia odbiera wtek w tle, ktry pi w funkcji systemowej, dopki nic si
+  nie dzieje. GetChanges sprawdza najpierw sam flag, wic wywoywanie go co
+  klatk nic nie kosztuje.
+- Zgaszane s pliki zapisane, utworzone albo podmienione przez zmian nazwy
+  (edytory czsto zapisuj przez plik tymczasowy). Usunicia nie s zgaszane.
+- Katalogi s obserwowane nierekurencyjnie.
+*/
+class FileWatcher
+{
+	DECLARE_NO_COPY_CLASS(FileWatcher)
+
+private:
+	scoped_ptr<FileWatcher_pimpl> pimpl;
+
+public:
+	FileWatcher();
+	~FileWatcher();
+
+	// Zaczyna obserwowa podany katalog. Jeli ju jest obserwowany, nic nie robi.
+	void AddDir(const string &Dir);
+	// Dopisuje do Out cieki plikw zmienionych od poprzedniego wywoania, kad raz.
+	// cieka to katalog w postaci podanej do AddDir, zakoczony separatorem, i nazwa pliku.
+	// Zwraca true, jeli co dopisaa. Nie blokuje.
+	bool GetChanges(STRING_VECTOR *Out);
+};
+
 
 // Zapisuje podany acuch jako tre pliku
 void SaveStringToFile(const string &FileName, const string &Data);
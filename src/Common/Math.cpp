@@ -8,6 +8,10 @@
  */
 #include "Base.hpp"
 #include <algorithm>
+#ifdef COMMON_SSE2
+	#include <emmintrin.h>
+	#include <immintrin.h>
+#endif
 #include "Math.hpp"
 
 
@@ -661,6 +665,140 @@ const MATRIX MATRIX::IDENTITY = MATRIX(
 	0.0f, 0.0f, 1.0f, 0.0f,
 	0.0f, 0.0f, 0.0f, 1.0f);
 
+#ifdef COMMON_SSE2
+
+// Zapamitane GetCpuFeatures dla Mul, Det i Inverse, ktre s wywoywane bardzo czsto.
+// Przed dynamiczn inicjalizacj tego moduu jest false, co oznacza po prostu wersje zwyke.
+static bool g_MatrixSse = CpuHasFeatures(CPU_FEATURE_SSE | CPU_FEATURE_SSE2);
+
+// Przestawienie skadowych jednego wektora, Out = (v[X], v[Y], v[Z], v[W])
+#define MATRIX_SWIZZLE(v, X, Y, Z, W) _mm_shuffle_ps((v), (v), _MM_SHUFFLE(W, Z, Y, X))
+
+// Kolejno dziaa taka sama jak w wersji zwykej, wic wynik jest identyczny.
+// Out moe by tym samym co m1 lub m2.
+static inline void Mul_SSE(MATRIX *Out, const MATRIX &m1, const MATRIX &m2)
+{
+	__m128 r0 = _mm_loadu_ps(m2.m[0]);
+	__m128 r1 = _mm_loadu_ps(m2.m[1]);
+	__m128 r2 = _mm_loadu_ps(m2.m[2]);
+	__m128 r3 = _mm_loadu_ps(m2.m[3]);
+	for (uint i = 0; i < 4; i++)
+	{
+		__m128 Row = _mm_loadu_ps(m1.m[i]);
+		__m128 R = _mm_add_ps(
+			_mm_add_ps(
+				_mm_add_ps(
+					_mm_mul_ps(MATRIX_SWIZZLE(Row, 0, 0, 0, 0), r0),
+					_mm_mul_ps(MATRIX_SWIZZLE(Row, 1, 1, 1, 1), r1)),
+				_mm_mul_ps(MATRIX_SWIZZLE(Row, 2, 2, 2, 2), r2)),
+			_mm_mul_ps(MATRIX_SWIZZLE(Row, 3, 3, 3, 3), r3));
+		_mm_storeu_ps(Out->m[i], R);
+	}
+}
+
+// Operacje na macierzach 2x2 zapisanych wierszami w jednym wektorze (a b c d)
+// A * B
+static inline __m128 Mat2Mul(__m128 A, __m128 B)
+{
+	return _mm_add_ps(_mm_mul_ps(A, MATRIX_SWIZZLE(B, 0, 3, 0, 3)), _mm_mul_ps(MATRIX_SWIZZLE(A, 1, 0, 3, 2), MATRIX_SWIZZLE(B, 2, 1, 2, 1)));
+}
+// adj(A) * B
+static inline __m128 Mat2AdjMul(__m128 A, __m128 B)
+{
+	return _mm_sub_ps(_mm_mul_ps(MATRIX_SWIZZLE(A, 3, 3, 0, 0), B), _mm_mul_ps(MATRIX_SWIZZLE(A, 1, 1, 2, 2), MATRIX_SWIZZLE(B, 2, 3, 0, 1)));
+}
+// A * adj(B)
+static inline __m128 Mat2MulAdj(__m128 A, __m128 B)
+{
+	return _mm_sub_ps(_mm_mul_ps(A, MATRIX_SWIZZLE(B, 3, 0, 3, 0)), _mm_mul_ps(MATRIX_SWIZZLE(A, 1, 0, 3, 2), MATRIX_SWIZZLE(B, 2, 1, 2, 1)));
+}
+
+// Rozkada macierz na bloki 2x2 | A B |
+//                               | C D |
+// i liczy ich wyznaczniki (|A| |B| |C| |D|), kady powielony na 4 skadowe.
+struct MATRIX_BLOCKS_SSE
+{
+	__m128 A, B, C, D;
+	__m128 DetA, DetB, DetC, DetD;
+	// adj(A) * B, adj(D) * C
+	__m128 A_B, D_C;
+};
+
+static inline void CalcMatrixBlocks_SSE(MATRIX_BLOCKS_SSE *Out, const MATRIX &m)
+{
+	__m128 r0 = _mm_loadu_ps(m.m[0]);
+	__m128 r1 = _mm_loadu_ps(m.m[1]);
+	__m128 r2 = _mm_loadu_ps(m.m[2]);
+	__m128 r3 = _mm_loadu_ps(m.m[3]);
+	Out->A = _mm_movelh_ps(r0, r1);
+	Out->B = _mm_movehl_ps(r1, r0);
+	Out->C = _mm_movelh_ps(r2, r3);
+	Out->D = _mm_movehl_ps(r3, r2);
+
+	__m128 DetSub = _mm_sub_ps(
+		_mm_mul_ps(_mm_shuffle_ps(r0, r2, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(r1, r3, _MM_SHUFFLE(3, 1, 3, 1))),
+		_mm_mul_ps(_mm_shuffle_ps(r0, r2, _MM_SHUFFLE(3, 1, 3, 1)), _mm_shuffle_ps(r1, r3, _MM_SHUFFLE(2, 0, 2, 0))));
+	Out->DetA = MATRIX_SWIZZLE(DetSub, 0, 0, 0, 0);
+	Out->DetB = MATRIX_SWIZZLE(DetSub, 1, 1, 1, 1);
+	Out->DetC = MATRIX_SWIZZLE(DetSub, 2, 2, 2, 2);
+	Out->DetD = MATRIX_SWIZZLE(DetSub, 3, 3, 3, 3);
+
+	Out->A_B = Mat2AdjMul(Out->A, Out->B);
+	Out->D_C = Mat2AdjMul(Out->D, Out->C);
+}
+
+// Wyznacznik caej macierzy ze wzoru na macierz blokow:
+// |M| = |A|*|D| + |B|*|C| - tr(adj(A)*B * adj(D)*C), powielony na 4 skadowe
+static inline __m128 CalcDetFromBlocks_SSE(const MATRIX_BLOCKS_SSE &b)
+{
+	__m128 Det = _mm_add_ps(_mm_mul_ps(b.DetA, b.DetD), _mm_mul_ps(b.DetB, b.DetC));
+	__m128 Tr = _mm_mul_ps(b.A_B, MATRIX_SWIZZLE(b.D_C, 0, 2, 1, 3));
+	Tr = _mm_add_ps(Tr, MATRIX_SWIZZLE(Tr, 2, 3, 0, 1));
+	Tr = _mm_add_ps(Tr, MATRIX_SWIZZLE(Tr, 1, 0, 3, 2));
+	return _mm_sub_ps(Det, Tr);
+}
+
+static inline float Det_SSE(const MATRIX &m)
+{
+	MATRIX_BLOCKS_SSE b;
+	CalcMatrixBlocks_SSE(&b, m);
+	return _mm_cvtss_f32(CalcDetFromBlocks_SSE(b));
+}
+
+static inline bool Inverse_SSE(MATRIX *Out, const MATRIX &m)
+{
+	MATRIX_BLOCKS_SSE b;
+	CalcMatrixBlocks_SSE(&b, m);
+	__m128 Det = CalcDetFromBlocks_SSE(b);
+	if (_mm_cvtss_f32(Det) == 0.0f)
+		return false;
+
+	// Odwrotno = 1/|M| * | X Y |, bloki przed transpozycj dopenie:
+	//                      | Z W |
+	__m128 X = _mm_sub_ps(_mm_mul_ps(b.DetD, b.A), Mat2Mul(b.B, b.D_C));
+	__m128 W = _mm_sub_ps(_mm_mul_ps(b.DetA, b.D), Mat2Mul(b.C, b.A_B));
+	__m128 Y = _mm_sub_ps(_mm_mul_ps(b.DetB, b.C), Mat2MulAdj(b.D, b.A_B));
+	__m128 Z = _mm_sub_ps(_mm_mul_ps(b.DetC, b.B), Mat2MulAdj(b.A, b.D_C));
+
+	// (1/|M|, -1/|M|, -1/|M|, 1/|M|)
+	__m128 RcpDet = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), Det);
+	X = _mm_mul_ps(X, RcpDet);
+	Y = _mm_mul_ps(Y, RcpDet);
+	Z = _mm_mul_ps(Z, RcpDet);
+	W = _mm_mul_ps(W, RcpDet);
+
+	// Dopenienie 2x2 poczone z uoeniem wierszy
+	_mm_storeu_ps(Out->m[0], _mm_shuffle_ps(X, Y, _MM_SHUFFLE(1, 3, 1, 3)));
+	_mm_storeu_ps(Out->m[1], _mm_shuffle_ps(X, Y, _MM_SHUFFLE(0, 2, 0, 2)));
+	_mm_storeu_ps(Out->m[2], _mm_shuffle_ps(Z, W, _MM_SHUFFLE(1, 3, 1, 3)));
+	_mm_storeu_ps(Out->m[3], _mm_shuffle_ps(Z, W, _MM_SHUFFLE(0, 2, 0, 2)));
+	return true;
+}
+
+#undef MATRIX_SWIZZLE
+
+#endif // COMMON_SSE2
+
 MATRIX MATRIX::operator - () const
 {
 	return MATRIX(
@@ -688,6 +826,13 @@ MATRIX MATRIX::operator - (const MATRIX &m) const
 		_41 - m._41, _42 - m._42, _43 - m._43, _44 - m._44);
 }
 
+MATRIX MATRIX::operator * (const MATRIX &m) const
+{
+	MATRIX R;
+	Mul(&R, *this, m);
+	return R;
+}
+
 MATRIX & MATRIX::operator += (const MATRIX &m)
 {
 	_11 += m._11; _12 += m._12; _13 += m._13; _14 += m._14;
@@ -746,26 +891,8 @@ MATRIX & MATRIX::operator /= (float s)
 
 MATRIX & MATRIX::operator *= (const MATRIX &m)
 {
-	MATRIX Tmp = MATRIX(
-		_11 * m._11 + _12 * m._21 + _13 * m._31 + _14 * m._41,
-		_11 * m._12 + _12 * m._22 + _13 * m._32 + _14 * m._42,
-		_11 * m._13 + _12 * m._23 + _13 * m._33 + _14 * m._43,
-		_11 * m._14 + _12 * m._24 + _13 * m._34 + _14 * m._44,
-
-		_21 * m._11 + _22 * m._21 + _23 * m._31 + _24 * m._41,
-		_21 * m._12 + _22 * m._22 + _23 * m._32 + _24 * m._42,
-		_21 * m._13 + _22 * m._23 + _23 * m._33 + _24 * m._43,
-		_21 * m._14 + _22 * m._24 + _23 * m._34 + _24 * m._44,
-
-		_31 * m._11 + _32 * m._21 + _33 * m._31 + _34 * m._41,
-		_31 * m._12 + _32 * m._22 + _33 * m._32 + _34 * m._42,
-		_31 * m._13 + _32 * m._23 + _33 * m._33 + _34 * m._43,
-		_31 * m._14 + _32 * m._24 + _33 * m._34 + _34 * m._44,
-
-		_41 * m._11 + _42 * m._21 + _43 * m._31 + _44 * m._41,
-		_41 * m._12 + _42 * m._22 + _43 * m._32 + _44 * m._42,
-		_41 * m._13 + _42 * m._23 + _43 * m._33 + _44 * m._43,
-		_41 * m._14 + _42 * m._24 + _43 * m._34 + _44 * m._44);
+	MATRIX Tmp;
+	Mul(&Tmp, *this, m);
 	*this = Tmp;
 
 	return *this;
@@ -806,6 +933,14 @@ void Sub(MATRIX *Out, const MATRIX &m1, const MATRIX &m2)
 
 void Mul(MATRIX *Out, const MATRIX &m1, const MATRIX &m2)
 {
+#ifdef COMMON_SSE2
+	if (g_MatrixSse)
+	{
+		Mul_SSE(Out, m1, m2);
+		return;
+	}
+#endif
+
 	Out->_11 = m1._11 * m2._11 + m1._12 * m2._21 + m1._13 * m2._31 + m1._14 * m2._41;
 	Out->_12 = m1._11 * m2._12 + m1._12 * m2._22 + m1._13 * m2._32 + m1._14 * m2._42;
 	Out->_13 = m1._11 * m2._13 + m1._12 * m2._23 + m1._13 * m2._33 + m1._14 * m2._43;
@@ -987,54 +1122,299 @@ void Transform(PLANE *Out, const PLANE &p, const MATRIX &m)
 	Out->d = p.a * m._14 + p.b * m._24 + p.c * m._34 + p.d * m._44;
 }
 
-void TransformArray(VEC3 OutPoints[], const VEC3 InPoints[], size_t PointCount, const MATRIX &M)
+// Rodzaj przeksztacenia w funkcjach tablicowych
+enum TRANSFORM_KIND
 {
-	for (size_t i = 0; i < PointCount; i++)
-		Transform(&OutPoints[i], InPoints[i], M);
+	TRANSFORM_KIND_POINT,  // Transform
+	TRANSFORM_KIND_NORMAL, // TransformNormal
+	TRANSFORM_KIND_COORD   // TransformCoord
+};
+
+// Wejcie przez warto, eby mona byo przeksztaca w miejscu
+static inline void TransformByKind(VEC3 *Out, VEC3 v, const MATRIX &M, TRANSFORM_KIND Kind)
+{
+	switch (Kind)
+	{
+	case TRANSFORM_KIND_POINT:  Transform(Out, v, M); break;
+	case TRANSFORM_KIND_NORMAL: TransformNormal(Out, v, M); break;
+	case TRANSFORM_KIND_COORD:  TransformCoord(Out, v, M); break;
+	}
 }
 
-void TransformArray(VEC3 InOutPoints[], size_t PointCount, const MATRIX &M)
+#ifdef COMMON_SSE2
+
+// Poniej tego rozmiaru wyniku w bajtach zapis idzie normalnie przez cache
+const size_t TRANSFORM_STREAM_MIN_BYTES = 512 * 1024;
+
+// Wczytuje 4 wektory VEC3 lece kolejno w pamici (48 bajtw) i rozkada na skadowe
+static inline void LoadVec3x4(__m128 *X, __m128 *Y, __m128 *Z, const VEC3 *In)
 {
-	VEC3 v;
-	for (size_t i = 0; i < PointCount; i++)
+	const float *f = &In->x;
+	__m128 a = _mm_loadu_ps(f);     // x0 y0 z0 x1
+	__m128 b = _mm_loadu_ps(f + 4); // y1 z1 x2 y2
+	__m128 c = _mm_loadu_ps(f + 8); // z2 x3 y3 z3
+	__m128 t, t2;
+	t  = _mm_shuffle_ps(b, c, _MM_SHUFFLE(0, 1, 0, 2)); // x2 y1 x3 z2
+	*X = _mm_shuffle_ps(a, t, _MM_SHUFFLE(2, 0, 3, 0)); // x0 x1 x2 x3
+	t  = _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 0, 1)); // y0 x0 y1 y1
+	t2 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(0, 2, 0, 3)); // y2 y1 y3 z2
+	*Y = _mm_shuffle_ps(t, t2, _MM_SHUFFLE(2, 0, 2, 0)); // y0 y1 y2 y3
+	t  = _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 1, 0, 2)); // z0 x0 z1 y1
+	*Z = _mm_shuffle_ps(t, c, _MM_SHUFFLE(3, 0, 2, 0)); // z0 z1 z2 z3
+}
+
+// Skada skadowe z powrotem w 3 rejestry z 4 wektorami VEC3 po kolei
+static inline void PackVec3x4(__m128 *A, __m128 *B, __m128 *C, __m128 X, __m128 Y, __m128 Z)
+{
+	*A = _mm_shuffle_ps(_mm_shuffle_ps(X, Y, _MM_SHUFFLE(0, 0, 0, 0)), _mm_shuffle_ps(Z, X, _MM_SHUFFLE(0, 1, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+	*B = _mm_shuffle_ps(_mm_shuffle_ps(Y, Z, _MM_SHUFFLE(0, 1, 0, 1)), _mm_shuffle_ps(X, Y, _MM_SHUFFLE(0, 2, 0, 2)), _MM_SHUFFLE(2, 0, 2, 0));
+	*C = _mm_shuffle_ps(_mm_shuffle_ps(Z, X, _MM_SHUFFLE(0, 3, 0, 2)), _mm_shuffle_ps(Y, Z, _MM_SHUFFLE(0, 3, 0, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+}
+
+// Przeksztaca 4 wektory zapisane jako skadowe. Kolejno dziaa taka sama jak w wersji zwykej.
+static inline void TransformVec3x4(__m128 *X, __m128 *Y, __m128 *Z, const __m128 M[16], TRANSFORM_KIND Kind)
+{
+	__m128 x = *X, y = *Y, z = *Z;
+	__m128 ox = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, M[0]), _mm_mul_ps(y, M[4])), _mm_mul_ps(z, M[ 8]));
+	__m128 oy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, M[1]), _mm_mul_ps(y, M[5])), _mm_mul_ps(z, M[ 9]));
+	__m128 oz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, M[2]), _mm_mul_ps(y, M[6])), _mm_mul_ps(z, M[10]));
+	if (Kind != TRANSFORM_KIND_NORMAL)
+	{
+		ox = _mm_add_ps(ox, M[12]);
+		oy = _mm_add_ps(oy, M[13]);
+		oz = _mm_add_ps(oz, M[14]);
+	}
+	if (Kind == TRANSFORM_KIND_COORD)
 	{
-		Transform(&v, InOutPoints[i], M);
-		InOutPoints[i] = v;
+		__m128 ow = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, M[3]), _mm_mul_ps(y, M[7])), _mm_mul_ps(z, M[11])), M[15]);
+		__m128 wrc = _mm_div_ps(_mm_set1_ps(1.0f), ow);
+		ox = _mm_mul_ps(ox, wrc);
+		oy = _mm_mul_ps(oy, wrc);
+		oz = _mm_mul_ps(oz, wrc);
 	}
+	*X = ox; *Y = oy; *Z = oz;
 }
 
-void TransformNormalArray(VEC3 OutPoints[], const VEC3 InPoints[], size_t PointCount, const MATRIX &M)
+static size_t TransformArray_SSE(VEC3 *Out, const VEC3 *In, size_t Count, const MATRIX &M, TRANSFORM_KIND Kind)
 {
-	for (size_t i = 0; i < PointCount; i++)
-		TransformNormal(&OutPoints[i], InPoints[i], M);
+	__m128 Mv[16];
+	for (uint i = 0; i < 16; i++)
+		Mv[i] = _mm_set1_ps((&M._11)[i]);
+
+	bool Stream = Out != In && ((size_t)Out & 15) == 0 && Count * sizeof(VEC3) >= TRANSFORM_STREAM_MIN_BYTES;
+	size_t i, End = Count & ~(size_t)3;
+	__m128 X, Y, Z, A, B, C;
+	for (i = 0; i < End; i += 4)
+	{
+		LoadVec3x4(&X, &Y, &Z, In + i);
+		TransformVec3x4(&X, &Y, &Z, Mv, Kind);
+		PackVec3x4(&A, &B, &C, X, Y, Z);
+		float *f = &Out[i].x;
+		if (Stream)
+		{
+			_mm_stream_ps(f, A); _mm_stream_ps(f + 4, B); _mm_stream_ps(f + 8, C);
+		}
+		else
+		{
+			_mm_storeu_ps(f, A); _mm_storeu_ps(f + 4, B); _mm_storeu_ps(f + 8, C);
+		}
+	}
+	if (Stream)
+		_mm_sfence();
+	return End;
 }
 
-void TransformNormalArray(VEC3 InOutPoints[], size_t PointCount, const MATRIX &M)
+// Wersja z przeplotem - wektory zbierane pojedynczo, liczone po 4
+static size_t TransformArrayStrided_SSE(char *Data, size_t Stride, size_t Count, const MATRIX &M, TRANSFORM_KIND Kind)
 {
-	VEC3 v;
-	for (size_t i = 0; i < PointCount; i++)
+	__m128 Mv[16];
+	for (uint i = 0; i < 16; i++)
+		Mv[i] = _mm_set1_ps((&M._11)[i]);
+
+	size_t i, End = Count & ~(size_t)3;
+	__m128 X, Y, Z;
+	float Tmp[3][4];
+	for (i = 0; i < End; i += 4)
+	{
+		VEC3 *p0 = (VEC3*)(Data + (i  ) * Stride);
+		VEC3 *p1 = (VEC3*)(Data + (i+1) * Stride);
+		VEC3 *p2 = (VEC3*)(Data + (i+2) * Stride);
+		VEC3 *p3 = (VEC3*)(Data + (i+3) * Stride);
+		X = _mm_setr_ps(p0->x, p1->x, p2->x, p3->x);
+		Y = _mm_setr_ps(p0->y, p1->y, p2->y, p3->y);
+		Z = _mm_setr_ps(p0->z, p1->z, p2->z, p3->z);
+		TransformVec3x4(&X, &Y, &Z, Mv, Kind);
+		_mm_storeu_ps(Tmp[0], X); _mm_storeu_ps(Tmp[1], Y); _mm_storeu_ps(Tmp[2], Z);
+		p0->x = Tmp[0][0]; p0->y = Tmp[1][0]; p0->z = Tmp[2][0];
+		p1->x = Tmp[0][1]; p1->y = Tmp[1][1]; p1->z = Tmp[2][1];
+		p2->x = Tmp[0][2]; p2->y = Tmp[1][2]; p2->z = Tmp[2][2];
+		p3->x = Tmp[0][3]; p3->y = Tmp[1][3]; p3->z = Tmp[2][3];
+	}
+	return End;
+}
+
+// Wczytuje 8 wektorw VEC3 lecych kolejno w pamici (96 bajtw) i rozkada na skadowe.
+// Te same przestawienia co w LoadVec3x4, tylko w obu powkach rejestru na raz.
+COMMON_AVX_FUNCTION static inline void LoadVec3x8(__m256 *X, __m256 *Y, __m256 *Z, const VEC3 *In)
+{
+	const float *f = &In->x;
+	__m256 l0 = _mm256_loadu_ps(f);      // a0 b0
+	__m256 l1 = _mm256_loadu_ps(f + 8);  // c0 a1
+	__m256 l2 = _mm256_loadu_ps(f + 16); // b1 c1
+	__m256 a = _mm256_permute2f128_ps(l0, l1, 0x30); // a0 a1
+	__m256 b = _mm256_permute2f128_ps(l0, l2, 0x21); // b0 b1
+	__m256 c = _mm256_permute2f128_ps(l1, l2, 0x30); // c0 c1
+	__m256 t, t2;
+	t  = _mm256_shuffle_ps(b, c, _MM_SHUFFLE(0, 1, 0, 2));
+	*X = _mm256_shuffle_ps(a, t, _MM_SHUFFLE(2, 0, 3, 0));
+	t  = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 0, 1));
+	t2 = _mm256_shuffle_ps(b, c, _MM_SHUFFLE(0, 2, 0, 3));
+	*Y = _mm256_shuffle_ps(t, t2, _MM_SHUFFLE(2, 0, 2, 0));
+	t  = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(0, 1, 0, 2));
+	*Z = _mm256_shuffle_ps(t, c, _MM_SHUFFLE(3, 0, 2, 0));
+}
+
+// Zapisuje 8 wektorw VEC3 po kolei. Stream wymaga wyrwnania Out do 32 bajtw.
+COMMON_AVX_FUNCTION static inline void StoreVec3x8(VEC3 *Out, __m256 X, __m256 Y, __m256 Z, bool Stream)
+{
+	__m256 a = _mm256_shuffle_ps(_mm256_shuffle_ps(X, Y, _MM_SHUFFLE(0, 0, 0, 0)), _mm256_shuffle_ps(Z, X, _MM_SHUFFLE(0, 1, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+	__m256 b = _mm256_shuffle_ps(_mm256_shuffle_ps(Y, Z, _MM_SHUFFLE(0, 1, 0, 1)), _mm256_shuffle_ps(X, Y, _MM_SHUFFLE(0, 2, 0, 2)), _MM_SHUFFLE(2, 0, 2, 0));
+	__m256 c = _mm256_shuffle_ps(_mm256_shuffle_ps(Z, X, _MM_SHUFFLE(0, 3, 0, 2)), _mm256_shuffle_ps(Y, Z, _MM_SHUFFLE(0, 3, 0, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+	__m256 l0 = _mm256_permute2f128_ps(a, b, 0x20);
+	__m256 l1 = _mm256_permute2f128_ps(c, a, 0x30);
+	__m256 l2 = _mm256_permute2f128_ps(b, c, 0x31);
+	float *f = &Out->x;
+	if (Stream)
+	{
+		_mm256_stream_ps(f, l0); _mm256_stream_ps(f + 8, l1); _mm256_stream_ps(f + 16, l2);
+	}
+	else
 	{
-		TransformNormal(&v, InOutPoints[i], M);
-		InOutPoints[i] = v;
+		_mm256_storeu_ps(f, l0); _mm256_storeu_ps(f + 8, l1); _mm256_storeu_ps(f + 16, l2);
 	}
 }
 
-void TransformCoordArray(VEC3 OutPoints[], const VEC3 InPoints[], size_t PointCount, const MATRIX &M)
+// cieka AVX - 8 wektorw na raz
+COMMON_AVX_FUNCTION static size_t TransformArray_AVX(VEC3 *Out, const VEC3 *In, size_t Count, const MATRIX &M, TRANSFORM_KIND Kind)
 {
-	for (size_t i = 0; i < PointCount; i++)
-		TransformCoord(&OutPoints[i], InPoints[i], M);
+	__m256 Mv[16];
+	for (uint i = 0; i < 16; i++)
+		Mv[i] = _mm256_set1_ps((&M._11)[i]);
+	const __m256 One = _mm256_set1_ps(1.0f);
+
+	bool Stream = Out != In && ((size_t)Out & 31) == 0 && Count * sizeof(VEC3) >= TRANSFORM_STREAM_MIN_BYTES;
+	size_t i, End = Count & ~(size_t)7;
+	__m256 x, y, z, ox, oy, oz, ow, wrc;
+	for (i = 0; i < End; i += 8)
+	{
+		LoadVec3x8(&x, &y, &z, In + i);
+		ox = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, Mv[0]), _mm256_mul_ps(y, Mv[4])), _mm256_mul_ps(z, Mv[ 8]));
+		oy = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, Mv[1]), _mm256_mul_ps(y, Mv[5])), _mm256_mul_ps(z, Mv[ 9]));
+		oz = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, Mv[2]), _mm256_mul_ps(y, Mv[6])), _mm256_mul_ps(z, Mv[10]));
+		if (Kind != TRANSFORM_KIND_NORMAL)
+		{
+			ox = _mm256_add_ps(ox, Mv[12]);
+			oy = _mm256_add_ps(oy, Mv[13]);
+			oz = _mm256_add_ps(oz, Mv[14]);
+		}
+		if (Kind == TRANSFORM_KIND_COORD)
+		{
+			ow = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, Mv[3]), _mm256_mul_ps(y, Mv[7])), _mm256_mul_ps(z, Mv[11])), Mv[15]);
+			wrc = _mm256_div_ps(One, ow);
+			ox = _mm256_mul_ps(ox, wrc);
+			oy = _mm256_mul_ps(oy, wrc);
+			oz = _mm256_mul_ps(oz, wrc);
+		}
+		StoreVec3x8(Out + i, ox, oy, oz, Stream);
+	}
+	if (Stream)
+		_mm_sfence();
+	_mm256_zeroupper();
+	return End;
 }
 
-void TransformCoordArray(VEC3 InOutPoints[], size_t PointCount, const MATRIX &M)
+#endif // COMMON_SSE2
+
+static void TransformArrayByKind(VEC3 *Out, const VEC3 *In, size_t Count, const MATRIX &M, TRANSFORM_KIND Kind)
 {
-	VEC3 v;
-	for (size_t i = 0; i < PointCount; i++)
+	size_t i = 0;
+#ifdef COMMON_SSE2
+	if (CpuHasFeatures(CPU_FEATURE_AVX))
+		i = TransformArray_AVX(Out, In, Count, M, Kind);
+	else if (CpuHasFeatures(CPU_FEATURE_SSE | CPU_FEATURE_SSE2))
+		i = TransformArray_SSE(Out, In, Count, M, Kind);
+#endif
+	for (; i < Count; i++)
+		TransformByKind(&Out[i], In[i], M, Kind);
+}
+
+static void TransformArrayStridedByKind(VEC3 *InOutFirstPoint, size_t Stride, size_t Count, const MATRIX &M, TRANSFORM_KIND Kind)
+{
+	// Wektory le kolejno - mona uy szybszej wersji
+	if (Stride == sizeof(VEC3))
 	{
-		TransformCoord(&v, InOutPoints[i], M);
-		InOutPoints[i] = v;
+		TransformArrayByKind(InOutFirstPoint, InOutFirstPoint, Count, M, Kind);
+		return;
+	}
+
+	char *Data = (char*)InOutFirstPoint;
+	size_t i = 0;
+#ifdef COMMON_SSE2
+	if (CpuHasFeatures(CPU_FEATURE_SSE | CPU_FEATURE_SSE2))
+		i = TransformArrayStrided_SSE(Data, Stride, Count, M, Kind);
+#endif
+	for (; i < Count; i++)
+	{
+		VEC3 *p = (VEC3*)(Data + i * Stride);
+		TransformByKind(p, *p, M, Kind);
 	}
 }
 
+void TransformArray(VEC3 OutPoints[], const VEC3 InPoints[], size_t PointCount, const MATRIX &M)
+{
+	TransformArrayByKind(OutPoints, InPoints, PointCount, M, TRANSFORM_KIND_POINT);
+}
+
+void TransformArray(VEC3 InOutPoints[], size_t PointCount, const MATRIX &M)
+{
+	TransformArrayByKind(InOutPoints, InOutPoints, PointCount, M, TRANSFORM_KIND_POINT);
+}
+
+void TransformNormalArray(VEC3 OutPoints[], const VEC3 InPoints[], size_t PointCount, const MATRIX &M)
+{
+	TransformArrayByKind(OutPoints, InPoints, PointCount, M, TRANSFORM_KIND_NORMAL);
+}
+
+void TransformNormalArray(VEC3 InOutPoints[], size_t PointCount, const MATRIX &M)
+{
+	TransformArrayByKind(InOutPoints, InOutPoints, PointCount, M, TRANSFORM_KIND_NORMAL);
+}
+
+void TransformCoordArray(VEC3 OutPoints[], const VEC3 InPoints[], size_t PointCount, const MATRIX &M)
+{
+	TransformArrayByKind(OutPoints, InPoints, PointCount, M, TRANSFORM_KIND_COORD);
+}
+
+void TransformCoordArray(VEC3 InOutPoints[], size_t PointCount, const MATRIX &M)
+{
+	TransformArrayByKind(InOutPoints, InOutPoints, PointCount, M, TRANSFORM_KIND_COORD);
+}
+
+void TransformArray_Strided(VEC3 *InOutFirstPoint, size_t Stride, size_t PointCount, const MATRIX &M)
+{
+	TransformArrayStridedByKind(InOutFirstPoint, Stride, PointCount, M, TRANSFORM_KIND_POINT);
+}
+
+void TransformNormalArray_Strided(VEC3 *InOutFirstPoint, size_t Stride, size_t PointCount, const MATRIX &M)
+{
+	TransformArrayStridedByKind(InOutFirstPoint, Stride, PointCount, M, TRANSFORM_KIND_NORMAL);
+}
+
+void TransformCoordArray_Strided(VEC3 *InOutFirstPoint, size_t Stride, size_t PointCount, const MATRIX &M)
+{
+	TransformArrayStridedByKind(InOutFirstPoint, Stride, PointCount, M, TRANSFORM_KIND_COORD);
+}
+
 void TransformRay(VEC3 *OutOrigin, VEC3 *OutDir, const VEC3 &RayOrigin, const VEC3 &RayDir, const MATRIX &m)
 {
 	Transform(OutOrigin, RayOrigin, m);
@@ -1485,6 +1865,11 @@ void Lerp(MATRIX *Out, const MATRIX &m1, const MATRIX &m2, float t)
 
 float Det(const MATRIX &m)
 {
+#ifdef COMMON_SSE2
+	if (g_MatrixSse)
+		return Det_SSE(m);
+#endif
+
 	return
 		(m(0, 0) * m(1, 1) - m(1, 0) * m(0, 1)) * (m(2, 2) * m(3, 3) - m(3, 2) * m(2, 3)) - (m(0, 0) * m(2, 1) - m(2, 0) * m(0, 1)) * (m(1, 2) * m(3, 3) - m(3, 2) * m(1, 3)) +
 		(m(0, 0) * m(3, 1) - m(3, 0) * m(0, 1)) * (m(1, 2) * m(2, 3) - m(2, 2) * m(1, 3)) + (m(1, 0) * m(2, 1) - m(2, 0) * m(1, 1)) * (m(0, 2) * m(3, 3) - m(3, 2) * m(0, 3)) -
@@ -1493,6 +1878,11 @@ float Det(const MATRIX &m)
 
 bool Inverse(MATRIX *Out, const MATRIX &m)
 {
+#ifdef COMMON_SSE2
+	if (g_MatrixSse)
+		return Inverse_SSE(Out, m);
+#endif
+
 	float d = Det(m);
 	if (d == 0.0f) return false;
 	d = 1.0f / d;
@@ -1515,6 +1905,39 @@ bool Inverse(MATRIX *Out, const MATRIX &m)
 	return true;
 }
 
+void ConcatHierarchy(MATRIX OutMatrices[], const MATRIX LocalMatrices[], const uint ParentIndices[], size_t Count)
+{
+	size_t i;
+	uint Parent;
+#ifdef COMMON_SSE2
+	if (g_MatrixSse)
+	{
+		for (i = 0; i < Count; i++)
+		{
+			Parent = ParentIndices[i];
+			if (Parent >= i)
+				OutMatrices[i] = LocalMatrices[i];
+			else
+				Mul_SSE(&OutMatrices[i], LocalMatrices[i], OutMatrices[Parent]);
+		}
+		return;
+	}
+#endif
+
+	MATRIX Tmp;
+	for (i = 0; i < Count; i++)
+	{
+		Parent = ParentIndices[i];
+		if (Parent >= i)
+			OutMatrices[i] = LocalMatrices[i];
+		else
+		{
+			Mul(&Tmp, LocalMatrices[i], OutMatrices[Parent]);
+			OutMatrices[i] = Tmp;
+		}
+	}
+}
+
 
 //HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
 // KWATERNION
@@ -2067,6 +2490,7 @@ void Slerp(QUATERNION *Out, const QUATERNION &q0, const QUATERNION &q1, float t)
 		new_q1.y = -new_q1.y;
 		new_q1.z = -new_q1.z;
 		new_q1.w = -new_q1.w;
+		cosOmega = -cosOmega;
 	}
 
 	// Check if they are very close together to protect against divide-by-zero
@@ -4130,11 +4554,35 @@ void SphereBoundingPoints(VEC3 *OutSphereCenter, float *OutSphereRadius, const V
 {
 	assert(PointCount > 0);
 
+	// Punkty skrajne wzdu osi
+	size_t MinIndex[3] = { 0, 0, 0 }, MaxIndex[3] = { 0, 0, 0 };
+	for (size_t i = 1; i < PointCount; i++)
+	{
+		for (uint Axis = 0; Axis < 3; Axis++)
+		{
+			if (Points[i][Axis] < Points[MinIndex[Axis]][Axis]) MinIndex[Axis] = i;
+			if (Points[i][Axis] > Points[MaxIndex[Axis]][Axis]) MaxIndex[Axis] = i;
+		}
+	}
+
+	// Sfera pocztkowa na najdalszej parze
+	uint BestAxis = 0;
+	float BestDistSq = DistanceSq(Points[MinIndex[0]], Points[MaxIndex[0]]);
+	for (uint Axis = 1; Axis < 3; Axis++)
+	{
+		float DistSq = DistanceSq(Points[MinIndex[Axis]], Points[MaxIndex[Axis]]);
+		if (DistSq > BestDistSq)
+		{
+			BestAxis = Axis;
+			BestDistSq = DistSq;
+		}
+	}
+	VEC3 Center; MidPoint(&Center, Points[MinIndex[BestAxis]], Points[MaxIndex[BestAxis]]);
+	float Radius = sqrtf(BestDistSq) * 0.5f;
+
+	// Powikszanie o punkty lece na zewntrz
 	const VEC3 *PtIt = &Points[0];
 	const VEC3 *EndIt = &Points[0] + PointCount;
-	float Radius = 0.f;
-	VEC3 Center = *PtIt++;
-
 	while (PtIt != EndIt)
 	{
 		const VEC3 &Tmp = *PtIt++;
@@ -4154,6 +4602,148 @@ void SphereBoundingPoints(VEC3 *OutSphereCenter, float *OutSphereRadius, const V
 	*OutSphereRadius = Radius;
 }
 
+// Sfera do algorytmu Welzla
+struct MIN_SPHERE
+{
+	VEC3 Center;
+	float RadiusSq;
+
+	// Tolerancja dla bdw zaokrgle - ostateczny promie i tak jest liczony na kocu od nowa
+	bool Contains(const VEC3 &p) const { return DistanceSq(p, Center) <= RadiusSq * (1.0f + 1e-5f) + 1e-10f; }
+};
+
+static void MinSphere2(MIN_SPHERE *Out, const VEC3 &a, const VEC3 &b)
+{
+	MidPoint(&Out->Center, a, b);
+	Out->RadiusSq = DistanceSq(a, b) * 0.25f;
+}
+
+static bool MinSphere3(MIN_SPHERE *Out, const VEC3 &a, const VEC3 &b, const VEC3 &c)
+{
+	VEC3 ab = b - a, ac = c - a;
+	VEC3 n; Cross(&n, ab, ac);
+	float Denom = 2.0f * Dot(n, n);
+	if (Denom <= 1e-12f * LengthSq(ab) * LengthSq(ac))
+		return false;
+	VEC3 t1, t2;
+	Cross(&t1, n, ab);
+	Cross(&t2, ac, n);
+	VEC3 Offset = (t1 * LengthSq(ac) + t2 * LengthSq(ab)) / Denom;
+	Out->Center = a + Offset;
+	Out->RadiusSq = LengthSq(Offset);
+	return true;
+}
+
+static bool MinSphere4(MIN_SPHERE *Out, const VEC3 &a, const VEC3 &b, const VEC3 &c, const VEC3 &d)
+{
+	VEC3 ab = b - a, ac = c - a, ad = d - a;
+	VEC3 c_cd, c_db, c_bc;
+	Cross(&c_cd, ac, ad);
+	Cross(&c_db, ad, ab);
+	Cross(&c_bc, ab, ac);
+	float Det = Dot(ab, c_cd);
+	if (fabsf(Det) <= 1e-6f * Length(ab) * Length(ac) * Length(ad))
+		return false;
+	VEC3 Offset = (c_cd * LengthSq(ab) + c_db * LengthSq(ac) + c_bc * LengthSq(ad)) / (2.0f * Det);
+	Out->Center = a + Offset;
+	Out->RadiusSq = LengthSq(Offset);
+	return true;
+}
+
+// Najmniejsza sfera otaczajca 3 albo 4 punkty, wybierana spord sfer rozpitych na parach i trjkach.
+// Dla przypadkw zdegenerowanych (punkty wspliniowe lub wsppaszczyznowe).
+static void MinSphereOfFew(MIN_SPHERE *Out, const VEC3 p[], uint Count)
+{
+	bool Found = false;
+	MIN_SPHERE S;
+	for (uint i = 0; i < Count; i++)
+	{
+		for (uint j = i+1; j < Count; j++)
+		{
+			for (uint k = j; k < Count; k++)
+			{
+				if (k == j)
+					MinSphere2(&S, p[i], p[j]);
+				else if (!MinSphere3(&S, p[i], p[j], p[k]))
+					continue;
+				if (Found && S.RadiusSq >= Out->RadiusSq)
+					continue;
+				bool ContainsAll = true;
+				for (uint l = 0; l < Count; l++)
+				{
+					if (!S.Contains(p[l]))
+					{
+						ContainsAll = false;
+						break;
+					}
+				}
+				if (ContainsAll)
+				{
+					*Out = S;
+					Found = true;
+				}
+			}
+		}
+	}
+	assert(Found);
+}
+
+void SphereBoundingPoints_Exact(VEC3 *OutSphereCenter, float *OutSphereRadius, const VEC3 Points[], size_t PointCount)
+{
+	assert(PointCount > 0);
+
+	// Losowa kolejno daje oczekiwany czas liniowy
+	std::vector<VEC3> P(Points, Points + PointCount);
+	RandomGenerator Rand(0x5EED5EED);
+	for (size_t i = PointCount - 1; i > 0; i--)
+		std::swap(P[i], P[(Rand.RandUint() >> 8) % (i + 1)]);
+
+	MIN_SPHERE S;
+	S.Center = P[0];
+	S.RadiusSq = 0.0f;
+	for (size_t i = 1; i < PointCount; i++)
+	{
+		if (S.Contains(P[i])) continue;
+		// P[i] ley na brzegu
+		S.Center = P[i];
+		S.RadiusSq = 0.0f;
+		for (size_t j = 0; j < i; j++)
+		{
+			if (S.Contains(P[j])) continue;
+			// P[i] i P[j] le na brzegu
+			MinSphere2(&S, P[i], P[j]);
+			for (size_t k = 0; k < j; k++)
+			{
+				if (S.Contains(P[k])) continue;
+				// P[i], P[j] i P[k] le na brzegu
+				if (!MinSphere3(&S, P[i], P[j], P[k]))
+				{
+					VEC3 Few[3] = { P[i], P[j], P[k] };
+					MinSphereOfFew(&S, Few, 3);
+				}
+				for (size_t l = 0; l < k; l++)
+				{
+					if (S.Contains(P[l])) continue;
+					// Sfera wyznaczona przez 4 punkty
+					if (!MinSphere4(&S, P[i], P[j], P[k], P[l]))
+					{
+						VEC3 Few[4] = { P[i], P[j], P[k], P[l] };
+						MinSphereOfFew(&S, Few, 4);
+					}
+				}
+			}
+		}
+	}
+
+	// Promie od nowa, eby na pewno obejmowa wszystkie punkty mimo bdw zaokrgle
+	float MaxDistSq = 0.0f;
+	for (size_t i = 0; i < PointCount; i++)
+		MaxDistSq = std::max(MaxDistSq, DistanceSq(Points[i], S.Center));
+
+	*OutSphereCenter = S.Center;
+	*OutSphereRadius = sqrtf(MaxDistSq);
+}
+
 bool SweptSphereToPlane(const VEC3 &SphereCenter, float SphereRadius, const VEC3 &SphereSweepDir, const PLANE &Plane, float *OutT0, float *OutT1)
 {
 	float b_dot_n = DotCoord(Plane, SphereCenter);
@@ -4343,45 +4933,234 @@ void BoxBoundingSpheres(BOX *OutBox, const VEC3 SpheresCenter[], const float Sph
 	}
 }
 
-void RandomPointInUnitSphere(VEC3 *Out, RandomGenerator &Rand)
+// Wartoci i wektory wasne macierzy symetrycznej 3x3 metod Jacobiego.
+// A jest niszczona - na przektnej zostaj wartoci wasne.
+// Kolumny OutVectors to wektory wasne.
+static void SymmetricEigen3(double A[3][3], double OutVectors[3][3])
 {
-	// Dla szecianu (-1,-1,-1)..(1,1,1) objto to 8, dla sfery o promieniu 1 objto to 4/3*PI ~= 4.18.
-	// Tak wic prawdopodobiestwo wylosowania liczby spoza zakresu wynosi 0.4775.
-	// Tak wic oczekiwana liczba iteracji tutaj wynosi nieco poniej 2.
-	do
+	for (uint i = 0; i < 3; i++)
+		for (uint j = 0; j < 3; j++)
+			OutVectors[i][j] = (i == j ? 1.0 : 0.0);
+
+	static const uint Pairs[3][2] = { { 0, 1 }, { 0, 2 }, { 1, 2 } };
+	for (uint Sweep = 0; Sweep < 32; Sweep++)
 	{
-		Out->x = Rand.RandFloat(-1.0f, 1.0f);
-		Out->y = Rand.RandFloat(-1.0f, 1.0f);
-		Out->z = Rand.RandFloat(-1.0f, 1.0f);
+		double Off = A[0][1]*A[0][1] + A[0][2]*A[0][2] + A[1][2]*A[1][2];
+		double Diag = A[0][0]*A[0][0] + A[1][1]*A[1][1] + A[2][2]*A[2][2];
+		if (Off <= 1e-24 * Diag)
+			break;
+
+		for (uint pi = 0; pi < 3; pi++)
+		{
+			uint p = Pairs[pi][0], q = Pairs[pi][1];
+			if (A[p][q] == 0.0)
+				continue;
+			// Obrt zerujcy A[p][q]
+			double Theta = (A[q][q] - A[p][p]) / (2.0 * A[p][q]);
+			double t = (Theta >= 0.0 ? 1.0 : -1.0) / (fabs(Theta) + sqrt(Theta*Theta + 1.0));
+			double c = 1.0 / sqrt(t*t + 1.0), s = t * c;
+			for (uint k = 0; k < 3; k++)
+			{
+				double akp = A[k][p], akq = A[k][q];
+				A[k][p] = c*akp - s*akq;
+				A[k][q] = s*akp + c*akq;
+			}
+			for (uint k = 0; k < 3; k++)
+			{
+				double apk = A[p][k], aqk = A[q][k];
+				A[p][k] = c*apk - s*aqk;
+				A[q][k] = s*apk + c*aqk;
+			}
+			for (uint k = 0; k < 3; k++)
+			{
+				double vkp = OutVectors[k][p], vkq = OutVectors[k][q];
+				OutVectors[k][p] = c*vkp - s*vkq;
+				OutVectors[k][q] = s*vkp + c*vkq;
+			}
+		}
 	}
-	while (Length(*Out) > 1.0f);
 }
 
-void RandomPointInUnitCircle(VEC2 *Out, RandomGenerator &Rand)
+// Wylicza OBB o podanych osiach otaczajcy punkty
+static void CalcObbForAxes(OBB *Out, const VEC3 Axes[3], const VEC3 Points[], size_t PointCount)
 {
-	// Dla kwadatu (-1,-1)..(1,1) powierzchnia to 4, dla koa o promieniu 1 powierzchnia to PI ~= 3.14.
-	// Tak wic prawdopodobiestwo wylosowania liczby spoza zakresu wynosi 0.215.
-	// Tak wic oczekiwana liczba iteracji tutaj wynosi poniej 1.5.
-	do
+	VEC3 MinProj, MaxProj;
+	for (uint a = 0; a < 3; a++)
+		MinProj[a] = MaxProj[a] = Dot(Points[0], Axes[a]);
+	for (size_t i = 1; i < PointCount; i++)
 	{
-		Out->x = Rand.RandFloat(-1.0f, 1.0f);
-		Out->y = Rand.RandFloat(-1.0f, 1.0f);
+		for (uint a = 0; a < 3; a++)
+		{
+			float Proj = Dot(Points[i], Axes[a]);
+			MinProj[a] = std::min(MinProj[a], Proj);
+			MaxProj[a] = std::max(MaxProj[a], Proj);
+		}
+	}
+
+	Out->Center = VEC3::ZERO;
+	for (uint a = 0; a < 3; a++)
+	{
+		Out->Axes[a] = Axes[a];
+		Out->Center += Axes[a] * ((MinProj[a] + MaxProj[a]) * 0.5f);
+		Out->HalfSize[a] = (MaxProj[a] - MinProj[a]) * 0.5f;
 	}
-	while (Length(*Out) > 1.0f);
 }
 
-void RandomPointInCapsule(VEC3 *Out, const VEC3 &p1, const VEC3 &p2, float R, RandomGenerator &Rand)
+// Zwraca true, jeli boks o poowach bokw h1 jest mniejszy ni o h2.
+// Porwnuje objto, a przy rwnej (np. dla paskich zbiorw punktw) pole powierzchni.
+static bool ObbSmaller(const VEC3 &h1, const VEC3 &h2)
 {
-	VEC3 p_vec = p2 - p1; // wektor p1-p2
-	float Help = PI * R * R;
-	float SphereVolume = 4.0f/3.0f * R * Help;
-	float CylinderVolume = Help * Length(p_vec);
-	// Prawdopodobiestwo wylosowania z kuli jest proporcjonalne do stosunku objtoci kuli do objtoci walca.
-	float SphereProbability = SphereVolume / (SphereVolume + CylinderVolume);
-	float RandomNumber = Rand.RandFloat();
-	// Punkt z jednej z pkul
-	if (RandomNumber <= SphereProbability)
-	{
+	float Volume1 = h1.x * h1.y * h1.z, Volume2 = h2.x * h2.y * h2.z;
+	if (Volume1 < Volume2 * (1.0f - 1e-5f))
+		return true;
+	if (Volume2 < Volume1 * (1.0f - 1e-5f))
+		return false;
+	float Area1 = h1.x*h1.y + h1.y*h1.z + h1.z*h1.x;
+	float Area2 = h2.x*h2.y + h2.y*h2.z + h2.z*h2.x;
+	return Area1 < Area2 * (1.0f - 1e-5f);
+}
+
+void ObbBoundingPoints(OBB *Out, const VEC3 Points[], size_t PointCount)
+{
+	assert(PointCount > 0);
+
+	// Macierz kowariancji
+	double Mean[3] = { 0.0, 0.0, 0.0 };
+	for (size_t i = 0; i < PointCount; i++)
+		for (uint a = 0; a < 3; a++)
+			Mean[a] += Points[i][a];
+	for (uint a = 0; a < 3; a++)
+		Mean[a] /= (double)PointCount;
+	double Cov[3][3] = { { 0.0, 0.0, 0.0 }, { 0.0, 0.0, 0.0 }, { 0.0, 0.0, 0.0 } };
+	for (size_t i = 0; i < PointCount; i++)
+	{
+		double d[3] = { Points[i].x - Mean[0], Points[i].y - Mean[1], Points[i].z - Mean[2] };
+		for (uint r = 0; r < 3; r++)
+			for (uint c = r; c < 3; c++)
+				Cov[r][c] += d[r] * d[c];
+	}
+	Cov[1][0] = Cov[0][1]; Cov[2][0] = Cov[0][2]; Cov[2][1] = Cov[1][2];
+
+	// Kierunki gwne
+	double Vectors[3][3];
+	SymmetricEigen3(Cov, Vectors);
+	VEC3 Axes[3];
+	for (uint a = 0; a < 3; a++)
+		Axes[a] = VEC3((float)Vectors[0][a], (float)Vectors[1][a], (float)Vectors[2][a]);
+	// Dla pewnoci ortonormalizacja
+	Normalize(&Axes[0]);
+	Axes[1] -= Axes[0] * Dot(Axes[1], Axes[0]);
+	Normalize(&Axes[1]);
+	Cross(&Axes[2], Axes[0], Axes[1]);
+
+	OBB Best, Candidate;
+	CalcObbForAxes(&Best, Axes, Points, PointCount);
+
+	// AABB bywa lepszy od PCA, np. dla symetrycznych bry
+	const VEC3 WorldAxes[3] = { VEC3::POSITIVE_X, VEC3::POSITIVE_Y, VEC3::POSITIVE_Z };
+	CalcObbForAxes(&Candidate, WorldAxes, Points, PointCount);
+	if (ObbSmaller(Candidate.HalfSize, Best.HalfSize))
+		Best = Candidate;
+
+	// Poprawianie - obroty wok kolejnych osi z coraz mniejszym krokiem, dopki zmniejszaj boks
+	for (uint Iteration = 0; Iteration < 2; Iteration++)
+	{
+		for (uint k = 0; k < 3; k++)
+		{
+			uint a = (k + 1) % 3, b = (k + 2) % 3;
+			float Step = PI_4 * 0.5f;
+			for (uint Try = 0; Try < 64 && Step > 1e-3f; Try++)
+			{
+				bool Improved = false;
+				for (int Dir = -1; Dir <= 1; Dir += 2)
+				{
+					float s = sinf(Step * Dir), c = cosf(Step * Dir);
+					Axes[k] = Best.Axes[k];
+					Axes[a] = Best.Axes[a] * c + Best.Axes[b] * s;
+					Axes[b] = Best.Axes[b] * c - Best.Axes[a] * s;
+					CalcObbForAxes(&Candidate, Axes, Points, PointCount);
+					if (ObbSmaller(Candidate.HalfSize, Best.HalfSize))
+					{
+						Best = Candidate;
+						Improved = true;
+						break;
+					}
+				}
+				if (!Improved)
+					Step *= 0.5f;
+			}
+		}
+	}
+
+	*Out = Best;
+}
+
+void ObbToPoints(VEC3 OutPoints[8], const OBB &Obb)
+{
+	VEC3 x = Obb.Axes[0] * Obb.HalfSize.x;
+	VEC3 y = Obb.Axes[1] * Obb.HalfSize.y;
+	VEC3 z = Obb.Axes[2] * Obb.HalfSize.z;
+	OutPoints[0] = Obb.Center - x - y - z;
+	OutPoints[1] = Obb.Center + x - y - z;
+	OutPoints[2] = Obb.Center - x + y - z;
+	OutPoints[3] = Obb.Center + x + y - z;
+	OutPoints[4] = Obb.Center - x - y + z;
+	OutPoints[5] = Obb.Center + x - y + z;
+	OutPoints[6] = Obb.Center - x + y + z;
+	OutPoints[7] = Obb.Center + x + y + z;
+}
+
+void ObbBoundingBox(BOX *Out, const OBB &Obb)
+{
+	VEC3 Extent;
+	for (uint a = 0; a < 3; a++)
+		Extent[a] =
+			fabsf(Obb.Axes[0][a]) * Obb.HalfSize.x +
+			fabsf(Obb.Axes[1][a]) * Obb.HalfSize.y +
+			fabsf(Obb.Axes[2][a]) * Obb.HalfSize.z;
+	Out->p1 = Obb.Center - Extent;
+	Out->p2 = Obb.Center + Extent;
+}
+
+void RandomPointInUnitSphere(VEC3 *Out, RandomGenerator &Rand)
+{
+	// Dla szecianu (-1,-1,-1)..(1,1,1) objto to 8, dla sfery o promieniu 1 objto to 4/3*PI ~= 4.18.
+	// Tak wic prawdopodobiestwo wylosowania liczby spoza zakresu wynosi 0.4775.
+	// Tak wic oczekiwana liczba iteracji tutaj wynosi nieco poniej 2.
+	do
+	{
+		Out->x = Rand.RandFloat(-1.0f, 1.0f);
+		Out->y = Rand.RandFloat(-1.0f, 1.0f);
+		Out->z = Rand.RandFloat(-1.0f, 1.0f);
+	}
+	while (Length(*Out) > 1.0f);
+}
+
+void RandomPointInUnitCircle(VEC2 *Out, RandomGenerator &Rand)
+{
+	// Dla kwadatu (-1,-1)..(1,1) powierzchnia to 4, dla koa o promieniu 1 powierzchnia to PI ~= 3.14.
+	// Tak wic prawdopodobiestwo wylosowania liczby spoza zakresu wynosi 0.215.
+	// Tak wic oczekiwana liczba iteracji tutaj wynosi poniej 1.5.
+	do
+	{
+		Out->x = Rand.RandFloat(-1.0f, 1.0f);
+		Out->y = Rand.RandFloat(-1.0f, 1.0f);
+	}
+	while (Length(*Out) > 1.0f);
+}
+
+void RandomPointInCapsule(VEC3 *Out, const VEC3 &p1, const VEC3 &p2, float R, RandomGenerator &Rand)
+{
+	VEC3 p_vec = p2 - p1; // wektor p1-p2
+	float Help = PI * R * R;
+	float SphereVolume = 4.0f/3.0f * R * Help;
+	float CylinderVolume = Help * Length(p_vec);
+	// Prawdopodobiestwo wylosowania z kuli jest proporcjonalne do stosunku objtoci kuli do objtoci walca.
+	float SphereProbability = SphereVolume / (SphereVolume + CylinderVolume);
+	float RandomNumber = Rand.RandFloat();
+	// Punkt z jednej z pkul
+	if (RandomNumber <= SphereProbability)
+	{
 		// Losowy wektor
 		VEC3 RandomVec; RandomPointInUnitSphere(&RandomVec, Rand);
 		// Pkula przy p2
@@ -4412,6 +5191,855 @@ void RandomPointInUnitCircle(VEC2 *Out) { RandomPointInUnitCircle(Out, common::g
 void RandomPointInCapsule(VEC3 *Out, const VEC3 &p1, const VEC3 &p2, float R) { RandomPointInCapsule(Out, p1, p2, R, common::g_Rand); }
 
 
+//HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
+// TESTY WSADOWE
+
+void BOX_SOA::Clear()
+{
+	MinX.clear(); MinY.clear(); MinZ.clear();
+	MaxX.clear(); MaxY.clear(); MaxZ.clear();
+}
+
+void BOX_SOA::Reserve(size_t Capacity)
+{
+	MinX.reserve(Capacity); MinY.reserve(Capacity); MinZ.reserve(Capacity);
+	MaxX.reserve(Capacity); MaxY.reserve(Capacity); MaxZ.reserve(Capacity);
+}
+
+void BOX_SOA::Resize(size_t NewSize)
+{
+	MinX.resize(NewSize); MinY.resize(NewSize); MinZ.resize(NewSize);
+	MaxX.resize(NewSize); MaxY.resize(NewSize); MaxZ.resize(NewSize);
+}
+
+void BOX_SOA::Add(const BOX &Box)
+{
+	MinX.push_back(Box.p1.x); MinY.push_back(Box.p1.y); MinZ.push_back(Box.p1.z);
+	MaxX.push_back(Box.p2.x); MaxY.push_back(Box.p2.y); MaxZ.push_back(Box.p2.z);
+}
+
+void BOX_SOA::Set(size_t Index, const BOX &Box)
+{
+	MinX[Index] = Box.p1.x; MinY[Index] = Box.p1.y; MinZ[Index] = Box.p1.z;
+	MaxX[Index] = Box.p2.x; MaxY[Index] = Box.p2.y; MaxZ[Index] = Box.p2.z;
+}
+
+void BOX_SOA::Get(BOX *Out, size_t Index) const
+{
+	Out->p1.x = MinX[Index]; Out->p1.y = MinY[Index]; Out->p1.z = MinZ[Index];
+	Out->p2.x = MaxX[Index]; Out->p2.y = MaxY[Index]; Out->p2.z = MaxZ[Index];
+}
+
+void SPHERE_SOA::Clear()
+{
+	CenterX.clear(); CenterY.clear(); CenterZ.clear(); Radius.clear();
+}
+
+void SPHERE_SOA::Reserve(size_t Capacity)
+{
+	CenterX.reserve(Capacity); CenterY.reserve(Capacity); CenterZ.reserve(Capacity); Radius.reserve(Capacity);
+}
+
+void SPHERE_SOA::Resize(size_t NewSize)
+{
+	CenterX.resize(NewSize); CenterY.resize(NewSize); CenterZ.resize(NewSize); Radius.resize(NewSize);
+}
+
+void SPHERE_SOA::Add(const VEC3 &Center, float a_Radius)
+{
+	CenterX.push_back(Center.x); CenterY.push_back(Center.y); CenterZ.push_back(Center.z); Radius.push_back(a_Radius);
+}
+
+void SPHERE_SOA::Set(size_t Index, const VEC3 &Center, float a_Radius)
+{
+	CenterX[Index] = Center.x; CenterY[Index] = Center.y; CenterZ[Index] = Center.z; Radius[Index] = a_Radius;
+}
+
+// Dla kadej paszczyzny frustuma wskaniki do tablic ze wsprzdnymi
+// wierzchoka boksa najdalej wysunitego w kierunku jej normalnej.
+// Tak samo jak w BoxToFrustum_Fast, tylko wybr jest robiony raz dla caej tablicy.
+struct BOX_ARRAY_PLANES
+{
+	const float *X[6], *Y[6], *Z[6];
+};
+
+static void BuildBoxArrayPlanes(BOX_ARRAY_PLANES *Out,
+	const float MinX[], const float MinY[], const float MinZ[],
+	const float MaxX[], const float MaxY[], const float MaxZ[],
+	const FRUSTUM_PLANES &Frustum)
+{
+	for (uint pi = 0; pi < 6; pi++)
+	{
+		Out->X[pi] = (Frustum.Planes[pi].a <= 0.0f) ? MinX : MaxX;
+		Out->Y[pi] = (Frustum.Planes[pi].b <= 0.0f) ? MinY : MaxY;
+		Out->Z[pi] = (Frustum.Planes[pi].c <= 0.0f) ? MinZ : MaxZ;
+	}
+}
+
+// Przetwarza boksy o indeksach Begin..End-1 bez SIMD. Bity w OutMask musz by wyzerowane.
+static size_t BoxArrayToFrustum_Scalar(uint4 OutMask[], const BOX_ARRAY_PLANES &P, size_t Begin, size_t End, const FRUSTUM_PLANES &Frustum)
+{
+	size_t Count = 0;
+	for (size_t i = Begin; i < End; i++)
+	{
+		uint pi;
+		for (pi = 0; pi < 6; pi++)
+		{
+			const PLANE &Pl = Frustum.Planes[pi];
+			if (Pl.a*P.X[pi][i] + Pl.b*P.Y[pi][i] + Pl.c*P.Z[pi][i] + Pl.d < 0.0f)
+				break;
+		}
+		if (pi == 6)
+		{
+			OutMask[i >> 5] |= 1u << (i & 31);
+			Count++;
+		}
+	}
+	return Count;
+}
+
+static size_t SphereArrayToFrustum_Scalar(uint4 OutMask[],
+	const float CenterX[], const float CenterY[], const float CenterZ[], const float Radius[],
+	size_t Begin, size_t End, const FRUSTUM_PLANES &Frustum)
+{
+	size_t Count = 0;
+	for (size_t i = Begin; i < End; i++)
+	{
+		float MinusRadius = -Radius[i];
+		uint pi;
+		for (pi = 0; pi < 6; pi++)
+		{
+			const PLANE &Pl = Frustum.Planes[pi];
+			if (Pl.a*CenterX[i] + Pl.b*CenterY[i] + Pl.c*CenterZ[i] + Pl.d <= MinusRadius)
+				break;
+		}
+		if (pi == 6)
+		{
+			OutMask[i >> 5] |= 1u << (i & 31);
+			Count++;
+		}
+	}
+	return Count;
+}
+
+#ifdef COMMON_SSE2
+
+// Liczba ustawionych bitw w 8-bitowej masce z movemask
+static inline size_t PopCount8(uint4 x)
+{
+	x = x - ((x >> 1) & 0x55);
+	x = (x & 0x33) + ((x >> 2) & 0x33);
+	return (x + (x >> 4)) & 0x0F;
+}
+
+// cieka SSE - 4 boksy na raz. Zwraca indeks pierwszego nieprzetworzonego boksa przez OutEnd.
+// Porwnanie NLT (nie mniejsze) zamiast GE, eby NaN dawa taki sam wynik jak w wersji zwykej.
+static size_t BoxArrayToFrustum_SSE(uint4 OutMask[], const BOX_ARRAY_PLANES &P, size_t BoxCount, const FRUSTUM_PLANES &Frustum, size_t *OutEnd)
+{
+	__m128 A[6], B[6], C[6], D[6];
+	for (uint pi = 0; pi < 6; pi++)
+	{
+		A[pi] = _mm_set1_ps(Frustum.Planes[pi].a);
+		B[pi] = _mm_set1_ps(Frustum.Planes[pi].b);
+		C[pi] = _mm_set1_ps(Frustum.Planes[pi].c);
+		D[pi] = _mm_set1_ps(Frustum.Planes[pi].d);
+	}
+	const __m128 Zero = _mm_setzero_ps();
+
+	size_t Count = 0, i, End = BoxCount & ~(size_t)3;
+	for (i = 0; i < End; i += 4)
+	{
+		__m128 Visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (uint pi = 0; pi < 6; pi++)
+		{
+			__m128 Dot = _mm_add_ps(
+				_mm_add_ps(
+					_mm_add_ps(
+						_mm_mul_ps(A[pi], _mm_loadu_ps(P.X[pi] + i)),
+						_mm_mul_ps(B[pi], _mm_loadu_ps(P.Y[pi] + i))),
+					_mm_mul_ps(C[pi], _mm_loadu_ps(P.Z[pi] + i))),
+				D[pi]);
+			Visible = _mm_and_ps(Visible, _mm_cmpnlt_ps(Dot, Zero));
+		}
+		uint4 Bits = (uint4)_mm_movemask_ps(Visible);
+		OutMask[i >> 5] |= Bits << (i & 31);
+		Count += PopCount8(Bits);
+	}
+	*OutEnd = End;
+	return Count;
+}
+
+static size_t SphereArrayToFrustum_SSE(uint4 OutMask[],
+	const float CenterX[], const float CenterY[], const float CenterZ[], const float Radius[],
+	size_t SphereCount, const FRUSTUM_PLANES &Frustum, size_t *OutEnd)
+{
+	__m128 A[6], B[6], C[6], D[6];
+	for (uint pi = 0; pi < 6; pi++)
+	{
+		A[pi] = _mm_set1_ps(Frustum.Planes[pi].a);
+		B[pi] = _mm_set1_ps(Frustum.Planes[pi].b);
+		C[pi] = _mm_set1_ps(Frustum.Planes[pi].c);
+		D[pi] = _mm_set1_ps(Frustum.Planes[pi].d);
+	}
+	const __m128 SignMask = _mm_set1_ps(-0.0f);
+
+	size_t Count = 0, i, End = SphereCount & ~(size_t)3;
+	for (i = 0; i < End; i += 4)
+	{
+		__m128 X = _mm_loadu_ps(CenterX + i);
+		__m128 Y = _mm_loadu_ps(CenterY + i);
+		__m128 Z = _mm_loadu_ps(CenterZ + i);
+		__m128 MinusRadius = _mm_xor_ps(_mm_loadu_ps(Radius + i), SignMask);
+		__m128 Visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (uint pi = 0; pi < 6; pi++)
+		{
+			__m128 Dot = _mm_add_ps(
+				_mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(A[pi], X), _mm_mul_ps(B[pi], Y)),
+					_mm_mul_ps(C[pi], Z)),
+				D[pi]);
+			Visible = _mm_and_ps(Visible, _mm_cmpnle_ps(Dot, MinusRadius));
+		}
+		uint4 Bits = (uint4)_mm_movemask_ps(Visible);
+		OutMask[i >> 5] |= Bits << (i & 31);
+		Count += PopCount8(Bits);
+	}
+	*OutEnd = End;
+	return Count;
+}
+
+// cieka AVX - 8 obiektw na raz
+COMMON_AVX_FUNCTION static size_t BoxArrayToFrustum_AVX(uint4 OutMask[], const BOX_ARRAY_PLANES &P, size_t BoxCount, const FRUSTUM_PLANES &Frustum, size_t *OutEnd)
+{
+	__m256 A[6], B[6], C[6], D[6];
+	for (uint pi = 0; pi < 6; pi++)
+	{
+		A[pi] = _mm256_set1_ps(Frustum.Planes[pi].a);
+		B[pi] = _mm256_set1_ps(Frustum.Planes[pi].b);
+		C[pi] = _mm256_set1_ps(Frustum.Planes[pi].c);
+		D[pi] = _mm256_set1_ps(Frustum.Planes[pi].d);
+	}
+	const __m256 Zero = _mm256_setzero_ps();
+
+	size_t Count = 0, i, End = BoxCount & ~(size_t)7;
+	for (i = 0; i < End; i += 8)
+	{
+		__m256 Visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (uint pi = 0; pi < 6; pi++)
+		{
+			__m256 Dot = _mm256_add_ps(
+				_mm256_add_ps(
+					_mm256_add_ps(
+						_mm256_mul_ps(A[pi], _mm256_loadu_ps(P.X[pi] + i)),
+						_mm256_mul_ps(B[pi], _mm256_loadu_ps(P.Y[pi] + i))),
+					_mm256_mul_ps(C[pi], _mm256_loadu_ps(P.Z[pi] + i))),
+				D[pi]);
+			Visible = _mm256_and_ps(Visible, _mm256_cmp_ps(Dot, Zero, _CMP_NLT_UQ));
+		}
+		uint4 Bits = (uint4)_mm256_movemask_ps(Visible);
+		OutMask[i >> 5] |= Bits << (i & 31);
+		Count += PopCount8(Bits);
+	}
+	_mm256_zeroupper();
+	*OutEnd = End;
+	return Count;
+}
+
+COMMON_AVX_FUNCTION static size_t SphereArrayToFrustum_AVX(uint4 OutMask[],
+	const float CenterX[], const float CenterY[], const float CenterZ[], const float Radius[],
+	size_t SphereCount, const FRUSTUM_PLANES &Frustum, size_t *OutEnd)
+{
+	__m256 A[6], B[6], C[6], D[6];
+	for (uint pi = 0; pi < 6; pi++)
+	{
+		A[pi] = _mm256_set1_ps(Frustum.Planes[pi].a);
+		B[pi] = _mm256_set1_ps(Frustum.Planes[pi].b);
+		C[pi] = _mm256_set1_ps(Frustum.Planes[pi].c);
+		D[pi] = _mm256_set1_ps(Frustum.Planes[pi].d);
+	}
+	const __m256 SignMask = _mm256_set1_ps(-0.0f);
+
+	size_t Count = 0, i, End = SphereCount & ~(size_t)7;
+	for (i = 0; i < End; i += 8)
+	{
+		__m256 X = _mm256_loadu_ps(CenterX + i);
+		__m256 Y = _mm256_loadu_ps(CenterY + i);
+		__m256 Z = _mm256_loadu_ps(CenterZ + i);
+		__m256 MinusRadius = _mm256_xor_ps(_mm256_loadu_ps(Radius + i), SignMask);
+		__m256 Visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (uint pi = 0; pi < 6; pi++)
+		{
+			__m256 Dot = _mm256_add_ps(
+				_mm256_add_ps(
+					_mm256_add_ps(_mm256_mul_ps(A[pi], X), _mm256_mul_ps(B[pi], Y)),
+					_mm256_mul_ps(C[pi], Z)),
+				D[pi]);
+			Visible = _mm256_and_ps(Visible, _mm256_cmp_ps(Dot, MinusRadius, _CMP_NLE_UQ));
+		}
+		uint4 Bits = (uint4)_mm256_movemask_ps(Visible);
+		OutMask[i >> 5] |= Bits << (i & 31);
+		Count += PopCount8(Bits);
+	}
+	_mm256_zeroupper();
+	*OutEnd = End;
+	return Count;
+}
+
+#endif // COMMON_SSE2
+
+size_t BoxArrayToFrustum_Fast(
+	uint4 OutMask[],
+	const float MinX[], const float MinY[], const float MinZ[],
+	const float MaxX[], const float MaxY[], const float MaxZ[],
+	size_t BoxCount, const FRUSTUM_PLANES &Frustum)
+{
+	ZeroMem(OutMask, VisibilityMaskSize(BoxCount) * sizeof(uint4));
+
+	BOX_ARRAY_PLANES P;
+	BuildBoxArrayPlanes(&P, MinX, MinY, MinZ, MaxX, MaxY, MaxZ, Frustum);
+
+	size_t Count = 0, Done = 0;
+#ifdef COMMON_SSE2
+	if (CpuHasFeatures(CPU_FEATURE_AVX))
+		Count = BoxArrayToFrustum_AVX(OutMask, P, BoxCount, Frustum, &Done);
+	else if (CpuHasFeatures(CPU_FEATURE_SSE | CPU_FEATURE_SSE2))
+		Count = BoxArrayToFrustum_SSE(OutMask, P, BoxCount, Frustum, &Done);
+#endif
+	return Count + BoxArrayToFrustum_Scalar(OutMask, P, Done, BoxCount, Frustum);
+}
+
+size_t SphereArrayToFrustum_Fast(
+	uint4 OutMask[],
+	const float CenterX[], const float CenterY[], const float CenterZ[], const float Radius[],
+	size_t SphereCount, const FRUSTUM_PLANES &Frustum)
+{
+	ZeroMem(OutMask, VisibilityMaskSize(SphereCount) * sizeof(uint4));
+
+	size_t Count = 0, Done = 0;
+#ifdef COMMON_SSE2
+	if (CpuHasFeatures(CPU_FEATURE_AVX))
+		Count = SphereArrayToFrustum_AVX(OutMask, CenterX, CenterY, CenterZ, Radius, SphereCount, Frustum, &Done);
+	else if (CpuHasFeatures(CPU_FEATURE_SSE | CPU_FEATURE_SSE2))
+		Count = SphereArrayToFrustum_SSE(OutMask, CenterX, CenterY, CenterZ, Radius, SphereCount, Frustum, &Done);
+#endif
+	return Count + SphereArrayToFrustum_Scalar(OutMask, CenterX, CenterY, CenterZ, Radius, Done, SphereCount, Frustum);
+}
+
+// Wersja zwyka dla jednego elementu paczki
+static inline uint RayToTriangleLane(float *OutT, uint Lane,
+	float OX, float OY, float OZ, float DX, float DY, float DZ,
+	const float *X0, const float *Y0, const float *Z0,
+	const float *X1, const float *Y1, const float *Z1,
+	const float *X2, const float *Y2, const float *Z2,
+	uint TriLane, bool BackfaceCulling)
+{
+	return RayToTriangle(VEC3(OX, OY, OZ), VEC3(DX, DY, DZ),
+		VEC3(X0[TriLane], Y0[TriLane], Z0[TriLane]),
+		VEC3(X1[TriLane], Y1[TriLane], Z1[TriLane]),
+		VEC3(X2[TriLane], Y2[TriLane], Z2[TriLane]),
+		BackfaceCulling, &OutT[Lane]) ? (1u << Lane) : 0u;
+}
+
+#ifdef COMMON_SSE2
+
+// Test kolizji promienia z trjktem dla 4 par promie-trjkt na raz.
+// Dziaania dokadnie jak w RayToTriangle, porwnania "nie mniejsze"/"nie wiksze", eby NaN dawa ten sam wynik.
+static inline uint RayToTriangle_SSE(float OutT[4],
+	__m128 OX, __m128 OY, __m128 OZ, __m128 DX, __m128 DY, __m128 DZ,
+	__m128 X0, __m128 Y0, __m128 Z0, __m128 X1, __m128 Y1, __m128 Z1, __m128 X2, __m128 Y2, __m128 Z2,
+	bool BackfaceCulling)
+{
+	const __m128 Zero = _mm_setzero_ps();
+	const __m128 One = _mm_set1_ps(1.0f);
+
+	__m128 E1X = _mm_sub_ps(X1, X0), E1Y = _mm_sub_ps(Y1, Y0), E1Z = _mm_sub_ps(Z1, Z0);
+	__m128 E2X = _mm_sub_ps(X2, X0), E2Y = _mm_sub_ps(Y2, Y0), E2Z = _mm_sub_ps(Z2, Z0);
+
+	__m128 PX = _mm_sub_ps(_mm_mul_ps(DY, E2Z), _mm_mul_ps(DZ, E2Y));
+	__m128 PY = _mm_sub_ps(_mm_mul_ps(DZ, E2X), _mm_mul_ps(DX, E2Z));
+	__m128 PZ = _mm_sub_ps(_mm_mul_ps(DX, E2Y), _mm_mul_ps(DY, E2X));
+
+	__m128 Det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(E1X, PX), _mm_mul_ps(E1Y, PY)), _mm_mul_ps(E1Z, PZ));
+	// FLOAT_ALMOST_ZERO - zerowy wykadnik
+	__m128 Valid = _mm_cmpneq_ps(_mm_and_ps(Det, _mm_castsi128_ps(_mm_set1_epi32(0x7f800000))), Zero);
+	if (BackfaceCulling)
+		Valid = _mm_and_ps(Valid, _mm_cmpnlt_ps(Det, Zero));
+	if (_mm_movemask_ps(Valid) == 0)
+		return 0;
+	__m128 InvDet = _mm_div_ps(One, Det);
+
+	__m128 TX = _mm_sub_ps(OX, X0), TY = _mm_sub_ps(OY, Y0), TZ = _mm_sub_ps(OZ, Z0);
+	__m128 U = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(TX, PX), _mm_mul_ps(TY, PY)), _mm_mul_ps(TZ, PZ)), InvDet);
+	Valid = _mm_and_ps(Valid, _mm_and_ps(_mm_cmpnlt_ps(U, Zero), _mm_cmpngt_ps(U, One)));
+
+	__m128 QX = _mm_sub_ps(_mm_mul_ps(TY, E1Z), _mm_mul_ps(TZ, E1Y));
+	__m128 QY = _mm_sub_ps(_mm_mul_ps(TZ, E1X), _mm_mul_ps(TX, E1Z));
+	__m128 QZ = _mm_sub_ps(_mm_mul_ps(TX, E1Y), _mm_mul_ps(TY, E1X));
+
+	__m128 V = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(DX, QX), _mm_mul_ps(DY, QY)), _mm_mul_ps(DZ, QZ)), InvDet);
+	Valid = _mm_and_ps(Valid, _mm_and_ps(_mm_cmpnlt_ps(V, Zero), _mm_cmpngt_ps(_mm_add_ps(U, V), One)));
+
+	__m128 T = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(E2X, QX), _mm_mul_ps(E2Y, QY)), _mm_mul_ps(E2Z, QZ)), InvDet);
+	_mm_storeu_ps(OutT, T);
+	return (uint)_mm_movemask_ps(Valid);
+}
+
+static uint RayToTriangle4_SSE(float OutT[4], const VEC3 &RayOrig, const VEC3 &RayDir,
+	const float *X0, const float *Y0, const float *Z0,
+	const float *X1, const float *Y1, const float *Z1,
+	const float *X2, const float *Y2, const float *Z2,
+	bool BackfaceCulling)
+{
+	return RayToTriangle_SSE(OutT,
+		_mm_set1_ps(RayOrig.x), _mm_set1_ps(RayOrig.y), _mm_set1_ps(RayOrig.z),
+		_mm_set1_ps(RayDir.x), _mm_set1_ps(RayDir.y), _mm_set1_ps(RayDir.z),
+		_mm_loadu_ps(X0), _mm_loadu_ps(Y0), _mm_loadu_ps(Z0),
+		_mm_loadu_ps(X1), _mm_loadu_ps(Y1), _mm_loadu_ps(Z1),
+		_mm_loadu_ps(X2), _mm_loadu_ps(Y2), _mm_loadu_ps(Z2),
+		BackfaceCulling);
+}
+
+// cieka AVX - 8 trjktw na raz, dziaania jak w RayToTriangle_SSE
+COMMON_AVX_FUNCTION static uint RayToTriangle8_AVX(float OutT[8], const VEC3 &RayOrig, const VEC3 &RayDir, const TRIANGLE_PACKET8 &Tri, bool BackfaceCulling)
+{
+	const __m256 Zero = _mm256_setzero_ps();
+	const __m256 One = _mm256_set1_ps(1.0f);
+
+	__m256 OX = _mm256_set1_ps(RayOrig.x), OY = _mm256_set1_ps(RayOrig.y), OZ = _mm256_set1_ps(RayOrig.z);
+	__m256 DX = _mm256_set1_ps(RayDir.x), DY = _mm256_set1_ps(RayDir.y), DZ = _mm256_set1_ps(RayDir.z);
+	__m256 X0 = _mm256_loadu_ps(Tri.X0), Y0 = _mm256_loadu_ps(Tri.Y0), Z0 = _mm256_loadu_ps(Tri.Z0);
+
+	__m256 E1X = _mm256_sub_ps(_mm256_loadu_ps(Tri.X1), X0), E1Y = _mm256_sub_ps(_mm256_loadu_ps(Tri.Y1), Y0), E1Z = _mm256_sub_ps(_mm256_loadu_ps(Tri.Z1), Z0);
+	__m256 E2X = _mm256_sub_ps(_mm256_loadu_ps(Tri.X2), X0), E2Y = _mm256_sub_ps(_mm256_loadu_ps(Tri.Y2), Y0), E2Z = _mm256_sub_ps(_mm256_loadu_ps(Tri.Z2), Z0);
+
+	__m256 PX = _mm256_sub_ps(_mm256_mul_ps(DY, E2Z), _mm256_mul_ps(DZ, E2Y));
+	__m256 PY = _mm256_sub_ps(_mm256_mul_ps(DZ, E2X), _mm256_mul_ps(DX, E2Z));
+	__m256 PZ = _mm256_sub_ps(_mm256_mul_ps(DX, E2Y), _mm256_mul_ps(DY, E2X));
+
+	__m256 Det = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(E1X, PX), _mm256_mul_ps(E1Y, PY)), _mm256_mul_ps(E1Z, PZ));
+	__m256 Valid = _mm256_cmp_ps(_mm256_and_ps(Det, _mm256_castsi256_ps(_mm256_set1_epi32(0x7f800000))), Zero, _CMP_NEQ_UQ);
+	if (BackfaceCulling)
+		Valid = _mm256_and_ps(Valid, _mm256_cmp_ps(Det, Zero, _CMP_NLT_UQ));
+	uint Result = 0;
+	if (_mm256_movemask_ps(Valid) != 0)
+	{
+		__m256 InvDet = _mm256_div_ps(One, Det);
+
+		__m256 TX = _mm256_sub_ps(OX, X0), TY = _mm256_sub_ps(OY, Y0), TZ = _mm256_sub_ps(OZ, Z0);
+		__m256 U = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(TX, PX), _mm256_mul_ps(TY, PY)), _mm256_mul_ps(TZ, PZ)), InvDet);
+		Valid = _mm256_and_ps(Valid, _mm256_and_ps(_mm256_cmp_ps(U, Zero, _CMP_NLT_UQ), _mm256_cmp_ps(U, One, _CMP_NGT_UQ)));
+
+		__m256 QX = _mm256_sub_ps(_mm256_mul_ps(TY, E1Z), _mm256_mul_ps(TZ, E1Y));
+		__m256 QY = _mm256_sub_ps(_mm256_mul_ps(TZ, E1X), _mm256_mul_ps(TX, E1Z));
+		__m256 QZ = _mm256_sub_ps(_mm256_mul_ps(TX, E1Y), _mm256_mul_ps(TY, E1X));
+
+		__m256 V = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(DX, QX), _mm256_mul_ps(DY, QY)), _mm256_mul_ps(DZ, QZ)), InvDet);
+		Valid = _mm256_and_ps(Valid, _mm256_and_ps(_mm256_cmp_ps(V, Zero, _CMP_NLT_UQ), _mm256_cmp_ps(_mm256_add_ps(U, V), One, _CMP_NGT_UQ)));
+
+		__m256 T = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(E2X, QX), _mm256_mul_ps(E2Y, QY)), _mm256_mul_ps(E2Z, QZ)), InvDet);
+		_mm256_storeu_ps(OutT, T);
+		Result = (uint)_mm256_movemask_ps(Valid);
+	}
+	_mm256_zeroupper();
+	return Result;
+}
+
+#endif // COMMON_SSE2
+
+uint RayToTriangle4(float OutT[4], const VEC3 &RayOrig, const VEC3 &RayDir, const TRIANGLE_PACKET4 &Triangles, bool BackfaceCulling)
+{
+	const TRIANGLE_PACKET4 &T = Triangles;
+#ifdef COMMON_SSE2
+	if (CpuHasFeatures(CPU_FEATURE_SSE | CPU_FEATURE_SSE2))
+		return RayToTriangle4_SSE(OutT, RayOrig, RayDir, T.X0, T.Y0, T.Z0, T.X1, T.Y1, T.Z1, T.X2, T.Y2, T.Z2, BackfaceCulling);
+#endif
+	uint Result = 0;
+	for (uint i = 0; i < 4; i++)
+		Result |= RayToTriangleLane(OutT, i, RayOrig.x, RayOrig.y, RayOrig.z, RayDir.x, RayDir.y, RayDir.z,
+			T.X0, T.Y0, T.Z0, T.X1, T.Y1, T.Z1, T.X2, T.Y2, T.Z2, i, BackfaceCulling);
+	return Result;
+}
+
+uint RayToTriangle8(float OutT[8], const VEC3 &RayOrig, const VEC3 &RayDir, const TRIANGLE_PACKET8 &Triangles, bool BackfaceCulling)
+{
+	const TRIANGLE_PACKET8 &T = Triangles;
+#ifdef COMMON_SSE2
+	if (CpuHasFeatures(CPU_FEATURE_AVX))
+		return RayToTriangle8_AVX(OutT, RayOrig, RayDir, T, BackfaceCulling);
+	if (CpuHasFeatures(CPU_FEATURE_SSE | CPU_FEATURE_SSE2))
+	{
+		// Dwie powki po 4
+		return
+			RayToTriangle4_SSE(OutT, RayOrig, RayDir, T.X0, T.Y0, T.Z0, T.X1, T.Y1, T.Z1, T.X2, T.Y2, T.Z2, BackfaceCulling) |
+			(RayToTriangle4_SSE(OutT + 4, RayOrig, RayDir, T.X0 + 4, T.Y0 + 4, T.Z0 + 4, T.X1 + 4, T.Y1 + 4, T.Z1 + 4, T.X2 + 4, T.Y2 + 4, T.Z2 + 4, BackfaceCulling) << 4);
+	}
+#endif
+	uint Result = 0;
+	for (uint i = 0; i < 8; i++)
+		Result |= RayToTriangleLane(OutT, i, RayOrig.x, RayOrig.y, RayOrig.z, RayDir.x, RayDir.y, RayDir.z,
+			T.X0, T.Y0, T.Z0, T.X1, T.Y1, T.Z1, T.X2, T.Y2, T.Z2, i, BackfaceCulling);
+	return Result;
+}
+
+uint Ray4ToTriangle(float OutT[4], const RAY_PACKET4 &Rays, const VEC3 &p0, const VEC3 &p1, const VEC3 &p2, bool BackfaceCulling)
+{
+	const RAY_PACKET4 &R = Rays;
+#ifdef COMMON_SSE2
+	if (CpuHasFeatures(CPU_FEATURE_SSE | CPU_FEATURE_SSE2))
+	{
+		return RayToTriangle_SSE(OutT,
+			_mm_loadu_ps(R.OrigX), _mm_loadu_ps(R.OrigY), _mm_loadu_ps(R.OrigZ),
+			_mm_loadu_ps(R.DirX), _mm_loadu_ps(R.DirY), _mm_loadu_ps(R.DirZ),
+			_mm_set1_ps(p0.x), _mm_set1_ps(p0.y), _mm_set1_ps(p0.z),
+			_mm_set1_ps(p1.x), _mm_set1_ps(p1.y), _mm_set1_ps(p1.z),
+			_mm_set1_ps(p2.x), _mm_set1_ps(p2.y), _mm_set1_ps(p2.z),
+			BackfaceCulling);
+	}
+#endif
+	uint Result = 0;
+	for (uint i = 0; i < 4; i++)
+		Result |= RayToTriangleLane(OutT, i, R.OrigX[i], R.OrigY[i], R.OrigZ[i], R.DirX[i], R.DirY[i], R.DirZ[i],
+			&p0.x, &p0.y, &p0.z, &p1.x, &p1.y, &p1.z, &p2.x, &p2.y, &p2.z, 0, BackfaceCulling);
+	return Result;
+}
+
+void POSE_SOA::Clear()
+{
+	RotX.clear(); RotY.clear(); RotZ.clear(); RotW.clear();
+	PosX.clear(); PosY.clear(); PosZ.clear();
+	Scaling.clear();
+}
+
+void POSE_SOA::Resize(size_t NewSize)
+{
+	RotX.resize(NewSize); RotY.resize(NewSize); RotZ.resize(NewSize); RotW.resize(NewSize);
+	PosX.resize(NewSize); PosY.resize(NewSize); PosZ.resize(NewSize);
+	Scaling.resize(NewSize);
+}
+
+void POSE_SOA::Set(size_t Index, const QUATERNION &Rot, const VEC3 &Pos, float Scal)
+{
+	RotX[Index] = Rot.x; RotY[Index] = Rot.y; RotZ[Index] = Rot.z; RotW[Index] = Rot.w;
+	PosX[Index] = Pos.x; PosY[Index] = Pos.y; PosZ[Index] = Pos.z;
+	Scaling[Index] = Scal;
+}
+
+void POSE_SOA::SetIdentity(size_t Index)
+{
+	Set(Index, QUATERNION::IDENTITY, VEC3::ZERO, 1.0f);
+}
+
+void POSE_SOA::Get(size_t Index, QUATERNION *OutRot, VEC3 *OutPos, float *OutScal) const
+{
+	OutRot->x = RotX[Index]; OutRot->y = RotY[Index]; OutRot->z = RotZ[Index]; OutRot->w = RotW[Index];
+	OutPos->x = PosX[Index]; OutPos->y = PosY[Index]; OutPos->z = PosZ[Index];
+	*OutScal = Scaling[Index];
+}
+
+// Cosinus poowy kta midzy obrotami, powyej ktrego POSE_BLEND_AUTO uywa Nlerp (ok. 16 stopni)
+static const float POSE_NLERP_MIN_COS = 0.99f;
+// Tak jak w Slerp - powyej tego progu zwyka interpolacja liniowa
+static const float POSE_LERP_MIN_COS = 0.9999f;
+
+// Liczba tablic skadowych w POSE_SOA
+static const uint POSE_COMPONENT_COUNT = 8;
+
+// Wskaniki do skadowych pozy od podanego indeksu, w kolejnoci pl POSE_SOA
+static inline void GetPoseComponents(const float *Out[], const POSE_SOA &Pose, size_t Offset)
+{
+	Out[0] = &Pose.RotX[Offset]; Out[1] = &Pose.RotY[Offset]; Out[2] = &Pose.RotZ[Offset]; Out[3] = &Pose.RotW[Offset];
+	Out[4] = &Pose.PosX[Offset]; Out[5] = &Pose.PosY[Offset]; Out[6] = &Pose.PosZ[Offset];
+	Out[7] = &Pose.Scaling[Offset];
+}
+static inline void GetPoseComponents(float *Out[], POSE_SOA *Pose, size_t Offset)
+{
+	Out[0] = &Pose->RotX[Offset]; Out[1] = &Pose->RotY[Offset]; Out[2] = &Pose->RotZ[Offset]; Out[3] = &Pose->RotW[Offset];
+	Out[4] = &Pose->PosX[Offset]; Out[5] = &Pose->PosY[Offset]; Out[6] = &Pose->PosZ[Offset];
+	Out[7] = &Pose->Scaling[Offset];
+}
+
+static void BlendPoseLane(POSE_SOA *Out, const POSE_SOA &A, const POSE_SOA &B, size_t i, float t, POSE_BLEND_MODE Mode)
+{
+	QUATERNION q0, q1, q;
+	VEC3 p0, p1;
+	float s0, s1;
+	A.Get(i, &q0, &p0, &s0);
+	B.Get(i, &q1, &p1, &s1);
+
+	float CosOmega = Dot(q0, q1);
+	if (Mode == POSE_BLEND_NLERP || (Mode == POSE_BLEND_AUTO && fabsf(CosOmega) > POSE_NLERP_MIN_COS))
+	{
+		if (CosOmega < 0.0f)
+		{
+			q1.x = -q1.x; q1.y = -q1.y; q1.z = -q1.z; q1.w = -q1.w;
+		}
+		float k0 = 1.0f - t;
+		q.x = q0.x*k0 + q1.x*t;
+		q.y = q0.y*k0 + q1.y*t;
+		q.z = q0.z*k0 + q1.z*t;
+		q.w = q0.w*k0 + q1.w*t;
+		Normalize(&q);
+	}
+	else
+		Slerp(&q, q0, q1, t);
+
+	Out->Set(i, q, VEC3(Lerp(p0.x, p1.x, t), Lerp(p0.y, p1.y, t), Lerp(p0.z, p1.z, t)), Lerp(s0, s1, t));
+}
+
+static void PoseToMatrixLane(MATRIX *Out, const POSE_SOA &Pose, size_t i)
+{
+	QUATERNION Rot; VEC3 Pos; float Scal;
+	Pose.Get(i, &Rot, &Pos, &Scal);
+	QuaternionToRotationMatrix(Out, Rot);
+	Out->_11 *= Scal; Out->_12 *= Scal; Out->_13 *= Scal;
+	Out->_21 *= Scal; Out->_22 *= Scal; Out->_23 *= Scal;
+	Out->_31 *= Scal; Out->_32 *= Scal; Out->_33 *= Scal;
+	Out->_41 = Pos.x; Out->_42 = Pos.y; Out->_43 = Pos.z;
+}
+
+#ifdef COMMON_SSE2
+
+static inline __m128 Select_SSE(__m128 Mask, __m128 IfTrue, __m128 IfFalse)
+{
+	return _mm_or_ps(_mm_and_ps(Mask, IfTrue), _mm_andnot_ps(Mask, IfFalse));
+}
+
+// atan(x) dla x z zakresu 0..1 - przyblienie wielomianowe jak w atanf z biblioteki Cephes
+static inline __m128 Atan01_SSE(__m128 x)
+{
+	const __m128 One = _mm_set1_ps(1.0f);
+	// Dla x > tan(PI/8): atan(x) = PI/4 + atan((x-1)/(x+1))
+	__m128 Big = _mm_cmpgt_ps(x, _mm_set1_ps(0.414213562373f));
+	x = Select_SSE(Big, _mm_div_ps(_mm_sub_ps(x, One), _mm_add_ps(x, One)), x);
+	__m128 z = _mm_mul_ps(x, x);
+	__m128 y = _mm_set1_ps(8.05374449538e-2f);
+	y = _mm_sub_ps(_mm_mul_ps(y, z), _mm_set1_ps(1.38776856032e-1f));
+	y = _mm_add_ps(_mm_mul_ps(y, z), _mm_set1_ps(1.99777106478e-1f));
+	y = _mm_sub_ps(_mm_mul_ps(y, z), _mm_set1_ps(3.33329491539e-1f));
+	y = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(y, z), x), x);
+	return _mm_add_ps(y, _mm_and_ps(Big, _mm_set1_ps(PI_4)));
+}
+
+// sin(x) dla x z zakresu 0..PI/2 - szereg Taylora do x^11
+static inline __m128 SinHalfPi_SSE(__m128 x)
+{
+	__m128 z = _mm_mul_ps(x, x);
+	__m128 y = _mm_set1_ps(-2.50521084e-8f);
+	y = _mm_add_ps(_mm_mul_ps(y, z), _mm_set1_ps(2.75573192e-6f));
+	y = _mm_add_ps(_mm_mul_ps(y, z), _mm_set1_ps(-1.98412698e-4f));
+	y = _mm_add_ps(_mm_mul_ps(y, z), _mm_set1_ps(8.33333333e-3f));
+	y = _mm_add_ps(_mm_mul_ps(y, z), _mm_set1_ps(-1.66666667e-1f));
+	return _mm_add_ps(_mm_mul_ps(_mm_mul_ps(y, z), x), x);
+}
+
+// Interpoluje 4 koci. Wskaniki jak z GetPoseComponents.
+static void BlendPose4_SSE(float *const Out[], const float *const A[], const float *const B[], __m128 t, POSE_BLEND_MODE Mode)
+{
+	const __m128 Zero = _mm_setzero_ps();
+	const __m128 One = _mm_set1_ps(1.0f);
+
+	__m128 a[4], b[4];
+	for (uint c = 0; c < 4; c++)
+	{
+		a[c] = _mm_loadu_ps(A[c]);
+		b[c] = _mm_loadu_ps(B[c]);
+	}
+	__m128 CosOmega = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+		_mm_mul_ps(a[0], b[0]), _mm_mul_ps(a[1], b[1])), _mm_mul_ps(a[2], b[2])), _mm_mul_ps(a[3], b[3]));
+	// Krtszy uk - przy ujemnym iloczynie skalarnym odwrcenie znaku drugiego kwaterniona
+	__m128 Sign = _mm_and_ps(_mm_cmplt_ps(CosOmega, Zero), _mm_set1_ps(-0.0f));
+	for (uint c = 0; c < 4; c++)
+		b[c] = _mm_xor_ps(b[c], Sign);
+	CosOmega = _mm_xor_ps(CosOmega, Sign);
+
+	__m128 K0 = _mm_sub_ps(One, t), K1 = t;
+	// Maska koci, dla ktrych wynik jest normalizowany (Nlerp)
+	__m128 NlerpMask;
+	if (Mode == POSE_BLEND_NLERP)
+		NlerpMask = _mm_cmpeq_ps(Zero, Zero);
+	else
+	{
+		__m128 SinOmega = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(One, _mm_mul_ps(CosOmega, CosOmega)), Zero));
+		// atan2(SinOmega, CosOmega) - oba s nieujemne
+		__m128 Swap = _mm_cmpgt_ps(SinOmega, CosOmega);
+		__m128 Omega = Atan01_SSE(_mm_div_ps(_mm_min_ps(SinOmega, CosOmega), _mm_max_ps(SinOmega, CosOmega)));
+		Omega = Select_SSE(Swap, _mm_sub_ps(_mm_set1_ps(PI_2), Omega), Omega);
+		__m128 OneOverSinOmega = _mm_div_ps(One, SinOmega);
+		__m128 SlerpK0 = _mm_mul_ps(SinHalfPi_SSE(_mm_mul_ps(K0, Omega)), OneOverSinOmega);
+		__m128 SlerpK1 = _mm_mul_ps(SinHalfPi_SSE(_mm_mul_ps(t, Omega)), OneOverSinOmega);
+
+		__m128 LinearMask = _mm_cmpgt_ps(CosOmega, _mm_set1_ps(Mode == POSE_BLEND_AUTO ? POSE_NLERP_MIN_COS : POSE_LERP_MIN_COS));
+		K0 = Select_SSE(LinearMask, K0, SlerpK0);
+		K1 = Select_SSE(LinearMask, K1, SlerpK1);
+		NlerpMask = Mode == POSE_BLEND_AUTO ? LinearMask : Zero;
+	}
+
+	__m128 q[4];
+	for (uint c = 0; c < 4; c++)
+		q[c] = _mm_add_ps(_mm_mul_ps(a[c], K0), _mm_mul_ps(b[c], K1));
+	if (Mode != POSE_BLEND_SLERP)
+	{
+		__m128 LengthSq = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(q[0], q[0]), _mm_mul_ps(q[1], q[1])), _mm_mul_ps(q[2], q[2])), _mm_mul_ps(q[3], q[3]));
+		__m128 Factor = Select_SSE(NlerpMask, _mm_div_ps(One, _mm_sqrt_ps(LengthSq)), One);
+		for (uint c = 0; c < 4; c++)
+			q[c] = _mm_mul_ps(q[c], Factor);
+	}
+	for (uint c = 0; c < 4; c++)
+		_mm_storeu_ps(Out[c], q[c]);
+
+	// Przesunicie i skalowanie - Lerp
+	for (uint c = 4; c < POSE_COMPONENT_COUNT; c++)
+	{
+		__m128 va = _mm_loadu_ps(A[c]);
+		__m128 vb = _mm_loadu_ps(B[c]);
+		_mm_storeu_ps(Out[c], _mm_add_ps(va, _mm_mul_ps(t, _mm_sub_ps(vb, va))));
+	}
+}
+
+// Wylicza macierze dla Count <= 4 koci. Wskaniki jak z GetPoseComponents, musz mie dostpne 4 elementy.
+static void PoseToMatrices4_SSE(MATRIX Out[], const float *const P[], size_t Count)
+{
+	const __m128 One = _mm_set1_ps(1.0f);
+	const __m128 Two = _mm_set1_ps(2.0f);
+	__m128 x = _mm_loadu_ps(P[0]), y = _mm_loadu_ps(P[1]), z = _mm_loadu_ps(P[2]), w = _mm_loadu_ps(P[3]);
+	__m128 s = _mm_loadu_ps(P[7]);
+	__m128
+		xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z),
+		xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z),
+		wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+	// Tak jak w QuaternionToRotationMatrix, pomnoone przez skalowanie
+	float R[9][4];
+	_mm_storeu_ps(R[0], _mm_mul_ps(_mm_sub_ps(One, _mm_mul_ps(Two, _mm_add_ps(yy, zz))), s));
+	_mm_storeu_ps(R[1], _mm_mul_ps(_mm_mul_ps(Two, _mm_add_ps(xy, wz)), s));
+	_mm_storeu_ps(R[2], _mm_mul_ps(_mm_mul_ps(Two, _mm_sub_ps(xz, wy)), s));
+	_mm_storeu_ps(R[3], _mm_mul_ps(_mm_mul_ps(Two, _mm_sub_ps(xy, wz)), s));
+	_mm_storeu_ps(R[4], _mm_mul_ps(_mm_sub_ps(One, _mm_mul_ps(Two, _mm_add_ps(xx, zz))), s));
+	_mm_storeu_ps(R[5], _mm_mul_ps(_mm_mul_ps(Two, _mm_add_ps(yz, wx)), s));
+	_mm_storeu_ps(R[6], _mm_mul_ps(_mm_mul_ps(Two, _mm_add_ps(xz, wy)), s));
+	_mm_storeu_ps(R[7], _mm_mul_ps(_mm_mul_ps(Two, _mm_sub_ps(yz, wx)), s));
+	_mm_storeu_ps(R[8], _mm_mul_ps(_mm_sub_ps(One, _mm_mul_ps(Two, _mm_add_ps(xx, yy))), s));
+
+	for (size_t j = 0; j < Count; j++)
+	{
+		MATRIX &M = Out[j];
+		M._11 = R[0][j]; M._12 = R[1][j]; M._13 = R[2][j]; M._14 = 0.0f;
+		M._21 = R[3][j]; M._22 = R[4][j]; M._23 = R[5][j]; M._24 = 0.0f;
+		M._31 = R[6][j]; M._32 = R[7][j]; M._33 = R[8][j]; M._34 = 0.0f;
+		M._41 = P[4][j]; M._42 = P[5][j]; M._43 = P[6][j]; M._44 = 1.0f;
+	}
+}
+
+#endif
+
+// T == NULL oznacza jeden wspczynnik UniformT dla wszystkich koci
+static void BlendPosesImpl(POSE_SOA *Out, const POSE_SOA &A, const POSE_SOA &B, const float T[], float UniformT, POSE_BLEND_MODE Mode)
+{
+	assert(A.Size() == B.Size());
+	size_t Count = A.Size();
+	Out->Resize(Count);
+	if (Count == 0) return;
+
+#ifdef COMMON_SSE2
+	if (g_MatrixSse)
+	{
+		float *OutPtr[POSE_COMPONENT_COUNT];
+		const float *APtr[POSE_COMPONENT_COUNT], *BPtr[POSE_COMPONENT_COUNT];
+		__m128 UniformTV = _mm_set1_ps(UniformT);
+		size_t i = 0;
+		for ( ; i + 4 <= Count; i += 4)
+		{
+			GetPoseComponents(OutPtr, Out, i);
+			GetPoseComponents(APtr, A, i);
+			GetPoseComponents(BPtr, B, i);
+			BlendPose4_SSE(OutPtr, APtr, BPtr, T ? _mm_loadu_ps(T + i) : UniformTV, Mode);
+		}
+		if (i < Count)
+		{
+			// Kocwka przez bufor uzupeniony ostatni koci - eby kada ko bya liczona tak samo
+			size_t Rest = Count - i;
+			float OutBuf[POSE_COMPONENT_COUNT][4], ABuf[POSE_COMPONENT_COUNT][4], BBuf[POSE_COMPONENT_COUNT][4], TBuf[4];
+			GetPoseComponents(APtr, A, i);
+			GetPoseComponents(BPtr, B, i);
+			for (uint j = 0; j < 4; j++)
+			{
+				size_t Src = std::min<size_t>(j, Rest - 1);
+				for (uint c = 0; c < POSE_COMPONENT_COUNT; c++)
+				{
+					ABuf[c][j] = APtr[c][Src];
+					BBuf[c][j] = BPtr[c][Src];
+				}
+				TBuf[j] = T ? T[i + Src] : UniformT;
+			}
+			for (uint c = 0; c < POSE_COMPONENT_COUNT; c++)
+			{
+				APtr[c] = ABuf[c];
+				BPtr[c] = BBuf[c];
+				OutPtr[c] = OutBuf[c];
+			}
+			BlendPose4_SSE(OutPtr, APtr, BPtr, _mm_loadu_ps(TBuf), Mode);
+
+			GetPoseComponents(OutPtr, Out, i);
+			for (uint c = 0; c < POSE_COMPONENT_COUNT; c++)
+				for (size_t j = 0; j < Rest; j++)
+					OutPtr[c][j] = OutBuf[c][j];
+		}
+		return;
+	}
+#endif
+
+	for (size_t i = 0; i < Count; i++)
+		BlendPoseLane(Out, A, B, i, T ? T[i] : UniformT, Mode);
+}
+
+void BlendPoses(POSE_SOA *Out, const POSE_SOA &A, const POSE_SOA &B, const float T[], POSE_BLEND_MODE Mode)
+{
+	BlendPosesImpl(Out, A, B, T, 0.0f, Mode);
+}
+
+void BlendPoses(POSE_SOA *Out, const POSE_SOA &A, const POSE_SOA &B, float T, POSE_BLEND_MODE Mode)
+{
+	BlendPosesImpl(Out, A, B, NULL, T, Mode);
+}
+
+void PoseToMatrices(MATRIX OutMatrices[], const POSE_SOA &Pose)
+{
+	size_t Count = Pose.Size();
+	if (Count == 0) return;
+
+#ifdef COMMON_SSE2
+	if (g_MatrixSse)
+	{
+		const float *Ptr[POSE_COMPONENT_COUNT];
+		size_t i = 0;
+		for ( ; i + 4 <= Count; i += 4)
+		{
+			GetPoseComponents(Ptr, Pose, i);
+			PoseToMatrices4_SSE(OutMatrices + i, Ptr, 4);
+		}
+		if (i < Count)
+		{
+			size_t Rest = Count - i;
+			float Buf[POSE_COMPONENT_COUNT][4];
+			GetPoseComponents(Ptr, Pose, i);
+			for (uint c = 0; c < POSE_COMPONENT_COUNT; c++)
+			{
+				for (uint j = 0; j < 4; j++)
+					Buf[c][j] = Ptr[c][std::min<size_t>(j, Rest - 1)];
+				Ptr[c] = Buf[c];
+			}
+			PoseToMatrices4_SSE(OutMatrices + i, Ptr, Rest);
+		}
+		return;
+	}
+#endif
+
+	for (size_t i = 0; i < Count; i++)
+		PoseToMatrixLane(&OutMatrices[i], Pose, i);
+}
+
+
 //HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
 // Poisson Disc
 
@@ -1986,29 +1986,7 @@ struct MATRIX
 	MATRIX operator - () const;
 	MATRIX operator + (const MATRIX &m) const;
 	MATRIX operator - (const MATRIX &m) const;
-	MATRIX operator * (const MATRIX &m) const
-	{
-		return MATRIX(
-			_11 * m._11 + _12 * m._21 + _13 * m._31 + _14 * m._41,
-			_11 * m._12 + _12 * m._22 + _13 * m._32 + _14 * m._42,
-			_11 * m._13 + _12 * m._23 + _13 * m._33 + _14 * m._43,
-			_11 * m._14 + _12 * m._24 + _13 * m._34 + _14 * m._44,
-
-			_21 * m._11 + _22 * m._21 + _23 * m._31 + _24 * m._41,
-			_21 * m._12 + _22 * m._22 + _23 * m._32 + _24 * m._42,
-			_21 * m._13 + _22 * m._23 + _23 * m._33 + _24 * m._43,
-			_21 * m._14 + _22 * m._24 + _23 * m._34 + _24 * m._44,
-
-			_31 * m._11 + _32 * m._21 + _33 * m._31 + _34 * m._41,
-			_31 * m._12 + _32 * m._22 + _33 * m._32 + _34 * m._42,
-			_31 * m._13 + _32 * m._23 + _33 * m._33 + _34 * m._43,
-			_31 * m._14 + _32 * m._24 + _33 * m._34 + _34 * m._44,
-
-			_41 * m._11 + _42 * m._21 + _43 * m._31 + _44 * m._41,
-			_41 * m._12 + _42 * m._22 + _43 * m._32 + _44 * m._42,
-			_41 * m._13 + _42 * m._23 + _43 * m._33 + _44 * m._43,
-			_41 * m._14 + _42 * m._24 + _43 * m._34 + _44 * m._44);
-	}
+	MATRIX operator * (const MATRIX &m) const;
 	MATRIX & operator += (const MATRIX &m);
 	MATRIX & operator -= (const MATRIX &m);
 	MATRIX & operator *= (const MATRIX &m);
@@ -2043,6 +2021,7 @@ bool MatrixEqual(const MATRIX &m1, const MATRIX &m2);
 // Negacja macierzy w miejscu
 void Minus(MATRIX *m);
 // Dodawanie, odejmowanie, mnoenie macierzy
+// Mul uywa SSE, jeli procesor je obsuguje - wynik jest identyczny jak w wersji zwykej.
 void Add(MATRIX *Out, const MATRIX &m1, const MATRIX &m2);
 void Sub(MATRIX *Out, const MATRIX &m1, const MATRIX &m2);
 void Mul(MATRIX *Out, const MATRIX &m1, const MATRIX &m2);
@@ -2072,12 +2051,21 @@ void TransformCoord(VEC3 *Out, const VEC3 &v, const MATRIX &m);
 void TransformNormal(VEC3 *Out, const VEC3 &v, const MATRIX &m);
 
 // Przeksztaca na raz ca tablic wektorw - w miejscu lub z tablicy wejciowej do wyjciowej
+// - Wynik jest dokadnie taki sam jak z Transform/TransformNormal/TransformCoord dla kadego elementu.
+// - Liczy po 8 (AVX) lub 4 (SSE) wektory na raz, cieka wybierana w czasie wykonania.
+// - Jeli OutPoints jest wyrwnane (do 16 bajtw, przy AVX do 32), a tablica dua, zapis omija cache.
 void TransformArray(VEC3 OutPoints[], const VEC3 InPoints[], size_t PointCount, const MATRIX &M);
 void TransformArray(VEC3 InOutPoints[], size_t PointCount, const MATRIX &M);
 void TransformNormalArray(VEC3 OutPoints[], const VEC3 InPoints[], size_t PointCount, const MATRIX &M);
 void TransformNormalArray(VEC3 InOutPoints[], size_t PointCount, const MATRIX &M);
 void TransformCoordArray(VEC3 OutPoints[], const VEC3 InPoints[], size_t PointCount, const MATRIX &M);
 void TransformCoordArray(VEC3 InOutPoints[], size_t PointCount, const MATRIX &M);
+// Przeksztacaj w miejscu wektory lece w tablicy z przeplotem, np. pole pozycji w tablicy wierzchokw.
+// InOutFirstPoint wskazuje na wektor w pierwszym elemencie, Stride to odlego midzy kolejnymi wektorami w bajtach.
+// Przykad: TransformArray_Strided(&Vertices[0].Pos, sizeof(VERTEX), Vertices.size(), M);
+void TransformArray_Strided(VEC3 *InOutFirstPoint, size_t Stride, size_t PointCount, const MATRIX &M);
+void TransformNormalArray_Strided(VEC3 *InOutFirstPoint, size_t Stride, size_t PointCount, const MATRIX &M);
+void TransformCoordArray_Strided(VEC3 *InOutFirstPoint, size_t Stride, size_t PointCount, const MATRIX &M);
 
 // Mnoenie wektora 4D przez macierz
 // Czyli przeksztacenie wektora we wsprzdnych jednorodnych przez t macierz.
@@ -2177,9 +2165,17 @@ void Transpose(MATRIX *m);
 // Interpolacja liniowa macierzy
 void Lerp(MATRIX *Out, const MATRIX &m1, const MATRIX &m2, float t);
 // Wyznacznik macierzy
+// Wersja SSE liczy go ze wzoru na macierz blokow 2x2 - wynik moe si rni w ostatnich bitach.
 float Det(const MATRIX &m);
 // Odwrotno macierzy
+// Zwraca false, jeli wyznacznik jest zerowy. Uwagi jak w Det.
 bool Inverse(MATRIX *Out, const MATRIX &m);
+// Skada na raz macierze caej hierarchii (np. koci), w jednym przebiegu:
+// OutMatrices[i] = LocalMatrices[i] * OutMatrices[ParentIndices[i]]
+// - Rodzic musi mie indeks mniejszy od dziecka.
+// - ParentIndices[i] >= i (np. MAXUINT4) oznacza brak rodzica - wtedy OutMatrices[i] = LocalMatrices[i].
+// - OutMatrices moe by t sam tablic co LocalMatrices.
+void ConcatHierarchy(MATRIX OutMatrices[], const MATRIX LocalMatrices[], const uint ParentIndices[], size_t Count);
 
 
 //HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
@@ -2740,8 +2736,14 @@ bool PointInPolygon(const VEC2 &Point, const VEC2 PolygonPoints[], uint PolygonP
 bool RayToPolygon(const VEC3 &RayOrig, const VEC3 &RayDir, const VEC3 PolygonPoints[], uint PolygonPointCount, bool BackfaceCulling, float *OutT);
 
 // Znajduje sfer otaczajc podany zbir punktw
-// - Nie jest to moe najmniejsza sfera, ale przynajmniej ten algorytm jest prosty i szybki.
+// - Nie jest to najmniejsza sfera, ale zwykle niewiele od niej wiksza. Czas liniowy.
+// - Metoda Rittera, zaczynajc od sfery rozpitej na najdalszej parze punktw skrajnych wzdu osi X, Y, Z (EPOS-6).
 void SphereBoundingPoints(VEC3 *OutSphereCenter, float *OutSphereRadius, const VEC3 Points[], size_t PointCount);
+// Znajduje najmniejsz sfer otaczajc podany zbir punktw
+// - Algorytm Welzla w wersji iteracyjnej, oczekiwany czas liniowy, ale kilka razy wolniejszy od SphereBoundingPoints.
+// - Punkty s przetwarzane w losowej kolejnoci ze staym ziarnem, wic wynik jest powtarzalny.
+// - PointCount musi by wiksze od 0.
+void SphereBoundingPoints_Exact(VEC3 *OutSphereCenter, float *OutSphereRadius, const VEC3 Points[], size_t PointCount);
 // Liczy kolizj poruszajcej si sfery z paszczyzn
 // - Paszczyzna musi by znormalizowana.
 // - Jako OutT0 i OutT1 mona podawa NULL, jeli nas akurat nie interesuje.
@@ -2780,6 +2782,27 @@ void SphereBoundingBox(BOX *Out, const VEC3 &SphereCenter, float SphereRadius);
 // - SphereCount musi by wiksze od 0.
 void BoxBoundingSpheres(BOX *OutBox, const VEC3 SpheresCenter[], const float SpheresRadius[], size_t SphereCount);
 
+// Prostopadocian zorientowany (Oriented Bounding Box)
+struct OBB
+{
+	VEC3 Center;
+	// Kierunki bokw - znormalizowane i wzajemnie prostopade
+	VEC3 Axes[3];
+	// Poowy dugoci bokw wzdu kolejnych osi
+	VEC3 HalfSize;
+};
+
+// Tworzy OBB otaczajcy podany zbir punktw
+// - Osie pocztkowe to kierunki gwne rozkadu punktw (PCA) albo osie ukadu, jeli daj mniejszy boks.
+//   Potem s obracane, dopki zmniejsza to objto.
+// - Nie jest to najmniejszy moliwy OBB, ale nigdy nie jest wikszy od AABB.
+// - PointCount musi by wiksze od 0.
+void ObbBoundingPoints(OBB *Out, const VEC3 Points[], size_t PointCount);
+// Oblicza 8 wierzchokw OBB
+void ObbToPoints(VEC3 OutPoints[8], const OBB &Obb);
+// Oblicza AABB otaczajcy OBB
+void ObbBoundingBox(BOX *Out, const OBB &Obb);
+
 // Losuje punkt wewntrz kuli o rodku w (0,0,0) i promieniu 1. Rozkad rwnomierny.
 void RandomPointInUnitSphere(VEC3 *Out, RandomGenerator &Rand);
 void RandomPointInUnitSphere(VEC3 *Out);
@@ -2791,6 +2814,181 @@ void RandomPointInCapsule(VEC3 *Out, const VEC3 &p1, const VEC3 &p2, float R, Ra
 void RandomPointInCapsule(VEC3 *Out, const VEC3 &p1, const VEC3 &p2, float R);
 
 
+//HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
+// TESTY WSADOWE
+
+/*
+Tablice obiektw w ukadzie SoA (Structure of Arrays) - kada skadowa w osobnej
+tablicy. W takim ukadzie testy kolizji mona liczy na raz dla 4 albo 8
+obiektw instrukcjami SSE albo AVX.
+*/
+
+// Tablica AABB
+struct BOX_SOA
+{
+	std::vector<float> MinX, MinY, MinZ;
+	std::vector<float> MaxX, MaxY, MaxZ;
+
+	size_t Size() const { return MinX.size(); }
+	bool Empty() const { return MinX.empty(); }
+	void Clear();
+	void Reserve(size_t Capacity);
+	void Resize(size_t NewSize);
+	void Add(const BOX &Box);
+	void Set(size_t Index, const BOX &Box);
+	void Get(BOX *Out, size_t Index) const;
+};
+
+// Tablica sfer
+struct SPHERE_SOA
+{
+	std::vector<float> CenterX, CenterY, CenterZ;
+	std::vector<float> Radius;
+
+	size_t Size() const { return CenterX.size(); }
+	bool Empty() const { return CenterX.empty(); }
+	void Clear();
+	void Reserve(size_t Capacity);
+	void Resize(size_t NewSize);
+	void Add(const VEC3 &Center, float Radius);
+	void Set(size_t Index, const VEC3 &Center, float Radius);
+};
+
+// Zwraca liczb elementw uint4 potrzebn na mask bitow dla podanej liczby obiektw
+inline size_t VisibilityMaskSize(size_t ObjectCount) { return (ObjectCount + 31) / 32; }
+// Zwraca bit obiektu o podanym indeksie z maski bitowej
+inline bool VisibilityMaskGet(const uint4 Mask[], size_t Index) { return ( Mask[Index >> 5] & (1u << (Index & 31)) ) != 0; }
+
+// Testuje na raz ca tablic AABB z frustumem.
+// - Wynik dla kadego boksa jest dokadnie taki sam jak z BoxToFrustum_Fast.
+// - OutMask to maska bitowa, bit obiektu i to (OutMask[i/32] >> (i%32)) & 1.
+//   Musi mie VisibilityMaskSize(BoxCount) elementw. Jest w caoci nadpisywana.
+// - Zwraca liczb boksw, ktre przeszy test.
+// - Wybiera w czasie wykonania ciek AVX, SSE albo zwyk, zalenie od procesora.
+size_t BoxArrayToFrustum_Fast(
+	uint4 OutMask[],
+	const float MinX[], const float MinY[], const float MinZ[],
+	const float MaxX[], const float MaxY[], const float MaxZ[],
+	size_t BoxCount, const FRUSTUM_PLANES &Frustum);
+inline size_t BoxArrayToFrustum_Fast(uint4 OutMask[], const BOX_SOA &Boxes, const FRUSTUM_PLANES &Frustum)
+{
+	if (Boxes.Empty()) return 0;
+	return BoxArrayToFrustum_Fast(OutMask,
+		&Boxes.MinX[0], &Boxes.MinY[0], &Boxes.MinZ[0], &Boxes.MaxX[0], &Boxes.MaxY[0], &Boxes.MaxZ[0],
+		Boxes.Size(), Frustum);
+}
+// Testuje na raz ca tablic sfer z frustumem.
+// - Wynik dla kadej sfery jest dokadnie taki sam jak z SphereToFrustum_Fast.
+// - Znaczenie OutMask i wartoci zwracanej jak w BoxArrayToFrustum_Fast.
+size_t SphereArrayToFrustum_Fast(
+	uint4 OutMask[],
+	const float CenterX[], const float CenterY[], const float CenterZ[], const float Radius[],
+	size_t SphereCount, const FRUSTUM_PLANES &Frustum);
+inline size_t SphereArrayToFrustum_Fast(uint4 OutMask[], const SPHERE_SOA &Spheres, const FRUSTUM_PLANES &Frustum)
+{
+	if (Spheres.Empty()) return 0;
+	return SphereArrayToFrustum_Fast(OutMask,
+		&Spheres.CenterX[0], &Spheres.CenterY[0], &Spheres.CenterZ[0], &Spheres.Radius[0],
+		Spheres.Size(), Frustum);
+}
+
+// Paczka 4 trjktw w ukadzie SoA do testu RayToTriangle4.
+// Miejsca nieuywane musz zawiera trjkty zdegenerowane (SetDegenerate) - te nigdy nie s trafiane.
+struct TRIANGLE_PACKET4
+{
+	float X0[4], Y0[4], Z0[4];
+	float X1[4], Y1[4], Z1[4];
+	float X2[4], Y2[4], Z2[4];
+
+	void Set(uint Index, const VEC3 &p0, const VEC3 &p1, const VEC3 &p2)
+	{
+		X0[Index] = p0.x; Y0[Index] = p0.y; Z0[Index] = p0.z;
+		X1[Index] = p1.x; Y1[Index] = p1.y; Z1[Index] = p1.z;
+		X2[Index] = p2.x; Y2[Index] = p2.y; Z2[Index] = p2.z;
+	}
+	void SetDegenerate(uint Index) { Set(Index, VEC3::ZERO, VEC3::ZERO, VEC3::ZERO); }
+};
+// Paczka 8 trjktw w ukadzie SoA do testu RayToTriangle8. Uwagi jak w TRIANGLE_PACKET4.
+struct TRIANGLE_PACKET8
+{
+	float X0[8], Y0[8], Z0[8];
+	float X1[8], Y1[8], Z1[8];
+	float X2[8], Y2[8], Z2[8];
+
+	void Set(uint Index, const VEC3 &p0, const VEC3 &p1, const VEC3 &p2)
+	{
+		X0[Index] = p0.x; Y0[Index] = p0.y; Z0[Index] = p0.z;
+		X1[Index] = p1.x; Y1[Index] = p1.y; Z1[Index] = p1.z;
+		X2[Index] = p2.x; Y2[Index] = p2.y; Z2[Index] = p2.z;
+	}
+	void SetDegenerate(uint Index) { Set(Index, VEC3::ZERO, VEC3::ZERO, VEC3::ZERO); }
+};
+// Paczka 4 promieni w ukadzie SoA do testu Ray4ToTriangle
+struct RAY_PACKET4
+{
+	float OrigX[4], OrigY[4], OrigZ[4];
+	float DirX[4], DirY[4], DirZ[4];
+
+	void Set(uint Index, const VEC3 &Orig, const VEC3 &Dir)
+	{
+		OrigX[Index] = Orig.x; OrigY[Index] = Orig.y; OrigZ[Index] = Orig.z;
+		DirX[Index] = Dir.x; DirY[Index] = Dir.y; DirZ[Index] = Dir.z;
+	}
+};
+
+// Kolizja promienia z 4 lub 8 trjktami na raz.
+// - Zwraca mask bitow - bit i jest ustawiony, jeli trafiony zosta trjkt i. Wtedy OutT[i] to parametr t kolizji.
+//   Elementy OutT dla trjktw nietrafionych maj warto nieokrelon.
+// - Wynik dla kadego trjkta jest dokadnie taki sam jak z RayToTriangle.
+// - Wybiera w czasie wykonania ciek AVX, SSE albo zwyk, zalenie od procesora.
+uint RayToTriangle4(float OutT[4], const VEC3 &RayOrig, const VEC3 &RayDir, const TRIANGLE_PACKET4 &Triangles, bool BackfaceCulling);
+uint RayToTriangle8(float OutT[8], const VEC3 &RayOrig, const VEC3 &RayDir, const TRIANGLE_PACKET8 &Triangles, bool BackfaceCulling);
+// Kolizja 4 promieni z jednym trjktem na raz - opaca si dla promieni spjnych, testowanych z tymi samymi trjktami.
+// Bit i wyniku i OutT[i] dotycz promienia i. Pozostae uwagi jak w RayToTriangle4.
+uint Ray4ToTriangle(float OutT[4], const RAY_PACKET4 &Rays, const VEC3 &p0, const VEC3 &p1, const VEC3 &p2, bool BackfaceCulling);
+
+// Tablica przeksztace koci (obrt, przesunicie, skalowanie jednorodne) w ukadzie SoA
+struct POSE_SOA
+{
+	std::vector<float> RotX, RotY, RotZ, RotW;
+	std::vector<float> PosX, PosY, PosZ;
+	std::vector<float> Scaling;
+
+	size_t Size() const { return RotX.size(); }
+	bool Empty() const { return RotX.empty(); }
+	void Clear();
+	void Resize(size_t NewSize);
+	void Set(size_t Index, const QUATERNION &Rot, const VEC3 &Pos, float Scal);
+	// Ustawia przeksztacenie tosamociowe
+	void SetIdentity(size_t Index);
+	void Get(size_t Index, QUATERNION *OutRot, VEC3 *OutPos, float *OutScal) const;
+};
+
+enum POSE_BLEND_MODE
+{
+	// Obroty interpolowane sferycznie, tak jak Slerp
+	POSE_BLEND_SLERP,
+	// Obroty interpolowane liniowo z normalizacj - najszybsze, ale prdko ktowa nie jest staa
+	POSE_BLEND_NLERP,
+	// Nlerp dla obrotw rnicych si o mniej ni ok. 16 stopni, Slerp dla pozostaych
+	POSE_BLEND_AUTO,
+};
+
+// Interpoluje na raz wszystkie koci dwch pz.
+// - Out[i] = A[i] dla T[i] = 0 i B[i] dla T[i] = 1. T powinno by w zakresie 0..1.
+// - Obrt wg Mode, przesunicie i skalowanie liniowo (jak Lerp).
+// - A i B musz mie tyle samo elementw. Out jest dopasowywany do ich rozmiaru
+//   i moe by tym samym obiektem co A albo B.
+// - cieka SSE liczy sinus i arcus tangens przyblieniami wielomianowymi -
+//   wynik Slerp moe rni si od funkcji Slerp na ostatnich bitach.
+void BlendPoses(POSE_SOA *Out, const POSE_SOA &A, const POSE_SOA &B, const float T[], POSE_BLEND_MODE Mode);
+// Wersja z jednym wspczynnikiem dla wszystkich koci
+void BlendPoses(POSE_SOA *Out, const POSE_SOA &A, const POSE_SOA &B, float T, POSE_BLEND_MODE Mode);
+// Wylicza macierze przeksztace koci: Scaling * Rotation * Translation.
+// OutMatrices musi mie Pose.Size() elementw.
+void PoseToMatrices(MATRIX OutMatrices[], const POSE_SOA &Pose);
+
+
 //HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
 // Poisson Disc
 
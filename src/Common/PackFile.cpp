@@ -0,0 +1,582 @@
+/*
+ * Kodowanie Windows-1250, koniec wiersza CR+LF, test: Za gl ja
+ * PackFile - Paczki z plikami i wirtualny system plikw
+ * Dokumentacja: Patrz plik doc/PackFile.txt
+ * Copyleft (C) 2007 Adam Sawicki
+ * Licencja: GNU LGPL
+ * Kontakt: mailto:sawickiap@poczta.onet.pl , http://regedit.gamedev.pl/
+ */
+#include "Base.hpp"
+#include "Error.hpp"
+#include "Files.hpp"
+#include "FastCompression.hpp"
+#include "PackFile.hpp"
+#include <algorithm>
+#include <cstring>
+#include <set>
+
+
+namespace common
+{
+
+/*
+Format paczki:
+- Nagwek: PACK_MAGIC (8 B), uint4 EntryCount, uint8 TocOffset
+- Dane plikw, kady od granicy PACK_ALIGNMENT
+- Spis (od granicy PACK_ALIGNMENT): EntryCount struktur PACK_ENTRY posortowanych
+  wedug NameHash, za nimi blok nazw (bez zer na kocu)
+*/
+const char * const PACK_MAGIC = "TFQPACK1";
+const size_t PACK_MAGIC_SIZE = 8;
+const size_t PACK_HEADER_SIZE = PACK_MAGIC_SIZE + sizeof(uint4) + sizeof(uint8);
+
+enum PACK_COMPRESSION
+{
+	PACK_COMPRESSION_NONE = 0,
+	PACK_COMPRESSION_FAST = 1, // FastCompressionStream
+};
+
+// Wpis spisu plikw - zapisywany tak jak jest, 32 B bez dopenie
+struct PACK_ENTRY
+{
+	// FastHash_Calc znormalizowanej nazwy
+	uint8 NameHash;
+	// Od pocztku paczki
+	uint8 Offset;
+	// Rozmiar pliku
+	uint4 Size;
+	// Rozmiar danych w paczce - rny od Size, jeli s skompresowane
+	uint4 StoredSize;
+	// Od pocztku bloku nazw
+	uint4 NameOffset;
+	uint2 NameLength;
+	uint1 Compression; // PACK_COMPRESSION
+	uint1 Reserved;
+};
+
+// Zamienia nazw pliku na posta, pod ktr jest szukany w paczce
+static void MakePackName(string *Out, const string &FileName)
+{
+	NormalizePath(Out, FileName);
+	for (size_t i = 0; i < Out->length(); i++)
+		if ((*Out)[i] == '/')
+			(*Out)[i] = '\\';
+	LowerCase(Out);
+}
+
+static bool PackEntryHashLess(const PACK_ENTRY &e1, const PACK_ENTRY &e2)
+{
+	return e1.NameHash < e2.NameHash;
+}
+
+
+//HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
+// Klasa PackWriter
+
+class PackWriter_pimpl
+{
+public:
+	FileStream m_File;
+	std::vector<PACK_ENTRY> m_Entries;
+	string m_Names;
+	std::set<string> m_NameSet;
+	uint8 m_Offset;
+	uint m_CompressedCount;
+	bool m_Finished;
+
+	PackWriter_pimpl(const string &FileName);
+	// Dopisuje zera do granicy PACK_ALIGNMENT
+	void Align();
+	void AddData(const string &Name, const void *Data, size_t Size, bool Compress);
+	void Finish();
+};
+
+PackWriter_pimpl::PackWriter_pimpl(const string &FileName) :
+	m_File(FileName, FM_WRITE),
+	m_Offset(0),
+	m_CompressedCount(0),
+	m_Finished(false)
+{
+	// Nagwek zostanie nadpisany w Finish
+	char Header[PACK_HEADER_SIZE];
+	ZeroMem(Header, PACK_HEADER_SIZE);
+	m_File.Write(Header, PACK_HEADER_SIZE);
+	m_Offset = PACK_HEADER_SIZE;
+}
+
+void PackWriter_pimpl::Align()
+{
+	static const char Zeros[PACK_ALIGNMENT] = { 0 };
+	size_t Padding = (size_t)((PACK_ALIGNMENT - m_Offset % PACK_ALIGNMENT) % PACK_ALIGNMENT);
+	if (Padding > 0)
+	{
+		m_File.Write(Zeros, Padding);
+		m_Offset += Padding;
+	}
+}
+
+void PackWriter_pimpl::AddData(const string &Name, const void *Data, size_t Size, bool Compress)
+{
+	if (m_Finished)
+		throw Error("Paczka jest ju zakoczona", __FILE__, __LINE__);
+
+	string PackName;
+	MakePackName(&PackName, Name);
+	if (PackName.empty() || PackName.length() > MAXUINT2)
+		throw Error("Bdna nazwa pliku w paczce: " + Name, __FILE__, __LINE__);
+	if (!m_NameSet.insert(PackName).second)
+		throw Error("Plik o tej nazwie jest ju w paczce: " + Name, __FILE__, __LINE__);
+
+	PACK_ENTRY Entry;
+	Entry.NameHash = FastHash_Calc::Calc(PackName);
+	Entry.Size = (uint4)Size;
+	Entry.StoredSize = (uint4)Size;
+	Entry.NameOffset = (uint4)m_Names.length();
+	Entry.NameLength = (uint2)PackName.length();
+	Entry.Compression = PACK_COMPRESSION_NONE;
+	Entry.Reserved = 0;
+
+	VectorStream Compressed;
+	if (Compress && Size > 0)
+	{
+		{
+			FastCompressionStream CompressionStream(&Compressed);
+			CompressionStream.Write(Data, Size);
+		}
+		// Nie opaca si kompresowa
+		if (Compressed.GetSize() < Size)
+		{
+			Entry.Compression = PACK_COMPRESSION_FAST;
+			Entry.StoredSize = (uint4)Compressed.GetSize();
+			Data = Compressed.Data();
+			m_CompressedCount++;
+		}
+	}
+
+	Align();
+	Entry.Offset = m_Offset;
+	m_File.Write(Data, Entry.StoredSize);
+	m_Offset += Entry.StoredSize;
+
+	m_Entries.push_back(Entry);
+	m_Names += PackName;
+}
+
+void PackWriter_pimpl::Finish()
+{
+	if (m_Finished)
+		return;
+	m_Finished = true;
+
+	// Stabilne, eby wynik nie zalea od implementacji sortowania
+	std::stable_sort(m_Entries.begin(), m_Entries.end(), PackEntryHashLess);
+
+	Align();
+	uint8 TocOffset = m_Offset;
+	if (!m_Entries.empty())
+		m_File.Write(&m_Entries[0], m_Entries.size() * sizeof(PACK_ENTRY));
+	m_File.Write(m_Names.data(), m_Names.length());
+
+	m_File.SetPos(0);
+	m_File.Write(PACK_MAGIC, PACK_MAGIC_SIZE);
+	m_File.WriteEx((uint4)m_Entries.size());
+	m_File.WriteEx(TocOffset);
+	m_File.Flush();
+}
+
+PackWriter::PackWriter(const string &FileName) :
+	pimpl(new PackWriter_pimpl(FileName))
+{
+}
+
+PackWriter::~PackWriter()
+{
+	try
+	{
+		pimpl->Finish();
+	}
+	catch (...)
+	{
+	}
+}
+
+void PackWriter::AddData(const string &Name, const void *Data, size_t Size, bool Compress)
+{
+	ERR_TRY;
+
+	pimpl->AddData(Name, Data, Size, Compress);
+
+	ERR_CATCH("Nie mona doda pliku do paczki: " + Name);
+}
+
+void PackWriter::AddFile(const string &Name, const string &SrcFileName, bool Compress)
+{
+	ERR_TRY;
+
+	MappedFileStream File(SrcFileName);
+	pimpl->AddData(Name, File.GetData(), File.GetSize(), Compress);
+
+	ERR_CATCH("Nie mona doda pliku do paczki: " + SrcFileName);
+}
+
+void PackWriter::Finish()
+{
+	ERR_TRY;
+
+	pimpl->Finish();
+
+	ERR_CATCH_FUNC;
+}
+
+uint PackWriter::GetFileCount()
+{
+	return pimpl->m_Entries.size();
+}
+
+uint PackWriter::GetCompressedCount()
+{
+	return pimpl->m_CompressedCount;
+}
+
+
+//HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
+// Klasa PackReader
+
+// Doczona paczka
+// Caa jest odwzorowana w pamici na czas doczenia.
+class PackReader
+{
+	DECLARE_NO_COPY_CLASS(PackReader)
+
+private:
+	string m_FileName;
+	MappedFileStream m_File;
+	const PACK_ENTRY *m_Entries;
+	uint4 m_EntryCount;
+	const char *m_Names;
+	size_t m_NamesSize;
+	uint8 m_TocOffset;
+
+public:
+	PackReader(const string &FileName);
+
+	const string & GetFileName() { return m_FileName; }
+	// Zwraca wpis pliku o podanej nazwie (ju w postaci z MakePackName) lub NULL
+	const PACK_ENTRY * Find(const string &PackName);
+	// Zwraca wskanik do danych pliku w paczce, po sprawdzeniu, czy mieszcz si w pliku
+	const char * GetEntryData(const PACK_ENTRY &Entry);
+};
+
+PackReader::PackReader(const string &FileName) :
+	m_FileName(FileName),
+	m_File(FileName)
+{
+	ERR_TRY;
+
+	const char *Header = m_File.GetView(0, PACK_HEADER_SIZE);
+	if (memcmp(Header, PACK_MAGIC, PACK_MAGIC_SIZE) != 0)
+		throw Error("Bdny nagwek", __FILE__, __LINE__);
+	memcpy(&m_EntryCount, Header + PACK_MAGIC_SIZE, sizeof(uint4));
+	memcpy(&m_TocOffset, Header + PACK_MAGIC_SIZE + sizeof(uint4), sizeof(uint8));
+
+	size_t FileSize = m_File.GetSize();
+	if (m_TocOffset > FileSize || m_EntryCount > (FileSize - m_TocOffset) / sizeof(PACK_ENTRY))
+		throw Error("Bdny spis plikw", __FILE__, __LINE__);
+	size_t TocSize = m_EntryCount * sizeof(PACK_ENTRY);
+
+	m_Entries = (const PACK_ENTRY*)m_File.GetView((size_t)m_TocOffset, TocSize);
+	m_NamesSize = FileSize - (size_t)m_TocOffset - TocSize;
+	m_Names = (m_NamesSize > 0 ? m_File.GetView((size_t)m_TocOffset + TocSize, m_NamesSize) : NULL);
+
+	ERR_CATCH("Nie mona otworzy paczki: " + FileName);
+}
+
+const PACK_ENTRY * PackReader::Find(const string &PackName)
+{
+	PACK_ENTRY Key;
+	Key.NameHash = FastHash_Calc::Calc(PackName);
+
+	const PACK_ENTRY *EntriesEnd = m_Entries + m_EntryCount;
+	for (const PACK_ENTRY *e = std::lower_bound(m_Entries, EntriesEnd, Key, PackEntryHashLess);
+		e != EntriesEnd && e->NameHash == Key.NameHash;
+		++e)
+	{
+		if (e->NameLength == PackName.length() &&
+			e->NameOffset <= m_NamesSize && e->NameLength <= m_NamesSize - e->NameOffset &&
+			memcmp(m_Names + e->NameOffset, PackName.data(), PackName.length()) == 0)
+		{
+			return e;
+		}
+	}
+	return NULL;
+}
+
+const char * PackReader::GetEntryData(const PACK_ENTRY &Entry)
+{
+	if (Entry.Offset > m_TocOffset || Entry.StoredSize > m_TocOffset - Entry.Offset)
+		throw Error("Plik wychodzi poza dane paczki: " + m_FileName, __FILE__, __LINE__);
+	if (Entry.StoredSize == 0)
+		return NULL;
+	return m_File.GetView((size_t)Entry.Offset, Entry.StoredSize);
+}
+
+
+//HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
+// Wirtualny system plikw
+
+class VfsPacks
+{
+public:
+	// Od najwczeniej doczonej
+	std::vector<PackReader*> m_Packs;
+
+	~VfsPacks() { Clear(); }
+
+	void Clear();
+	// Szuka pliku w paczkach, od ostatnio doczonej
+	// Zwraca true i wypenia OutPack, OutEntry, jeli znalaz.
+	bool Find(const string &FileName, PackReader **OutPack, const PACK_ENTRY **OutEntry);
+};
+
+void VfsPacks::Clear()
+{
+	for (size_t i = m_Packs.size(); i > 0; i--)
+		delete m_Packs[i-1];
+	m_Packs.clear();
+}
+
+bool VfsPacks::Find(const string &FileName, PackReader **OutPack, const PACK_ENTRY **OutEntry)
+{
+	if (m_Packs.empty())
+		return false;
+
+	string PackName;
+	MakePackName(&PackName, FileName);
+	for (size_t i = m_Packs.size(); i > 0; i--)
+	{
+		const PACK_ENTRY *Entry = m_Packs[i-1]->Find(PackName);
+		if (Entry != NULL)
+		{
+			*OutPack = m_Packs[i-1];
+			*OutEntry = Entry;
+			return true;
+		}
+	}
+	return false;
+}
+
+static VfsPacks g_VfsPacks;
+// Czy plik luny przesania plik z paczki
+static bool g_VfsLooseOverride = true;
+
+void VfsMountPack(const string &PackFileName)
+{
+	PackReader *Pack = new PackReader(PackFileName);
+	g_VfsPacks.m_Packs.push_back(Pack);
+}
+
+uint VfsMountPacks(const string &Dir, const string &Mask)
+{
+	ERR_TRY;
+
+	STRING_VECTOR Names;
+	{
+		DirLister Lister(Dir);
+		string Name;
+		FILE_ITEM_TYPE Type;
+		while (Lister.ReadNext(&Name, &Type))
+		{
+			if (Type == IT_FILE && ValidateWildcard(Mask, Name, false))
+				Names.push_back(Name);
+		}
+	}
+	std::sort(Names.begin(), Names.end());
+
+	string DirWithSep;
+	IncludeTrailingPathDelimiter(&DirWithSep, Dir);
+	for (size_t i = 0; i < Names.size(); i++)
+		VfsMountPack(DirWithSep + Names[i]);
+	return Names.size();
+
+	ERR_CATCH("Nie mona doczy paczek z katalogu: " + Dir);
+}
+
+void VfsUnmountAll()
+{
+	g_VfsPacks.Clear();
+}
+
+void VfsSetLooseOverride(bool Enabled)
+{
+	g_VfsLooseOverride = Enabled;
+}
+
+bool VfsGetLooseOverride()
+{
+	return g_VfsLooseOverride;
+}
+
+bool VfsFileExists(const string &FileName)
+{
+	PackReader *Pack;
+	const PACK_ENTRY *Entry;
+	if (g_VfsPacks.Find(FileName, &Pack, &Entry))
+		return true;
+	return (GetFileItemType(FileName) == IT_FILE);
+}
+
+void VfsLoadStringFromFile(const string &FileName, string *Data)
+{
+	VfsFileStream File(FileName);
+	if (File.GetSize() > 0)
+		Data->assign(File.GetData(), File.GetSize());
+	else
+		Data->clear();
+}
+
+
+//HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
+// Klasa VfsFileStream
+
+class VfsFileStream_pimpl
+{
+public:
+	const char *m_Data;
+	size_t m_Size;
+	size_t m_Pos;
+	// Plik luny
+	scoped_ptr<MappedFileStream> m_Loose;
+	// Rozpakowany plik z paczki
+	std::vector<char> m_Buf;
+
+	void ThrowViewError(size_t Offset, size_t Length);
+};
+
+void VfsFileStream_pimpl::ThrowViewError(size_t Offset, size_t Length)
+{
+	throw Error(Format("Widok #..# B wychodzi poza koniec pliku o rozmiarze # B") % Offset % (Offset + Length) % m_Size, __FILE__, __LINE__);
+}
+
+VfsFileStream::VfsFileStream(const string &FileName, bool CopyLoose) :
+	pimpl(new VfsFileStream_pimpl)
+{
+	ERR_TRY;
+
+	pimpl->m_Data = NULL;
+	pimpl->m_Size = 0;
+	pimpl->m_Pos = 0;
+
+	PackReader *Pack;
+	const PACK_ENTRY *Entry;
+	// Plik luny ma pierwszestwo - o ile jest wczone przesanianie. Dysk jest
+	// sprawdzany tylko dla plikw, ktre s w paczce.
+	if (g_VfsPacks.Find(FileName, &Pack, &Entry) &&
+		(!g_VfsLooseOverride || GetFileItemType(FileName) != IT_FILE))
+	{
+		const char *StoredData = Pack->GetEntryData(*Entry);
+		pimpl->m_Size = Entry->Size;
+
+		if (Entry->Compression == PACK_COMPRESSION_NONE)
+		{
+			if (Entry->StoredSize != Entry->Size)
+				throw Error("Bdny rozmiar pliku w paczce: " + Pack->GetFileName(), __FILE__, __LINE__);
+			pimpl->m_Data = StoredData;
+		}
+		else if (Entry->Compression == PACK_COMPRESSION_FAST)
+		{
+			if (Entry->Size > 0)
+			{
+				pimpl->m_Buf.resize(Entry->Size);
+				MemoryStream Src(Entry->StoredSize, const_cast<char*>(StoredData));
+				FastDecompressionStream Decompression(&Src);
+				Decompression.MustRead(&pimpl->m_Buf[0], Entry->Size);
+				pimpl->m_Data = &pimpl->m_Buf[0];
+			}
+		}
+		else
+			throw Error("Nieznany rodzaj kompresji pliku w paczce: " + Pack->GetFileName(), __FILE__, __LINE__);
+	}
+	else
+	{
+		pimpl->m_Loose.reset(new MappedFileStream(FileName, CopyLoose));
+		pimpl->m_Data = pimpl->m_Loose->GetData();
+		pimpl->m_Size = pimpl->m_Loose->GetSize();
+	}
+
+	ERR_CATCH("Nie mona otworzy pliku: " + FileName);
+}
+
+VfsFileStream::~VfsFileStream()
+{
+}
+
+size_t VfsFileStream::Read(void *Data, size_t Size)
+{
+	if (pimpl->m_Pos >= pimpl->m_Size)
+		return 0;
+	size_t BytesRead = std::min(Size, pimpl->m_Size - pimpl->m_Pos);
+	memcpy(Data, pimpl->m_Data + pimpl->m_Pos, BytesRead);
+	pimpl->m_Pos += BytesRead;
+	return BytesRead;
+}
+
+void VfsFileStream::MustRead(void *Data, size_t Size)
+{
+	if (Size == 0) return;
+	memcpy(Data, MustReadView(Size), Size);
+}
+
+size_t VfsFileStream::Skip(size_t MaxLength)
+{
+	if (pimpl->m_Pos >= pimpl->m_Size)
+		return 0;
+	size_t Skipped = std::min(MaxLength, pimpl->m_Size - pimpl->m_Pos);
+	pimpl->m_Pos += Skipped;
+	return Skipped;
+}
+
+bool VfsFileStream::End()
+{
+	return (pimpl->m_Pos >= pimpl->m_Size);
+}
+
+size_t VfsFileStream::GetSize()
+{
+	return pimpl->m_Size;
+}
+
+int VfsFileStream::GetPos()
+{
+	return (int)pimpl->m_Pos;
+}
+
+void VfsFileStream::SetPos(int pos)
+{
+	pimpl->m_Pos = (size_t)pos;
+}
+
+const char * VfsFileStream::GetData()
+{
+	return pimpl->m_Data;
+}
+
+const char * VfsFileStream::GetView(size_t Offset, size_t Length)
+{
+	if (Offset > pimpl->m_Size || Length > pimpl->m_Size - Offset)
+		pimpl->ThrowViewError(Offset, Length);
+	return pimpl->m_Data + Offset;
+}
+
+const char * VfsFileStream::MustReadView(size_t Length)
+{
+	const char *R = GetView(pimpl->m_Pos, Length);
+	pimpl->m_Pos += Length;
+	return R;
+}
+
+bool VfsFileStream::IsPacked()
+{
+	return (pimpl->m_Loose == NULL);
+}
+
+} // namespace common
@@ -0,0 +1,135 @@
+/*
+ * Kodowanie Windows-1250, koniec wiersza CR+LF, test: Za gl ja
+ * PackFile - Paczki z plikami i wirtualny system plikw
+ * Dokumentacja: Patrz plik doc/PackFile.txt
+ * Copyleft (C) 2007 Adam Sawicki
+ * Licencja: GNU LGPL
+ * Kontakt: mailto:sawickiap@poczta.onet.pl , http://regedit.gamedev.pl/
+ */
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif
+#ifndef COMMON_PACK_FILE_H_
+#define COMMON_PACK_FILE_H_
+
+#include "Stream.hpp"
+
+namespace common
+{
+
+// Dane kadego pliku w paczce zaczynaj si od wielokrotnoci tej liczby bajtw
+const size_t PACK_ALIGNMENT = 16;
+
+class PackWriter_pimpl;
+
+/*
+Tworzy paczk z plikami
+- Nazwy plikw nie rozrniaj wielkoci liter ani rodzaju ukonika ('/' i '\'),
+  s te normalizowane (NormalizePath). Musz by unikalne.
+- Plik dodany z Compress = true zostaje skompresowany (FastCompression), o ile
+  si to opaca. Plik zapisany wprost mona potem czyta bez kopiowania.
+- Spis plikw zapisuje si w Finish. Jeli nie wywoano, robi to destruktor
+  (ignorujc bdy).
+*/
+class PackWriter
+{
+	DECLARE_NO_COPY_CLASS(PackWriter)
+
+private:
+	scoped_ptr<PackWriter_pimpl> pimpl;
+
+public:
+	PackWriter(const string &FileName);
+	~PackWriter();
+
+	// Dodaje plik o podanej nazwie - pod ni bdzie dostpny w wirtualnym systemie plikw
+	void AddData(const string &Name, const void *Data, size_t Size, bool Compress);
+	// Dodaje plik wczytany z dysku
+	void AddFile(const string &Name, const string &SrcFileName, bool Compress);
+	// Zapisuje spis plikw i koczy paczk. Potem nie wolno ju dodawa plikw.
+	void Finish();
+
+	// Liczba dodanych plikw
+	uint GetFileCount();
+	// Liczba dodanych plikw zapisanych jako skompresowane
+	uint GetCompressedCount();
+};
+
+class VfsFileStream_pimpl;
+
+/*
+Strumie do odczytu pliku przez wirtualny system plikw
+- Szuka pliku w doczonych paczkach, od ostatnio doczonej. Jeli wczone s
+  pliki lune (VfsSetLooseOverride) i istnieje plik luny o tej nazwie, czyta
+  z niego.
+- Plik, ktrego nie ma w adnej paczce, jest zawsze czytany jako luny - jest
+  odwzorowany w pamici tak jak w MappedFileStream.
+- Plik zapisany w paczce wprost nie jest kopiowany - widoki wskazuj prosto
+  w odwzorowanie paczki. Plik skompresowany jest rozpakowywany w konstruktorze.
+- Widoki s wane do zniszczenia obiektu. Nie musz by wyrwnane bardziej ni
+  do PACK_ALIGNMENT.
+- CopyLoose = true: plik luny jest kopiowany do pamici i zamykany jeszcze
+  w konstruktorze (MappedFileStream z CopyToMemory).
+*/
+class VfsFileStream : public SeekableStream
+{
+private:
+	scoped_ptr<VfsFileStream_pimpl> pimpl;
+
+public:
+	VfsFileStream(const string &FileName, bool CopyLoose = false);
+	virtual ~VfsFileStream();
+
+	// ======== Implementacja Stream ========
+	virtual size_t Read(void *Data, size_t Size);
+	virtual void MustRead(void *Data, size_t Size);
+	virtual size_t Skip(size_t MaxLength);
+	virtual bool End();
+
+	// ======== Implementacja SeekableStream ========
+	virtual size_t GetSize();
+	virtual int GetPos();
+	virtual void SetPos(int pos);
+
+	// ======== Widoki ========
+	// Zwraca wskanik do pocztku danych pliku
+	// Jeli plik jest pusty, zwraca NULL.
+	const char * GetData();
+	// Zwraca wskanik do Length bajtw od pozycji Offset.
+	// Jeli wychodz poza koniec pliku, zgasza bd.
+	const char * GetView(size_t Offset, size_t Length);
+	// Zwraca wskanik do Length bajtw od biecej pozycji i przesuwa kursor za nie.
+	// Jeli wychodz poza koniec pliku, zgasza bd.
+	const char * MustReadView(size_t Length);
+	// Tak samo, ale dla tablicy Count elementw typu T
+	template <typename T>
+	const T * MustReadView(size_t Count) { return (const T*)MustReadView(Count * sizeof(T)); }
+
+	// Czy plik pochodzi z paczki (a nie jest plikiem lunym)
+	bool IsPacked();
+};
+
+// ======== Wirtualny system plikw ========
+// Lista doczonych paczek nie jest chroniona muteksem - docza i odcza je
+// trzeba wtedy, kiedy nikt inny nie czyta plikw.
+
+// Docza paczk. Paczki doczone pniej przesaniaj wczeniejsze.
+void VfsMountPack(const string &PackFileName);
+// Docza wszystkie paczki pasujce do maski z podanego katalogu, w kolejnoci nazw
+// Zwraca liczb doczonych paczek.
+uint VfsMountPacks(const string &Dir, const string &Mask);
+// Odcza wszystkie paczki
+// Nie moe ju wtedy istnie aden VfsFileStream z pliku z paczki.
+void VfsUnmountAll();
+// Wcza/wycza przesanianie plikw z paczek plikami lunymi (domylnie wczone)
+// Wyczone oszczdza sprawdzanie dysku przy kadym otwarciu pliku z paczki.
+void VfsSetLooseOverride(bool Enabled);
+bool VfsGetLooseOverride();
+// Zwraca true, jeli plik istnieje - luny albo w paczce
+bool VfsFileExists(const string &FileName);
+// Wczytuje cay plik do acucha
+void VfsLoadStringFromFile(const string &FileName, string *Data);
+
+} // namespace common
+
+#endif
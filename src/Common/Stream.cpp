@@ -9,6 +9,11 @@
 #include "Base.hpp"
 #include <typeinfo>
 #include <memory.h> // dla memcpy
+#ifdef COMMON_SSE2
+	#include <emmintrin.h>
+	#include <tmmintrin.h> // dla SSSE3
+	#include <wmmintrin.h> // dla PCLMULQDQ
+#endif
 #include "Error.hpp"
 #include "Stream.hpp"
 
@@ -17,11 +22,17 @@ namespace common
 {
 
 const size_t BUFFER_SIZE = 4096;
+const size_t BUFFERED_STREAM_BLOCK_SIZE = 64*1024;
 
 const char * const ERRMSG_DECODE_INVALID_CHAR = "Bd dekodowania strumienia: Nieprawidowy znak.";
 const char * const ERRMSG_UNEXPECTED_END      = "Bd strumienia: Nieoczekiwany koniec danych.";
 
 const char BASE64_CHARS[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+const char * const HEX_DIGITS_U = "0123456789ABCDEF";
+const char * const HEX_DIGITS_L = "0123456789abcdef";
+
+// Rozmiar bufora na stosie, przez ktry strumienie kodujce przepuszczaj dane blokami
+const size_t CODER_CHUNK_SIZE = 1536;
 
 
 //HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
@@ -66,6 +77,214 @@ void _ThrowBufEndError(const char *File, int Line)
 	throw Error("Napotkano koniec strumienia.", File, Line);
 }
 
+/*
+Blokowe kodowanie i dekodowanie Hex oraz Base64.
+Na procesorach z SSSE3 przetwarzaj po 16 bajtw/znakw na raz metod
+"lookup-shuffle" (PSHUFB jako tablica 16 elementw), reszt - skalarnie.
+Na podstawie: Wojciech Mua, "Base64 encoding/decoding with SIMD instructions".
+*/
+
+#ifdef COMMON_SSE2
+
+static bool g_CoderSsse3 = CpuHasFeatures(CPU_FEATURE_SSE2 | CPU_FEATURE_SSSE3);
+
+COMMON_SSSE3_FUNCTION static size_t HexEncode_SSSE3(char *Out, const uint1 *In, size_t Length, const char *Digits)
+{
+	const __m128i Lut = _mm_loadu_si128((const __m128i*)Digits);
+	const __m128i Mask = _mm_set1_epi8(0x0F);
+	size_t i = 0;
+	for ( ; i + 16 <= Length; i += 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)(In + i));
+		__m128i Hi = _mm_shuffle_epi8(Lut, _mm_and_si128(_mm_srli_epi16(v, 4), Mask));
+		__m128i Lo = _mm_shuffle_epi8(Lut, _mm_and_si128(v, Mask));
+		_mm_storeu_si128((__m128i*)(Out + i*2     ), _mm_unpacklo_epi8(Hi, Lo));
+		_mm_storeu_si128((__m128i*)(Out + i*2 + 16), _mm_unpackhi_epi8(Hi, Lo));
+	}
+	return i;
+}
+
+// Zamienia 16 znakw na wartoci cyfr szesnastkowych. Jeli ktry nie jest cyfr, zwraca false.
+static inline bool HexCharsToNibbles_SSE2(__m128i *Out, __m128i c)
+{
+	__m128i Lower = _mm_or_si128(c, _mm_set1_epi8(0x20));
+	__m128i IsDigit = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(c, _mm_set1_epi8('9' + 1)));
+	__m128i IsAlpha = _mm_and_si128(_mm_cmpgt_epi8(Lower, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(Lower, _mm_set1_epi8('f' + 1)));
+	if (_mm_movemask_epi8(_mm_or_si128(IsDigit, IsAlpha)) != 0xFFFF)
+		return false;
+	*Out = _mm_or_si128(
+		_mm_and_si128(IsDigit, _mm_sub_epi8(c, _mm_set1_epi8('0'))),
+		_mm_and_si128(IsAlpha, _mm_sub_epi8(Lower, _mm_set1_epi8('a' - 10))));
+	return true;
+}
+
+// Zwraca liczb zdekodowanych bajtw. Zatrzymuje si przed blokiem z bdnym znakiem.
+COMMON_SSSE3_FUNCTION static size_t HexDecode_SSSE3(uint1 *Out, const char *In, size_t ByteCount)
+{
+	// Starsza cyfra razy 16 plus modsza
+	const __m128i Weights = _mm_set1_epi16(0x0110);
+	size_t i = 0;
+	__m128i v0, v1;
+	for ( ; i + 16 <= ByteCount; i += 16)
+	{
+		if (!HexCharsToNibbles_SSE2(&v0, _mm_loadu_si128((const __m128i*)(In + i*2     )))) break;
+		if (!HexCharsToNibbles_SSE2(&v1, _mm_loadu_si128((const __m128i*)(In + i*2 + 16)))) break;
+		_mm_storeu_si128((__m128i*)(Out + i), _mm_packus_epi16(_mm_maddubs_epi16(v0, Weights), _mm_maddubs_epi16(v1, Weights)));
+	}
+	return i;
+}
+
+// Zwraca liczb zakodowanych trjek bajtw (wielokrotno 4).
+COMMON_SSSE3_FUNCTION static size_t Base64Encode_SSSE3(char *Out, const uint1 *In, size_t TripleCount)
+{
+	const __m128i Shuffle = _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+	const __m128i ShiftLut = _mm_setr_epi8(
+		'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+		'0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+	size_t i = 0;
+	// Wczytywane jest 16 bajtw, z ktrych uywane 12 - std zapas
+	for ( ; i + 6 <= TripleCount; i += 4)
+	{
+		__m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(In + i*3)), Shuffle);
+		// Rozdzielenie 3 bajtw na 4 liczby 6-bitowe
+		__m128i t1 = _mm_mulhi_epu16(_mm_and_si128(v, _mm_set1_epi32(0x0FC0FC00)), _mm_set1_epi32(0x04000040));
+		__m128i t3 = _mm_mullo_epi16(_mm_and_si128(v, _mm_set1_epi32(0x003F03F0)), _mm_set1_epi32(0x01000010));
+		__m128i Indices = _mm_or_si128(t1, t3);
+		// Zamiana liczb na znaki - przesunicie zalene od przedziau
+		__m128i Range = _mm_subs_epu8(Indices, _mm_set1_epi8(51));
+		Range = _mm_or_si128(Range, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), Indices), _mm_set1_epi8(13)));
+		_mm_storeu_si128((__m128i*)(Out + i*4), _mm_add_epi8(_mm_shuffle_epi8(ShiftLut, Range), Indices));
+	}
+	return i;
+}
+
+// Zwraca liczb zdekodowanych znakw (wielokrotno 16). Zatrzymuje si przed blokiem
+// zawierajcym cokolwiek poza cyframi base64 (take '=').
+COMMON_SSSE3_FUNCTION static size_t Base64Decode_SSSE3(uint1 *Out, const char *In, size_t CharCount)
+{
+	const __m128i ShiftLut = _mm_setr_epi8(0, 0, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+	// Bit n jest zapalony, jeli znak o starszej powce n i modszej rwnej indeksowi jest cyfr base64
+	const __m128i MaskLut = _mm_setr_epi8(
+		(char)0xA8, (char)0xF8, (char)0xF8, (char)0xF8, (char)0xF8, (char)0xF8, (char)0xF8, (char)0xF8,
+		(char)0xF8, (char)0xF8, (char)0xF0, 0x54, 0x50, 0x50, 0x50, 0x54);
+	const __m128i BitLut = _mm_setr_epi8(0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char)0x80, 0, 0, 0, 0, 0, 0, 0, 0);
+	const __m128i PackShuffle = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+	size_t i = 0;
+	for ( ; i + 16 <= CharCount; i += 16)
+	{
+		__m128i c = _mm_loadu_si128((const __m128i*)(In + i));
+		__m128i HiNibble = _mm_and_si128(_mm_srli_epi32(c, 4), _mm_set1_epi8(0x0F));
+		__m128i LoNibble = _mm_and_si128(c, _mm_set1_epi8(0x0F));
+		// Walidacja
+		__m128i Match = _mm_and_si128(_mm_shuffle_epi8(MaskLut, LoNibble), _mm_shuffle_epi8(BitLut, HiNibble));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(Match, _mm_setzero_si128())) != 0)
+			break;
+		// Zamiana znakw na liczby 6-bitowe. '/' jest jedynym wyjtkiem w swoim przedziale.
+		__m128i IsSlash = _mm_cmpeq_epi8(c, _mm_set1_epi8('/'));
+		__m128i Shift = _mm_or_si128(
+			_mm_andnot_si128(IsSlash, _mm_shuffle_epi8(ShiftLut, HiNibble)),
+			_mm_and_si128(IsSlash, _mm_set1_epi8(16)));
+		__m128i v = _mm_add_epi8(c, Shift);
+		// Zoenie 4 liczb 6-bitowych w 3 bajty
+		v = _mm_madd_epi16(_mm_maddubs_epi16(v, _mm_set1_epi32(0x01400140)), _mm_set1_epi32(0x00011000));
+		v = _mm_shuffle_epi8(v, PackShuffle);
+		// Tylko 12 bajtw, eby nie pisa poza bufor
+		_mm_storel_epi64((__m128i*)(Out + i/4*3), v);
+		uint4 Last = (uint4)_mm_cvtsi128_si32(_mm_srli_si128(v, 8));
+		memcpy(Out + i/4*3 + 8, &Last, 4);
+	}
+	return i;
+}
+
+#endif
+
+static void HexEncodeBlock(char *Out, const uint1 *In, size_t Length, bool UpperCase)
+{
+	const char *Digits = UpperCase ? HEX_DIGITS_U : HEX_DIGITS_L;
+#ifdef COMMON_SSE2
+	if (Length >= 16 && g_CoderSsse3)
+	{
+		size_t Done = HexEncode_SSSE3(Out, In, Length, Digits);
+		Out += Done * 2; In += Done; Length -= Done;
+	}
+#endif
+	for ( ; Length > 0; Length--, In++)
+	{
+		*Out++ = Digits[*In >> 4];
+		*Out++ = Digits[*In & 0x0F];
+	}
+}
+
+// Dekoduje ByteCount bajtw z 2*ByteCount znakw. Jeli napotka nie-cyfr, zwraca false.
+static bool HexDecodeBlock(uint1 *Out, const char *In, size_t ByteCount)
+{
+#ifdef COMMON_SSE2
+	if (ByteCount >= 16 && g_CoderSsse3)
+	{
+		size_t Done = HexDecode_SSSE3(Out, In, ByteCount);
+		Out += Done; In += Done * 2; ByteCount -= Done;
+	}
+#endif
+	uint1 Hi, Lo;
+	for ( ; ByteCount > 0; ByteCount--, In += 2)
+	{
+		Hi = HexDigitToNumber(In[0]);
+		Lo = HexDigitToNumber(In[1]);
+		if (Hi == 0xFF || Lo == 0xFF)
+			return false;
+		*Out++ = (Hi << 4) | Lo;
+	}
+	return true;
+}
+
+// Koduje TripleCount penych trjek bajtw na 4*TripleCount znakw
+static void Base64EncodeBlock(char *Out, const uint1 *In, size_t TripleCount)
+{
+#ifdef COMMON_SSE2
+	if (TripleCount >= 6 && g_CoderSsse3)
+	{
+		size_t Done = Base64Encode_SSSE3(Out, In, TripleCount);
+		Out += Done * 4; In += Done * 3; TripleCount -= Done;
+	}
+#endif
+	for ( ; TripleCount > 0; TripleCount--, In += 3)
+	{
+		*Out++ = BASE64_CHARS[ In[0] >> 2 ];
+		*Out++ = BASE64_CHARS[ ((In[0] & 0x3) << 4) | (In[1] >> 4) ];
+		*Out++ = BASE64_CHARS[ ((In[1] & 0xF) << 2) | (In[2] >> 6) ];
+		*Out++ = BASE64_CHARS[ (In[2] & 0x3F) ];
+	}
+}
+
+// Dekoduje kolejne czwrki znakw zoone z samych cyfr base64.
+// Zwraca liczb przetworzonych znakw (wielokrotno 4). Zatrzymuje si przed
+// pierwsz czwrk zawierajc '=' lub bdny znak - t trzeba obsuy osobno.
+static size_t Base64DecodeBlock(uint1 *Out, const char *In, size_t CharCount)
+{
+	size_t Done = 0;
+#ifdef COMMON_SSE2
+	if (CharCount >= 16 && g_CoderSsse3)
+	{
+		Done = Base64Decode_SSSE3(Out, In, CharCount);
+		Out += Done / 4 * 3;
+	}
+#endif
+	uint1 n0, n1, n2, n3;
+	for ( ; Done + 4 <= CharCount; Done += 4)
+	{
+		n0 = Base64CharToNumber(In[Done  ]);
+		n1 = Base64CharToNumber(In[Done+1]);
+		n2 = Base64CharToNumber(In[Done+2]);
+		n3 = Base64CharToNumber(In[Done+3]);
+		if ((n0 | n1 | n2 | n3) >= 0x40)
+			break;
+		*Out++ = (n0 << 2) | (n1 >> 4);
+		*Out++ = (n1 << 4) | (n2 >> 2);
+		*Out++ = (n2 << 6) | n3;
+	}
+	return Done;
+}
+
 
 //HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
 // Klasa Stream
@@ -75,6 +294,15 @@ void Stream::Write(const void *Data, size_t Size)
 	throw Error(Format("Strumie klasy # nie obsuguje zapisywnia") % typeid(this).name(), __FILE__, __LINE__);
 }
 
+void Stream::WriteV(const STREAM_WRITE_BUF *Bufs, size_t Count)
+{
+	for (size_t i = 0; i < Count; i++)
+	{
+		if (Bufs[i].Size > 0)
+			Write(Bufs[i].Data, Bufs[i].Size);
+	}
+}
+
 void Stream::WriteString1(const string &s)
 {
 	typedef uint1 T;
@@ -113,6 +341,41 @@ void Stream::WriteBool(bool b)
 	Write(&bt, sizeof(bt));
 }
 
+void Stream::WriteArrayBytes(const void *Data, size_t Size, uint SwapWordSize)
+{
+	if (Size == 0) return;
+
+	if (SwapWordSize == 0)
+	{
+		Write(Data, Size);
+		return;
+	}
+
+	assert(Size % SwapWordSize == 0);
+	// BUFFER_SIZE jest wielokrotnoci kadego dozwolonego rozmiaru sowa
+	char Buf[BUFFER_SIZE];
+	const char *DataBytes = (const char*)Data;
+	while (Size > 0)
+	{
+		size_t BlockSize = std::min(Size, BUFFER_SIZE);
+		memcpy(Buf, DataBytes, BlockSize);
+		SwapByteOrder(Buf, SwapWordSize, BlockSize / SwapWordSize);
+		Write(Buf, BlockSize);
+		DataBytes += BlockSize;
+		Size -= BlockSize;
+	}
+}
+
+void Stream::ReadArrayBytes(void *Out, size_t Size, uint SwapWordSize)
+{
+	MustRead(Out, Size);
+	if (SwapWordSize != 0)
+	{
+		assert(Size % SwapWordSize == 0);
+		SwapByteOrder(Out, SwapWordSize, Size / SwapWordSize);
+	}
+}
+
 size_t Stream::Read(void *Data, size_t Size)
 {
 	throw Error(Format("Strumie klasy # nie obsuguje odczytywania") % typeid(this).name(), __FILE__, __LINE__);
@@ -126,6 +389,30 @@ void Stream::MustRead(void *Data, size_t Size)
 		throw Error(Format("Odczytano ze strumienia #/# B") % i % Size, __FILE__, __LINE__);
 }
 
+size_t Stream::ReadV(const STREAM_READ_BUF *Bufs, size_t Count)
+{
+	size_t Sum = 0;
+	for (size_t i = 0; i < Count; i++)
+	{
+		if (Bufs[i].Size == 0) continue;
+		size_t BytesRead = Read(Bufs[i].Data, Bufs[i].Size);
+		Sum += BytesRead;
+		if (BytesRead < Bufs[i].Size)
+			break;
+	}
+	return Sum;
+}
+
+void Stream::MustReadV(const STREAM_READ_BUF *Bufs, size_t Count)
+{
+	size_t Size = 0;
+	for (size_t i = 0; i < Count; i++)
+		Size += Bufs[i].Size;
+	size_t BytesRead = ReadV(Bufs, Count);
+	if (BytesRead != Size)
+		throw Error(Format("Odczytano ze strumienia #/# B") % BytesRead % Size, __FILE__, __LINE__);
+}
+
 size_t Stream::Skip(size_t MaxLength)
 {
 	// Implementacja dla klasy Stream nie posiadajcej kursora.
@@ -514,7 +801,7 @@ void CharReader::MustReadString(char *Out, size_t Length)
 size_t CharReader::ReadData(void *Out, size_t MaxLength)
 {
 	char *OutChars = (char*)Out;
-	uint BlockSize, i, Sum = 0;
+	uint BlockSize, Sum = 0;
 
 	// MaxLength bdzie zmniejszane.
 	// OutChars bdzie przesuwane.
@@ -527,12 +814,9 @@ size_t CharReader::ReadData(void *Out, size_t MaxLength)
 				return Sum;
 		}
 		BlockSize = std::min(m_BufEnd - m_BufBeg, MaxLength);
-		for (i = 0; i < BlockSize; i++)
-		{
-			*OutChars = m_Buf[m_BufBeg];
-			OutChars++;
-			m_BufBeg++;
-		}
+		memcpy(OutChars, &m_Buf[m_BufBeg], BlockSize);
+		OutChars += BlockSize;
+		m_BufBeg += BlockSize;
 		MaxLength -= BlockSize;
 		Sum += BlockSize;
 	}
@@ -907,6 +1191,20 @@ void CounterOverlayStream::Flush()
 	GetStream()->Flush();
 }
 
+void CounterOverlayStream::WriteV(const STREAM_WRITE_BUF *Bufs, size_t Count)
+{
+	GetStream()->WriteV(Bufs, Count);
+	for (size_t i = 0; i < Count; i++)
+		m_WriteCounter += Bufs[i].Size;
+}
+
+size_t CounterOverlayStream::ReadV(const STREAM_READ_BUF *Bufs, size_t Count)
+{
+	size_t BytesRead = GetStream()->ReadV(Bufs, Count);
+	m_ReadCounter += BytesRead;
+	return BytesRead;
+}
+
 //HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
 // Klasa LimitOverlayStream
 
@@ -959,6 +1257,56 @@ void LimitOverlayStream::Flush()
 	GetStream()->Flush();
 }
 
+void LimitOverlayStream::WriteV(const STREAM_WRITE_BUF *Bufs, size_t Count)
+{
+	size_t Size = 0;
+	for (size_t i = 0; i < Count; i++)
+		Size += Bufs[i].Size;
+
+	if (Size == 0)
+		return;
+	// Mieci si w limicie - caa tablica idzie dalej
+	else if (Size <= m_WriteLimit)
+	{
+		GetStream()->WriteV(Bufs, Count);
+		m_WriteLimit -= Size;
+	}
+	// Nie mieci si - zapisze po kawaku ile si da i rzuci bd
+	else
+		Stream::WriteV(Bufs, Count);
+}
+
+size_t LimitOverlayStream::ReadV(const STREAM_READ_BUF *Bufs, size_t Count)
+{
+	size_t Size = 0, i;
+	for (i = 0; i < Count; i++)
+		Size += Bufs[i].Size;
+
+	if (m_ReadLimit == 0 || Size == 0)
+		return 0;
+	else if (Size <= m_ReadLimit)
+	{
+		size_t BytesRead = GetStream()->ReadV(Bufs, Count);
+		m_ReadLimit -= BytesRead;
+		return BytesRead;
+	}
+	else
+	{
+		// Tablica przycita do limitu
+		std::vector<STREAM_READ_BUF> LimitedBufs;
+		size_t Remaining = m_ReadLimit;
+		for (i = 0; i < Count && Remaining > 0; i++)
+		{
+			LimitedBufs.push_back(Bufs[i]);
+			LimitedBufs.back().Size = std::min(Bufs[i].Size, Remaining);
+			Remaining -= LimitedBufs.back().Size;
+		}
+		size_t BytesRead = GetStream()->ReadV(&LimitedBufs[0], LimitedBufs.size());
+		m_ReadLimit -= BytesRead;
+		return BytesRead;
+	}
+}
+
 void LimitOverlayStream::SetWriteLimit(uint4 WriteLimit)
 {
 	m_WriteLimit = WriteLimit;
@@ -970,6 +1318,245 @@ void LimitOverlayStream::SetReadLimit(uint4 ReadLimit)
 }
 
 
+//HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
+// Klasa BufferedReadStream
+
+BufferedReadStream::BufferedReadStream(Stream *a_Stream, size_t BlockSize) :
+	OverlayStream(a_Stream),
+	m_Seekable(dynamic_cast<SeekableStream*>(a_Stream)),
+	m_BufBeg(0),
+	m_BufEnd(0),
+	m_BufPos(0)
+{
+	assert(BlockSize > 0);
+	m_Buf.resize(BlockSize);
+	if (m_Seekable != NULL)
+		m_BufPos = m_Seekable->GetPos();
+}
+
+SeekableStream * BufferedReadStream::MustGetSeekable()
+{
+	if (m_Seekable == NULL)
+		throw Error("BufferedReadStream: Strumie rdowy nie obsuguje kursora", __FILE__, __LINE__);
+	return m_Seekable;
+}
+
+size_t BufferedReadStream::FillBuffer(size_t MinLength)
+{
+	// Zsunicie nieodczytanych danych na pocztek
+	if (m_BufBeg > 0)
+	{
+		if (m_BufEnd > m_BufBeg)
+			memmove(&m_Buf[0], &m_Buf[m_BufBeg], m_BufEnd - m_BufBeg);
+		m_BufPos += (int)m_BufBeg;
+		m_BufEnd -= m_BufBeg;
+		m_BufBeg = 0;
+	}
+	if (MinLength > m_Buf.size())
+		m_Buf.resize(MinLength);
+
+	while (m_BufEnd < MinLength)
+	{
+		size_t ReadSize = GetStream()->Read(&m_Buf[m_BufEnd], m_Buf.size() - m_BufEnd);
+		if (ReadSize == 0)
+			break;
+		m_BufEnd += ReadSize;
+	}
+	return m_BufEnd;
+}
+
+size_t BufferedReadStream::Read(void *Data, size_t Size)
+{
+	char *CharData = (char*)Data;
+	size_t Sum = 0, BlockLength;
+	// Size bdzie zmniejszany. Oznacza liczb pozostaych do odczytania bajtw.
+
+	while (Size > 0)
+	{
+		// Dane z bufora
+		if (m_BufBeg < m_BufEnd)
+		{
+			BlockLength = std::min(m_BufEnd - m_BufBeg, Size);
+			memcpy(CharData, &m_Buf[m_BufBeg], BlockLength);
+			m_BufBeg += BlockLength;
+			CharData += BlockLength;
+			Sum += BlockLength;
+			Size -= BlockLength;
+		}
+		// Bufor pusty, a zostao co najmniej tyle co blok - prosto do strumienia rdowego
+		else if (Size >= m_Buf.size())
+		{
+			m_BufPos += (int)m_BufEnd;
+			m_BufBeg = m_BufEnd = 0;
+			BlockLength = GetStream()->Read(CharData, Size);
+			m_BufPos += (int)BlockLength;
+			Sum += BlockLength;
+			break;
+		}
+		// Bufor pusty - doczytanie
+		else if (FillBuffer(1) == 0)
+			break;
+	}
+
+	return Sum;
+}
+
+void BufferedReadStream::MustRead(void *Data, size_t Size)
+{
+	// Szybka cieka
+	if (Size <= m_BufEnd - m_BufBeg)
+	{
+		memcpy(Data, &m_Buf[m_BufBeg], Size);
+		m_BufBeg += Size;
+	}
+	else
+		Stream::MustRead(Data, Size);
+}
+
+bool BufferedReadStream::End()
+{
+	return (m_BufBeg == m_BufEnd) && GetStream()->End();
+}
+
+size_t BufferedReadStream::Skip(size_t MaxLength)
+{
+	size_t Sum = std::min(m_BufEnd - m_BufBeg, MaxLength);
+	m_BufBeg += Sum;
+	MaxLength -= Sum;
+
+	// Reszta do pominicia w strumieniu rdowym
+	if (MaxLength > 0)
+	{
+		m_BufPos += (int)m_BufEnd;
+		m_BufBeg = m_BufEnd = 0;
+		size_t Skipped = GetStream()->Skip(MaxLength);
+		m_BufPos += (int)Skipped;
+		Sum += Skipped;
+	}
+
+	return Sum;
+}
+
+const char * BufferedReadStream::GetBufferPtr(size_t *OutLength, size_t MinLength)
+{
+	if (m_BufEnd - m_BufBeg < MinLength)
+		FillBuffer(MinLength);
+	*OutLength = m_BufEnd - m_BufBeg;
+	return &m_Buf[m_BufBeg];
+}
+
+void BufferedReadStream::DiscardBuffer()
+{
+	m_BufBeg = m_BufEnd = 0;
+	m_BufPos = (m_Seekable != NULL ? m_Seekable->GetPos() : 0);
+}
+
+void BufferedReadStream::SetPos(int pos)
+{
+	SeekableStream *Seekable = MustGetSeekable();
+
+	// Nowa pozycja w obrbie wczytanego bloku - bufor zostaje
+	if (pos >= m_BufPos && pos <= m_BufPos + (int)m_BufEnd)
+		m_BufBeg = (size_t)(pos - m_BufPos);
+	else
+	{
+		Seekable->SetPos(pos);
+		m_BufBeg = m_BufEnd = 0;
+		m_BufPos = pos;
+	}
+}
+
+
+//HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
+// Klasa BufferedWriteStream
+
+BufferedWriteStream::BufferedWriteStream(Stream *a_Stream, size_t BlockSize) :
+	OverlayStream(a_Stream),
+	m_Seekable(dynamic_cast<SeekableStream*>(a_Stream)),
+	m_BufIndex(0)
+{
+	assert(BlockSize > 0);
+	m_Buf.resize(BlockSize);
+}
+
+BufferedWriteStream::~BufferedWriteStream()
+{
+	try
+	{
+		FlushBuffer();
+	}
+	catch (...)
+	{
+		assert(0 && "Wyjtek zapany w BufferedWriteStream::~BufferedWriteStream podczas wykonywania BufferedWriteStream::FlushBuffer.");
+	}
+}
+
+SeekableStream * BufferedWriteStream::MustGetSeekable()
+{
+	if (m_Seekable == NULL)
+		throw Error("BufferedWriteStream: Strumie rdowy nie obsuguje kursora", __FILE__, __LINE__);
+	return m_Seekable;
+}
+
+void BufferedWriteStream::FlushBuffer()
+{
+	if (m_BufIndex > 0)
+	{
+		// Zerowane przed zapisem, eby po bdzie destruktor nie prbowa zapisa tego samego
+		size_t Length = m_BufIndex;
+		m_BufIndex = 0;
+		GetStream()->Write(&m_Buf[0], Length);
+	}
+}
+
+void BufferedWriteStream::Write(const void *Data, size_t Size)
+{
+	// Mieci si w buforze
+	if (Size <= m_Buf.size() - m_BufIndex)
+	{
+		memcpy(&m_Buf[m_BufIndex], Data, Size);
+		m_BufIndex += Size;
+	}
+	else
+	{
+		FlushBuffer();
+		// Duy blok - prosto do strumienia rdowego
+		if (Size >= m_Buf.size())
+			GetStream()->Write(Data, Size);
+		else
+		{
+			memcpy(&m_Buf[0], Data, Size);
+			m_BufIndex = Size;
+		}
+	}
+}
+
+void BufferedWriteStream::Flush()
+{
+	FlushBuffer();
+	GetStream()->Flush();
+}
+
+void BufferedWriteStream::WriteV(const STREAM_WRITE_BUF *Bufs, size_t Count)
+{
+	// Bez wywoa wirtualnych na kady kawaek
+	for (size_t i = 0; i < Count; i++)
+		BufferedWriteStream::Write(Bufs[i].Data, Bufs[i].Size);
+}
+
+char * BufferedWriteStream::GetBufferPtr(size_t *OutLength, size_t MinLength)
+{
+	if (m_Buf.size() - m_BufIndex < MinLength)
+	{
+		FlushBuffer();
+		if (MinLength > m_Buf.size())
+			m_Buf.resize(MinLength);
+	}
+	*OutLength = m_Buf.size() - m_BufIndex;
+	return &m_Buf[m_BufIndex];
+}
+
+
 //HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
 // Klasa MultiWriterStream
 
@@ -1002,6 +1589,16 @@ void MultiWriterStream::Write(const void *Data, size_t Size)
 	ERR_CATCH_FUNC;
 }
 
+void MultiWriterStream::WriteV(const STREAM_WRITE_BUF *Bufs, size_t Count)
+{
+	ERR_TRY;
+
+	for (uint i = 0; i < m_Streams.size(); i++)
+		m_Streams[i]->WriteV(Bufs, Count);
+
+	ERR_CATCH_FUNC;
+}
+
 void MultiWriterStream::Flush()
 {
 	ERR_TRY;
@@ -1016,67 +1613,52 @@ void MultiWriterStream::Flush()
 //HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
 // Klasa Hash_Calc
 
-void Hash_Calc::Write(const void *Data, size_t Size)
-{
-	uint1 *ByteData = (uint1*)Data; // Bdzie przesuwany
+#define HASH_STEP(Hash, Byte) { (Hash) += (Byte); (Hash) += ((Hash) << 10); (Hash) ^= ((Hash) >> 6); }
 
-	for (size_t i = 0; i < Size; i++)
+// Dodaje dane do sumy. Ptla rozwinita po 4 bajty.
+static inline uint4 HashUpdate(uint4 Hash, const uint1 *ByteData, size_t Size)
+{
+	for ( ; Size >= 4; Size -= 4, ByteData += 4)
 	{
-		m_Hash += *ByteData;
-		m_Hash += (m_Hash << 10);
-		m_Hash ^= (m_Hash >> 6);
-
-		ByteData++;
+		HASH_STEP(Hash, ByteData[0]);
+		HASH_STEP(Hash, ByteData[1]);
+		HASH_STEP(Hash, ByteData[2]);
+		HASH_STEP(Hash, ByteData[3]);
 	}
+	for ( ; Size > 0; Size--, ByteData++)
+		HASH_STEP(Hash, *ByteData);
+	return Hash;
 }
 
-uint4 Hash_Calc::Finish()
-{
-	m_Hash += (m_Hash << 3);
-	m_Hash ^= (m_Hash >> 11);
-	m_Hash += (m_Hash << 15);
-
-	return m_Hash;
-}
+#undef HASH_STEP
 
-uint4 Hash_Calc::Calc(const void *Buf, uint4 BufLen)
+static inline uint4 HashFinish(uint4 Hash)
 {
-	uint4 Hash = 0;
-
-	uint1 *ByteData = (uint1*)Buf; // Bdzie przesuwany
-
-	for (size_t i = 0; i < BufLen; i++)
-	{
-		Hash += *ByteData;
-		Hash += (Hash << 10);
-		Hash ^= (Hash >> 6);
-
-		ByteData++;
-	}
-
 	Hash += (Hash << 3);
 	Hash ^= (Hash >> 11);
 	Hash += (Hash << 15);
-
 	return Hash;
 }
 
-uint4 Hash_Calc::Calc(const string &s)
+void Hash_Calc::Write(const void *Data, size_t Size)
 {
-	uint4 Hash = 0;
+	m_Hash = HashUpdate(m_Hash, (const uint1*)Data, Size);
+}
 
-	for (size_t i = 0; i < s.length(); i++)
-	{
-		Hash += (uint1)s[i];
-		Hash += (Hash << 10);
-		Hash ^= (Hash >> 6);
-	}
+uint4 Hash_Calc::Finish()
+{
+	m_Hash = HashFinish(m_Hash);
+	return m_Hash;
+}
 
-	Hash += (Hash << 3);
-	Hash ^= (Hash >> 11);
-	Hash += (Hash << 15);
+uint4 Hash_Calc::Calc(const void *Buf, uint4 BufLen)
+{
+	return HashFinish(HashUpdate(0, (const uint1*)Buf, BufLen));
+}
 
-	return Hash;
+uint4 Hash_Calc::Calc(const string &s)
+{
+	return HashFinish(HashUpdate(0, (const uint1*)s.data(), s.length()));
 }
 
 
@@ -1137,35 +1719,138 @@ const uint4 CRC32_TABLE[256] = {
 	0xB40BBE37, 0xC30C8EA1, 0x5A05DF1B, 0x2D02EF8D
 };
 
-void CRC32_Calc::Write(const void *Data, size_t Size)
+/*
+Slicing-by-8: Tablica [k][i] to CRC32 bajtu i, za ktrym jest k bajtw zerowych.
+[0] to po prostu CRC32_TABLE. Pozwala przetwarza 8 bajtw na raz, w 8
+niezalenych odczytach z tablic zamiast 8 kolejnych, zalenych od siebie krokw.
+*/
+class CRC32_SLICING_TABLES
+{
+public:
+	uint4 T[8][256];
+
+	CRC32_SLICING_TABLES()
+	{
+		for (uint i = 0; i < 256; i++)
+		{
+			T[0][i] = CRC32_TABLE[i];
+			for (uint k = 1; k < 8; k++)
+				T[k][i] = (T[k-1][i] >> 8) ^ CRC32_TABLE[T[k-1][i] & 0xFF];
+		}
+	}
+};
+
+static const CRC32_SLICING_TABLES g_Crc32Slicing;
+
+#ifdef COMMON_SSE2
+
+static bool g_Crc32Pclmul = CpuHasFeatures(CPU_FEATURE_SSE2 | CPU_FEATURE_PCLMUL);
+
+// Zwija 128 bitw x o 128 lub 512 bitw do przodu i dodaje nastpny blok
+COMMON_PCLMUL_FUNCTION static inline __m128i Crc32Fold_PCLMUL(__m128i x, __m128i K, __m128i Next)
 {
-	uint4 k;
-	uint1 *DataBytes = (uint1*)Data;
-	while (Size > 0)
-	{
-		k = (m_CRC ^ (*DataBytes)) & 0x000000FF;
-		m_CRC = ((m_CRC >> 8) & 0x00FFFFFF) ^ CRC32_TABLE[k];
+	return _mm_xor_si128(
+		_mm_xor_si128(_mm_clmulepi64_si128(x, K, 0x00), _mm_clmulepi64_si128(x, K, 0x11)),
+		Next);
+}
 
-		DataBytes++;
-		Size--;
+/*
+CRC32 metod zwijania (folding) z mnoeniem bez przeniesie.
+Na podstawie: "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ
+Instruction", Intel, 2009. Stae dla wielomianu odwrconego 0xEDB88320.
+Size musi by >= 64 i podzielne przez 16.
+CRC to warto bieca rejestru (bez negacji na wejciu i wyjciu).
+*/
+COMMON_PCLMUL_FUNCTION static uint4 Crc32Update_PCLMUL(uint4 CRC, const uint1 *Data, size_t Size)
+{
+	assert(Size >= 64 && (Size & 15) == 0);
+
+	const __m128i K1K2  = _mm_set_epi32(0x00000001, 0xC6E41596, 0x00000001, 0x54442BD4);
+	const __m128i K3K4  = _mm_set_epi32(0x00000000, 0xCCAA009E, 0x00000001, 0x751997D0);
+	const __m128i K5    = _mm_set_epi32(0x00000000, 0x00000000, 0x00000001, 0x63CD6124);
+	const __m128i Poly  = _mm_set_epi32(0x00000001, 0xF7011641, 0x00000001, 0xDB710641);
+	const __m128i Mask32 = _mm_set_epi32(0, 0, 0, -1);
+
+	__m128i x1 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(Data     )), _mm_cvtsi32_si128((int)CRC));
+	__m128i x2 = _mm_loadu_si128((const __m128i*)(Data + 16));
+	__m128i x3 = _mm_loadu_si128((const __m128i*)(Data + 32));
+	__m128i x4 = _mm_loadu_si128((const __m128i*)(Data + 48));
+	Data += 64; Size -= 64;
+
+	// Po 64 bajty, w 4 niezalenych strumieniach
+	for ( ; Size >= 64; Data += 64, Size -= 64)
+	{
+		x1 = Crc32Fold_PCLMUL(x1, K1K2, _mm_loadu_si128((const __m128i*)(Data     )));
+		x2 = Crc32Fold_PCLMUL(x2, K1K2, _mm_loadu_si128((const __m128i*)(Data + 16)));
+		x3 = Crc32Fold_PCLMUL(x3, K1K2, _mm_loadu_si128((const __m128i*)(Data + 32)));
+		x4 = Crc32Fold_PCLMUL(x4, K1K2, _mm_loadu_si128((const __m128i*)(Data + 48)));
 	}
+
+	// Zwinicie 4 strumieni w jeden
+	x1 = Crc32Fold_PCLMUL(x1, K3K4, x2);
+	x1 = Crc32Fold_PCLMUL(x1, K3K4, x3);
+	x1 = Crc32Fold_PCLMUL(x1, K3K4, x4);
+
+	// Pozostae bloki po 16 bajtw
+	for ( ; Size >= 16; Data += 16, Size -= 16)
+		x1 = Crc32Fold_PCLMUL(x1, K3K4, _mm_loadu_si128((const __m128i*)Data));
+
+	// 128 -> 64 bity
+	x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), _mm_clmulepi64_si128(K3K4, x1, 0x01));
+	// 64 -> 32 bity
+	x2 = _mm_srli_si128(x1, 4);
+	x1 = _mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, Mask32), K5, 0x00), x2);
+	// Redukcja Barretta
+	x2 = x1;
+	x1 = _mm_and_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, Mask32), Poly, 0x10), Mask32);
+	x1 = _mm_xor_si128(_mm_clmulepi64_si128(x1, Poly, 0x00), x2);
+	return (uint4)_mm_cvtsi128_si32(_mm_srli_si128(x1, 4));
 }
 
-uint CRC32_Calc::Calc(const void *Data, size_t DataLength)
+#endif
+
+// Dodaje dane do sumy CRC32. CRC to warto bieca rejestru.
+static uint4 Crc32Update(uint4 CRC, const uint1 *Data, size_t Size)
 {
-	uint4 crc = 0xFFFFFFFF; // preconditioning sets non zero value
+#ifdef COMMON_SSE2
+	if (Size >= 64 && g_Crc32Pclmul)
+	{
+		size_t BlockSize = Size & ~(size_t)15;
+		CRC = Crc32Update_PCLMUL(CRC, Data, BlockSize);
+		Data += BlockSize;
+		Size -= BlockSize;
+	}
+#endif
 
-	// loop through the buffer and calculate CRC
-	for(uint4 i = 0; i < DataLength; ++i)
+	// Slicing-by-8. Zakada little endian.
+	const uint4 (*T)[256] = g_Crc32Slicing.T;
+	uint4 A, B;
+	for ( ; Size >= 8; Data += 8, Size -= 8)
 	{
-		int k = (crc ^ ((uint1*)(Data))[i]) & 0x000000FF;
-		crc = ((crc >> 8) & 0x00FFFFFF) ^ CRC32_TABLE[k];
+		memcpy(&A, Data, 4);
+		memcpy(&B, Data + 4, 4);
+		A ^= CRC;
+		CRC =
+			T[7][A & 0xFF] ^ T[6][(A >> 8) & 0xFF] ^ T[5][(A >> 16) & 0xFF] ^ T[4][A >> 24] ^
+			T[3][B & 0xFF] ^ T[2][(B >> 8) & 0xFF] ^ T[1][(B >> 16) & 0xFF] ^ T[0][B >> 24];
 	}
 
-	crc = ~crc; // postconditioning
+	// Pozostae bajty
+	for ( ; Size > 0; Data++, Size--)
+		CRC = (CRC >> 8) ^ CRC32_TABLE[(CRC ^ *Data) & 0xFF];
+
+	return CRC;
+}
+
+void CRC32_Calc::Write(const void *Data, size_t Size)
+{
+	m_CRC = Crc32Update(m_CRC, (const uint1*)Data, Size);
+}
 
-	// report results
-	return crc;
+uint CRC32_Calc::Calc(const void *Data, size_t DataLength)
+{
+	// Warto pocztkowa 0xFFFFFFFF i negacja na kocu - zgodnie ze standardem
+	return ~Crc32Update(0xFFFFFFFF, (const uint1*)Data, DataLength);
 }
 
 
@@ -1216,10 +1901,20 @@ uint1 md5_padding[64] =
     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
 };
 
-void MD5_Calc::Process(uint1 data[64])
+void MD5_Calc::Process(const uint1 *data, size_t BlockCount)
 {
     uint4 X[16], A, B, C, D;
 
+    // Stan trzymany w zmiennych lokalnych przez wszystkie bloki
+    uint4 S0 = state[0], S1 = state[1], S2 = state[2], S3 = state[3];
+
+    for ( ; BlockCount > 0; BlockCount--, data += 64)
+    {
+
+#ifdef COMMON_SSE2
+    // x86 to little endian - sowa mona skopiowa wprost
+    memcpy(X, data, 64);
+#else
     MD5_GET_UINT32_LE( X[0],  data,  0 );
     MD5_GET_UINT32_LE( X[1],  data,  4 );
     MD5_GET_UINT32_LE( X[2],  data,  8 );
@@ -1236,18 +1931,23 @@ void MD5_Calc::Process(uint1 data[64])
     MD5_GET_UINT32_LE( X[13], data, 52 );
     MD5_GET_UINT32_LE( X[14], data, 56 );
     MD5_GET_UINT32_LE( X[15], data, 60 );
+#endif
 
-#define S(x,n) ((x << n) | ((x & 0xFFFFFFFF) >> (32 - n)))
+#ifdef _MSC_VER
+	#define S(x,n) _rotl(x, n)
+#else
+	#define S(x,n) ((x << n) | ((x & 0xFFFFFFFF) >> (32 - n)))
+#endif
 
 #define P(a,b,c,d,k,s,t)                                \
 {                                                       \
     a += F(b,c,d) + X[k] + t; a = S(a,s) + b;           \
 }
 
-    A = state[0];
-    B = state[1];
-    C = state[2];
-    D = state[3];
+    A = S0;
+    B = S1;
+    C = S2;
+    D = S3;
 
 #define F(x,y,z) (z ^ (x & (y ^ z)))
     P( A, B, C, D,  0,  7, 0xD76AA478 );
@@ -1328,10 +2028,17 @@ void MD5_Calc::Process(uint1 data[64])
 #undef P
 #undef S
 
-    state[0] += A;
-    state[1] += B;
-    state[2] += C;
-    state[3] += D;
+    S0 += A;
+    S1 += B;
+    S2 += C;
+    S3 += D;
+
+    }
+
+    state[0] = S0;
+    state[1] = S1;
+    state[2] = S2;
+    state[3] = S3;
 }
 
 MD5_Calc::MD5_Calc()
@@ -1361,17 +2068,18 @@ void MD5_Calc::Write(const void *Buf, size_t BufLen)
 	if(left && (int)BufLen >= fill)
 	{
 		memcpy((void*)(buffer + left), (void*)ByteBuf, fill);
-		Process(buffer);
+		Process(buffer, 1);
 		ByteBuf += fill;
 		BufLen -= fill;
 		left = 0;
 	}
 
-	while(BufLen >= 64)
+	// Wszystkie pene bloki jednym wywoaniem, prosto z danych wejciowych
+	if(BufLen >= 64)
 	{
-		Process(ByteBuf);
-		ByteBuf += 64;
-		BufLen -= 64;
+		Process(ByteBuf, BufLen / 64);
+		ByteBuf += BufLen & ~(size_t)63;
+		BufLen &= 63;
 	}
 
 	if(BufLen > 0)
@@ -1423,6 +2131,199 @@ void MD5_Calc::Calc(MD5_SUM *Out, const void *Buf, uint4 BufLen)
 #undef MD5_GET_UINT32_LE
 
 
+//HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
+// Klasa FastHash_Calc
+
+static const uint8 XXH_PRIME1 = 0x9E3779B185EBCA87ULL;
+static const uint8 XXH_PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint8 XXH_PRIME3 = 0x165667B19E3779F9ULL;
+static const uint8 XXH_PRIME4 = 0x85EBCA77C2B2AE63ULL;
+static const uint8 XXH_PRIME5 = 0x27D4EB2F165667C5ULL;
+
+static inline uint8 XxhRotl(uint8 x, int n)
+{
+#ifdef _MSC_VER
+	return _rotl64(x, n);
+#else
+	return (x << n) | (x >> (64 - n));
+#endif
+}
+
+// Zakada little endian
+static inline uint8 XxhRead8(const uint1 *p) { uint8 r; memcpy(&r, p, 8); return r; }
+static inline uint4 XxhRead4(const uint1 *p) { uint4 r; memcpy(&r, p, 4); return r; }
+
+static inline uint8 XxhRound(uint8 Acc, uint8 Input)
+{
+	Acc += Input * XXH_PRIME2;
+	Acc = XxhRotl(Acc, 31);
+	return Acc * XXH_PRIME1;
+}
+
+static inline uint8 XxhMerge(uint8 Acc, uint8 Val)
+{
+	Acc ^= XxhRound(0, Val);
+	return Acc * XXH_PRIME1 + XXH_PRIME4;
+}
+
+// Przetwarza pene pasy po 32 bajty. Zwraca liczb przetworzonych bajtw.
+static size_t XxhStripes(uint8 V[4], const uint1 *Data, size_t Size)
+{
+	uint8 v1 = V[0], v2 = V[1], v3 = V[2], v4 = V[3];
+	const uint1 *p = Data, *End = Data + (Size & ~(size_t)31);
+	for ( ; p < End; p += 32)
+	{
+		v1 = XxhRound(v1, XxhRead8(p     ));
+		v2 = XxhRound(v2, XxhRead8(p +  8));
+		v3 = XxhRound(v3, XxhRead8(p + 16));
+		v4 = XxhRound(v4, XxhRead8(p + 24));
+	}
+	V[0] = v1; V[1] = v2; V[2] = v3; V[3] = v4;
+	return p - Data;
+}
+
+// Dodaje reszt danych (< 32 bajty) i miesza bity wyniku
+static uint8 XxhFinish(uint8 h, const uint1 *p, size_t Size)
+{
+	for ( ; Size >= 8; p += 8, Size -= 8)
+		h = XxhRotl(h ^ XxhRound(0, XxhRead8(p)), 27) * XXH_PRIME1 + XXH_PRIME4;
+	if (Size >= 4)
+	{
+		h = XxhRotl(h ^ (XxhRead4(p) * XXH_PRIME1), 23) * XXH_PRIME2 + XXH_PRIME3;
+		p += 4; Size -= 4;
+	}
+	for ( ; Size > 0; p++, Size--)
+		h = XxhRotl(h ^ (*p * XXH_PRIME5), 11) * XXH_PRIME1;
+
+	h ^= h >> 33;
+	h *= XXH_PRIME2;
+	h ^= h >> 29;
+	h *= XXH_PRIME3;
+	h ^= h >> 32;
+	return h;
+}
+
+// Warto porednia dla wyniku 64-bitowego - standardowe XXH64
+static inline uint8 XxhStart64(const uint8 V[4], uint8 Seed, uint8 TotalLength)
+{
+	uint8 h;
+	if (TotalLength >= 32)
+	{
+		h = XxhRotl(V[0], 1) + XxhRotl(V[1], 7) + XxhRotl(V[2], 12) + XxhRotl(V[3], 18);
+		h = XxhMerge(h, V[0]);
+		h = XxhMerge(h, V[1]);
+		h = XxhMerge(h, V[2]);
+		h = XxhMerge(h, V[3]);
+	}
+	else
+		h = Seed + XXH_PRIME5;
+	return h + TotalLength;
+}
+
+// Warto porednia dla drugiej poowy wyniku 128-bitowego - pasy poczone w odwrotnej kolejnoci
+static inline uint8 XxhStartHi(const uint8 V[4], uint8 Seed, uint8 TotalLength)
+{
+	uint8 h;
+	if (TotalLength >= 32)
+	{
+		h = XxhRotl(V[3], 1) + XxhRotl(V[2], 7) + XxhRotl(V[1], 12) + XxhRotl(V[0], 18);
+		h = XxhMerge(h, V[3]);
+		h = XxhMerge(h, V[2]);
+		h = XxhMerge(h, V[1]);
+		h = XxhMerge(h, V[0]);
+	}
+	else
+		h = Seed ^ XXH_PRIME3;
+	return h ^ (TotalLength * XXH_PRIME2);
+}
+
+void FastHash_Calc::Reset(uint8 Seed)
+{
+	m_Seed = Seed;
+	m_V[0] = Seed + XXH_PRIME1 + XXH_PRIME2;
+	m_V[1] = Seed + XXH_PRIME2;
+	m_V[2] = Seed;
+	m_V[3] = Seed - XXH_PRIME1;
+	m_TotalLength = 0;
+	m_BufLength = 0;
+}
+
+void FastHash_Calc::Write(const void *Data, size_t Size)
+{
+	const uint1 *ByteData = (const uint1*)Data;
+	m_TotalLength += Size;
+
+	// Dopenij zaczty pas
+	if (m_BufLength > 0)
+	{
+		size_t Fill = std::min<size_t>(32 - m_BufLength, Size);
+		memcpy(m_Buf + m_BufLength, ByteData, Fill);
+		m_BufLength += (uint4)Fill;
+		ByteData += Fill;
+		Size -= Fill;
+		if (m_BufLength < 32)
+			return;
+		XxhStripes(m_V, m_Buf, 32);
+		m_BufLength = 0;
+	}
+
+	// Pene pasy prosto z danych wejciowych
+	size_t Done = XxhStripes(m_V, ByteData, Size);
+	ByteData += Done;
+	Size -= Done;
+
+	// Reszta do bufora
+	if (Size > 0)
+	{
+		memcpy(m_Buf, ByteData, Size);
+		m_BufLength = (uint4)Size;
+	}
+}
+
+uint8 FastHash_Calc::GetResult() const
+{
+	return XxhFinish(XxhStart64(m_V, m_Seed, m_TotalLength), m_Buf, m_BufLength);
+}
+
+void FastHash_Calc::GetResult128(HASH128 *Out) const
+{
+	Out->Lo = XxhFinish(XxhStart64(m_V, m_Seed, m_TotalLength), m_Buf, m_BufLength);
+	Out->Hi = XxhFinish(XxhStartHi(m_V, m_Seed, m_TotalLength), m_Buf, m_BufLength);
+}
+
+uint8 FastHash_Calc::Calc(const void *Data, size_t DataLength, uint8 Seed)
+{
+	FastHash_Calc Calc(Seed);
+	size_t Done = XxhStripes(Calc.m_V, (const uint1*)Data, DataLength);
+	return XxhFinish(XxhStart64(Calc.m_V, Seed, DataLength), (const uint1*)Data + Done, DataLength - Done);
+}
+
+void FastHash_Calc::Calc128(HASH128 *Out, const void *Data, size_t DataLength, uint8 Seed)
+{
+	FastHash_Calc Calc(Seed);
+	size_t Done = XxhStripes(Calc.m_V, (const uint1*)Data, DataLength);
+	Out->Lo = XxhFinish(XxhStart64(Calc.m_V, Seed, DataLength), (const uint1*)Data + Done, DataLength - Done);
+	Out->Hi = XxhFinish(XxhStartHi(Calc.m_V, Seed, DataLength), (const uint1*)Data + Done, DataLength - Done);
+}
+
+void Hash128ToStr(string *Out, const HASH128 &Hash)
+{
+	string Lo;
+	UintToStr2(Out, Hash.Hi, 16, 16);
+	UintToStr2(&Lo, Hash.Lo, 16, 16);
+	Out->append(Lo);
+}
+
+bool StrToHash128(HASH128 *Out, const string &s)
+{
+	if (s.length() != 32)
+		return false;
+	return
+		StrToUint(&Out->Hi, s.substr(0, 16), 16) == 0 &&
+		StrToUint(&Out->Lo, s.substr(16), 16) == 0;
+}
+
+
 //HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
 // Klasa XorCoder
 
@@ -2238,35 +3139,22 @@ break_2_ALL:
 //HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
 // Klasa HexEncoder
 
-const char * const HEX_DIGITS_U = "0123456789ABCDEF";
-const char * const HEX_DIGITS_L = "0123456789abcdef";
-
 void HexEncoder::Write(const void *Data, size_t Size)
 {
 	ERR_TRY;
 
+	// Kodowanie blokami przez bufor na stosie
 	const uint1 *Bytes = (const uint1*)Data;
-	uint1 Byte;
+	char Chars[CODER_CHUNK_SIZE];
+	size_t BlockSize;
 
-	if (m_UpperCase)
-	{
-		for (uint i = 0; i < Size; i++)
-		{
-			Byte = *Bytes;
-			m_CharWriter.WriteChar(HEX_DIGITS_U[(Byte & 0xF0) >> 4]);
-			m_CharWriter.WriteChar(HEX_DIGITS_U[Byte & 0x0F]);
-			Bytes++;
-		}
-	}
-	else
+	while (Size > 0)
 	{
-		for (uint i = 0; i < Size; i++)
-		{
-			Byte = *Bytes;
-			m_CharWriter.WriteChar(HEX_DIGITS_L[(Byte & 0xF0) >> 4]);
-			m_CharWriter.WriteChar(HEX_DIGITS_L[Byte & 0x0F]);
-			Bytes++;
-		}
+		BlockSize = std::min(Size, CODER_CHUNK_SIZE / 2);
+		HexEncodeBlock(Chars, Bytes, BlockSize, m_UpperCase);
+		m_CharWriter.WriteData(Chars, BlockSize * 2);
+		Bytes += BlockSize;
+		Size -= BlockSize;
 	}
 
 	ERR_CATCH_FUNC;
@@ -2274,68 +3162,14 @@ void HexEncoder::Write(const void *Data, size_t Size)
 
 void HexEncoder::Encode(char *Out, const void *Data, size_t DataLength, bool UpperCase)
 {
-	// DataLength bdzie zmniejszane.
-	// Out i InBytes bd przesuwane.
-
-	const uint1 *InBytes = (const uint1*)Data;
-	uint1 Byte;
-
-	if (UpperCase)
-	{
-		while (DataLength > 0)
-		{
-			Byte = *InBytes;
-			*Out = HEX_DIGITS_U[(Byte & 0xF0) >> 4]; Out++;
-			*Out = HEX_DIGITS_U[ Byte & 0x0F      ]; Out++;
-			InBytes++;
-			DataLength--;
-		}
-	}
-	else
-	{
-		while (DataLength > 0)
-		{
-			Byte = *InBytes;
-			*Out = HEX_DIGITS_L[(Byte & 0xF0) >> 4]; Out++;
-			*Out = HEX_DIGITS_L[ Byte & 0x0F      ]; Out++;
-			InBytes++;
-			DataLength--;
-		}
-	}
+	HexEncodeBlock(Out, (const uint1*)Data, DataLength, UpperCase);
 }
 
 void HexEncoder::Encode(string *Out, const void *Data, size_t DataLength, bool UpperCase)
 {
-	// DataLength bdzie zmniejszane.
-	// InBytes bdzie przesuwane.
 	Out->resize(DataLength * 2);
-
-	const uint1 *InBytes = (const uint1*)Data;
-	uint1 Byte;
-	uint Out_i = 0;
-
-	if (UpperCase)
-	{
-		while (DataLength > 0)
-		{
-			Byte = *InBytes;
-			(*Out)[Out_i] = HEX_DIGITS_U[(Byte & 0xF0) >> 4]; Out_i++;
-			(*Out)[Out_i] = HEX_DIGITS_U[ Byte & 0x0F      ]; Out_i++;
-			InBytes++;
-			DataLength--;
-		}
-	}
-	else
-	{
-		while (DataLength > 0)
-		{
-			Byte = *InBytes;
-			(*Out)[Out_i] = HEX_DIGITS_L[(Byte & 0xF0) >> 4]; Out_i++;
-			(*Out)[Out_i] = HEX_DIGITS_L[ Byte & 0x0F      ]; Out_i++;
-			InBytes++;
-			DataLength--;
-		}
-	}
+	if (DataLength > 0)
+		HexEncodeBlock(&(*Out)[0], (const uint1*)Data, DataLength, UpperCase);
 }
 
 
@@ -2362,26 +3196,25 @@ size_t HexDecoder::Read(void *Out, size_t Size)
 
 	if (m_Tolerance == DECODE_TOLERANCE_NONE)
 	{
+		// Znaki wczytywane i dekodowane blokami przez bufor na stosie
+		char Chars[CODER_CHUNK_SIZE];
+		size_t BlockSize, CharCount;
 		while (Size > 0)
 		{
-			// Pierwsza cyfra - moe jej nie by jeli to koniec strumienia
-			if (!m_CharReader.ReadChar(&Ch))
-				break;
-			HexNumber = HexDigitToNumber(Ch);
-			if (HexNumber == 0xFF)
+			BlockSize = std::min(Size, CODER_CHUNK_SIZE / 2);
+			CharCount = m_CharReader.ReadData(Chars, BlockSize * 2);
+			// Druga cyfra ostatniego bajtu musi by
+			if ((CharCount & 1) != 0)
+				Chars[CharCount++] = m_CharReader.MustReadChar();
+			if (!HexDecodeBlock(OutBytes, Chars, CharCount / 2))
 				throw Error(ERRMSG_DECODE_INVALID_CHAR, __FILE__, __LINE__);
-			Byte = HexNumber << 4;
 
-			// Druga cyfra
-			HexNumber = HexDigitToNumber(m_CharReader.MustReadChar());
-			if (HexNumber == 0xFF)
-				throw Error(ERRMSG_DECODE_INVALID_CHAR, __FILE__, __LINE__);
-			Byte |= HexNumber;
-
-			*OutBytes = Byte;
-			OutBytes++;
-			Sum++;
-			Size--;
+			OutBytes += CharCount / 2;
+			Sum += CharCount / 2;
+			Size -= CharCount / 2;
+			// Koniec strumienia
+			if (CharCount < BlockSize * 2)
+				break;
 		}
 	}
 	else if (m_Tolerance == DECODE_TOLERANCE_WHITESPACE)
@@ -2543,20 +3376,8 @@ size_t HexDecoder::Decode(void *OutData, const string &s, DECODE_TOLERANCE Toler
 	{
 		if ((s.length() & 0x01) != 0) return MAXUINT4;
 
-		while (s_i < s.length())
-		{
-			HexNumber = HexDigitToNumber(s[s_i++]);
-			if (HexNumber == 0xFF) return MAXUINT4;
-			Byte = HexNumber << 4;
-
-			HexNumber = HexDigitToNumber(s[s_i++]);
-			if (HexNumber == 0xFF) return MAXUINT4;
-			Byte |= HexNumber;
-
-			*OutBytes = Byte;
-			OutBytes++;
-			Sum++;
-		}
+		if (!HexDecodeBlock(OutBytes, s.data(), s.length() / 2)) return MAXUINT4;
+		Sum = s.length() / 2;
 	}
 	else if (Tolerance == DECODE_TOLERANCE_WHITESPACE)
 	{
@@ -2661,20 +3482,8 @@ size_t HexDecoder::Decode(void *OutData, const char *s, uint s_Length, DECODE_TO
 	{
 		if ((s_Length & 0x01) != 0) return MAXUINT4;
 
-		while (s_i < s_Length)
-		{
-			HexNumber = HexDigitToNumber(s[s_i++]);
-			if (HexNumber == 0xFF) return MAXUINT4;
-			Byte = HexNumber << 4;
-
-			HexNumber = HexDigitToNumber(s[s_i++]);
-			if (HexNumber == 0xFF) return MAXUINT4;
-			Byte |= HexNumber;
-
-			*OutBytes = Byte;
-			OutBytes++;
-			Sum++;
-		}
+		if (!HexDecodeBlock(OutBytes, s, s_Length / 2)) return MAXUINT4;
+		Sum = s_Length / 2;
 	}
 	else if (Tolerance == DECODE_TOLERANCE_WHITESPACE)
 	{
@@ -2828,6 +3637,17 @@ void Base64Encoder::Write(const void *Data, size_t Size)
 			m_CharWriter.WriteChar( BASE64_CHARS[ (*ByteData & 0x3F) ] );
 			m_BufIndex = 0;
 		}
+		else if (m_BufIndex == 0 && Size >= 3)
+		{
+			// Bufor pusty - cae trjki kodowane blokami przez bufor na stosie
+			char Chars[CODER_CHUNK_SIZE];
+			size_t TripleCount = std::min(Size / 3, CODER_CHUNK_SIZE / 4);
+			Base64EncodeBlock(Chars, ByteData, TripleCount);
+			m_CharWriter.WriteData(Chars, TripleCount * 4);
+			Size -= TripleCount * 3;
+			ByteData += TripleCount * 3;
+			continue;
+		}
 		else
 			m_Buf[m_BufIndex++] = *ByteData;
 
@@ -2850,18 +3670,9 @@ size_t Base64Encoder::Encode(char *Out, const void *Data, size_t DataLength)
 	size_t RemainingBytes = DataLength % 3;
 	size_t OutLength = ceil_div<size_t>(DataLength, 3) * 4;
 
-	size_t OutIndex = 0;
-
-	while (BlockCount > 0)
-	{
-		Out[OutIndex++] = BASE64_CHARS[ ByteData[0] >> 2 ];
-		Out[OutIndex++] = BASE64_CHARS[ ((ByteData[0] & 0x3) << 4) | (ByteData[1] >> 4) ];
-		Out[OutIndex++] = BASE64_CHARS[ ((ByteData[1] & 0xF) << 2) | (ByteData[2] >> 6) ];
-		Out[OutIndex++] = BASE64_CHARS[ (ByteData[2] & 0x3F) ];
-
-		ByteData += 3;
-		BlockCount--;
-	}
+	Base64EncodeBlock(Out, ByteData, BlockCount);
+	size_t OutIndex = BlockCount * 4;
+	ByteData += BlockCount * 3;
 
 	switch (RemainingBytes)
 	{
@@ -2891,18 +3702,10 @@ size_t Base64Encoder::Encode(string *Out, const void *Data, size_t DataLength)
 
 	Out->clear();
 	Out->resize(OutLength);
-	size_t OutIndex = 0;
-
-	while (BlockCount > 0)
-	{
-		(*Out)[OutIndex++] = BASE64_CHARS[ ByteData[0] >> 2 ];
-		(*Out)[OutIndex++] = BASE64_CHARS[ ((ByteData[0] & 0x3) << 4) | (ByteData[1] >> 4) ];
-		(*Out)[OutIndex++] = BASE64_CHARS[ ((ByteData[1] & 0xF) << 2) | (ByteData[2] >> 6) ];
-		(*Out)[OutIndex++] = BASE64_CHARS[ (ByteData[2] & 0x3F) ];
-
-		ByteData += 3;
-		BlockCount--;
-	}
+	if (BlockCount > 0)
+		Base64EncodeBlock(&(*Out)[0], ByteData, BlockCount);
+	size_t OutIndex = BlockCount * 4;
+	ByteData += BlockCount * 3;
 
 	switch (RemainingBytes)
 	{
@@ -2927,6 +3730,51 @@ size_t Base64Encoder::Encode(string *Out, const void *Data, size_t DataLength)
 //HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
 // Klasa Base64Decoder
 
+void Base64Decoder::DecodeQuad(const uint1 Numbers[4])
+{
+	// Koczy si na "=" lub "=="
+	if (Numbers[3] == 0xFE)
+	{
+		// Koczy si na "=="
+		if (Numbers[2] == 0xFE)
+		{
+			if (Numbers[0] >= 0xFE) throw Error(ERRMSG_DECODE_INVALID_CHAR);
+			if (Numbers[1] >= 0xFE) throw Error(ERRMSG_DECODE_INVALID_CHAR);
+
+			m_Buf[0] = (Numbers[0] << 2) | (Numbers[1] >> 4);
+			m_BufLength = 1;
+			m_Finished = true;
+			return;
+		}
+		// Koczy si na "="
+		else
+		{
+			if (Numbers[0] >= 0xFE) throw Error(ERRMSG_DECODE_INVALID_CHAR);
+			if (Numbers[1] >= 0xFE) throw Error(ERRMSG_DECODE_INVALID_CHAR);
+			if (Numbers[2] >= 0xFE) throw Error(ERRMSG_DECODE_INVALID_CHAR);
+
+			m_Buf[1] = (Numbers[0] << 2) | (Numbers[1] >> 4);
+			m_Buf[0] = (Numbers[1] << 4) | (Numbers[2] >> 2);
+			m_BufLength = 2;
+			m_Finished = true;
+			return;
+		}
+	}
+
+	// Nie koczy si - normalne znaki
+
+	// Bdne znaki lub '=' tam gdzie nie trzeba.
+	if (Numbers[0] >= 0xFE) throw Error(ERRMSG_DECODE_INVALID_CHAR);
+	if (Numbers[1] >= 0xFE) throw Error(ERRMSG_DECODE_INVALID_CHAR);
+	if (Numbers[2] >= 0xFE) throw Error(ERRMSG_DECODE_INVALID_CHAR);
+	if (Numbers[3] >= 0xFE) throw Error(ERRMSG_DECODE_INVALID_CHAR);
+
+	m_Buf[2] = (Numbers[0] << 2) | (Numbers[1] >> 4);
+	m_Buf[1] = (Numbers[1] << 4) | (Numbers[2] >> 2);
+	m_Buf[0] = (Numbers[2] << 6) | Numbers[3];
+	m_BufLength = 3;
+}
+
 bool Base64Decoder::ReadNextBuf()
 {
 	uint1 Numbers[4];
@@ -2945,45 +3793,7 @@ bool Base64Decoder::ReadNextBuf()
 		Numbers[2] = Base64CharToNumber(Chs[2]);
 		Numbers[3] = Base64CharToNumber(Chs[3]);
 
-		// Koczy si na "=" lub "=="
-		if (Numbers[3] == 0xFE)
-		{
-			// Koczy si na "=="
-			if (Numbers[2] == 0xFE)
-			{
-				if (Numbers[0] >= 0xFE) throw Error(ERRMSG_DECODE_INVALID_CHAR);
-				if (Numbers[1] >= 0xFE) throw Error(ERRMSG_DECODE_INVALID_CHAR);
-
-				m_Buf[0] = (Numbers[0] << 2) | (Numbers[1] >> 4);
-				m_BufLength = 1;
-				m_Finished = true;
-				return true;
-			}
-			// Koczy si na "="
-			else
-			{
-				if (Numbers[0] >= 0xFE) throw Error(ERRMSG_DECODE_INVALID_CHAR);
-				if (Numbers[1] >= 0xFE) throw Error(ERRMSG_DECODE_INVALID_CHAR);
-				if (Numbers[2] >= 0xFE) throw Error(ERRMSG_DECODE_INVALID_CHAR);
-
-				m_Buf[1] = (Numbers[0] << 2) | (Numbers[1] >> 4);
-				m_Buf[0] = (Numbers[1] << 4) | (Numbers[2] >> 2);
-				m_BufLength = 2;
-				m_Finished = true;
-				return true;
-			}
-		}
-
-		// Bdne znaki lub '=' tam gdzie nie trzeba.
-		if (Numbers[0] >= 0xFE) throw Error(ERRMSG_DECODE_INVALID_CHAR);
-		if (Numbers[1] >= 0xFE) throw Error(ERRMSG_DECODE_INVALID_CHAR);
-		if (Numbers[2] >= 0xFE) throw Error(ERRMSG_DECODE_INVALID_CHAR);
-		if (Numbers[3] >= 0xFE) throw Error(ERRMSG_DECODE_INVALID_CHAR);
-
-		m_Buf[2] = (Numbers[0] << 2) | (Numbers[1] >> 4);
-		m_Buf[1] = (Numbers[1] << 4) | (Numbers[2] >> 2);
-		m_Buf[0] = (Numbers[2] << 6) | Numbers[3];
-		m_BufLength = 3;
+		DecodeQuad(Numbers);
 		return true;
 	}
 	else
@@ -3019,53 +3829,10 @@ bool Base64Decoder::ReadNextBuf()
 			{
 				Numbers[NumberIndex++] = Base64CharToNumber(Ch);
 
-				// To czwarty z czwrki znakw
+				// To czwarty z czwrki znakw - przetwrz t czwrk
 				if (NumberIndex == 4)
 				{
-					// Przetwrz t czwrk
-
-					// Koczy si na "=" lub "=="
-					if (Numbers[3] == 0xFE)
-					{
-						// Koczy si na "=="
-						if (Numbers[2] == 0xFE)
-						{
-							if (Numbers[0] >= 0xFE) throw Error(ERRMSG_DECODE_INVALID_CHAR);
-							if (Numbers[1] >= 0xFE) throw Error(ERRMSG_DECODE_INVALID_CHAR);
-
-							m_Buf[0] = (Numbers[0] << 2) | (Numbers[1] >> 4); //OutBytes++;
-							m_BufLength = 1;
-							m_Finished = true;
-							return true;
-						}
-						// Koczy si na "="
-						else
-						{
-							if (Numbers[0] >= 0xFE) throw Error(ERRMSG_DECODE_INVALID_CHAR);
-							if (Numbers[1] >= 0xFE) throw Error(ERRMSG_DECODE_INVALID_CHAR);
-							if (Numbers[2] >= 0xFE) throw Error(ERRMSG_DECODE_INVALID_CHAR);
-
-							m_Buf[1] = (Numbers[0] << 2) | (Numbers[1] >> 4);
-							m_Buf[0] = (Numbers[1] << 4) | (Numbers[2] >> 2);
-							m_BufLength = 2;
-							m_Finished = true;
-							return true;
-						}
-					}
-
-					// Nie koczy si - normalne znaki
-
-					// Bdne znaki lub '=' tam gdzie nie trzeba.
-					if (Numbers[0] >= 0xFE) throw Error(ERRMSG_DECODE_INVALID_CHAR);
-					if (Numbers[1] >= 0xFE) throw Error(ERRMSG_DECODE_INVALID_CHAR);
-					if (Numbers[2] >= 0xFE) throw Error(ERRMSG_DECODE_INVALID_CHAR);
-					if (Numbers[3] >= 0xFE) throw Error(ERRMSG_DECODE_INVALID_CHAR);
-
-					m_Buf[2] = (Numbers[0] << 2) | (Numbers[1] >> 4);
-					m_Buf[1] = (Numbers[1] << 4) | (Numbers[2] >> 2);
-					m_Buf[0] = (Numbers[2] << 6) | Numbers[3];
-
-					m_BufLength = 3;
+					DecodeQuad(Numbers);
 					return true;
 				}
 			}
@@ -3090,6 +3857,55 @@ size_t Base64Decoder::Read(void *Out, size_t Size)
 	// Size bdzie zmniejszany. OutBytes bdzie przesuwany.
 
 	size_t Sum = 0;
+
+	// Szybka cieka - cae czwrki znakw wczytywane i dekodowane blokami przez bufor na stosie.
+	// Bloku jest co najwyej Size / 3 czwrek, wic wszystko z niego mieci si w Out.
+	if (m_Tolerance == DECODE_TOLERANCE_NONE)
+	{
+		char Chars[CODER_CHUNK_SIZE];
+		size_t BlockCharCount, CharCount, CharIndex, DoneCharCount;
+		uint1 Numbers[4];
+		while (Size >= 3 && m_BufLength == 0)
+		{
+			BlockCharCount = std::min(Size / 3, CODER_CHUNK_SIZE / 4) * 4;
+			CharCount = m_CharReader.ReadData(Chars, BlockCharCount);
+			if ((CharCount & 3) != 0)
+				_ThrowBufEndError(__FILE__, __LINE__);
+
+			CharIndex = 0;
+			while (CharIndex < CharCount)
+			{
+				DoneCharCount = Base64DecodeBlock(OutBytes, Chars + CharIndex, CharCount - CharIndex);
+				CharIndex += DoneCharCount;
+				OutBytes += DoneCharCount / 4 * 3;
+				Sum += DoneCharCount / 4 * 3;
+				Size -= DoneCharCount / 4 * 3;
+
+				// Czwrka z '=' lub bdnym znakiem - przez m_Buf jak zwykle
+				if (CharIndex < CharCount)
+				{
+					Numbers[0] = Base64CharToNumber(Chars[CharIndex  ]);
+					Numbers[1] = Base64CharToNumber(Chars[CharIndex+1]);
+					Numbers[2] = Base64CharToNumber(Chars[CharIndex+2]);
+					Numbers[3] = Base64CharToNumber(Chars[CharIndex+3]);
+					DecodeQuad(Numbers);
+					CharIndex += 4;
+					while (m_BufLength > 0)
+					{
+						*OutBytes = m_Buf[--m_BufLength];
+						OutBytes++;
+						Sum++;
+						Size--;
+					}
+				}
+			}
+
+			// Koniec strumienia
+			if (CharCount < BlockCharCount)
+				break;
+		}
+	}
+
 	while (Size > 0)
 	{
 		if (!GetNextByte(OutBytes))
@@ -3223,6 +4039,11 @@ size_t Base64Decoder::Decode(void *OutData, const string &s, DECODE_TOLERANCE To
 	{
 		if ((s.length() & 3) != 0) return MAXUINT4;
 
+		// Wszystkie czwrki bez '=' na raz, dalej tylko kocwka
+		s_i = (uint)Base64DecodeBlock(OutBytes, s.data(), s.length());
+		Sum = s_i / 4 * 3;
+		OutBytes += Sum;
+
 		while (s_i < s.length())
 		{
 			Numbers[0] = Base64CharToNumber(s[s_i++]);
@@ -3371,6 +4192,11 @@ size_t Base64Decoder::Decode(void *OutData, const char *s, uint s_Length, DECODE
 	{
 		if ((s_Length & 3) != 0) return MAXUINT4;
 
+		// Wszystkie czwrki bez '=' na raz, dalej tylko kocwka
+		s_i = (uint)Base64DecodeBlock(OutBytes, s, s_Length);
+		Sum = s_i / 4 * 3;
+		OutBytes += Sum;
+
 		while (s_i < s_Length)
 		{
 			Numbers[0] = Base64CharToNumber(s[s_i++]);
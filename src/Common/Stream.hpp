@@ -16,6 +16,8 @@ namespace common
 {
 
 extern const size_t BUFFER_SIZE;
+// Domylny rozmiar bloku BufferedReadStream i BufferedWriteStream
+extern const size_t BUFFERED_STREAM_BLOCK_SIZE;
 
 // [Wewntrzne]
 void _ThrowBufEndError(const char *File, int Line);
@@ -27,6 +29,20 @@ enum DECODE_TOLERANCE
 	DECODE_TOLERANCE_ALL,        // Wszelkie nieznane znaki bd ignorowane i nie spowoduj bdu
 };
 
+// Opis jednego kawaka danych do zapisania przez Stream::WriteV
+struct STREAM_WRITE_BUF
+{
+	const void *Data;
+	size_t Size;
+};
+
+// Opis jednego kawaka bufora do odczytania przez Stream::ReadV
+struct STREAM_READ_BUF
+{
+	void *Data;
+	size_t Size;
+};
+
 
 // Abstrakcyjna klasa bazowa strumieni danych binarnych
 class Stream
@@ -42,6 +58,13 @@ public:
 	virtual void Write(const void *Data, size_t Size);
 	// Domylnie nie robi nic.
 	virtual void Flush() { }
+	// Zapisuje po kolei dane z Count podanych kawakw (scatter/gather)
+	// - Dziaa tak samo jak kolejne wywoania Write, ale jednym wywoaniem wirtualnym.
+	//   Nakadki przekazujce dane bez zmian przekazuj ca tablic dalej, a
+	//   FileStream zapisuje j jednym wywoaniem systemowym.
+	// - Tablica i dane musz by wane tylko na czas wywoania.
+	// (W oryginale: wywouje Write dla kadego kawaka)
+	virtual void WriteV(const STREAM_WRITE_BUF *Bufs, size_t Count);
 
 	// Zapisuje dane, sama odczytuje rozmiar przekazanej zmiennej
 	template <typename T>
@@ -58,6 +81,14 @@ public:
 	void WriteStringF(const string &s);
 	// Zapisuje warto logiczn za pomoc jednego bajtu
 	void WriteBool(bool b);
+	// Zapisuje tablic elementw typu POD jednym wywoaniem Write
+	// - SwapWordSize = 2, 4 lub 8 zapisuje j z odwrcon kolejnoci bajtw w kadym sowie o tym
+	//   rozmiarze (np. format big endian). sizeof(T) musi by jego wielokrotnoci.
+	//   Wtedy zapis idzie przez bufor, po BUFFER_SIZE bajtw.
+	template <typename T>
+	void WriteArray(const T *Data, size_t Count, uint SwapWordSize = 0) { WriteArrayBytes(Data, Count * sizeof(T), SwapWordSize); }
+	template <typename T>
+	void WriteArray(const std::vector<T> &Data, uint SwapWordSize = 0) { if (!Data.empty()) WriteArray(&Data[0], Data.size(), SwapWordSize); }
 
 	// ======== ODCZYTYWANIE ========
 
@@ -71,6 +102,12 @@ public:
 	// Jeli koniec pliku albo jeli odczytano mniej, zgasza bd.
 	// (Mona j przeadowa, ale nie trzeba - ma swoj wersj oryginaln)
 	virtual void MustRead(void *Data, size_t Length);
+	// Odczytuje dane po kolei do Count podanych kawakw bufora (scatter/gather)
+	// Zwraca czn liczb odczytanych bajtw. Mniej ni suma rozmiarw oznacza koniec strumienia.
+	// (W oryginale: wywouje Read dla kadego kawaka, a ktry odczyta mniej)
+	virtual size_t ReadV(const STREAM_READ_BUF *Bufs, size_t Count);
+	// Tak jak ReadV, ale jeli odczyta mniej ni suma rozmiarw, zgasza bd.
+	void MustReadV(const STREAM_READ_BUF *Bufs, size_t Count);
 	// Tak samo jak MustRead, ale sama odczytuje rozmiar przekazanej zmiennej
 	// Zwraca true, jeli osignito koniec strumienia
 	// (W oryginale: zgasza bd)
@@ -94,6 +131,13 @@ public:
 	void ReadStringToEnd(string *s);
 	// Odczytuje warto logiczn za pomoc jednego bajtu
 	void ReadBool(bool *b);
+	// Odczytuje tablic elementw typu POD jednym wywoaniem MustRead
+	// - Znaczenie SwapWordSize jak w WriteArray. Zamiana kolejnoci bajtw jest robiona w miejscu, z SSE2.
+	template <typename T>
+	void ReadArray(T *Out, size_t Count, uint SwapWordSize = 0) { ReadArrayBytes(Out, Count * sizeof(T), SwapWordSize); }
+	// Zmienia rozmiar wektora na Count i wczytuje do niego elementy
+	template <typename T>
+	void ReadArray(std::vector<T> *Out, size_t Count, uint SwapWordSize = 0) { Out->resize(Count); if (Count > 0) ReadArray(&(*Out)[0], Count, SwapWordSize); }
 	// Pomija koniecznie podan liczb bajtw.
 	// Jeli wczeniej osignito koniec, zgasza bd.
 	void MustSkip(size_t Length);
@@ -107,6 +151,10 @@ public:
 	void MustCopyFrom(Stream *s, size_t Size);
 	// Odczytuje dane do koca z podanego strumienia
 	void CopyFromToEnd(Stream *s);
+
+	// [Wewntrzne]
+	void WriteArrayBytes(const void *Data, size_t Size, uint SwapWordSize);
+	void ReadArrayBytes(void *Out, size_t Size, uint SwapWordSize);
 };
 
 // Abstrakcyjna klasa bazowa strumieni pozwalajcych na odczytywanie rozmiaru i zmian pozycji
@@ -412,6 +460,8 @@ public:
 	virtual size_t Read(void *Data, size_t Size);
 	virtual void MustRead(void *Data, size_t Size);
 	virtual void Flush();
+	virtual void WriteV(const STREAM_WRITE_BUF *Bufs, size_t Count);
+	virtual size_t ReadV(const STREAM_READ_BUF *Bufs, size_t Count);
 
 	uint4 GetWriteCounter() { return m_WriteCounter; }
 	uint4 GetReadCounter() { return m_ReadCounter; }
@@ -438,12 +488,125 @@ public:
 	virtual void Write(const void *Data, size_t Size);
 	virtual size_t Read(void *Data, size_t Size);
 	virtual void Flush();
+	virtual void WriteV(const STREAM_WRITE_BUF *Bufs, size_t Count);
+	virtual size_t ReadV(const STREAM_READ_BUF *Bufs, size_t Count);
 
 	// Ustawia nowy limit
 	void SetWriteLimit(uint4 WriteLimit);
 	void SetReadLimit(uint4 ReadLimit);
 };
 
+// Nakadka buforujca odczyt ze strumienia
+/*
+- Odczytuje ze strumienia rdowego caymi blokami po BlockSize bajtw, wic
+  odczyt maymi kawakami (ReadEx, Tokenizer, CharReader) nie wywouje za
+  kadym razem odczytu ze strumienia rdowego (np. funkcji systemowej pliku).
+- Odczyty nie mniejsze ni blok id prosto do strumienia rdowego, z pominiciem bufora.
+- GetBufferPtr i Advance pozwalaj parserom czyta dane prosto z bufora, bez kopiowania.
+- Jeli strumie rdowy jest SeekableStream, dziaaj te metody kursora.
+  SetPos w obrbie wczytanego bloku nie odrzuca bufora.
+- Dopki nakadka istnieje, nie naley odczytywa ani przesuwa kursora
+  strumienia rdowego bezporednio. Jeli trzeba, potem wywoaj DiscardBuffer.
+*/
+class BufferedReadStream : public OverlayStream
+{
+private:
+	SeekableStream *m_Seekable;
+	std::vector<char> m_Buf;
+	// Miejsce, do ktrego doczytaem z bufora
+	size_t m_BufBeg;
+	// Miejsce, do ktrego bufor jest wypeniony danymi
+	size_t m_BufEnd;
+	// Pozycja w strumieniu rdowym odpowiadajca pocztkowi bufora
+	int m_BufPos;
+
+	// Zsuwa nieodczytane dane na pocztek bufora i doczytuje za nimi ile si da,
+	// a w buforze bdzie co najmniej MinLength bajtw albo skoczy si strumie.
+	// Zwraca liczb bajtw dostpnych w buforze.
+	size_t FillBuffer(size_t MinLength);
+	SeekableStream * MustGetSeekable();
+
+public:
+	BufferedReadStream(Stream *a_Stream, size_t BlockSize = BUFFERED_STREAM_BLOCK_SIZE);
+
+	size_t GetBlockSize() { return m_Buf.size(); }
+
+	// ======== Implementacja Stream ========
+	virtual size_t Read(void *Data, size_t Size);
+	virtual void MustRead(void *Data, size_t Size);
+	virtual bool End();
+	virtual size_t Skip(size_t MaxLength);
+
+	// ======== Bezporedni dostp do bufora ========
+	// Zwraca wskanik do nieodczytanych danych w buforze, a przez OutLength ich dugo.
+	// Jeli w buforze jest mniej ni MinLength bajtw, najpierw doczytuje (jeli
+	// trzeba, powiksza bufor). Mniej ni MinLength oznacza koniec strumienia.
+	// Wskanik jest wany do nastpnego wywoania innej metody tego obiektu ni Advance.
+	const char * GetBufferPtr(size_t *OutLength, size_t MinLength = 1);
+	// Przesuwa kursor o Length bajtw pobranych przez GetBufferPtr.
+	// Length nie moe przekracza dugoci zwrconej przez GetBufferPtr.
+	void Advance(size_t Length) { assert(Length <= m_BufEnd - m_BufBeg); m_BufBeg += Length; }
+	// Odrzuca zawarto bufora
+	// Nastpny odczyt bdzie od biecej pozycji strumienia rdowego.
+	void DiscardBuffer();
+
+	// ======== Kursor ========
+	// Wymagaj, eby strumie rdowy by SeekableStream. Jeli nie jest - bd.
+	int GetPos() { MustGetSeekable(); return m_BufPos + (int)m_BufBeg; }
+	void SetPos(int pos);
+	void SetPosFromCurrent(int pos) { SetPos(GetPos() + pos); }
+	void Rewind() { SetPos(0); }
+};
+
+// Nakadka buforujca zapis do strumienia
+/*
+- Zbiera zapisywane dane w buforze i zapisuje je do strumienia rdowego
+  caymi blokami po BlockSize bajtw.
+- Zapisy nie mniejsze ni blok id prosto do strumienia rdowego, z pominiciem bufora.
+- GetBufferPtr i Advance pozwalaj generowa dane prosto do bufora.
+- Flush zapisuje dane z bufora i wywouje Flush strumienia rdowego.
+- Sama zapisuje dane pozostae w buforze w destruktorze.
+  Jeli chcesz to zrobi wczeniej i z kontrol bdw, wywoaj Flush.
+*/
+class BufferedWriteStream : public OverlayStream
+{
+private:
+	SeekableStream *m_Seekable;
+	std::vector<char> m_Buf;
+	// Liczba bajtw zapisanych w buforze
+	size_t m_BufIndex;
+
+	// Zapisuje dane z bufora do strumienia rdowego, bez jego Flush.
+	void FlushBuffer();
+	SeekableStream * MustGetSeekable();
+
+public:
+	BufferedWriteStream(Stream *a_Stream, size_t BlockSize = BUFFERED_STREAM_BLOCK_SIZE);
+	virtual ~BufferedWriteStream();
+
+	size_t GetBlockSize() { return m_Buf.size(); }
+
+	// ======== Implementacja Stream ========
+	virtual void Write(const void *Data, size_t Size);
+	virtual void Flush();
+	virtual void WriteV(const STREAM_WRITE_BUF *Bufs, size_t Count);
+
+	// ======== Bezporedni dostp do bufora ========
+	// Zwraca wskanik do wolnego miejsca w buforze, a przez OutLength jego dugo,
+	// nie mniejsz ni MinLength (jeli trzeba, zapisuje bufor i go powiksza).
+	char * GetBufferPtr(size_t *OutLength, size_t MinLength = 1);
+	// Zatwierdza Length bajtw zapisanych pod wskanik zwrcony przez GetBufferPtr.
+	void Advance(size_t Length) { assert(Length <= m_Buf.size() - m_BufIndex); m_BufIndex += Length; }
+
+	// ======== Kursor ========
+	// Wymagaj, eby strumie rdowy by SeekableStream. Jeli nie jest - bd.
+	// SetPos najpierw zapisuje zawarto bufora.
+	int GetPos() { return MustGetSeekable()->GetPos() + (int)m_BufIndex; }
+	void SetPos(int pos) { FlushBuffer(); MustGetSeekable()->SetPos(pos); }
+	void SetPosFromCurrent(int pos) { SetPos(GetPos() + pos); }
+	void Rewind() { SetPos(0); }
+};
+
 // Ten strumie zapisuje zapisywane dane do wielu podczonych do niego strumieni na raz.
 class MultiWriterStream : public Stream
 {
@@ -465,6 +628,7 @@ public:
 	// ======== Implementacja Stream ========
 	virtual void Write(const void *Data, size_t Size);
 	virtual void Flush();
+	virtual void WriteV(const STREAM_WRITE_BUF *Bufs, size_t Count);
 };
 
 // Klasa obliczajca hash 32-bitowy z kolejno podawanych blokw danych
@@ -499,6 +663,7 @@ public:
 // [Strumie nie seekable, tylko zapis]
 // GetResult - wyliczon dotychczas sum mona otrzymywa w kadej chwili, a potem dalej dodawa nowe dane.
 // Reset - rozpoczyna liczenie nowej sumy kontrolnej.
+// Liczy metod slicing-by-8, a due bloki instrukcj PCLMULQDQ, jeli procesor j obsuguje.
 class CRC32_Calc : public Stream
 {
 private:
@@ -561,7 +726,8 @@ private:
 	uint4 state[4];
 	uint1 buffer[64];
 
-	void Process(uint1 data[64]);
+	// Przetwarza BlockCount kolejnych blokw po 64 bajty
+	void Process(const uint1 *data, size_t BlockCount);
 
 public:
 	MD5_Calc();
@@ -579,6 +745,58 @@ public:
 	static void Calc(MD5_SUM *Out, const void *Buf, uint4 BufLen);
 };
 
+// Suma 128-bitowa z FastHash_Calc - dwie liczby 64-bitowe.
+struct HASH128
+{
+	uint8 Lo, Hi;
+
+	bool operator == (const HASH128 &h) const { return Lo == h.Lo && Hi == h.Hi; }
+	bool operator != (const HASH128 &h) const { return Lo != h.Lo || Hi != h.Hi; }
+	bool operator < (const HASH128 &h) const { return Hi < h.Hi || (Hi == h.Hi && Lo < h.Lo); }
+};
+
+// Zamienia na 32 cyfry szesnastkowe, najpierw Hi, potem Lo
+void Hash128ToStr(string *Out, const HASH128 &Hash);
+bool StrToHash128(HASH128 *Out, const string &s);
+
+// Klasa obliczajca szybki hash 64- lub 128-bitowy z kolejno podawanych blokw danych
+// Algorytm: XXH64 (xxHash), http://cyan4973.github.io/xxHash/
+// Nie jest kryptograficzny - do kluczy cache, porwnywania zawartoci plikw itp.
+// Jest wielokrotnie szybszy od MD5_Calc i o wiele odporniejszy na kolizje ni Hash_Calc.
+// [Strumie nie seekable, tylko zapis]
+// Wynik nie zaley od tego, jak dane zostay podzielone na kolejne wywoania Write.
+// GetResult - wyliczon dotychczas sum mona otrzymywa w kadej chwili, a potem dalej dodawa nowe dane.
+// Wynik 64-bitowy jest zgodny ze standardowym XXH64. Wynik 128-bitowy ma w Lo to samo,
+// a w Hi drug sum, powsta z innego poczenia tego samego stanu.
+// Reset - rozpoczyna liczenie nowej sumy.
+class FastHash_Calc : public Stream
+{
+private:
+	uint8 m_Seed;
+	uint8 m_V[4];
+	uint8 m_TotalLength;
+	uint1 m_Buf[32];
+	uint4 m_BufLength;
+
+public:
+	FastHash_Calc(uint8 Seed = 0) { Reset(Seed); }
+
+	// ======== Implementacja Stream ========
+	virtual void Write(const void *Data, size_t Size);
+
+	// Zwraca policzon dotychczas sum
+	uint8 GetResult() const;
+	void GetResult128(HASH128 *Out) const;
+	// Rozpoczyna liczenie nowej sumy
+	void Reset(uint8 Seed = 0);
+
+	// ======== Statyczne ========
+	// Po prostu oblicza sum z podanych danych
+	static uint8 Calc(const void *Data, size_t DataLength, uint8 Seed = 0);
+	static uint8 Calc(const string &s, uint8 Seed = 0) { return Calc(s.data(), s.length(), Seed); }
+	static void Calc128(HASH128 *Out, const void *Data, size_t DataLength, uint8 Seed = 0);
+};
+
 // Koduje lub dekoduje zapisywane/odczytywane bajty XOR podany bajt lub cig bajtw
 // Mapuje bezporednio bajty na bajty strumienia do ktrego jest podczony,
 // nic nie buforuje, wic mona operowa te na strumieniu Stream.
@@ -766,6 +984,9 @@ private:
 	// True, jeli sparsowano kocwk z '='
 	bool m_Finished;
 
+	// Wypenia m_Buf maksymalnie 3 bajtami zdekodowanymi z numerw 4 znakw.
+	// Ustawia m_BufLength i jeli trzeba, to m_Finished. Jeli bdne znaki, rzuca wyjtek.
+	void DecodeQuad(const uint1 Numbers[4]);
 	// Czyta 4 znaki ze strumienia podczonego (0 albo 4, inaczej bd) i wypenia m_Buf maksymalnie 3 zdekodowanymi bajtami.
 	// Ustawia m_BufLength i jeli trzeba, to m_Finished.
 	bool ReadNextBuf();
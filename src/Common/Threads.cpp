@@ -8,16 +8,23 @@
  */
 #include "Base.hpp"
 #ifdef WIN32
-	#define _WIN32_WINNT 0x0400 // dla windows.h dla SwitchToThread
+	#define _WIN32_WINNT 0x0501 // dla windows.h dla SwitchToThread i GetLogicalProcessorInformation
 	#include <windows.h>
 	#include <process.h> // dla _beginthreadex
+	#include <intrin.h> // dla _ReadWriteBarrier
 #else
 	#include <pthread.h>
 	#include <semaphore.h>
 	#include <sched.h> // dla sched_yield
 	#include <time.h> // dla pthread_mutex_timedlock
+	#include <unistd.h> // dla sysconf
+	#include <set> // dla GetCpuCoreCount
 #endif
+#include <cstddef> // dla std::ptrdiff_t
+#include <deque>
+#include <exception>
 #include "Error.hpp"
+#include "Stream.hpp"
 #include "Threads.hpp"
 
 
@@ -33,8 +40,63 @@ namespace common
 		Out->tv_sec = Now + Milliseconds / 1000;
 		Out->tv_nsec = Milliseconds % 1000 * 1000000;
 	}
+
+	// [Wewntrzna] Odczytuje liczb z pliku /sys/devices/system/cpu/cpu<CpuIndex>/topology/<Name>
+	bool ReadCpuTopologyValue(int *Out, uint CpuIndex, const char *Name)
+	{
+		char Path[128];
+		sprintf(Path, "/sys/devices/system/cpu/cpu%u/topology/%s", CpuIndex, Name);
+		FILE *F = fopen(Path, "r");
+		if (F == NULL)
+			return false;
+		bool R = (fscanf(F, "%d", Out) == 1);
+		fclose(F);
+		return R;
+	}
 #endif
 
+uint GetCpuCount()
+{
+#ifdef WIN32
+	SYSTEM_INFO SystemInfo;
+	GetSystemInfo(&SystemInfo);
+	return std::max<uint>(1, SystemInfo.dwNumberOfProcessors);
+#else
+	long R = sysconf(_SC_NPROCESSORS_ONLN);
+	return (R < 1 ? 1 : (uint)R);
+#endif
+}
+
+uint GetCpuCoreCount()
+{
+#ifdef WIN32
+	DWORD Size = 0;
+	GetLogicalProcessorInformation(NULL, &Size);
+	if (Size == 0)
+		return GetCpuCount();
+	std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> Info(Size / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+	if (Info.empty() || GetLogicalProcessorInformation(&Info[0], &Size) == FALSE)
+		return GetCpuCount();
+	uint R = 0;
+	for (size_t i = 0; i < Info.size(); i++)
+		if (Info[i].Relationship == RelationProcessorCore)
+			R++;
+	return (R > 0 ? R : GetCpuCount());
+#else
+	// Rdze wyznacza para (numer procesora fizycznego, numer rdzenia w nim)
+	uint CpuCount = GetCpuCount();
+	std::set< std::pair<int, int> > Cores;
+	for (uint i = 0; i < CpuCount; i++)
+	{
+		int PackageId, CoreId;
+		if (!ReadCpuTopologyValue(&PackageId, i, "physical_package_id") || !ReadCpuTopologyValue(&CoreId, i, "core_id"))
+			return CpuCount;
+		Cores.insert(std::make_pair(PackageId, CoreId));
+	}
+	return (Cores.empty() ? CpuCount : (uint)Cores.size());
+#endif
+}
+
 //HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
 // Klasa Thread
 
@@ -888,4 +950,1136 @@ niej si
 
 #endif
 
+
+//HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
+// Klasa PrefetchStream
+
+class PrefetchThread;
+
+class PrefetchStream_pimpl
+{
+public:
+	struct BLOCK
+	{
+		std::vector<char> Data;
+		// Liczba wczytanych bajtw. 0 oznacza koniec strumienia albo bd.
+		size_t Length;
+		// Jeli niepusty, przy odczycie tego bloku wystpi bd
+		string ErrorMsg;
+	};
+
+	Stream *m_Stream;
+	std::vector<BLOCK> m_Blocks;
+	// Liczba blokw wolnych do zapenienia przez wtek w tle
+	Semaphore m_FreeBlocks;
+	// Liczba blokw zapenionych, czekajcych na odczyt
+	Semaphore m_FilledBlocks;
+	// Ustawiana przed podniesieniem m_FreeBlocks w destruktorze. Odczytywana po jego opuszczeniu.
+	bool m_Stop;
+	scoped_ptr<PrefetchThread> m_Thread;
+
+	// ==== Uywane tylko przez wtek odczytujcy ====
+	// Indeks biecego bloku, MAXUINT4 jeli aden nie jest pobrany
+	uint m_CurrentBlock;
+	// Indeks nastpnego bloku do pobrania
+	uint m_NextBlock;
+	// Miejsce, do ktrego doczytaem z biecego bloku
+	size_t m_BlockPos;
+	// Pobrany zosta ju ostatni blok (niepeny albo z bdem)
+	bool m_End;
+
+	PrefetchStream_pimpl(Stream *a_Stream, size_t BlockSize, uint BlockCount);
+	// Funkcja do wtku
+	void ThreadFunc();
+};
+
+class PrefetchThread : public Thread
+{
+private:
+	PrefetchStream_pimpl *m_Pimpl;
+
+protected:
+	virtual void Run() { m_Pimpl->ThreadFunc(); }
+
+public:
+	PrefetchThread(PrefetchStream_pimpl *Pimpl) : m_Pimpl(Pimpl) { }
+};
+
+PrefetchStream_pimpl::PrefetchStream_pimpl(Stream *a_Stream, size_t BlockSize, uint BlockCount) :
+	m_Stream(a_Stream),
+	m_FreeBlocks(BlockCount),
+	m_FilledBlocks(0),
+	m_Stop(false),
+	m_CurrentBlock(MAXUINT4),
+	m_NextBlock(0),
+	m_BlockPos(0),
+	m_End(false)
+{
+	m_Blocks.resize(BlockCount);
+	for (uint i = 0; i < BlockCount; i++)
+	{
+		m_Blocks[i].Data.resize(BlockSize);
+		m_Blocks[i].Length = 0;
+	}
+}
+
+void PrefetchStream_pimpl::ThreadFunc()
+{
+	uint BlockIndex = 0;
+	for (;;)
+	{
+		m_FreeBlocks.P();
+		if (m_Stop)
+			break;
+
+		BLOCK &Block = m_Blocks[BlockIndex];
+		try
+		{
+			// Doczytuje do penego bloku, chyba e wczeniej koniec
+			Block.Length = 0;
+			while (Block.Length < Block.Data.size())
+			{
+				size_t ReadSize = m_Stream->Read(&Block.Data[Block.Length], Block.Data.size() - Block.Length);
+				if (ReadSize == 0)
+					break;
+				Block.Length += ReadSize;
+			}
+		}
+		catch (const Error &e)
+		{
+			Block.Length = 0;
+			e.GetMessage_(&Block.ErrorMsg);
+			if (Block.ErrorMsg.empty())
+				Block.ErrorMsg = "Nieznany bd";
+		}
+		catch (...)
+		{
+			// eby wyjtek nie wylecia poza wtek
+			Block.Length = 0;
+			Block.ErrorMsg = "Nieznany bd";
+		}
+
+		bool End = (Block.Length < Block.Data.size());
+		m_FilledBlocks.V();
+		// Koniec strumienia albo bd - nie ma po co czyta dalej
+		if (End)
+			break;
+		BlockIndex = (BlockIndex + 1) % m_Blocks.size();
+	}
+}
+
+PrefetchStream::PrefetchStream(Stream *a_Stream, size_t BlockSize, uint BlockCount) :
+	OverlayStream(a_Stream),
+	pimpl(new PrefetchStream_pimpl(a_Stream, BlockSize, BlockCount))
+{
+	assert(BlockSize > 0 && BlockCount > 0);
+
+	pimpl->m_Thread.reset(new PrefetchThread(pimpl.get()));
+	pimpl->m_Thread->Start();
+}
+
+PrefetchStream::~PrefetchStream()
+{
+	// Jeli wtek czeka na wolny blok, wznowi si i zakoczy.
+	// Jeli akurat czyta, zakoczy si przy nastpnym czekaniu.
+	pimpl->m_Stop = true;
+	pimpl->m_FreeBlocks.V();
+	pimpl->m_Thread->Join();
+}
+
+bool PrefetchStream::EnsureBlock()
+{
+	if (pimpl->m_CurrentBlock != MAXUINT4)
+	{
+		if (pimpl->m_BlockPos < pimpl->m_Blocks[pimpl->m_CurrentBlock].Length)
+			return true;
+		if (pimpl->m_End)
+			return false;
+		// Biecy blok przeczytany - oddaj go wtkowi w tle
+		pimpl->m_CurrentBlock = MAXUINT4;
+		pimpl->m_FreeBlocks.V();
+	}
+	else if (pimpl->m_End)
+		return false;
+
+	pimpl->m_FilledBlocks.P();
+	pimpl->m_CurrentBlock = pimpl->m_NextBlock;
+	pimpl->m_NextBlock = (pimpl->m_NextBlock + 1) % pimpl->m_Blocks.size();
+	pimpl->m_BlockPos = 0;
+
+	const PrefetchStream_pimpl::BLOCK &Block = pimpl->m_Blocks[pimpl->m_CurrentBlock];
+	if (!Block.ErrorMsg.empty())
+	{
+		pimpl->m_End = true;
+		throw Error("PrefetchStream: Bd odczytu w wtku w tle: " + Block.ErrorMsg, __FILE__, __LINE__);
+	}
+	if (Block.Length < Block.Data.size())
+		pimpl->m_End = true;
+	return (Block.Length > 0);
+}
+
+size_t PrefetchStream::Read(void *Data, size_t Size)
+{
+	char *CharData = (char*)Data;
+	size_t Sum = 0, BlockLength;
+	// Size bdzie zmniejszany. Oznacza liczb pozostaych do odczytania bajtw.
+
+	while (Size > 0)
+	{
+		if (!EnsureBlock())
+			break;
+
+		const PrefetchStream_pimpl::BLOCK &Block = pimpl->m_Blocks[pimpl->m_CurrentBlock];
+		BlockLength = std::min(Block.Length - pimpl->m_BlockPos, Size);
+		memcpy(CharData, &Block.Data[pimpl->m_BlockPos], BlockLength);
+		pimpl->m_BlockPos += BlockLength;
+		CharData += BlockLength;
+		Sum += BlockLength;
+		Size -= BlockLength;
+	}
+
+	return Sum;
+}
+
+bool PrefetchStream::End()
+{
+	size_t Length;
+	GetBufferPtr(&Length);
+	return (Length == 0);
+}
+
+const char * PrefetchStream::GetBufferPtr(size_t *OutLength)
+{
+	if (!EnsureBlock())
+	{
+		*OutLength = 0;
+		return NULL;
+	}
+	const PrefetchStream_pimpl::BLOCK &Block = pimpl->m_Blocks[pimpl->m_CurrentBlock];
+	*OutLength = Block.Length - pimpl->m_BlockPos;
+	return &Block.Data[0] + pimpl->m_BlockPos;
+}
+
+void PrefetchStream::Advance(size_t Length)
+{
+	assert(pimpl->m_CurrentBlock != MAXUINT4);
+	assert(Length <= pimpl->m_Blocks[pimpl->m_CurrentBlock].Length - pimpl->m_BlockPos);
+	pimpl->m_BlockPos += Length;
+}
+
+//HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
+// Klasa SpscRingBuffer
+
+// Rozmiar linii pamici podrcznej, na ktre rozdzielane s pola pisane przez rne wtki
+const size_t CACHE_LINE_SIZE = 64;
+
+// [Wewntrzne] Atomowy odczyt z semantyk acquire, zapis z semantyk release
+// i pena bariera pamici (zapis-odczyt). Dla size_t i wskanikw.
+// Do tego atomowe porwnanie z zamian i dodawanie (zwraca now warto) - z pen barier.
+#ifdef WIN32
+	// Na x86 zwyky odczyt i zapis ma ju tak semantyk - wystarczy nie da
+	// przestawi instrukcji kompilatorowi.
+	template <typename T> inline T AtomicLoadAcquire(T const volatile *p) { T R = *p; _ReadWriteBarrier(); return R; }
+	template <typename T> inline void AtomicStoreRelease(T volatile *p, T v) { _ReadWriteBarrier(); *p = v; }
+	inline void FullMemoryBarrier() { MemoryBarrier(); }
+	#ifdef _WIN64
+		inline bool AtomicCompareExchange(volatile size_t *p, size_t Exchange, size_t Comparand) { return (size_t)InterlockedCompareExchange64((volatile LONGLONG*)p, (LONGLONG)Exchange, (LONGLONG)Comparand) == Comparand; }
+		inline size_t AtomicAdd(volatile size_t *p, size_t v) { return (size_t)InterlockedExchangeAdd64((volatile LONGLONG*)p, (LONGLONG)v) + v; }
+	#else
+		inline bool AtomicCompareExchange(volatile size_t *p, size_t Exchange, size_t Comparand) { return (size_t)InterlockedCompareExchange((volatile LONG*)p, (LONG)Exchange, (LONG)Comparand) == Comparand; }
+		inline size_t AtomicAdd(volatile size_t *p, size_t v) { return (size_t)InterlockedExchangeAdd((volatile LONG*)p, (LONG)v) + v; }
+	#endif
+#else
+	template <typename T> inline T AtomicLoadAcquire(T const volatile *p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+	template <typename T> inline void AtomicStoreRelease(T volatile *p, T v) { __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+	inline void FullMemoryBarrier() { __sync_synchronize(); }
+	inline bool AtomicCompareExchange(volatile size_t *p, size_t Exchange, size_t Comparand) { return __sync_bool_compare_and_swap(p, Comparand, Exchange); }
+	inline size_t AtomicAdd(volatile size_t *p, size_t v) { return __sync_add_and_fetch(p, v); }
+#endif
+
+class SpscRingBuffer_pimpl
+{
+public:
+	// ==== Stae od utworzenia ====
+	std::vector<char> m_Buf;
+	size_t m_Capacity;
+	size_t m_Mask;
+	bool m_Blocking;
+	// Tylko w trybie Blocking
+	scoped_ptr<Event> m_DataEvent;
+	scoped_ptr<Event> m_SpaceEvent;
+
+	char m_Pad1[CACHE_LINE_SIZE];
+	// ==== Pisane przez producenta ====
+	// Liczba wszystkich zapisanych bajtw (licznik zawija si, liczy si rnica)
+	volatile size_t m_Head;
+	// Ustawiane na 1 przez Close
+	volatile size_t m_Closed;
+	// Ostatnio widziana przez producenta warto m_Tail
+	size_t m_CachedTail;
+
+	char m_Pad2[CACHE_LINE_SIZE];
+	// ==== Pisane przez konsumenta ====
+	// Liczba wszystkich odczytanych bajtw
+	volatile size_t m_Tail;
+	// Ostatnio widziana przez konsumenta warto m_Head
+	size_t m_CachedHead;
+
+	char m_Pad3[CACHE_LINE_SIZE];
+	// ==== Flagi czekania - zmieniaj si rzadko, wic mog lee razem ====
+	// Ustawiane przez stron, ktra zaraz zacznie czeka na swoim zdarzeniu.
+	volatile size_t m_ConsumerWaiting;
+	volatile size_t m_ProducerWaiting;
+	char m_Pad4[CACHE_LINE_SIZE];
+
+	SpscRingBuffer_pimpl(size_t Capacity, bool Blocking);
+
+	// Zwraca ilo wolnego miejsca. Jeli z zapamitanej m_Tail wychodzi mniej
+	// ni Wanted, odczytuje j od nowa. Tylko dla producenta.
+	size_t GetFreeSpace(size_t Wanted);
+	// Zwraca liczb bajtw do odczytu. Jeli z zapamitanej m_Head wychodzi mniej
+	// ni Wanted, odczytuje j od nowa. Tylko dla konsumenta.
+	size_t GetAvailable(size_t Wanted);
+	bool IsClosed() { return AtomicLoadAcquire(&m_Closed) != 0; }
+	// Budzi drug stron, jeli czeka. Wywoywa po przesuniciu swojego indeksu.
+	void WakeConsumer();
+	void WakeProducer();
+};
+
+SpscRingBuffer_pimpl::SpscRingBuffer_pimpl(size_t Capacity, bool Blocking) :
+	m_Blocking(Blocking),
+	m_Head(0),
+	m_Closed(0),
+	m_CachedTail(0),
+	m_Tail(0),
+	m_CachedHead(0),
+	m_ConsumerWaiting(0),
+	m_ProducerWaiting(0)
+{
+	m_Capacity = 1;
+	while (m_Capacity < Capacity)
+		m_Capacity <<= 1;
+	m_Mask = m_Capacity - 1;
+	m_Buf.resize(m_Capacity);
+
+	if (Blocking)
+	{
+		m_DataEvent.reset(new Event(false, Event::TYPE_AUTO_RESET));
+		m_SpaceEvent.reset(new Event(false, Event::TYPE_AUTO_RESET));
+	}
+}
+
+size_t SpscRingBuffer_pimpl::GetFreeSpace(size_t Wanted)
+{
+	size_t Free = m_Capacity - (m_Head - m_CachedTail);
+	if (Free < Wanted)
+	{
+		m_CachedTail = AtomicLoadAcquire(&m_Tail);
+		Free = m_Capacity - (m_Head - m_CachedTail);
+	}
+	return Free;
+}
+
+size_t SpscRingBuffer_pimpl::GetAvailable(size_t Wanted)
+{
+	size_t Available = m_CachedHead - m_Tail;
+	if (Available < Wanted)
+	{
+		m_CachedHead = AtomicLoadAcquire(&m_Head);
+		Available = m_CachedHead - m_Tail;
+	}
+	return Available;
+}
+
+void SpscRingBuffer_pimpl::WakeConsumer()
+{
+	if (!m_Blocking)
+		return;
+	// Zapis indeksu musi by widoczny przed odczytem flagi - para z barier w WaitForData.
+	FullMemoryBarrier();
+	if (m_ConsumerWaiting)
+		m_DataEvent->Set();
+}
+
+void SpscRingBuffer_pimpl::WakeProducer()
+{
+	if (!m_Blocking)
+		return;
+	FullMemoryBarrier();
+	if (m_ProducerWaiting)
+		m_SpaceEvent->Set();
+}
+
+SpscRingBuffer::SpscRingBuffer(size_t Capacity, bool Blocking) :
+	pimpl(new SpscRingBuffer_pimpl(Capacity, Blocking))
+{
+	assert(Capacity > 0);
+}
+
+SpscRingBuffer::~SpscRingBuffer()
+{
+}
+
+size_t SpscRingBuffer::GetCapacity()
+{
+	return pimpl->m_Capacity;
+}
+
+size_t SpscRingBuffer::GetSize()
+{
+	size_t Tail = AtomicLoadAcquire(&pimpl->m_Tail);
+	return AtomicLoadAcquire(&pimpl->m_Head) - Tail;
+}
+
+bool SpscRingBuffer::IsClosed()
+{
+	return pimpl->IsClosed();
+}
+
+void SpscRingBuffer::Write(const void *Data, size_t Size)
+{
+	assert(!pimpl->IsClosed());
+
+	if (!pimpl->m_Blocking)
+	{
+		// Nie zmieci si w buforze
+		if (pimpl->GetFreeSpace(Size) < Size)
+			throw Error(Format("Bd zapisu do SpscRingBuffer: Nie mona zapisa # B - dane si nie zmieszcz.") % Size, __FILE__, __LINE__);
+		TryWrite(Data, Size);
+		return;
+	}
+
+	const char *CharData = (const char*)Data;
+	while (Size > 0)
+	{
+		size_t Written = TryWrite(CharData, Size);
+		if (Written == 0)
+			WaitForSpace();
+		CharData += Written;
+		Size -= Written;
+	}
+}
+
+size_t SpscRingBuffer::TryWrite(const void *Data, size_t Size)
+{
+	size_t Free = pimpl->GetFreeSpace(Size);
+	if (Size > Free)
+		Size = Free;
+	if (Size == 0)
+		return 0;
+
+	// Dwa kawaki - do koca bufora i od jego pocztku
+	size_t Pos = pimpl->m_Head & pimpl->m_Mask;
+	size_t PartSize = std::min(Size, pimpl->m_Capacity - Pos);
+	memcpy(&pimpl->m_Buf[Pos], Data, PartSize);
+	if (PartSize < Size)
+		memcpy(&pimpl->m_Buf[0], (const char*)Data + PartSize, Size - PartSize);
+
+	CommitWrite(Size);
+	return Size;
+}
+
+char * SpscRingBuffer::GetWritePtr(size_t *OutLength)
+{
+	size_t Pos = pimpl->m_Head & pimpl->m_Mask;
+	size_t ToEnd = pimpl->m_Capacity - Pos;
+	*OutLength = std::min(pimpl->GetFreeSpace(ToEnd), ToEnd);
+	return &pimpl->m_Buf[Pos];
+}
+
+void SpscRingBuffer::CommitWrite(size_t Length)
+{
+	assert(Length <= pimpl->m_Capacity - (pimpl->m_Head - pimpl->m_CachedTail));
+	AtomicStoreRelease(&pimpl->m_Head, pimpl->m_Head + Length);
+	pimpl->WakeConsumer();
+}
+
+void SpscRingBuffer::WaitForSpace()
+{
+	assert(pimpl->m_Blocking);
+
+	while (pimpl->GetFreeSpace(1) == 0)
+	{
+		pimpl->m_ProducerWaiting = 1;
+		FullMemoryBarrier();
+		// Sprawdzenie jeszcze raz po ustawieniu flagi - konsument mg zwolni
+		// miejsce zanim j zobaczy
+		if (pimpl->GetFreeSpace(1) == 0)
+			pimpl->m_SpaceEvent->Wait();
+		pimpl->m_ProducerWaiting = 0;
+	}
+}
+
+bool SpscRingBuffer::TimeoutWaitForSpace(uint Milliseconds)
+{
+	assert(pimpl->m_Blocking);
+
+	while (pimpl->GetFreeSpace(1) == 0)
+	{
+		pimpl->m_ProducerWaiting = 1;
+		FullMemoryBarrier();
+		bool Signaled = true;
+		if (pimpl->GetFreeSpace(1) == 0)
+			Signaled = pimpl->m_SpaceEvent->TimeoutWait(Milliseconds);
+		pimpl->m_ProducerWaiting = 0;
+		if (!Signaled)
+			return (pimpl->GetFreeSpace(1) > 0);
+	}
+	return true;
+}
+
+void SpscRingBuffer::Close()
+{
+	AtomicStoreRelease(&pimpl->m_Closed, (size_t)1);
+	pimpl->WakeConsumer();
+}
+
+size_t SpscRingBuffer::Read(void *Out, size_t MaxLength)
+{
+	char *CharOut = (char*)Out;
+	size_t Sum = 0, Length;
+	const char *Ptr;
+	// MaxLength bdzie zmniejszany. Oznacza liczb pozostaych do odczytania bajtw.
+
+	while (MaxLength > 0)
+	{
+		Ptr = GetReadPtr(&Length);
+		if (Length == 0)
+		{
+			if (!pimpl->m_Blocking)
+				break;
+			// Flaga przed ponownym sprawdzeniem danych - producent zapisuje je przed Close
+			if (pimpl->IsClosed() && pimpl->GetAvailable(1) == 0)
+				break;
+			WaitForData();
+			continue;
+		}
+		Length = std::min(Length, MaxLength);
+		memcpy(CharOut, Ptr, Length);
+		CommitRead(Length);
+		CharOut += Length;
+		Sum += Length;
+		MaxLength -= Length;
+	}
+
+	return Sum;
+}
+
+bool SpscRingBuffer::End()
+{
+	if (pimpl->m_Blocking)
+		WaitForData();
+	return (pimpl->GetAvailable(1) == 0);
+}
+
+const char * SpscRingBuffer::GetReadPtr(size_t *OutLength)
+{
+	size_t Pos = pimpl->m_Tail & pimpl->m_Mask;
+	size_t ToEnd = pimpl->m_Capacity - Pos;
+	*OutLength = std::min(pimpl->GetAvailable(ToEnd), ToEnd);
+	return &pimpl->m_Buf[Pos];
+}
+
+void SpscRingBuffer::CommitRead(size_t Length)
+{
+	assert(Length <= pimpl->m_CachedHead - pimpl->m_Tail);
+	AtomicStoreRelease(&pimpl->m_Tail, pimpl->m_Tail + Length);
+	pimpl->WakeProducer();
+}
+
+void SpscRingBuffer::WaitForData()
+{
+	assert(pimpl->m_Blocking);
+
+	while (pimpl->GetAvailable(1) == 0 && !pimpl->IsClosed())
+	{
+		pimpl->m_ConsumerWaiting = 1;
+		FullMemoryBarrier();
+		// Sprawdzenie jeszcze raz po ustawieniu flagi - producent mg zapisa
+		// dane zanim j zobaczy
+		if (pimpl->GetAvailable(1) == 0 && !pimpl->IsClosed())
+			pimpl->m_DataEvent->Wait();
+		pimpl->m_ConsumerWaiting = 0;
+	}
+}
+
+bool SpscRingBuffer::TimeoutWaitForData(uint Milliseconds)
+{
+	assert(pimpl->m_Blocking);
+
+	while (pimpl->GetAvailable(1) == 0 && !pimpl->IsClosed())
+	{
+		pimpl->m_ConsumerWaiting = 1;
+		FullMemoryBarrier();
+		bool Signaled = true;
+		if (pimpl->GetAvailable(1) == 0 && !pimpl->IsClosed())
+			Signaled = pimpl->m_DataEvent->TimeoutWait(Milliseconds);
+		pimpl->m_ConsumerWaiting = 0;
+		if (!Signaled)
+			return (pimpl->GetAvailable(1) > 0 || pimpl->IsClosed());
+	}
+	return true;
+}
+
+//HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
+// Klasa JobScheduler
+
+#ifdef WIN32
+	#define THREAD_LOCAL __declspec(thread)
+	inline void YieldCurrentThread() { SwitchToThread(); }
+#else
+	#define THREAD_LOCAL __thread
+	inline void YieldCurrentThread() { sched_yield(); }
+#endif
+
+// Ile razy bezczynny wtek szuka zada (oddajc midzy prbami procesor), zanim zanie
+const uint JOB_SPIN_COUNT = 64;
+// Pocztkowa pojemno kolejki zada wtku (potga dwjki). Ronie w razie potrzeby.
+const size_t JOB_DEQUE_INITIAL_CAPACITY = 256;
+
+/*
+Kolejka dwustronna Chase-Lev
+("Dynamic Circular Work-Stealing Deque", Chase, Lev, SPAA 2005; bariery wg
+"Correct and Efficient Work-Stealing for Weak Memory Models", Le i in., PPoPP 2013)
+- Push i Pop tylko z wtku waciciela - koniec Bottom, bez blokad.
+- Steal z dowolnego wtku - koniec Top, jedna operacja CAS.
+- Indeksy rosn bez koca (zawijaj si), liczy si rnica.
+- Stare tablice po powikszeniu zostaj do zniszczenia kolejki, bo zodziej moe
+  jeszcze z nich czyta.
+*/
+class JobDeque
+{
+public:
+	JobDeque();
+	~JobDeque();
+
+	void Push(Job *j);
+	// Zwraca NULL, jeli pusta
+	Job * Pop();
+	// Zwraca NULL, jeli pusta albo inny wtek by szybszy
+	Job * Steal();
+	bool IsEmpty() { return (std::ptrdiff_t)(AtomicLoadAcquire(&m_Bottom) - AtomicLoadAcquire(&m_Top)) <= 0; }
+
+private:
+	struct ARRAY
+	{
+		size_t Mask;
+		std::vector<Job*> Items;
+	};
+
+	char m_Pad1[CACHE_LINE_SIZE];
+	// Pisane przez zodziei
+	volatile size_t m_Top;
+	char m_Pad2[CACHE_LINE_SIZE];
+	// Pisane przez waciciela
+	volatile size_t m_Bottom;
+	ARRAY * volatile m_Array;
+	std::vector<ARRAY*> m_OldArrays;
+	char m_Pad3[CACHE_LINE_SIZE];
+
+	ARRAY * Grow(ARRAY *a, size_t Top, size_t Bottom);
+};
+
+JobDeque::JobDeque() :
+	m_Top(0),
+	m_Bottom(0)
+{
+	ARRAY *a = new ARRAY;
+	a->Items.resize(JOB_DEQUE_INITIAL_CAPACITY);
+	a->Mask = JOB_DEQUE_INITIAL_CAPACITY - 1;
+	m_Array = a;
+}
+
+JobDeque::~JobDeque()
+{
+	delete m_Array;
+	for (size_t i = 0; i < m_OldArrays.size(); i++)
+		delete m_OldArrays[i];
+}
+
+JobDeque::ARRAY * JobDeque::Grow(ARRAY *a, size_t Top, size_t Bottom)
+{
+	ARRAY *NewArray = new ARRAY;
+	NewArray->Items.resize(a->Items.size() * 2);
+	NewArray->Mask = NewArray->Items.size() - 1;
+	for (size_t i = Top; i != Bottom; i++)
+		NewArray->Items[i & NewArray->Mask] = a->Items[i & a->Mask];
+	m_OldArrays.push_back(a);
+	AtomicStoreRelease(&m_Array, NewArray);
+	return NewArray;
+}
+
+void JobDeque::Push(Job *j)
+{
+	size_t b = m_Bottom;
+	size_t t = AtomicLoadAcquire(&m_Top);
+	ARRAY *a = m_Array;
+	if (b - t > a->Mask)
+		a = Grow(a, t, b);
+	a->Items[b & a->Mask] = j;
+	AtomicStoreRelease(&m_Bottom, b + 1);
+}
+
+Job * JobDeque::Pop()
+{
+	size_t b = m_Bottom - 1;
+	ARRAY *a = m_Array;
+	m_Bottom = b;
+	// Zapis Bottom musi by widoczny dla zodziei przed odczytem Top - para z barier w Steal
+	FullMemoryBarrier();
+	size_t t = m_Top;
+
+	if ((std::ptrdiff_t)(b - t) < 0)
+	{
+		m_Bottom = b + 1;
+		return NULL;
+	}
+	Job *j = a->Items[b & a->Mask];
+	if (b != t)
+		return j;
+
+	// Ostatni element - o niego mona si ciga ze zodziejem
+	if (!AtomicCompareExchange(&m_Top, t + 1, t))
+		j = NULL;
+	m_Bottom = b + 1;
+	return j;
+}
+
+Job * JobDeque::Steal()
+{
+	size_t t = AtomicLoadAcquire(&m_Top);
+	FullMemoryBarrier();
+	size_t b = AtomicLoadAcquire(&m_Bottom);
+	if ((std::ptrdiff_t)(b - t) <= 0)
+		return NULL;
+
+	ARRAY *a = AtomicLoadAcquire(&m_Array);
+	Job *j = a->Items[t & a->Mask];
+	if (!AtomicCompareExchange(&m_Top, t + 1, t))
+		return NULL;
+	return j;
+}
+
+// Dane wtku wykonujcego zadania. Kady alokowany osobno, eby kolejki nie
+// dzieliy linii pamici podrcznej.
+struct JOB_WORKER
+{
+	JobScheduler_pimpl *Scheduler;
+	JobDeque Deque;
+	// Stan generatora liczb pseudolosowych do wyboru wtku, z ktrego podkra
+	uint4 RandState;
+};
+
+// Wtek biecy, jeli wykonuje zadania jakiego planisty, wpp. NULL
+static THREAD_LOCAL JOB_WORKER *t_CurrentWorker = NULL;
+
+// Wykonuje zadanie. Jeli rzuci wyjtek, zwraca false i jego komunikat przez ErrorMsg.
+static bool ExecuteJobCatch(Job *j, string *ErrorMsg)
+{
+	try
+	{
+		j->Execute();
+		return true;
+	}
+	catch (const Error &e)
+	{
+		e.GetMessage_(ErrorMsg);
+	}
+	catch (const std::exception &e)
+	{
+		*ErrorMsg = e.what();
+	}
+	catch (...)
+	{
+		*ErrorMsg = "Nieznany wyjtek w zadaniu.";
+	}
+	return false;
+}
+
+class JobGroup_pimpl
+{
+public:
+	JobScheduler_pimpl *m_Scheduler;
+	// Liczba zleconych i jeszcze nie wykonanych zada
+	volatile size_t m_Pending;
+	// Komunikat pierwszego bdu. Zapisywany pod muteksem planisty.
+	string m_ErrorMsg;
+	bool m_HasError;
+
+	JobGroup_pimpl(JobScheduler_pimpl *Scheduler) : m_Scheduler(Scheduler), m_Pending(0), m_HasError(false) { }
+};
+
+class JobWorkerThread;
+
+class JobScheduler_pimpl
+{
+public:
+	// [0] to wtek, ktry utworzy planist
+	std::vector<JOB_WORKER*> m_Workers;
+	std::vector<JobWorkerThread*> m_Threads;
+	// Warto t_CurrentWorker wtku, ktry utworzy planist, sprzed jego utworzenia
+	JOB_WORKER *m_PrevWorker;
+
+	// Kolejka zada zleconych spoza wtkw planisty
+	Mutex m_InjectionMutex;
+	std::deque<Job*> m_InjectionQueue;
+	volatile size_t m_InjectionCount;
+
+	// Usypianie wtkw roboczych. Liczba picych jest zmniejszana przez tego,
+	// kto budzi (i podnosi semafor), albo przez sam wtek, jeli jednak nie zanie.
+	Semaphore m_SleepSemaphore;
+	volatile size_t m_SleepingCount;
+	volatile size_t m_Stop;
+
+	// Usypianie wtkw w JobGroup::Wait - budzi je zakoczenie ostatniego zadania grupy
+	Mutex m_WaitMutex;
+	Cond m_WaitCond;
+	volatile size_t m_WaitingCount;
+
+	// Chroni JobGroup_pimpl::m_ErrorMsg
+	Mutex m_ErrorMutex;
+
+	JobScheduler_pimpl();
+
+	// Zwraca dane biecego wtku, jeli naley do tego planisty, wpp. NULL
+	JOB_WORKER * GetCurrentWorker();
+	void Push(Job *j);
+	// Szuka zadania: najpierw we wasnej kolejce, potem we wsplnej, potem u innych
+	Job * FindJob(JOB_WORKER *Worker);
+	bool HasJobs();
+	void ExecuteJob(Job *j);
+	void WakeWorker();
+	void WorkerSleep();
+	void WaitForGroup(JobGroup_pimpl *Group);
+	// Funkcja do wtku
+	void WorkerFunc(uint Index);
+};
+
+class JobWorkerThread : public Thread
+{
+private:
+	JobScheduler_pimpl *m_Scheduler;
+	uint m_Index;
+
+protected:
+	virtual void Run() { m_Scheduler->WorkerFunc(m_Index); }
+
+public:
+	JobWorkerThread(JobScheduler_pimpl *Scheduler, uint Index) : m_Scheduler(Scheduler), m_Index(Index) { }
+};
+
+JobScheduler_pimpl::JobScheduler_pimpl() :
+	m_PrevWorker(NULL),
+	m_InjectionMutex(0),
+	m_InjectionCount(0),
+	m_SleepSemaphore(0),
+	m_SleepingCount(0),
+	m_Stop(0),
+	m_WaitMutex(0),
+	m_WaitingCount(0),
+	m_ErrorMutex(0)
+{
+}
+
+JOB_WORKER * JobScheduler_pimpl::GetCurrentWorker()
+{
+	JOB_WORKER *Worker = t_CurrentWorker;
+	return (Worker != NULL && Worker->Scheduler == this) ? Worker : NULL;
+}
+
+void JobScheduler_pimpl::Push(Job *j)
+{
+	JOB_WORKER *Worker = GetCurrentWorker();
+	if (Worker != NULL)
+		Worker->Deque.Push(j);
+	else
+	{
+		MUTEX_LOCK(&m_InjectionMutex);
+		m_InjectionQueue.push_back(j);
+		AtomicAdd(&m_InjectionCount, 1);
+	}
+	WakeWorker();
+}
+
+Job * JobScheduler_pimpl::FindJob(JOB_WORKER *Worker)
+{
+	Job *j;
+	if (Worker != NULL)
+	{
+		j = Worker->Deque.Pop();
+		if (j != NULL)
+			return j;
+	}
+
+	if (AtomicLoadAcquire(&m_InjectionCount) > 0)
+	{
+		MUTEX_LOCK(&m_InjectionMutex);
+		if (!m_InjectionQueue.empty())
+		{
+			j = m_InjectionQueue.front();
+			m_InjectionQueue.pop_front();
+			AtomicAdd(&m_InjectionCount, (size_t)-1);
+			return j;
+		}
+	}
+
+	// Podkradanie - od losowego wtku, eby zodzieje nie toczyli si u jednego
+	uint Count = m_Workers.size();
+	uint Start = 0;
+	if (Worker != NULL)
+	{
+		// Xorshift
+		Worker->RandState ^= Worker->RandState << 13;
+		Worker->RandState ^= Worker->RandState >> 17;
+		Worker->RandState ^= Worker->RandState << 5;
+		Start = Worker->RandState % Count;
+	}
+	for (uint i = 0; i < Count; i++)
+	{
+		JOB_WORKER *Victim = m_Workers[(Start + i) % Count];
+		if (Victim == Worker)
+			continue;
+		j = Victim->Deque.Steal();
+		if (j != NULL)
+			return j;
+	}
+	return NULL;
+}
+
+bool JobScheduler_pimpl::HasJobs()
+{
+	if (AtomicLoadAcquire(&m_InjectionCount) > 0)
+		return true;
+	for (size_t i = 0; i < m_Workers.size(); i++)
+		if (!m_Workers[i]->Deque.IsEmpty())
+			return true;
+	return false;
+}
+
+void JobScheduler_pimpl::ExecuteJob(Job *j)
+{
+	// Po Execute obiektu zadania ju nie wolno dotyka
+	JobGroup_pimpl *Group = j->m_Group;
+
+	string ErrorMsg;
+	if (!ExecuteJobCatch(j, &ErrorMsg))
+	{
+		MUTEX_LOCK(&m_ErrorMutex);
+		if (!Group->m_HasError)
+		{
+			Group->m_ErrorMsg = ErrorMsg;
+			Group->m_HasError = true;
+		}
+	}
+
+	// Po zmniejszeniu licznika grupa moe ju nie istnie - dalej tylko planista
+	if (AtomicAdd(&Group->m_Pending, (size_t)-1) == 0)
+	{
+		if (AtomicLoadAcquire(&m_WaitingCount) > 0)
+		{
+			MUTEX_LOCK(&m_WaitMutex);
+			m_WaitCond.Broadcast();
+		}
+	}
+}
+
+void JobScheduler_pimpl::WakeWorker()
+{
+	// Zapis zadania musi by widoczny przed odczytem licznika - para z AtomicAdd w Sleep
+	FullMemoryBarrier();
+	for (;;)
+	{
+		size_t SleepingCount = AtomicLoadAcquire(&m_SleepingCount);
+		if (SleepingCount == 0)
+			return;
+		if (AtomicCompareExchange(&m_SleepingCount, SleepingCount - 1, SleepingCount))
+		{
+			m_SleepSemaphore.V();
+			return;
+		}
+	}
+}
+
+void JobScheduler_pimpl::WorkerSleep()
+{
+	AtomicAdd(&m_SleepingCount, 1);
+
+	// Zadanie mogo zosta zlecone, zanim zwikszyem licznik - wtedy nikt by mnie nie obudzi
+	if (HasJobs() || AtomicLoadAcquire(&m_Stop))
+	{
+		for (;;)
+		{
+			size_t SleepingCount = AtomicLoadAcquire(&m_SleepingCount);
+			// Kto ju zmniejszy licznik za mnie i podnis (podniesie) semafor
+			if (SleepingCount == 0)
+				break;
+			if (AtomicCompareExchange(&m_SleepingCount, SleepingCount - 1, SleepingCount))
+				return;
+		}
+	}
+
+	m_SleepSemaphore.P();
+}
+
+void JobScheduler_pimpl::WaitForGroup(JobGroup_pimpl *Group)
+{
+	JOB_WORKER *Worker = GetCurrentWorker();
+	uint IdleCount = 0;
+	while (AtomicLoadAcquire(&Group->m_Pending) > 0)
+	{
+		Job *j = FindJob(Worker);
+		if (j != NULL)
+		{
+			ExecuteJob(j);
+			IdleCount = 0;
+		}
+		else if (++IdleCount < JOB_SPIN_COUNT)
+			YieldCurrentThread();
+		else
+		{
+			// Nie ma co podkra, a zadania grupy wykonuj si gdzie indziej.
+			// Czeka z limitem czasu, eby co jaki czas sprawdzi, czy nie pojawiy si
+			// nowe zadania, w ktrych mona pomc.
+			AtomicAdd(&m_WaitingCount, 1);
+			{
+				MUTEX_LOCK(&m_WaitMutex);
+				if (AtomicLoadAcquire(&Group->m_Pending) > 0)
+					m_WaitCond.TimeoutWait(&m_WaitMutex, 1);
+			}
+			AtomicAdd(&m_WaitingCount, (size_t)-1);
+			IdleCount = 0;
+		}
+	}
+}
+
+void JobScheduler_pimpl::WorkerFunc(uint Index)
+{
+	JOB_WORKER *Worker = m_Workers[Index];
+	t_CurrentWorker = Worker;
+
+	uint IdleCount = 0;
+	while (!AtomicLoadAcquire(&m_Stop))
+	{
+		Job *j = FindJob(Worker);
+		if (j != NULL)
+		{
+			ExecuteJob(j);
+			IdleCount = 0;
+		}
+		else if (++IdleCount < JOB_SPIN_COUNT)
+			YieldCurrentThread();
+		else
+		{
+			WorkerSleep();
+			IdleCount = 0;
+		}
+	}
+
+	t_CurrentWorker = NULL;
+}
+
+JobScheduler::JobScheduler(uint ThreadCount) :
+	pimpl(new JobScheduler_pimpl)
+{
+	if (ThreadCount == 0)
+		ThreadCount = GetCpuCoreCount();
+
+	pimpl->m_Workers.resize(ThreadCount);
+	for (uint i = 0; i < ThreadCount; i++)
+	{
+		pimpl->m_Workers[i] = new JOB_WORKER;
+		pimpl->m_Workers[i]->Scheduler = pimpl.get();
+		pimpl->m_Workers[i]->RandState = 0x9E3779B9u * (i + 1);
+	}
+
+	pimpl->m_PrevWorker = t_CurrentWorker;
+	t_CurrentWorker = pimpl->m_Workers[0];
+
+	for (uint i = 1; i < ThreadCount; i++)
+	{
+		JobWorkerThread *T = new JobWorkerThread(pimpl.get(), i);
+		pimpl->m_Threads.push_back(T);
+		T->Start();
+	}
+}
+
+JobScheduler::~JobScheduler()
+{
+	AtomicStoreRelease(&pimpl->m_Stop, (size_t)1);
+	pimpl->m_SleepSemaphore.V(pimpl->m_Threads.size());
+	for (size_t i = 0; i < pimpl->m_Threads.size(); i++)
+	{
+		pimpl->m_Threads[i]->Join();
+		delete pimpl->m_Threads[i];
+	}
+
+	t_CurrentWorker = pimpl->m_PrevWorker;
+
+	for (size_t i = 0; i < pimpl->m_Workers.size(); i++)
+		delete pimpl->m_Workers[i];
+}
+
+uint JobScheduler::GetThreadCount()
+{
+	return pimpl->m_Workers.size();
+}
+
+//HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
+// Klasa JobGroup
+
+JobGroup::JobGroup(JobScheduler *Scheduler) :
+	pimpl(new JobGroup_pimpl(Scheduler == NULL ? NULL : Scheduler->pimpl.get()))
+{
+}
+
+JobGroup::~JobGroup()
+{
+	if (AtomicLoadAcquire(&pimpl->m_Pending) > 0)
+	{
+		try
+		{
+			Wait();
+		}
+		catch (...)
+		{
+		}
+	}
+}
+
+void JobGroup::Run(Job *j)
+{
+	j->m_Group = pimpl.get();
+	AtomicAdd(&pimpl->m_Pending, 1);
+
+	if (pimpl->m_Scheduler == NULL)
+	{
+		// Bez planisty - od razu, ale bdy tak samo trafiaj do Wait
+		string ErrorMsg;
+		if (!ExecuteJobCatch(j, &ErrorMsg) && !pimpl->m_HasError)
+		{
+			pimpl->m_ErrorMsg = ErrorMsg;
+			pimpl->m_HasError = true;
+		}
+		AtomicAdd(&pimpl->m_Pending, (size_t)-1);
+	}
+	else
+		pimpl->m_Scheduler->Push(j);
+}
+
+void JobGroup::Wait()
+{
+	if (pimpl->m_Scheduler != NULL)
+		pimpl->m_Scheduler->WaitForGroup(pimpl.get());
+
+	if (pimpl->m_HasError)
+	{
+		string Msg;
+		Msg.swap(pimpl->m_ErrorMsg);
+		pimpl->m_HasError = false;
+		throw Error("Bd w zadaniu: " + Msg, __FILE__, __LINE__);
+	}
+}
+
+scoped_ptr<JobScheduler> g_JobScheduler;
+
 } // namespace common
@@ -12,6 +12,11 @@
 #ifndef COMMON_THREADS_H_
 #define COMMON_THREADS_H_
 
+#include "Stream.hpp"
+#include <algorithm>
+#include <functional>
+#include <iterator>
+
 namespace common
 {
 
@@ -22,6 +27,17 @@ class Semaphore_pimpl;
 class Cond_pimpl;
 class Barrier_pimpl;
 class Event_pimpl;
+class PrefetchStream_pimpl;
+class SpscRingBuffer_pimpl;
+class JobScheduler_pimpl;
+class JobGroup_pimpl;
+
+// Zwraca liczb procesorw logicznych (rdzeni, wtkw sprztowych) w systemie.
+// - Zawsze co najmniej 1.
+uint GetCpuCount();
+// Zwraca liczb fizycznych rdzeni procesora (bez wtkw sprztowych Hyper-Threading).
+// - Zawsze co najmniej 1. Jeli nie da si tego ustali, zwraca GetCpuCount().
+uint GetCpuCoreCount();
 
 /*
 Klasa bazowa wtku.
@@ -293,6 +309,471 @@ public:
 	bool TimeoutWait(uint Milliseconds);
 };
 
+/*
+Nakadka na strumie odczytujca dane z wyprzedzeniem w osobnym wtku
+- Wtek w tle wczytuje ze strumienia rdowego kolejne bloki po BlockSize bajtw
+  do piercienia BlockCount buforw, podczas gdy wtek uywajcy strumienia
+  przetwarza dane z biecego bloku.
+- Kiedy wszystkie bufory s pene, wtek w tle czeka (semafor), a si zwolni.
+- Tylko odczyt, bez kursora.
+- Bd odczytu w wtku w tle zostaje rzucony jako wyjtek z Read, kiedy do niego dojdzie.
+- Od utworzenia do zniszczenia obiektu nie wolno uywa strumienia rdowego
+  bezporednio - wtek w tle czyta z niego w dowolnej chwili i moe przeczyta wicej
+  ni zostanie odczytane z tej nakadki.
+*/
+class PrefetchStream : public OverlayStream
+{
+	DECLARE_NO_COPY_CLASS(PrefetchStream)
+
+private:
+	scoped_ptr<PrefetchStream_pimpl> pimpl;
+
+	// Jeli biecy blok si skoczy, oddaje go wtkowi w tle i czeka na nastpny.
+	// Zwraca false, jeli to koniec strumienia.
+	bool EnsureBlock();
+
+public:
+	// Od razu uruchamia wtek w tle.
+	PrefetchStream(Stream *a_Stream, size_t BlockSize = BUFFERED_STREAM_BLOCK_SIZE, uint BlockCount = 4);
+	// Zatrzymuje wtek w tle i czeka na jego zakoczenie.
+	virtual ~PrefetchStream();
+
+	// ======== Implementacja Stream ========
+	virtual size_t Read(void *Data, size_t Size);
+	virtual bool End();
+	// Nie robi nic - nie wolno dotyka strumienia rdowego z tego wtku.
+	virtual void Flush() { }
+
+	// ======== Bezporedni dostp do bufora ========
+	// Zwraca wskanik do nieodczytanych danych biecego bloku, a przez OutLength ich dugo.
+	// Jeli blok si skoczy, czeka na nastpny. 0 oznacza koniec strumienia.
+	const char * GetBufferPtr(size_t *OutLength);
+	// Przesuwa kursor o Length bajtw pobranych przez GetBufferPtr.
+	void Advance(size_t Length);
+};
+
+/*
+Bufor koowy do przesyania bajtw midzy dwoma wtkami bez blokowania muteksu
+- Dokadnie jeden wtek zapisuje (producent) i dokadnie jeden wtek odczytuje
+  (konsument). Z wicej ni jednego wtku po tej samej stronie si posypie.
+- W ciece zapisu i odczytu nie ma blokad ani wywoa systemowych. Indeksy
+  pocztku i koca le w osobnych liniach pamici podrcznej, eby wtki nie
+  przerzucay ich sobie nawzajem.
+- Pojemno jest zaokrglana w gr do potgi dwjki.
+- Opcjonalnie (Blocking = true) strona, ktrej brakuje danych albo miejsca,
+  czeka na zdarzeniu (Event). Zdarzenie jest sygnalizowane tylko wtedy, kiedy
+  kto na nie naprawd czeka.
+- Koniec strumienia zaznacza producent przez Close.
+*/
+class SpscRingBuffer : public Stream
+{
+	DECLARE_NO_COPY_CLASS(SpscRingBuffer)
+
+private:
+	scoped_ptr<SpscRingBuffer_pimpl> pimpl;
+
+public:
+	SpscRingBuffer(size_t Capacity, bool Blocking = true);
+	virtual ~SpscRingBuffer();
+
+	// Zwraca pojemno bufora (po zaokrgleniu do potgi dwjki)
+	size_t GetCapacity();
+	// Zwraca liczb bajtw w buforze
+	// - Wywoana z innego wtku ni producent czy konsument zwraca warto przyblion.
+	size_t GetSize();
+	bool IsEmpty() { return GetSize() == 0; }
+	bool IsClosed();
+
+	// ======== Strona producenta ========
+	// Zapisuje wszystkie dane.
+	// - Blocking: Jeli brakuje miejsca, czeka a konsument je zwolni.
+	// - Bez Blocking: Jeli dane si nie zmieszcz, rzuca wyjtek (jak RingBuffer).
+	virtual void Write(const void *Data, size_t Size);
+	// Zapisuje ile si zmieci, nigdy nie czeka. Zwraca liczb zapisanych bajtw.
+	size_t TryWrite(const void *Data, size_t Size);
+	// Zwraca wskanik do cigego wolnego miejsca w buforze, a przez OutLength jego dugo.
+	// - Nie czeka. Dugo moe by mniejsza ni cae wolne miejsce (zawinicie bufora).
+	char * GetWritePtr(size_t *OutLength);
+	// Udostpnia konsumentowi Length bajtw zapisanych pod wskanik z GetWritePtr.
+	void CommitWrite(size_t Length);
+	// Czeka, a w buforze bdzie wolne miejsce. Tylko w trybie Blocking.
+	void WaitForSpace();
+	// Jak wyej, ale co najwyej podany czas. Zwraca true, jeli jest miejsce.
+	bool TimeoutWaitForSpace(uint Milliseconds);
+	// Zaznacza koniec strumienia. Po tym nie wolno ju nic zapisywa.
+	void Close();
+
+	// ======== Strona konsumenta ========
+	// Odczytuje dane.
+	// - Blocking: Czeka na MaxLength bajtw. Mniej zwraca tylko po Close producenta.
+	// - Bez Blocking: Odczytuje tyle, ile akurat jest.
+	virtual size_t Read(void *Out, size_t MaxLength);
+	// Blocking: Czeka na dane albo Close. Bez Blocking: Zwraca true, jeli bufor jest pusty.
+	virtual bool End();
+	// Zwraca wskanik do cigych danych do odczytu, a przez OutLength ich dugo.
+	// - Nie czeka. Dugo moe by mniejsza ni wszystkie dane (zawinicie bufora).
+	const char * GetReadPtr(size_t *OutLength);
+	// Zwalnia Length bajtw odczytanych spod wskanika z GetReadPtr.
+	void CommitRead(size_t Length);
+	// Czeka, a w buforze bd dane albo producent zrobi Close. Tylko w trybie Blocking.
+	void WaitForData();
+	// Jak wyej, ale co najwyej podany czas. Zwraca true, jeli s dane albo Close.
+	bool TimeoutWaitForData(uint Milliseconds);
+};
+
+/*
+Zadanie dla JobScheduler
+- Odziedzicz po tej klasie i nadpisz Execute.
+- Obiekt musi istnie, dopki zadanie si nie wykona. Po powrocie z Execute
+  planista ju go nie dotyka, wic Execute moe na kocu zrobi delete this.
+*/
+class Job
+{
+	friend class JobScheduler_pimpl;
+	friend class JobGroup;
+
+private:
+	JobGroup_pimpl *m_Group;
+
+public:
+	Job() : m_Group(NULL) { }
+	virtual ~Job() { }
+
+	// Kod zadania. Moe zleca kolejne zadania, w tej samej albo innej grupie.
+	virtual void Execute() = 0;
+};
+
+/*
+Planista zada z podkradaniem pracy (work stealing)
+- Wtkw jest ThreadCount, liczc wtek, ktry utworzy planist - powstaje
+  ThreadCount-1 wtkw roboczych. 0 oznacza GetCpuCoreCount().
+- Kady z tych wtkw ma wasn kolejk dwustronn (Chase-Lev). Swoje nowe
+  zadania wkada i wyjmuje z jednego koca, bez blokad. Wtek, ktry nie ma co
+  robi, podkrada zadania z drugiego koca kolejki innego wtku - jedn
+  operacj CAS.
+- Zadania zlecone z innych wtkw trafiaj do wsplnej kolejki chronionej
+  muteksem, skd bior je wtki robocze.
+- Bezczynny wtek roboczy przez chwil szuka zada, a potem zasypia na
+  semaforze. Zlecenie zadania budzi jeden picy wtek, jeli jaki pi.
+- Przed zniszczeniem planisty wszystkie grupy zada musz by zakoczone.
+*/
+class JobScheduler
+{
+	DECLARE_NO_COPY_CLASS(JobScheduler)
+	friend class JobGroup;
+
+private:
+	scoped_ptr<JobScheduler_pimpl> pimpl;
+
+public:
+	JobScheduler(uint ThreadCount = 0);
+	~JobScheduler();
+
+	// Zwraca liczb wtkw wykonujcych zadania, cznie z tym, ktry utworzy planist
+	uint GetThreadCount();
+};
+
+/*
+Grupa zada
+- Run zleca zadanie, Wait czeka na wykonanie wszystkich zleconych w grupie.
+- Czekajcy w Wait wtek sam wykonuje w tym czasie zadania (dowolne, nie tylko
+  z tej grupy), a zasypia dopiero kiedy nie ma ju co podkra.
+- Wyjtek z zadania jest zapamitywany (tylko pierwszy) i rzucany z Wait.
+  Pozostae zadania i tak si wykonuj.
+- Scheduler = NULL: zadania wykonuj si od razu, w Run.
+- Destruktor czeka na niezakoczone zadania (ignorujc bdy).
+*/
+class JobGroup
+{
+	DECLARE_NO_COPY_CLASS(JobGroup)
+
+private:
+	scoped_ptr<JobGroup_pimpl> pimpl;
+
+public:
+	JobGroup(JobScheduler *Scheduler);
+	~JobGroup();
+
+	// Zleca zadanie do wykonania
+	void Run(Job *j);
+	// Czeka na wykonanie wszystkich zleconych dotychczas zada
+	void Wait();
+};
+
+// Domylny planista - tworzy go i niszczy program.
+// Jeli NULL, kod korzystajcy z niego ma wykonywa wszystko w biecym wtku.
+extern scoped_ptr<JobScheduler> g_JobScheduler;
+
+// ======== Algorytmy rwnolege ========
+/*
+- Korzystaj z g_JobScheduler. Jeli jest NULL albo danych jest za mao, eby
+  opacao si je dzieli, wykonuj wszystko w biecym wtku.
+- Mona ich uywa take wewntrz zada - czekajcy wtek wykonuje w tym czasie
+  inne zadania.
+- Funktory s wywoywane z wielu wtkw naraz, przez referencj do staej.
+  Musz mie operator() const i nie mog zapisywa niczego wsplnego bez
+  synchronizacji.
+- Grain - najmniejsza liczba elementw, dla ktrej warto utworzy osobne zadanie.
+  Ma by taka, eby praca na tylu elementach trwaa co najmniej kilka
+  mikrosekund. 0 znaczy 1.
+- Wyjtek rzucony z funktora wychodzi z funkcji (tylko pierwszy).
+*/
+
+// [Wewntrzne] Zadanie ParallelFor - dzieli zakres na p, dopki jest wikszy ni Grain
+template <typename FuncT>
+class ParallelForJob : public Job
+{
+private:
+	JobGroup *m_Group;
+	const FuncT *m_Func;
+	size_t m_Begin, m_End, m_Grain;
+
+public:
+	ParallelForJob(JobGroup *Group, const FuncT *Func, size_t Begin, size_t End, size_t Grain) : m_Group(Group), m_Func(Func), m_Begin(Begin), m_End(End), m_Grain(Grain) { }
+
+	virtual void Execute()
+	{
+		try
+		{
+			// Drug poow zleca (moe j podkra inny wtek), pierwsz dzieli dalej sam
+			while (m_End - m_Begin > m_Grain)
+			{
+				size_t Middle = m_Begin + (m_End - m_Begin) / 2;
+				m_Group->Run(new ParallelForJob<FuncT>(m_Group, m_Func, Middle, m_End, m_Grain));
+				m_End = Middle;
+			}
+			(*m_Func)(m_Begin, m_End);
+		}
+		catch (...)
+		{
+			delete this;
+			throw;
+		}
+		delete this;
+	}
+};
+
+/*
+Wywouje Func(b, e) dla rozcznych podzakresw pokrywajcych [Begin, End)
+- Podzakresy maj od Grain/2 do Grain elementw (ostatni moe mie mniej).
+- Kolejno i przydzia podzakresw do wtkw s nieokrelone.
+*/
+template <typename FuncT>
+void ParallelFor(size_t Begin, size_t End, size_t Grain, const FuncT &Func)
+{
+	if (End <= Begin)
+		return;
+	if (Grain == 0)
+		Grain = 1;
+
+	if (g_JobScheduler == NULL || End - Begin <= Grain)
+	{
+		Func(Begin, End);
+		return;
+	}
+
+	JobGroup Group(g_JobScheduler.get());
+	Group.Run(new ParallelForJob<FuncT>(&Group, &Func, Begin, End, Grain));
+	Group.Wait();
+}
+
+// [Wewntrzne] Funktor ParallelReduce - liczy wyniki czciowe kawakw o numerach [b, e)
+template <typename T, typename FuncT>
+class ParallelReduceFunc
+{
+private:
+	const FuncT &m_Func;
+	std::vector<T> &m_Partials;
+	size_t m_Begin, m_End, m_Grain;
+
+public:
+	ParallelReduceFunc(const FuncT &Func, std::vector<T> &Partials, size_t Begin, size_t End, size_t Grain) : m_Func(Func), m_Partials(Partials), m_Begin(Begin), m_End(End), m_Grain(Grain) { }
+
+	void operator () (size_t ChunkBegin, size_t ChunkEnd) const
+	{
+		for (size_t ci = ChunkBegin; ci < ChunkEnd; ci++)
+		{
+			size_t b = m_Begin + ci * m_Grain;
+			m_Partials[ci] = m_Func(b, std::min(b + m_Grain, m_End));
+		}
+	}
+};
+
+/*
+Redukcja rwnolega
+- Dzieli [Begin, End) na kolejne kawaki po dokadnie Grain elementw (ostatni
+  moe mie mniej) i dla kadego wywouje Func(b, e), zwracajce wynik
+  czciowy typu T.
+- Wyniki czciowe czy Combine(a, b) -> T od lewej do prawej, zaczynajc od
+  Identity, w biecym wtku.
+- Podzia i kolejno czenia zale tylko od Begin, End i Grain, a nie od
+  liczby wtkw ani od tego, ktry skoczy pierwszy. Dziki temu wynik jest
+  zawsze ten sam, take dla sum liczb zmiennoprzecinkowych. Combine musi by
+  tylko czne, nie musi by przemienne.
+- Zajmuje pami na (End-Begin)/Grain obiektw T.
+*/
+template <typename T, typename FuncT, typename CombineT>
+T ParallelReduce(size_t Begin, size_t End, size_t Grain, const T &Identity, const FuncT &Func, const CombineT &Combine)
+{
+	if (End <= Begin)
+		return Identity;
+	if (Grain == 0)
+		Grain = 1;
+
+	size_t ChunkCount = (End - Begin + Grain - 1) / Grain;
+	std::vector<T> Partials(ChunkCount, Identity);
+	ParallelFor(0, ChunkCount, 1, ParallelReduceFunc<T, FuncT>(Func, Partials, Begin, End, Grain));
+
+	T R = Identity;
+	for (size_t ci = 0; ci < ChunkCount; ci++)
+		R = Combine(R, Partials[ci]);
+	return R;
+}
+
+// Zakresy mniejsze ni tyle elementw ParallelSort sortuje (i scala) w jednym zadaniu
+const size_t PARALLEL_SORT_GRAIN = 4096;
+
+// [Wewntrzne] Funktor ParallelSort - sortuje kawaki o numerach [b, e)
+template <typename IterT, typename CompareT>
+class ParallelSortChunkFunc
+{
+private:
+	IterT m_Begin;
+	size_t m_Count, m_ChunkSize;
+	const CompareT &m_Comp;
+
+public:
+	ParallelSortChunkFunc(IterT Begin, size_t Count, size_t ChunkSize, const CompareT &Comp) : m_Begin(Begin), m_Count(Count), m_ChunkSize(ChunkSize), m_Comp(Comp) { }
+
+	void operator () (size_t ChunkBegin, size_t ChunkEnd) const
+	{
+		for (size_t ci = ChunkBegin; ci < ChunkEnd; ci++)
+		{
+			size_t b = ci * m_ChunkSize;
+			std::sort(m_Begin + b, m_Begin + std::min(b + m_ChunkSize, m_Count), m_Comp);
+		}
+	}
+};
+
+// [Wewntrzne] Zadanie ParallelSort - scala dwa posortowane cigi [A1, A2) i [B1, B2) do Dst
+/*
+Dopki scalanych elementw jest wicej ni Grain, dzieli duszy cig na p
+i wyszukuje binarnie miejsce podziau w drugim. Obie powki wyniku s
+niezalene - drug zleca jako nowe zadanie. Przy rwnych elementach te z A
+trafiaj przed te z B, wic scalanie jest stabilne. Grain musi by >= 2.
+*/
+template <typename SrcIterT, typename DstIterT, typename CompareT>
+class ParallelMergeJob : public Job
+{
+private:
+	JobGroup *m_Group;
+	SrcIterT m_A1, m_A2, m_B1, m_B2;
+	DstIterT m_Dst;
+	const CompareT *m_Comp;
+	size_t m_Grain;
+
+public:
+	ParallelMergeJob(JobGroup *Group, SrcIterT A1, SrcIterT A2, SrcIterT B1, SrcIterT B2, DstIterT Dst, const CompareT *Comp, size_t Grain) : m_Group(Group), m_A1(A1), m_A2(A2), m_B1(B1), m_B2(B2), m_Dst(Dst), m_Comp(Comp), m_Grain(Grain) { }
+
+	virtual void Execute()
+	{
+		try
+		{
+			while ((size_t)((m_A2 - m_A1) + (m_B2 - m_B1)) > m_Grain)
+			{
+				SrcIterT AMiddle, BMiddle;
+				if (m_A2 - m_A1 >= m_B2 - m_B1)
+				{
+					AMiddle = m_A1 + (m_A2 - m_A1) / 2;
+					BMiddle = std::lower_bound(m_B1, m_B2, *AMiddle, *m_Comp);
+				}
+				else
+				{
+					BMiddle = m_B1 + (m_B2 - m_B1) / 2;
+					AMiddle = std::upper_bound(m_A1, m_A2, *BMiddle, *m_Comp);
+				}
+				DstIterT DstMiddle = m_Dst + ((AMiddle - m_A1) + (BMiddle - m_B1));
+				m_Group->Run(new ParallelMergeJob<SrcIterT, DstIterT, CompareT>(m_Group, AMiddle, m_A2, BMiddle, m_B2, DstMiddle, m_Comp, m_Grain));
+				m_A2 = AMiddle;
+				m_B2 = BMiddle;
+			}
+			std::merge(m_A1, m_A2, m_B1, m_B2, m_Dst, *m_Comp);
+		}
+		catch (...)
+		{
+			delete this;
+			throw;
+		}
+		delete this;
+	}
+};
+
+// [Wewntrzne] Jeden przebieg scalania ParallelSort - czy w pary ssiednie posortowane cigi dugoci Width
+template <typename SrcIterT, typename DstIterT, typename CompareT>
+void ParallelMergePass(SrcIterT Src, DstIterT Dst, size_t Count, size_t Width, const CompareT &Comp)
+{
+	JobGroup Group(g_JobScheduler.get());
+	for (size_t b = 0; b < Count; b += Width * 2)
+	{
+		size_t Middle = std::min(b + Width, Count);
+		size_t e = std::min(b + Width * 2, Count);
+		Group.Run(new ParallelMergeJob<SrcIterT, DstIterT, CompareT>(&Group, Src + b, Src + Middle, Src + Middle, Src + e, Dst + b, &Comp, PARALLEL_SORT_GRAIN));
+	}
+	Group.Wait();
+}
+
+/*
+Sortowanie rwnolege (przez scalanie)
+- Iteratory musz by swobodnego dostpu.
+- Najpierw std::sort na kawakach (po kilka na wtek), potem przebiegi
+  scalania parami przez bufor pomocniczy. Kade scalenie te jest dzielone na
+  zadania, wic ostatnie przebiegi nie wykonuj si w jednym wtku.
+- Nie jest stabilne (kawaki sortuje std::sort), ale wynik nie zaley od liczby
+  wtkw ani kolejnoci ich wykonania. Bez planisty kawaki i scalanie te s
+  te same, tylko wykonuj si po kolei w biecym wtku - wynik jest ten sam.
+- Zajmuje dodatkowo pami na kopi sortowanych elementw.
+*/
+template <typename IterT, typename CompareT>
+void ParallelSort(IterT Begin, IterT End, CompareT Comp)
+{
+	typedef typename std::iterator_traits<IterT>::value_type ValueT;
+	typedef typename std::vector<ValueT>::iterator BufIterT;
+
+	size_t Count = (size_t)(End - Begin);
+	if (Count <= PARALLEL_SORT_GRAIN * 2)
+	{
+		std::sort(Begin, End, Comp);
+		return;
+	}
+
+	// Liczba kawakw nie zaley od liczby wtkw - po kilka na rdze typowego procesora,
+	// ale nie mniejszych ni PARALLEL_SORT_GRAIN
+	size_t ChunkCount = std::min<size_t>(Count / PARALLEL_SORT_GRAIN, 32);
+	size_t ChunkSize = (Count + ChunkCount - 1) / ChunkCount;
+	ParallelFor(0, ChunkCount, 1, ParallelSortChunkFunc<IterT, CompareT>(Begin, Count, ChunkSize, Comp));
+
+	// Scalanie - na przemian z danych do bufora i z powrotem
+	std::vector<ValueT> Buf(Begin, End);
+	bool InBuf = false;
+	for (size_t Width = ChunkSize; Width < Count; Width *= 2)
+	{
+		if (InBuf)
+			ParallelMergePass<BufIterT, IterT, CompareT>(Buf.begin(), Begin, Count, Width, Comp);
+		else
+			ParallelMergePass<IterT, BufIterT, CompareT>(Begin, Buf.begin(), Count, Width, Comp);
+		InBuf = !InBuf;
+	}
+	if (InBuf)
+		std::copy(Buf.begin(), Buf.end(), Begin);
+}
+
+// Sortowanie rwnolege rosnco, wg operatora <
+template <typename IterT>
+void ParallelSort(IterT Begin, IterT End)
+{
+	ParallelSort(Begin, End, std::less<typename std::iterator_traits<IterT>::value_type>());
+}
+
 } // namespace common
 
 #endif
@@ -7,12 +7,15 @@
  * Kontakt: mailto:sawickiap@poczta.onet.pl , http://regedit.gamedev.pl/
  */
 #include "Base.hpp"
+#include <deque>
+#include <map>
 extern "C" {
 	#include <errno.h>
 	#include <zlib.h>
 	#include <string.h> // dla strnlen
 }
 #include "DateTime.hpp"
+#include "Threads.hpp"
 #include "ZlibUtils.hpp"
 
 
@@ -36,6 +39,393 @@ ZlibError::ZlibError(int Code, const string &Msg, const string &File, int Line)
 const int ZLIB_DEFAULT_LEVEL = Z_DEFAULT_COMPRESSION;
 
 
+//HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
+// Klasa ZlibParallelCompressor
+
+// Rozmiar okna deflate - tyle kocowych bajtw poprzedniego bloku suy za sownik
+const size_t DEFLATE_WINDOW_SIZE = 32*1024;
+
+class ZlibParallelCompressor;
+
+// Blok danych do skompresowania w wtku roboczym
+struct DEFLATE_JOB
+{
+	std::vector<char> Input;
+	// Ostatnie bajty poprzedniego bloku
+	std::vector<char> Dict;
+	size_t InputLength;
+	// Ostatni blok - koczy strumie deflate. Pozostae kocz si Z_SYNC_FLUSH.
+	bool Last;
+	// ==== Wypeniane przez wtek roboczy ====
+	std::vector<char> Output;
+	// Adler-32 (zlib) lub CRC-32 (gzip) samego tego bloku
+	uint4 Check;
+	// Kod bdu zlib, Z_OK jeli si udao
+	int ErrorCode;
+	bool Done;
+};
+
+class DeflateWorkerThread : public Thread
+{
+private:
+	ZlibParallelCompressor *m_Owner;
+
+protected:
+	virtual void Run();
+
+public:
+	DeflateWorkerThread(ZlibParallelCompressor *Owner) : m_Owner(Owner) { }
+};
+
+/*
+Kompresja na wzr pigz. Wtek wywoujcy zbiera dane w bloki i wstawia je do
+kolejki, wtki robocze kompresuj je niezalenie jako surowy deflate, a wtek
+wywoujcy zapisuje wyniki po kolei, sklejajc sumy kontrolne przez
+adler32_combine / crc32_combine. Nagwek i stopk zlib/gzip pisze sam.
+*/
+class ZlibParallelCompressor
+{
+	DECLARE_NO_COPY_CLASS(ZlibParallelCompressor)
+
+private:
+	Stream *m_Stream;
+	int m_Level;
+	bool m_Gzip;
+	std::vector<DeflateWorkerThread*> m_Threads;
+
+	// Biecy, zbierany blok
+	std::vector<char> m_CurrentInput;
+	// Kocwka ostatnio wysanego bloku - sownik dla nastpnego
+	std::vector<char> m_LastTail;
+	// Ile blokw moe naraz czeka w kolejce - eby nie zaj caej pamici
+	size_t m_MaxJobs;
+	// Suma kontrolna zapisanych dotd blokw
+	uint4 m_Check;
+	// Dugo zapisanych dotd danych (dla gzip modulo 2^32)
+	uint4 m_TotalIn;
+
+	// Chroni wszystkie pola poniej
+	Mutex m_Mutex;
+	// Sygnalizowana kiedy pojawio si zadanie albo trzeba skoczy
+	Cond m_JobAvailableOrStop;
+	// Sygnalizowana kiedy zadanie zostao wykonane
+	Cond m_JobDone;
+	// Wszystkie zadania jeszcze nie zapisane, w kolejnoci
+	std::deque<DEFLATE_JOB*> m_Jobs;
+	// Zadania jeszcze nie pobrane przez wtki robocze
+	std::deque<DEFLATE_JOB*> m_Todo;
+	bool m_Stop;
+
+	void WriteHeader(const string *FileName, const string *Comment);
+	// Wysya biecy blok do kompresji
+	void SubmitBlock(bool Last);
+	// Zapisuje do strumienia gotowe zadania z pocztku kolejki.
+	// Czeka na zadania, dopki w kolejce jest ich wicej ni MaxPending.
+	void WriteDoneJobs(size_t MaxPending);
+	void StopThreads();
+
+public:
+	// FileName, Comment - tylko dla gzip, mog by NULL.
+	ZlibParallelCompressor(Stream *a_Stream, int Level, bool Gzip, const string *FileName, const string *Comment, uint ThreadCount);
+	~ZlibParallelCompressor();
+
+	void Write(const void *Data, size_t Size);
+	void Flush();
+	// Kompresuje ostatni blok i zapisuje stopk. Wywoa przed zniszczeniem.
+	void Finish();
+	// Funkcja do wtku
+	void ThreadFunc();
+};
+
+void DeflateWorkerThread::Run()
+{
+	m_Owner->ThreadFunc();
+}
+
+ZlibParallelCompressor::ZlibParallelCompressor(Stream *a_Stream, int Level, bool Gzip, const string *FileName, const string *Comment, uint ThreadCount) :
+	m_Stream(a_Stream),
+	m_Level(Level),
+	m_Gzip(Gzip),
+	m_TotalIn(0),
+	m_Mutex(0),
+	m_Stop(false)
+{
+	if (ThreadCount == 0)
+		ThreadCount = GetCpuCount();
+	m_MaxJobs = ThreadCount * 2;
+	m_Check = (Gzip ? crc32(0, Z_NULL, 0) : adler32(0, Z_NULL, 0));
+	m_CurrentInput.reserve(ZLIB_PARALLEL_BLOCK_SIZE);
+
+	WriteHeader(FileName, Comment);
+
+	try
+	{
+		for (uint i = 0; i < ThreadCount; i++)
+		{
+			m_Threads.push_back(new DeflateWorkerThread(this));
+			m_Threads.back()->Start();
+		}
+	}
+	catch (...)
+	{
+		StopThreads();
+		throw;
+	}
+}
+
+ZlibParallelCompressor::~ZlibParallelCompressor()
+{
+	StopThreads();
+	for (size_t i = 0; i < m_Jobs.size(); i++)
+		delete m_Jobs[i];
+}
+
+void ZlibParallelCompressor::StopThreads()
+{
+	{
+		MUTEX_LOCK(&m_Mutex);
+		m_Stop = true;
+		m_JobAvailableOrStop.Broadcast();
+	}
+	for (size_t i = 0; i < m_Threads.size(); i++)
+	{
+		m_Threads[i]->Join();
+		delete m_Threads[i];
+	}
+	m_Threads.clear();
+}
+
+void ZlibParallelCompressor::WriteHeader(const string *FileName, const string *Comment)
+{
+	int Level = (m_Level == Z_DEFAULT_COMPRESSION ? 6 : m_Level);
+
+	if (m_Gzip)
+	{
+		bool HasFileName = (FileName != NULL && !FileName->empty());
+		bool HasComment = (Comment != NULL && !Comment->empty());
+		uint4 Time = (uint4)Now().GetTicks();
+
+		uint1 Header[10];
+		Header[0] = 0x1F; // ID1, ID2
+		Header[1] = 0x8B;
+		Header[2] = 8; // CM = deflate
+		Header[3] = (HasFileName ? 0x08 : 0) | (HasComment ? 0x10 : 0); // FLG
+		Header[4] = (uint1)(Time); // MTIME
+		Header[5] = (uint1)(Time >> 8);
+		Header[6] = (uint1)(Time >> 16);
+		Header[7] = (uint1)(Time >> 24);
+		Header[8] = (Level == 9 ? 2 : (Level == 1 ? 4 : 0)); // XFL
+#ifdef WIN32
+		Header[9] = 0; // OS
+#else
+		Header[9] = 3;
+#endif
+		m_Stream->Write(Header, 10);
+		if (HasFileName)
+			m_Stream->Write(FileName->c_str(), FileName->length()+1);
+		if (HasComment)
+			m_Stream->Write(Comment->c_str(), Comment->length()+1);
+	}
+	else
+	{
+		// CMF = deflate z oknem 32 KB, FLEVEL jak w deflate.c, FCHECK dopenia do wielokrotnoci 31
+		uint LevelFlags = (Level < 2 ? 0 : (Level < 6 ? 1 : (Level == 6 ? 2 : 3)));
+		uint Header = (0x78 << 8) | (LevelFlags << 6);
+		Header += 31 - Header % 31;
+		uint1 HeaderBytes[2] = { (uint1)(Header >> 8), (uint1)Header };
+		m_Stream->Write(HeaderBytes, 2);
+	}
+}
+
+void ZlibParallelCompressor::Write(const void *Data, size_t Size)
+{
+	const char *CharData = (const char*)Data;
+	while (Size > 0)
+	{
+		size_t PartSize = std::min(Size, ZLIB_PARALLEL_BLOCK_SIZE - m_CurrentInput.size());
+		m_CurrentInput.insert(m_CurrentInput.end(), CharData, CharData + PartSize);
+		CharData += PartSize;
+		Size -= PartSize;
+
+		if (m_CurrentInput.size() == ZLIB_PARALLEL_BLOCK_SIZE)
+		{
+			SubmitBlock(false);
+			WriteDoneJobs(m_MaxJobs);
+		}
+	}
+}
+
+void ZlibParallelCompressor::Flush()
+{
+	if (!m_CurrentInput.empty())
+		SubmitBlock(false);
+	WriteDoneJobs(0);
+}
+
+void ZlibParallelCompressor::Finish()
+{
+	SubmitBlock(true);
+	WriteDoneJobs(0);
+
+	uint1 Footer[8];
+	if (m_Gzip)
+	{
+		// CRC32, ISIZE - little endian
+		for (uint i = 0; i < 4; i++)
+		{
+			Footer[i] = (uint1)(m_Check >> (i*8));
+			Footer[i+4] = (uint1)(m_TotalIn >> (i*8));
+		}
+		m_Stream->Write(Footer, 8);
+	}
+	else
+	{
+		// Adler-32 - big endian
+		for (uint i = 0; i < 4; i++)
+			Footer[i] = (uint1)(m_Check >> (24-i*8));
+		m_Stream->Write(Footer, 4);
+	}
+}
+
+void ZlibParallelCompressor::SubmitBlock(bool Last)
+{
+	DEFLATE_JOB *Job = new DEFLATE_JOB;
+	Job->Input.swap(m_CurrentInput);
+	Job->Dict.swap(m_LastTail);
+	Job->InputLength = Job->Input.size();
+	Job->Last = Last;
+	Job->Check = 0;
+	Job->ErrorCode = Z_OK;
+	Job->Done = false;
+
+	// Sownik dla nastpnego bloku: jego wasny koniec, a jeli krtszy ni okno - take koniec sownika
+	if (Job->InputLength >= DEFLATE_WINDOW_SIZE)
+		m_LastTail.assign(Job->Input.end() - DEFLATE_WINDOW_SIZE, Job->Input.end());
+	else
+	{
+		size_t DictPart = std::min(Job->Dict.size(), DEFLATE_WINDOW_SIZE - Job->InputLength);
+		m_LastTail.assign(Job->Dict.end() - DictPart, Job->Dict.end());
+		m_LastTail.insert(m_LastTail.end(), Job->Input.begin(), Job->Input.end());
+	}
+	m_CurrentInput.reserve(ZLIB_PARALLEL_BLOCK_SIZE);
+
+	MUTEX_LOCK(&m_Mutex);
+	m_Jobs.push_back(Job);
+	m_Todo.push_back(Job);
+	m_JobAvailableOrStop.Signal();
+}
+
+void ZlibParallelCompressor::WriteDoneJobs(size_t MaxPending)
+{
+	for (;;)
+	{
+		DEFLATE_JOB *Job;
+		{
+			MUTEX_LOCK(&m_Mutex);
+			if (m_Jobs.empty())
+				break;
+			Job = m_Jobs.front();
+			if (!Job->Done)
+			{
+				if (m_Jobs.size() <= MaxPending)
+					break;
+				while (!Job->Done)
+					m_JobDone.Wait(&m_Mutex);
+			}
+			m_Jobs.pop_front();
+		}
+
+		scoped_ptr<DEFLATE_JOB> JobPtr(Job);
+		if (Job->ErrorCode != Z_OK)
+			throw ZlibError(Job->ErrorCode, "Nie mona skompresowa bloku danych", __FILE__, __LINE__);
+		if (!Job->Output.empty())
+			m_Stream->Write(&Job->Output[0], Job->Output.size());
+		if (m_Gzip)
+			m_Check = crc32_combine(m_Check, Job->Check, Job->InputLength);
+		else
+			m_Check = adler32_combine(m_Check, Job->Check, Job->InputLength);
+		m_TotalIn += (uint4)Job->InputLength;
+	}
+}
+
+void ZlibParallelCompressor::ThreadFunc()
+{
+	z_stream ZStream;
+	ZStream.zalloc = Z_NULL;
+	ZStream.zfree = Z_NULL;
+	ZStream.opaque = Z_NULL;
+	// Surowy deflate - bez nagwka i sumy kontrolnej
+	int InitResult = deflateInit2(&ZStream, m_Level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+
+	for (;;)
+	{
+		DEFLATE_JOB *Job;
+		{
+			MUTEX_LOCK(&m_Mutex);
+			while (m_Todo.empty() && !m_Stop)
+				m_JobAvailableOrStop.Wait(&m_Mutex);
+			if (m_Stop)
+				break;
+			Job = m_Todo.front();
+			m_Todo.pop_front();
+		}
+
+		int R = InitResult;
+		if (R == Z_OK)
+			R = deflateReset(&ZStream);
+		if (R == Z_OK && !Job->Dict.empty())
+			R = deflateSetDictionary(&ZStream, (const Bytef*)&Job->Dict[0], Job->Dict.size());
+		if (R == Z_OK)
+		{
+			char Foo = '\0';
+			ZStream.next_in = (Bytef*)(Job->Input.empty() ? &Foo : &Job->Input[0]);
+			ZStream.avail_in = Job->InputLength;
+			int FlushMode = (Job->Last ? Z_FINISH : Z_SYNC_FLUSH);
+
+			Job->Output.resize(deflateBound(&ZStream, Job->InputLength) + 16);
+			size_t OutPos = 0;
+			for (;;)
+			{
+				if (OutPos == Job->Output.size())
+					Job->Output.resize(Job->Output.size() * 2);
+				ZStream.next_out = (Bytef*)&Job->Output[OutPos];
+				ZStream.avail_out = Job->Output.size() - OutPos;
+				R = deflate(&ZStream, FlushMode);
+				OutPos = Job->Output.size() - ZStream.avail_out;
+				// Z_FINISH koczy si Z_STREAM_END, Z_SYNC_FLUSH - kiedy zostao miejsce w buforze
+				if (Job->Last ? (R == Z_STREAM_END) : (R == Z_OK && ZStream.avail_out > 0))
+				{
+					R = Z_OK;
+					break;
+				}
+				// Z_BUF_ERROR przy penym buforze nie jest bdem - powikszy si i pjdzie dalej
+				if (R != Z_OK && !(R == Z_BUF_ERROR && ZStream.avail_out == 0))
+					break;
+			}
+			Job->Output.resize(OutPos);
+		}
+
+		if (m_Gzip)
+			Job->Check = crc32(crc32(0, Z_NULL, 0), (const Bytef*)(Job->Input.empty() ? NULL : &Job->Input[0]), Job->InputLength);
+		else
+			Job->Check = adler32(adler32(0, Z_NULL, 0), (const Bytef*)(Job->Input.empty() ? NULL : &Job->Input[0]), Job->InputLength);
+		// Wejcie nie bdzie ju potrzebne
+		std::vector<char>().swap(Job->Input);
+		std::vector<char>().swap(Job->Dict);
+
+		{
+			MUTEX_LOCK(&m_Mutex);
+			Job->ErrorCode = R;
+			Job->Done = true;
+			m_JobDone.Broadcast();
+		}
+	}
+
+	if (InitResult == Z_OK)
+		deflateEnd(&ZStream);
+}
+
+
 //HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
 // Klasa ZlibCompressionStream_pimpl
 
@@ -51,21 +441,29 @@ private:
 	gz_header m_Header;
 	std::vector<char> m_Header_FileName;
 	std::vector<char> m_Header_Comment;
+	// Tylko w trybie rwnolegym - wtedy m_ZStream nie jest uywany
+	scoped_ptr<ZlibParallelCompressor> m_Parallel;
 
 public:
 	// Wersja ZlibError
-	ZlibCompressionStream_pimpl(Stream *a_Stream, int Level);
+	ZlibCompressionStream_pimpl(Stream *a_Stream, int Level, uint ThreadCount);
 	// Wersja Gzip
-	ZlibCompressionStream_pimpl(Stream *a_Stream, const string *FileName, const string *Comment, int Level);
+	ZlibCompressionStream_pimpl(Stream *a_Stream, const string *FileName, const string *Comment, int Level, uint ThreadCount);
 	~ZlibCompressionStream_pimpl();
 
 	void Write(const void *Data, size_t Size);
 	void Flush();
 };
 
-ZlibCompressionStream_pimpl::ZlibCompressionStream_pimpl(Stream *a_Stream, int Level) :
+ZlibCompressionStream_pimpl::ZlibCompressionStream_pimpl(Stream *a_Stream, int Level, uint ThreadCount) :
 	m_Stream(a_Stream)
 {
+	if (ThreadCount != 1)
+	{
+		m_Parallel.reset(new ZlibParallelCompressor(a_Stream, Level, false, NULL, NULL, ThreadCount));
+		return;
+	}
+
 	m_OutBuf.resize(BUFFER_SIZE);
 
 	m_ZStream.zalloc = Z_NULL;
@@ -77,9 +475,15 @@ ZlibCompressionStream_pimpl::ZlibCompressionStream_pimpl(Stream *a_Stream, int L
 		throw ZlibError(R, "Nie mona zainicjalizowa kompresji zlib", __FILE__, __LINE__);
 }
 
-ZlibCompressionStream_pimpl::ZlibCompressionStream_pimpl(Stream *a_Stream, const string *FileName, const string *Comment, int Level) :
+ZlibCompressionStream_pimpl::ZlibCompressionStream_pimpl(Stream *a_Stream, const string *FileName, const string *Comment, int Level, uint ThreadCount) :
 	m_Stream(a_Stream)
 {
+	if (ThreadCount != 1)
+	{
+		m_Parallel.reset(new ZlibParallelCompressor(a_Stream, Level, true, FileName, Comment, ThreadCount));
+		return;
+	}
+
 	m_OutBuf.resize(BUFFER_SIZE);
 
 	m_ZStream.zalloc = Z_NULL;
@@ -127,6 +531,13 @@ ZlibCompressionStream_pimpl::~ZlibCompressionStream_pimpl()
 {
 	try
 	{
+		if (m_Parallel.get() != NULL)
+		{
+			m_Parallel->Finish();
+			m_Parallel.reset();
+			return;
+		}
+
 		char Foo = '\0';
 		m_ZStream.next_in = (Bytef*)&Foo;
 		m_ZStream.avail_in = 0;
@@ -156,6 +567,12 @@ void ZlibCompressionStream_pimpl::Write(const void *Data, size_t Size)
 {
 	if (Size == 0) return;
 
+	if (m_Parallel.get() != NULL)
+	{
+		m_Parallel->Write(Data, Size);
+		return;
+	}
+
 	m_ZStream.next_in = (Bytef*)Data;
 	m_ZStream.avail_in = Size;
 
@@ -175,6 +592,12 @@ void ZlibCompressionStream_pimpl::Write(const void *Data, size_t Size)
 
 void ZlibCompressionStream_pimpl::Flush()
 {
+	if (m_Parallel.get() != NULL)
+	{
+		m_Parallel->Flush();
+		return;
+	}
+
 	char Foo = '\0';
 	m_ZStream.next_in = (Bytef*)&Foo;
 	m_ZStream.avail_in = 0;
@@ -196,9 +619,9 @@ void ZlibCompressionStream_pimpl::Flush()
 //HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
 // Klasa ZlibCompressionStream
 
-ZlibCompressionStream::ZlibCompressionStream(Stream *a_Stream, int Level) :
+ZlibCompressionStream::ZlibCompressionStream(Stream *a_Stream, int Level, uint ThreadCount) :
 	OverlayStream(a_Stream),
-	pimpl(new ZlibCompressionStream_pimpl(a_Stream, Level))
+	pimpl(new ZlibCompressionStream_pimpl(a_Stream, Level, ThreadCount))
 {
 }
 
@@ -235,9 +658,9 @@ size_t ZlibCompressionStream::Compress(void *OutData, size_t BufLength, const vo
 //HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
 // Klasa GzipCompressionStream
 
-GzipCompressionStream::GzipCompressionStream(Stream *a_Stream, const string *FileName, const string *Comment, int Level) :
+GzipCompressionStream::GzipCompressionStream(Stream *a_Stream, const string *FileName, const string *Comment, int Level, uint ThreadCount) :
 	OverlayStream(a_Stream),
-	pimpl(new ZlibCompressionStream_pimpl(a_Stream, FileName, Comment, Level))
+	pimpl(new ZlibCompressionStream_pimpl(a_Stream, FileName, Comment, Level, ThreadCount))
 {
 }
 
@@ -491,6 +914,543 @@ bool GzipDecompressionStream::GetHeaderComment(string *OutComment)
 }
 
 
+//HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
+// Format porcjowany
+
+/*
+Format:
+- Nagwek: CHUNKED_MAGIC (8 B), uint4 ChunkSize
+- Porcje, jedna za drug
+- Indeks: dla kadej porcji uint8 Offset (od pocztku nagwka), uint4 Size
+  (z flag CHUNKED_STORED_FLAG, jeli porcja nie jest skompresowana)
+- Stopka: uint8 IndexOffset, uint8 UncompressedSize, uint4 ChunkCount, CHUNKED_MAGIC (8 B)
+*/
+const char * const CHUNKED_MAGIC = "TFQCHNK1";
+const size_t CHUNKED_MAGIC_SIZE = 8;
+const uint4 CHUNKED_STORED_FLAG = 0x80000000;
+const size_t CHUNKED_INDEX_ENTRY_SIZE = sizeof(uint8) + sizeof(uint4);
+const size_t CHUNKED_FOOTER_SIZE = sizeof(uint8) + sizeof(uint8) + sizeof(uint4) + CHUNKED_MAGIC_SIZE;
+
+struct CHUNK_DESC
+{
+	uint8 Offset;
+	// Rozmiar po kompresji, bez flagi
+	uint4 Size;
+	bool Stored;
+};
+
+
+//HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
+// Klasa ChunkedCompressionStream
+
+class ChunkedCompressionStream_pimpl
+{
+public:
+	Stream *m_Stream;
+	size_t m_ChunkSize;
+	int m_Level;
+	std::vector<char> m_InBuf;
+	std::vector<char> m_OutBuf;
+	std::vector<CHUNK_DESC> m_Index;
+	// Liczba zapisanych dotd bajtw, razem z nagwkiem
+	uint8 m_Offset;
+	uint8 m_UncompressedSize;
+
+	ChunkedCompressionStream_pimpl(Stream *a_Stream, size_t ChunkSize, int Level);
+	// Kompresuje i zapisuje m_InBuf
+	void WriteChunk();
+	// Zapisuje ostatni porcj, indeks i stopk
+	void Finish();
+};
+
+ChunkedCompressionStream_pimpl::ChunkedCompressionStream_pimpl(Stream *a_Stream, size_t ChunkSize, int Level) :
+	m_Stream(a_Stream),
+	m_ChunkSize(ChunkSize),
+	m_Level(Level),
+	m_Offset(0),
+	m_UncompressedSize(0)
+{
+	m_InBuf.reserve(ChunkSize);
+	m_OutBuf.resize(compressBound(ChunkSize));
+
+	m_Stream->Write(CHUNKED_MAGIC, CHUNKED_MAGIC_SIZE);
+	m_Stream->WriteEx((uint4)ChunkSize);
+	m_Offset = CHUNKED_MAGIC_SIZE + sizeof(uint4);
+}
+
+void ChunkedCompressionStream_pimpl::WriteChunk()
+{
+	if (m_InBuf.empty())
+		return;
+
+	uLongf DestLen = m_OutBuf.size();
+	int R = compress2((Bytef*)&m_OutBuf[0], &DestLen, (const Bytef*)&m_InBuf[0], m_InBuf.size(), m_Level);
+	if (R != Z_OK)
+		throw ZlibError(R, "Nie mona skompresowa porcji danych", __FILE__, __LINE__);
+
+	CHUNK_DESC Desc;
+	Desc.Offset = m_Offset;
+	// Nie opaca si kompresowa
+	Desc.Stored = (DestLen >= m_InBuf.size());
+	if (Desc.Stored)
+	{
+		Desc.Size = (uint4)m_InBuf.size();
+		m_Stream->Write(&m_InBuf[0], m_InBuf.size());
+	}
+	else
+	{
+		Desc.Size = (uint4)DestLen;
+		m_Stream->Write(&m_OutBuf[0], DestLen);
+	}
+	m_Index.push_back(Desc);
+
+	m_Offset += Desc.Size;
+	m_UncompressedSize += m_InBuf.size();
+	m_InBuf.clear();
+}
+
+void ChunkedCompressionStream_pimpl::Finish()
+{
+	WriteChunk();
+
+	uint8 IndexOffset = m_Offset;
+	for (size_t i = 0; i < m_Index.size(); i++)
+	{
+		m_Stream->WriteEx(m_Index[i].Offset);
+		m_Stream->WriteEx(m_Index[i].Size | (m_Index[i].Stored ? CHUNKED_STORED_FLAG : 0));
+	}
+
+	m_Stream->WriteEx(IndexOffset);
+	m_Stream->WriteEx(m_UncompressedSize);
+	m_Stream->WriteEx((uint4)m_Index.size());
+	m_Stream->Write(CHUNKED_MAGIC, CHUNKED_MAGIC_SIZE);
+}
+
+ChunkedCompressionStream::ChunkedCompressionStream(Stream *a_Stream, size_t ChunkSize, int Level) :
+	OverlayStream(a_Stream),
+	pimpl(new ChunkedCompressionStream_pimpl(a_Stream, ChunkSize, Level))
+{
+	assert(ChunkSize > 0 && ChunkSize < CHUNKED_STORED_FLAG);
+}
+
+ChunkedCompressionStream::~ChunkedCompressionStream()
+{
+	try
+	{
+		pimpl->Finish();
+	}
+	catch (...)
+	{
+		assert(0 && "ChunkedCompressionStream.dtor - wyjtek");
+	}
+}
+
+void ChunkedCompressionStream::Write(const void *Data, size_t Size)
+{
+	const char *CharData = (const char*)Data;
+	while (Size > 0)
+	{
+		size_t PartSize = std::min(Size, pimpl->m_ChunkSize - pimpl->m_InBuf.size());
+		pimpl->m_InBuf.insert(pimpl->m_InBuf.end(), CharData, CharData + PartSize);
+		CharData += PartSize;
+		Size -= PartSize;
+
+		if (pimpl->m_InBuf.size() == pimpl->m_ChunkSize)
+			pimpl->WriteChunk();
+	}
+}
+
+
+//HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
+// Klasa ChunkedDecompressionStream
+
+// Porcja rozkompresowywana z wyprzedzeniem w wtku roboczym
+struct CHUNK_JOB
+{
+	uint Index;
+	std::vector<char> Data;
+	// Jeli niepusty, przy dekompresji wystpi bd
+	string ErrorMsg;
+	bool Done;
+	// Ju niepotrzebna - wtek roboczy sam j usunie
+	bool Abandoned;
+};
+
+class ChunkDecompressThread;
+
+class ChunkedDecompressionStream_pimpl
+{
+public:
+	SeekableStream *m_Stream;
+	// Pozycja nagwka w strumieniu rdowym
+	int m_Base;
+	size_t m_ChunkSize;
+	uint8 m_UncompressedSize;
+	std::vector<CHUNK_DESC> m_Index;
+	// Chroni dostp do m_Stream
+	Mutex m_StreamMutex;
+
+	// ==== Uywane tylko przez wtek odczytujcy ====
+	size_t m_Pos;
+	// Indeks biecej porcji, MAXUINT4 jeli adna
+	uint m_CurrentChunk;
+	std::vector<char> m_CurrentData;
+	// Ile porcji rozkompresowywa z wyprzedzeniem, 0 jeli bez wtkw
+	uint m_ReadAhead;
+	std::vector<ChunkDecompressThread*> m_Threads;
+
+	// ==== Chronione przez m_JobMutex ====
+	Mutex m_JobMutex;
+	Cond m_JobAvailableOrStop;
+	Cond m_JobDone;
+	// Zadania zlecone z wyprzedzeniem, wg indeksu porcji
+	std::map<uint, CHUNK_JOB*> m_Jobs;
+	// Zadania jeszcze nie pobrane przez wtki robocze
+	std::deque<CHUNK_JOB*> m_Todo;
+	bool m_Stop;
+
+	ChunkedDecompressionStream_pimpl(SeekableStream *a_Stream);
+	~ChunkedDecompressionStream_pimpl();
+
+	void LoadIndex();
+	void StartThreads(uint ThreadCount);
+	// Wczytuje i rozkompresowuje podan porcj. Moe by wywoana z dowolnego wtku.
+	void DecompressChunk(uint Index, std::vector<char> *Out);
+	// Zapewnia, e m_CurrentData zawiera podan porcj
+	void EnsureChunk(uint Index);
+	// Funkcja do wtku
+	void ThreadFunc();
+};
+
+class ChunkDecompressThread : public Thread
+{
+private:
+	ChunkedDecompressionStream_pimpl *m_Pimpl;
+
+protected:
+	virtual void Run() { m_Pimpl->ThreadFunc(); }
+
+public:
+	ChunkDecompressThread(ChunkedDecompressionStream_pimpl *Pimpl) : m_Pimpl(Pimpl) { }
+};
+
+ChunkedDecompressionStream_pimpl::ChunkedDecompressionStream_pimpl(SeekableStream *a_Stream) :
+	m_Stream(a_Stream),
+	m_Base(0),
+	m_ChunkSize(0),
+	m_UncompressedSize(0),
+	m_StreamMutex(0),
+	m_Pos(0),
+	m_CurrentChunk(MAXUINT4),
+	m_ReadAhead(0),
+	m_JobMutex(0),
+	m_Stop(false)
+{
+}
+
+ChunkedDecompressionStream_pimpl::~ChunkedDecompressionStream_pimpl()
+{
+	{
+		MUTEX_LOCK(&m_JobMutex);
+		m_Stop = true;
+		m_JobAvailableOrStop.Broadcast();
+	}
+	for (size_t i = 0; i < m_Threads.size(); i++)
+	{
+		m_Threads[i]->Join();
+		delete m_Threads[i];
+	}
+
+	// Porzucone zadania s ju tylko w m_Todo, pozostae w m_Jobs
+	for (size_t i = 0; i < m_Todo.size(); i++)
+	{
+		if (m_Todo[i]->Abandoned)
+			delete m_Todo[i];
+	}
+	for (std::map<uint, CHUNK_JOB*>::iterator it = m_Jobs.begin(); it != m_Jobs.end(); ++it)
+		delete it->second;
+}
+
+void ChunkedDecompressionStream_pimpl::LoadIndex()
+{
+	size_t StreamSize = m_Stream->GetSize();
+	if (StreamSize < CHUNKED_MAGIC_SIZE + sizeof(uint4) + CHUNKED_FOOTER_SIZE)
+		throw Error("Strumie za krtki na format porcjowany.", __FILE__, __LINE__);
+
+	// Stopka
+	uint8 IndexOffset;
+	uint4 ChunkCount;
+	char Magic[CHUNKED_MAGIC_SIZE];
+	m_Stream->SetPos((int)(StreamSize - CHUNKED_FOOTER_SIZE));
+	m_Stream->ReadEx(&IndexOffset);
+	m_Stream->ReadEx(&m_UncompressedSize);
+	m_Stream->ReadEx(&ChunkCount);
+	m_Stream->MustRead(Magic, CHUNKED_MAGIC_SIZE);
+	if (memcmp(Magic, CHUNKED_MAGIC, CHUNKED_MAGIC_SIZE) != 0)
+		throw Error("Nieprawidowa stopka formatu porcjowanego.", __FILE__, __LINE__);
+
+	// Pocztek formatu w strumieniu - indeks ley tu przed stopk
+	uint8 IndexSize = (uint8)ChunkCount * CHUNKED_INDEX_ENTRY_SIZE;
+	if (IndexSize + IndexOffset + CHUNKED_FOOTER_SIZE > StreamSize)
+		throw Error("Nieprawidowy indeks formatu porcjowanego.", __FILE__, __LINE__);
+	m_Base = (int)(StreamSize - CHUNKED_FOOTER_SIZE - IndexSize - IndexOffset);
+
+	// Nagwek
+	uint4 ChunkSize;
+	m_Stream->SetPos(m_Base);
+	m_Stream->MustRead(Magic, CHUNKED_MAGIC_SIZE);
+	m_Stream->ReadEx(&ChunkSize);
+	if (memcmp(Magic, CHUNKED_MAGIC, CHUNKED_MAGIC_SIZE) != 0 || ChunkSize == 0)
+		throw Error("Nieprawidowy nagwek formatu porcjowanego.", __FILE__, __LINE__);
+	m_ChunkSize = ChunkSize;
+	if ((m_UncompressedSize + m_ChunkSize - 1) / m_ChunkSize != ChunkCount)
+		throw Error("Liczba porcji nie zgadza si z rozmiarem danych.", __FILE__, __LINE__);
+
+	// Indeks
+	m_Stream->SetPos(m_Base + (int)IndexOffset);
+	m_Index.resize(ChunkCount);
+	uint4 Size;
+	for (uint i = 0; i < ChunkCount; i++)
+	{
+		m_Stream->ReadEx(&m_Index[i].Offset);
+		m_Stream->ReadEx(&Size);
+		m_Index[i].Stored = ((Size & CHUNKED_STORED_FLAG) != 0);
+		m_Index[i].Size = Size & ~CHUNKED_STORED_FLAG;
+		if (m_Index[i].Offset + m_Index[i].Size > IndexOffset)
+			throw Error(Format("Nieprawidowy opis porcji #.") % i, __FILE__, __LINE__);
+	}
+}
+
+void ChunkedDecompressionStream_pimpl::StartThreads(uint ThreadCount)
+{
+	if (ThreadCount == 0)
+		ThreadCount = GetCpuCount();
+	if (ThreadCount <= 1)
+		return;
+
+	m_ReadAhead = ThreadCount * 2;
+	for (uint i = 0; i < ThreadCount; i++)
+	{
+		m_Threads.push_back(new ChunkDecompressThread(this));
+		m_Threads.back()->Start();
+	}
+}
+
+void ChunkedDecompressionStream_pimpl::DecompressChunk(uint Index, std::vector<char> *Out)
+{
+	const CHUNK_DESC &Desc = m_Index[Index];
+	size_t Length = (Index + 1 < m_Index.size() ? m_ChunkSize : (size_t)(m_UncompressedSize - (uint8)Index * m_ChunkSize));
+	Out->resize(Length);
+
+	if (Desc.Stored)
+	{
+		if (Desc.Size != Length)
+			throw Error(Format("Nieprawidowy rozmiar porcji #.") % Index, __FILE__, __LINE__);
+		MUTEX_LOCK(&m_StreamMutex);
+		m_Stream->SetPos(m_Base + (int)Desc.Offset);
+		m_Stream->MustRead(&(*Out)[0], Length);
+		return;
+	}
+
+	std::vector<char> Compressed(Desc.Size);
+	{
+		MUTEX_LOCK(&m_StreamMutex);
+		m_Stream->SetPos(m_Base + (int)Desc.Offset);
+		m_Stream->MustRead(&Compressed[0], Desc.Size);
+	}
+
+	uLongf DestLen = Length;
+	int R = uncompress((Bytef*)&(*Out)[0], &DestLen, (const Bytef*)&Compressed[0], Desc.Size);
+	if (R != Z_OK)
+		throw ZlibError(R, Format("Nie mona rozkompresowa porcji #.") % Index, __FILE__, __LINE__);
+	if (DestLen != Length)
+		throw Error(Format("Nieprawidowy rozmiar porcji # po dekompresji.") % Index, __FILE__, __LINE__);
+}
+
+void ChunkedDecompressionStream_pimpl::EnsureChunk(uint Index)
+{
+	if (Index == m_CurrentChunk)
+		return;
+
+	bool Sequential = (Index == m_CurrentChunk + 1) || (m_CurrentChunk == MAXUINT4 && Index == 0);
+	m_CurrentChunk = MAXUINT4;
+
+	if (m_ReadAhead == 0)
+		DecompressChunk(Index, &m_CurrentData);
+	else
+	{
+		CHUNK_JOB *Job = NULL;
+		{
+			MUTEX_LOCK(&m_JobMutex);
+
+			// Zadania spoza nowego okna wyprzedzenia s niepotrzebne.
+			// Wykonane mona usun od razu, czekajce lub wykonywane usunie wtek roboczy.
+			std::map<uint, CHUNK_JOB*>::iterator it = m_Jobs.begin();
+			while (it != m_Jobs.end())
+			{
+				if (it->first < Index || it->first > Index + m_ReadAhead)
+				{
+					if (it->second->Done)
+						delete it->second;
+					else
+						it->second->Abandoned = true;
+					m_Jobs.erase(it++);
+				}
+				else
+					++it;
+			}
+
+			it = m_Jobs.find(Index);
+			if (it != m_Jobs.end())
+			{
+				Job = it->second;
+				m_Jobs.erase(it);
+				while (!Job->Done)
+					m_JobDone.Wait(&m_JobMutex);
+			}
+
+			// Zle nastpne porcje - tylko przy odczycie po kolei
+			if (Sequential)
+			{
+				for (uint i = Index + 1; i <= Index + m_ReadAhead && i < m_Index.size(); i++)
+				{
+					if (m_Jobs.find(i) != m_Jobs.end())
+						continue;
+					CHUNK_JOB *NewJob = new CHUNK_JOB;
+					NewJob->Index = i;
+					NewJob->Done = false;
+					NewJob->Abandoned = false;
+					m_Jobs.insert(std::make_pair(i, NewJob));
+					m_Todo.push_back(NewJob);
+				}
+				m_JobAvailableOrStop.Broadcast();
+			}
+		}
+
+		if (Job != NULL)
+		{
+			scoped_ptr<CHUNK_JOB> JobPtr(Job);
+			if (!Job->ErrorMsg.empty())
+				throw Error("Bd dekompresji porcji w wtku roboczym: " + Job->ErrorMsg, __FILE__, __LINE__);
+			m_CurrentData.swap(Job->Data);
+		}
+		else
+			DecompressChunk(Index, &m_CurrentData);
+	}
+
+	m_CurrentChunk = Index;
+}
+
+void ChunkedDecompressionStream_pimpl::ThreadFunc()
+{
+	for (;;)
+	{
+		CHUNK_JOB *Job;
+		{
+			MUTEX_LOCK(&m_JobMutex);
+			while (m_Todo.empty() && !m_Stop)
+				m_JobAvailableOrStop.Wait(&m_JobMutex);
+			if (m_Stop)
+				break;
+			Job = m_Todo.front();
+			m_Todo.pop_front();
+			if (Job->Abandoned)
+			{
+				delete Job;
+				continue;
+			}
+		}
+
+		try
+		{
+			DecompressChunk(Job->Index, &Job->Data);
+		}
+		catch (const Error &e)
+		{
+			e.GetMessage_(&Job->ErrorMsg);
+			if (Job->ErrorMsg.empty())
+				Job->ErrorMsg = "Nieznany bd";
+		}
+		catch (...)
+		{
+			// eby wyjtek nie wylecia poza wtek
+			Job->ErrorMsg = "Nieznany bd";
+		}
+
+		{
+			MUTEX_LOCK(&m_JobMutex);
+			if (Job->Abandoned)
+				delete Job;
+			else
+			{
+				Job->Done = true;
+				m_JobDone.Broadcast();
+			}
+		}
+	}
+}
+
+ChunkedDecompressionStream::ChunkedDecompressionStream(SeekableStream *a_Stream, uint ThreadCount) :
+	pimpl(new ChunkedDecompressionStream_pimpl(a_Stream))
+{
+	pimpl->LoadIndex();
+	pimpl->StartThreads(ThreadCount);
+}
+
+ChunkedDecompressionStream::~ChunkedDecompressionStream()
+{
+}
+
+size_t ChunkedDecompressionStream::GetChunkSize()
+{
+	return pimpl->m_ChunkSize;
+}
+
+uint ChunkedDecompressionStream::GetChunkCount()
+{
+	return pimpl->m_Index.size();
+}
+
+size_t ChunkedDecompressionStream::Read(void *Out, size_t MaxLength)
+{
+	char *CharOut = (char*)Out;
+	size_t Sum = 0, Length;
+	// MaxLength bdzie zmniejszany. Oznacza liczb pozostaych do odczytania bajtw.
+
+	while (MaxLength > 0 && pimpl->m_Pos < pimpl->m_UncompressedSize)
+	{
+		uint Index = (uint)(pimpl->m_Pos / pimpl->m_ChunkSize);
+		pimpl->EnsureChunk(Index);
+
+		size_t ChunkPos = pimpl->m_Pos - (size_t)Index * pimpl->m_ChunkSize;
+		Length = std::min(pimpl->m_CurrentData.size() - ChunkPos, MaxLength);
+		memcpy(CharOut, &pimpl->m_CurrentData[ChunkPos], Length);
+		pimpl->m_Pos += Length;
+		CharOut += Length;
+		Sum += Length;
+		MaxLength -= Length;
+	}
+
+	return Sum;
+}
+
+size_t ChunkedDecompressionStream::GetSize()
+{
+	return (size_t)pimpl->m_UncompressedSize;
+}
+
+int ChunkedDecompressionStream::GetPos()
+{
+	return (int)pimpl->m_Pos;
+}
+
+void ChunkedDecompressionStream::SetPos(int pos)
+{
+	assert(pos >= 0);
+	pimpl->m_Pos = std::min((size_t)pos, (size_t)pimpl->m_UncompressedSize);
+}
+
+
 //HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
 // Klasa GzipFileStream
 
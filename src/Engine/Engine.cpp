@@ -2393,8 +2393,7 @@ float PositionedLight::GetScissorRect(RECT *OutRect, const MATRIX &View, const M
 	VEC3 ViewPoints[8], TransformedPoints[8];
 	const VEC3 *Points = GetBoundingBox();
 
-	for (uint i = 0; i < 8; i++)
-		Transform(&ViewPoints[i], Points[i], View);
+	TransformArray(ViewPoints, Points, 8, View);
 
 	// Jeli cho jeden punkt jest z tyu kamery, ustaw cay prostokt
 	bool PointBehind = false;
@@ -2416,8 +2415,7 @@ float PositionedLight::GetScissorRect(RECT *OutRect, const MATRIX &View, const M
 	}
 	else
 	{
-		for (uint i = 0; i < 8; i++)
-			TransformCoord(&TransformedPoints[i], ViewPoints[i], Proj);
+		TransformCoordArray(TransformedPoints, ViewPoints, 8, Proj);
 
 		RECTF Rect1;
 		Rect1.left = Rect1.right  = TransformedPoints[0].x;
@@ -3143,21 +3141,23 @@ bool QMapRenderer::RayCollisionToNode(const QMap::COLLISION_NODE *Node, const VE
 	const VEC3 *CollisionVB = m_Map->GetCollisionVB();
 	const uint *CollisionIB = m_Map->GetCollisionIB();
 
-	// Przejrzyj trjkty z tego wza
-	for (uint vi = Node->IndexBegin; vi < Node->IndexEnd; vi += 3)
+	// Przejrzyj trjkty z tego wza, paczkami po 8
+	TRIANGLE_PACKET8 Packet;
+	float PacketT[8];
+	uint vi = Node->IndexBegin, PacketSize, HitMask, ti;
+	while (vi < Node->IndexEnd)
 	{
-		if (RayToTriangle(
-			RayOrig,
-			RayDir,
-			CollisionVB[CollisionIB[vi  ]],
-			CollisionVB[CollisionIB[vi+1]],
-			CollisionVB[CollisionIB[vi+2]],
-			true,
-			&t))
+		for (PacketSize = 0; PacketSize < 8 && vi < Node->IndexEnd; PacketSize++, vi += 3)
+			Packet.Set(PacketSize, CollisionVB[CollisionIB[vi]], CollisionVB[CollisionIB[vi+1]], CollisionVB[CollisionIB[vi+2]]);
+		for (ti = PacketSize; ti < 8; ti++)
+			Packet.SetDegenerate(ti);
+
+		HitMask = RayToTriangle8(PacketT, RayOrig, RayDir, Packet, true);
+		for (ti = 0; HitMask != 0; ti++, HitMask >>= 1)
 		{
-			if (t >= 0.f && t < *InOutT)
+			if ((HitMask & 1) != 0 && PacketT[ti] >= 0.f && PacketT[ti] < *InOutT)
 			{
-				*InOutT = t;
+				*InOutT = PacketT[ti];
 				Found = true;
 			}
 		}
@@ -3333,31 +3333,28 @@ void TerrainRenderer::GetTreesInFrustum(TREE_DRAW_DESC_VECTOR *InOut, const Para
 	int x2 = minmax(0, roundo(ceilf(FrustumBox.p2.x / PatchCX)), (int)m_TreePatchesX-1);
 	int z2 = minmax(0, roundo(ceilf(FrustumBox.p2.z / PatchCZ)), (int)m_TreePatchesZ-1);
 	int x, z;
-	uint ti;
-	float TreeHalfWidth, TreeHalfHeight; BOX TreeBox;
+	uint ti, TreeCount;
 	for (z = z1; z <= z2; z++)
 	{
 		for (x = x1; x <= x2; x++)
 		{
 			const PATCH &Patch = EnsurePatch(x, z);
-			for (ti = 0; ti < Patch.TreeDescs.size(); ti++)
+			TreeCount = Patch.TreeDescs.size();
+			if (TreeCount == 0)
+				continue;
+			if (!FrustumCulling)
+				InOut->insert(InOut->end(), Patch.TreeDescs.begin(), Patch.TreeDescs.end());
+			else
 			{
-				const TREE_DRAW_DESC &Tree = Patch.TreeDescs[ti];
-				if (!FrustumCulling)
-					InOut->push_back(Tree);
-				else
+				// Frustum Culling - wszystkie drzewa patcha na raz
+				m_TreeVisibilityMask.resize(VisibilityMaskSize(TreeCount));
+				if (BoxArrayToFrustum_Fast(&m_TreeVisibilityMask[0], Patch.TreeBoxes, Cam.GetMatrices().GetFrustumPlanes()) > 0)
 				{
-					TreeHalfWidth  = Tree.tree->GetDesc().HalfWidth;
-					TreeHalfHeight = Tree.tree->GetDesc().HalfHeight;
-					// Frustum Culling
-					TreeBox.p1.x = Tree.world._41 - TreeHalfWidth * Tree.scaling;
-					TreeBox.p1.y = Tree.world._42;
-					TreeBox.p1.z = Tree.world._43 - TreeHalfWidth * Tree.scaling;
-					TreeBox.p2.x = Tree.world._41 + TreeHalfWidth * Tree.scaling;
-					TreeBox.p2.y = Tree.world._42 + TreeHalfHeight * 2.0f * Tree.scaling;
-					TreeBox.p2.z = Tree.world._43 + TreeHalfWidth * Tree.scaling;
-					if (BoxToFrustum_Fast(TreeBox, Cam.GetMatrices().GetFrustumPlanes()))
-						InOut->push_back(Tree);
+					for (ti = 0; ti < TreeCount; ti++)
+					{
+						if (VisibilityMaskGet(&m_TreeVisibilityMask[0], ti))
+							InOut->push_back(Patch.TreeDescs[ti]);
+					}
 				}
 			}
 		}
@@ -3416,7 +3413,7 @@ void TerrainRenderer::LoadTreeDescFile(const string &TreeDescFileName)
 {
 	ERR_TRY;
 
-	FileStream fs(TreeDescFileName, FM_READ);
+	VfsFileStream fs(TreeDescFileName);
 	Tokenizer tok(&fs, 0);
 	tok.Next();
 
@@ -3638,8 +3635,9 @@ void TerrainRenderer::GeneratePatch(PATCH *P)
 	uint x, z;
 	TREE_DRAW_DESC desc;
 	uint1 TreeIndex;
-	float xf, zf;
+	float xf, zf, TreeHalfWidth, TreeHalfHeight;
 	MATRIX tm, rm, sm;
+	BOX TreeBox;
 	for (z = P->pz * TERRAIN_PATCH_SIZE; z < zc; z++)
 	{
 		for (x = P->px * TERRAIN_PATCH_SIZE; x < xc; x++)
@@ -3667,6 +3665,16 @@ void TerrainRenderer::GeneratePatch(PATCH *P)
 				Inverse(&desc.world_inv, desc.world);
 
 				P->TreeDescs.push_back(desc);
+
+				TreeHalfWidth  = desc.tree->GetDesc().HalfWidth;
+				TreeHalfHeight = desc.tree->GetDesc().HalfHeight;
+				TreeBox.p1.x = desc.world._41 - TreeHalfWidth * desc.scaling;
+				TreeBox.p1.y = desc.world._42;
+				TreeBox.p1.z = desc.world._43 - TreeHalfWidth * desc.scaling;
+				TreeBox.p2.x = desc.world._41 + TreeHalfWidth * desc.scaling;
+				TreeBox.p2.y = desc.world._42 + TreeHalfHeight * 2.0f * desc.scaling;
+				TreeBox.p2.z = desc.world._43 + TreeHalfWidth * desc.scaling;
+				P->TreeBoxes.Add(TreeBox);
 			}
 		}
 	}
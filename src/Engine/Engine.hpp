@@ -913,6 +913,8 @@ private:
 	struct PATCH
 	{
 		TREE_DRAW_DESC_VECTOR TreeDescs;
+		// Bounding boksy drzew z TreeDescs, pod tymi samymi indeksami
+		BOX_SOA TreeBoxes;
 		uint px, pz;
 	};
 
@@ -938,6 +940,8 @@ private:
 	std::vector<uint1> m_TreeDensityMap;
 	// Cache. Ostatnio uywane s na kocu.
 	std::vector< shared_ptr<PATCH> > m_PatchCache;
+	// Bufor roboczy na mask widocznoci drzew w patchu
+	std::vector<uint4> m_TreeVisibilityMask;
 
 	void LoadTreeDescFile(const string &TreeDescFileName);
 	void LoadTreeDensityMap(const string &FileName);
@@ -235,7 +235,7 @@ void Grass_pimpl::LoadGrassDesc(const string &DescFileName)
 {
 	ERR_TRY;
 
-	FileStream GrassDescFile(DescFileName, FM_READ);
+	VfsFileStream GrassDescFile(DescFileName);
 	Tokenizer tok(&GrassDescFile, 0);
 	tok.Next();
 
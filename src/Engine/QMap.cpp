@@ -122,17 +122,10 @@ void QMap_pimpl::LoadDrawTreeNode(Stream &F, QMap::DRAW_NODE *Node)
 		}
 	}
 
+	// Pola DRAW_FRAGMENT le w pliku w tej samej kolejnoci, po 4 bajty
 	uint4 FragmentCount;
 	F.ReadEx(&FragmentCount);
-	Node->Fragments.resize(FragmentCount);
-	for (uint fi = 0; fi < FragmentCount; fi++)
-	{
-		F.ReadEx(&Node->Fragments[fi].MaterialIndex);
-		F.ReadEx(&Node->Fragments[fi].IndexBegin);
-		F.ReadEx(&Node->Fragments[fi].IndexEnd);
-		F.ReadEx(&Node->Fragments[fi].VertexBegin);
-		F.ReadEx(&Node->Fragments[fi].VertexEnd);
-	}
+	F.ReadArray(&Node->Fragments, FragmentCount);
 }
 
 // Funkcja rekurencyjna
@@ -182,6 +175,7 @@ QMap::QMap(const string &Name, const string &Group, const string &FileName) :
 	pimpl(new QMap_pimpl)
 {
 	pimpl->FileName = FileName;
+	WatchFile(FileName);
 }
 
 QMap::~QMap()
@@ -274,7 +268,7 @@ void QMap::OnLoad()
 {
 	ERR_TRY;
 	{
-		common::FileStream F(pimpl->FileName, common::FM_READ);
+		common::VfsFileStream F(pimpl->FileName);
 
 		LOG(0x08, Format("QMap: \"#\" Loading from \"#\"") % GetName() % GetFileName());
 
@@ -298,27 +292,29 @@ void QMap::OnLoad()
 		pimpl->DrawIBOffset = F.GetPos();
 		F.Skip(pimpl->DrawIndexCount * sizeof(uint4));
 
+		// Dalej plik jest czytany ju tylko sekwencyjnie, do koca.
+		// Wtek w tle czyta kolejne bloki, kiedy ten buduje drzewa.
+		common::PrefetchStream P(&F);
+
 		// DrawTree
 		pimpl->DrawNodeCount = 0;
 		pimpl->DrawTree = pimpl->DrawTreeMemory.New();
-		pimpl->LoadDrawTreeNode(F, pimpl->DrawTree);
+		pimpl->LoadDrawTreeNode(P, pimpl->DrawTree);
 
 		// CollisionVB
 		uint4 CollisionVertexCount;
-		F.ReadEx(&CollisionVertexCount);
-		pimpl->CollisionVB.resize(CollisionVertexCount);
-		F.MustRead(&pimpl->CollisionVB[0], CollisionVertexCount * sizeof(VEC3));
+		P.ReadEx(&CollisionVertexCount);
+		P.ReadArray(&pimpl->CollisionVB, CollisionVertexCount);
 
 		// CollisionIB
 		uint4 CollisionIndexCount;
-		F.ReadEx(&CollisionIndexCount);
-		pimpl->CollisionIB.resize(CollisionIndexCount);
-		F.MustRead(&pimpl->CollisionIB[0], CollisionIndexCount * sizeof(uint4));
+		P.ReadEx(&CollisionIndexCount);
+		P.ReadArray(&pimpl->CollisionIB, CollisionIndexCount);
 
 		// CollisionTree
 		pimpl->CollisionNodeCount = 0;
 		pimpl->CollisionTree = pimpl->CollisionTreeMemory.New();
-		pimpl->LoadCollisionTreeNode(F, pimpl->CollisionTree);
+		pimpl->LoadCollisionTreeNode(P, pimpl->CollisionTree);
 	}
 	ERR_CATCH("Nie mona wczyta mapy z pliku \"" + pimpl->FileName + "\"");
 
@@ -343,7 +339,7 @@ void QMap::OnDeviceCreate()
 	HRESULT hr;
 	LOG(0x08, Format("QMap: \"#\" Loading mesh from \"#\"") % GetName() % GetFileName());
 
-	common::FileStream File(pimpl->FileName, common::FM_READ);
+	common::VfsFileStream File(pimpl->FileName);
 
 	// Wierzchoki
 
@@ -53,7 +53,7 @@ enum TERRAIN_EFFECT_PARAMS
 // Liczba przebiegw rozmywania form terenu
 const uint BLUE_PASSES = 2;
 
-const string CACHE_FILE_HEADER = "TFQ_TERRAIN_10";
+const string CACHE_FILE_HEADER = "TFQ_TERRAIN_11";
 
 
 //HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
@@ -113,7 +113,9 @@ struct PATCH
 	float MinY, MaxY;
 	// Tablica bdzie przechowywaa indeksy do tablicy Terrain_pimpl::m_FormDescData z formami terenu do uycia w tym patchu.
 	uint TerrainForms[TERRAIN_FORMS_PER_PATCH];
-	VERTEX Vertices[PATCH_VERTEX_COUNT];
+	// Tablica PATCH_VERTEX_COUNT wierzchokw.
+	// Wskazuje do Terrain_pimpl::m_PatchVertices albo prosto do pliku cache odwzorowanego w pamici.
+	const VERTEX *Vertices;
 };
 
 struct Terrain_pimpl
@@ -138,6 +140,15 @@ struct Terrain_pimpl
 	// Liczba patchw na X i na Z
 	uint m_PatchCX, m_PatchCZ;
 	std::vector<PATCH> m_Patches;
+	// Wierzchoki patchw wygenerowanych od nowa, po PATCH_VERTEX_COUNT na patch
+	std::vector<VERTEX> m_PatchVertices;
+	// Plik cache (luny albo z paczki), jeli patche zostay z niego wczytane
+	scoped_ptr<VfsFileStream> m_CacheMapping;
+	// Bounding boksy patchw w ukadzie SoA, do wsadowego testu widocznoci.
+	// Ma dugo m_PatchCX * m_PatchCZ.
+	BOX_SOA m_PatchBoxes;
+	// Bufor roboczy na mask widocznoci patchw
+	std::vector<uint4> m_VisibilityMask;
 	scoped_ptr<IDirect3DIndexBuffer9, ReleasePolicy> m_IB;
 	scoped_ptr<IDirect3DVertexBuffer9, ReleasePolicy> m_VB;
 	// Indeksy patchw wczytanych do VB, MAXUINT4 jeli aden
@@ -169,9 +180,18 @@ struct Terrain_pimpl
 	void LoadFormMap();
 	void CalcFormWeights(std::vector<uint1> *OutFormWeights);
 	void GeneratePatches();
+	// Liczy hash danych, z ktrych generowane s patche - klucz pliku cache.
+	// Heightmapa i mapa form musz ju by wczytane.
+	void CalcSourceHash(HASH128 *Out);
+	// Wypenia m_PatchBoxes na podstawie m_Patches
+	void CalcPatchBoxes();
 	// Wylicza normalne na podstawie heightmapy. Sam rozszerza podany wektor.
 	void CalcNormals(std::vector<VEC3> *OutNormals);
-	void GeneratePatch(PATCH *OutPatch, uint StartX, uint StartZ, const std::vector<VEC3> &Normals, const std::vector<uint1> &FormWeights);
+	// Wylicza normalne wierszy wierzchokw [z1, z2). Heights - wysokoci wszystkich wierzchokw.
+	// Wywoywana rwnolegle dla rnych wierszy.
+	void CalcNormalRows(uint z1, uint z2, const std::vector<float> &Heights, std::vector<VEC3> *OutNormals);
+	// OutVertices - tablica PATCH_VERTEX_COUNT wierzchokw do wypenienia
+	void GeneratePatch(PATCH *OutPatch, VERTEX *OutVertices, uint StartX, uint StartZ, const std::vector<VEC3> &Normals, const std::vector<uint1> &FormWeights);
 	void GenerateIndices();
 	void CreateVB();
 	// aduje w razie potrzeby patch o podanym indeksie do VB
@@ -183,15 +203,56 @@ struct Terrain_pimpl
 	void LoadFormDesc_ComplexItem(Tokenizer &Tok, FORM_DESC_ITEM_COMPLEX *OutItem);
 	void LoadFormDesc_Data(Tokenizer &Tok, FORM_DESC_DATA *OutData);
 	// Zapisuje wygenerowane ju patche terenu do pliku m_CacheFileName
-	void WritePatchesToCache();
+	void WritePatchesToCache(const HASH128 &SourceHash);
 	// Wczytuje patche z pliku m_CacheFileName do tablicy m_Patches.
 	// Tablica musi by ju rozszerzona do odpowiedniego rozmiaru.
-	void LoadPatchesFromCache();
+	// Jeli plik ma inn wersj lub powsta z innych danych rdowych, zwraca false.
+	bool LoadPatchesFromCache(const HASH128 &SourceHash);
 
 	bool RayCollision_Patch_Vertical(int px, int pz, const VEC3 &RayOrig, const VEC3 &RayDir, float *OutT, float MaxT);
 	bool RayCollision_Patch(uint px, uint pz, const VEC3 &RayOrig, const VEC3 &RayDir, float *OutT, float StartT, float MaxT);
 };
 
+// Funktory dla ParallelFor
+
+class TerrainNormalRowsFunc
+{
+private:
+	Terrain_pimpl *m_Terrain;
+	const std::vector<float> &m_Heights;
+	std::vector<VEC3> *m_OutNormals;
+
+public:
+	TerrainNormalRowsFunc(Terrain_pimpl *Terrain, const std::vector<float> &Heights, std::vector<VEC3> *OutNormals) : m_Terrain(Terrain), m_Heights(Heights), m_OutNormals(OutNormals) { }
+
+	void operator () (size_t z1, size_t z2) const
+	{
+		m_Terrain->CalcNormalRows((uint)z1, (uint)z2, m_Heights, m_OutNormals);
+	}
+};
+
+class TerrainGeneratePatchesFunc
+{
+private:
+	Terrain_pimpl *m_Terrain;
+	const std::vector<VEC3> &m_Normals;
+	const std::vector<uint1> &m_FormWeights;
+
+public:
+	TerrainGeneratePatchesFunc(Terrain_pimpl *Terrain, const std::vector<VEC3> &Normals, const std::vector<uint1> &FormWeights) : m_Terrain(Terrain), m_Normals(Normals), m_FormWeights(FormWeights) { }
+
+	// Kady patch pisze tylko do swojej struktury i swojego kawaka m_PatchVertices
+	void operator () (size_t pi1, size_t pi2) const
+	{
+		for (size_t pi = pi1; pi < pi2; pi++)
+		{
+			uint px = (uint)pi % m_Terrain->m_PatchCX;
+			uint pz = (uint)pi / m_Terrain->m_PatchCX;
+			m_Terrain->GeneratePatch(&m_Terrain->m_Patches[pi], &m_Terrain->m_PatchVertices[pi * PATCH_VERTEX_COUNT], px * PATCH_SIZE, pz * PATCH_SIZE, m_Normals, m_FormWeights);
+		}
+	}
+};
+
 uint1 Terrain_pimpl::GetHeight(uint x, uint z)
 {
 	if (x > m_CX) return 0;
@@ -219,7 +280,7 @@ void Terrain_pimpl::LoadHeightmap_Raw(uint1 *OutHeightmap)
 {
 	LOG(0x08, Format("Terrain: Loading raw heightmap from \"#\".") % m_HeightmapFileName);
 
-	FileStream File(m_HeightmapFileName, FM_READ);
+	VfsFileStream File(m_HeightmapFileName);
 	File.MustRead(OutHeightmap, (m_CX+1) * (m_CZ+1) * sizeof(uint1));
 }
 
@@ -449,23 +510,13 @@ void Terrain_pimpl::GeneratePatches()
 	uint PatchCount = m_PatchCX * m_PatchCZ;
 	m_Patches.resize(PatchCount);
 
-	// Jeli plik cache istnieje i jest aktualny, wczytaj go
-	DATETIME HeightmapFileTime;
-	DATETIME FormDescFileTime;
-	DATETIME FormMapFileTime;
-	DATETIME CacheFileTime;
-	if (GetFileItemInfo(m_HeightmapFileName, NULL, NULL, &HeightmapFileTime, NULL, NULL) &&
-		GetFileItemInfo(m_FormDescFileName, NULL, NULL, &FormDescFileTime, NULL, NULL) &&
-		GetFileItemInfo(m_FormMapFileName, NULL, NULL, &FormMapFileTime, NULL, NULL) &&
-		GetFileItemInfo(m_CacheFileName, NULL, NULL, &CacheFileTime, NULL, NULL) &&
-		HeightmapFileTime < CacheFileTime &&
-		FormDescFileTime < CacheFileTime &&
-		FormMapFileTime < CacheFileTime)
-	{
-		LoadPatchesFromCache();
-	}
+	// Jeli plik cache istnieje i powsta z tych samych danych, wczytaj go.
+	// O aktualnoci decyduje zawarto, nie daty modyfikacji plikw.
+	HASH128 SourceHash;
+	CalcSourceHash(&SourceHash);
+	bool FromCache = VfsFileExists(m_CacheFileName) && LoadPatchesFromCache(SourceHash);
 	// Jeli plik cache nie istnia lub nie by aktualny, wygeneruj patche od nowa
-	else
+	if (!FromCache)
 	{
 		LOG(0x08, "Terrain: Generating patches...");
 
@@ -478,29 +529,68 @@ void Terrain_pimpl::GeneratePatches()
 		std::vector<uint1> FormWeights;
 		CalcFormWeights(&FormWeights);
 
-		// Wygeneruj poszczeglne patche
-		uint x, z, pz, px;
-		for (z = 0, pz = 0; z < m_CZ; z += PATCH_SIZE, pz++)
-		{
-			for (x = 0, px = 0; x < m_CX; x += PATCH_SIZE, px++)
-			{
-				GeneratePatch(&m_Patches[pz*m_PatchCX+px], x, z, Normals, FormWeights);
-			}
-		}
+		// Wygeneruj poszczeglne patche - niezalenie od siebie, rwnolegle
+		m_PatchVertices.resize(PatchCount * PATCH_VERTEX_COUNT);
+		ParallelFor(0, PatchCount, 1, TerrainGeneratePatchesFunc(this, Normals, FormWeights));
 
 		// Zapisz plik cache
-		WritePatchesToCache();
+		WritePatchesToCache(SourceHash);
 	}
 
+	CalcPatchBoxes();
+
 	ERR_CATCH("Nie mona wygenerowa fragmentw mapy.");
 }
 
+void Terrain_pimpl::CalcSourceHash(HASH128 *Out)
+{
+	FastHash_Calc Hash;
+
+	// Parametry
+	Hash.WriteEx(m_CX);
+	Hash.WriteEx(m_CZ);
+	Hash.WriteEx(m_VertexDistance);
+	Hash.WriteEx(m_MinY);
+	Hash.WriteEx(m_MaxY);
+
+	// Wczytane ju dane
+	Hash.Write(&m_Heightmap[0], m_Heightmap.size());
+	Hash.Write(&m_FormMap[0], m_FormMap.size());
+
+	// Opis form terenu jest sparsowany do struktur, wic hashowany jest sam plik
+	VfsFileStream File(m_FormDescFileName);
+	Hash.Write(File.GetData(), File.GetSize());
+
+	Hash.GetResult128(Out);
+}
+
+void Terrain_pimpl::CalcPatchBoxes()
+{
+	m_PatchBoxes.Resize(m_Patches.size());
+	m_VisibilityMask.resize(VisibilityMaskSize(m_PatchCX));
+
+	BOX Box;
+	uint x, z, pi;
+	for (z = 0, pi = 0; z < m_PatchCZ; z++)
+	{
+		for (x = 0; x < m_PatchCX; x++, pi++)
+		{
+			Box.p1.x = x * PATCH_SIZE * m_VertexDistance;
+			Box.p1.z = z * PATCH_SIZE * m_VertexDistance;
+			Box.p1.y = m_Patches[pi].MinY;
+			Box.p2.x = (x+1) * PATCH_SIZE * m_VertexDistance;
+			Box.p2.z = (z+1) * PATCH_SIZE * m_VertexDistance;
+			Box.p2.y = m_Patches[pi].MaxY;
+			m_PatchBoxes.Set(pi, Box);
+		}
+	}
+}
+
 void Terrain_pimpl::CalcNormals(std::vector<VEC3> *OutNormals)
 {
 	uint cx_plus_1 = m_CX + 1;
 	uint VertexCount = cx_plus_1 * (m_CZ+1);
 	uint x, z, i;
-	VEC3 v, v1, v2, v2n, vn, Pos;
 
 	// Wylicz wysokoci - to przyspieszy obliczenia
 	std::vector<float> Heights;
@@ -513,9 +603,18 @@ void Terrain_pimpl::CalcNormals(std::vector<VEC3> *OutNormals)
 		}
 	}
 
-	// Wylicz normalne
+	// Wylicz normalne - kady wiersz niezalenie, rwnolegle
 	OutNormals->resize(VertexCount);
-	for (z = 0, i = 0; z <= m_CZ; z++)
+	ParallelFor(0, m_CZ+1, 8, TerrainNormalRowsFunc(this, Heights, OutNormals));
+}
+
+void Terrain_pimpl::CalcNormalRows(uint z1, uint z2, const std::vector<float> &Heights, std::vector<VEC3> *OutNormals)
+{
+	uint cx_plus_1 = m_CX + 1;
+	uint x, z, i;
+	VEC3 v, v1, v2, v2n, vn, Pos;
+
+	for (z = z1, i = z1*cx_plus_1; z < z2; z++)
 	{
 		for (x = 0; x <= m_CX; x++)
 		{
@@ -606,7 +705,7 @@ void Terrain_pimpl::CalcNormals(std::vector<VEC3> *OutNormals)
 	}
 }
 
-void Terrain_pimpl::GeneratePatch(PATCH *OutPatch, uint StartX, uint StartZ, const std::vector<VEC3> &Normals, const std::vector<uint1> &FormWeights)
+void Terrain_pimpl::GeneratePatch(PATCH *OutPatch, VERTEX *OutVertices, uint StartX, uint StartZ, const std::vector<VEC3> &Normals, const std::vector<uint1> &FormWeights)
 {
 	uint FormCount = m_FormDescData.size();
 	uint VertexCX = m_CX + 1;
@@ -683,7 +782,8 @@ void Terrain_pimpl::GeneratePatch(PATCH *OutPatch, uint StartX, uint StartZ, con
 	}
 
 	// Wierzchoki zwyke
-	VERTEX *Vertex = &OutPatch->Vertices[0];
+	OutPatch->Vertices = OutVertices;
+	VERTEX *Vertex = &OutVertices[0];
 	VEC3 v, v1, v2, v2n, vn;
 	float Height;
 	OutPatch->MinY = OutPatch->MaxY = GetHeight_Float(x1, z1);
@@ -695,15 +795,15 @@ void Terrain_pimpl::GeneratePatch(PATCH *OutPatch, uint StartX, uint StartZ, con
 			// - Poza zakresem i na X i na Z
 			if (x > m_CX && z > m_CZ)
 				// Przepisz ostatni wierzchoek, z rogu, z koca
-				*Vertex = OutPatch->Vertices[(m_CZ-z1)*(PATCH_SIZE+1) + (m_CX-x1)];
+				*Vertex = OutVertices[(m_CZ-z1)*(PATCH_SIZE+1) + (m_CX-x1)];
 			// - Poza zakresem tylko na X
 			else if (x > m_CX)
 				// Przepisz ostatni normalny wierzhoek z tego wiersza
-				*Vertex = OutPatch->Vertices[(z-z1)*(PATCH_SIZE+1) + (m_CX-x1)];
+				*Vertex = OutVertices[(z-z1)*(PATCH_SIZE+1) + (m_CX-x1)];
 			// - Poza zakresem tylko na Z
 			else if (z > m_CZ)
 				// Przepisz ostatni normalny wierzchoek z tej kolumny
-				*Vertex = OutPatch->Vertices[(m_CZ-z1)*(PATCH_SIZE+1) + (x-x1)];
+				*Vertex = OutVertices[(m_CZ-z1)*(PATCH_SIZE+1) + (x-x1)];
 			// Wierzchoek normalny, nie jest poza zakresem
 			else
 			{
@@ -742,7 +842,7 @@ void Terrain_pimpl::GeneratePatch(PATCH *OutPatch, uint StartX, uint StartZ, con
 	// - Lewy
 	for (z = z1, i = 0; z < z2; z++, i++)
 	{
-		*Vertex = OutPatch->Vertices[i * (PATCH_SIZE+1)];
+		*Vertex = OutVertices[i * (PATCH_SIZE+1)];
 		// Skirt jest tylko jeli to nie brzeg caej heightmapy, w przeciwnym wypadku jest degenerowany.
 		if (x1 > 0)
 			Vertex->Pos.y = m_MinY;
@@ -751,7 +851,7 @@ void Terrain_pimpl::GeneratePatch(PATCH *OutPatch, uint StartX, uint StartZ, con
 	// - Prawy
 	for (z = z1, i = 0; z < z2; z++, i++)
 	{
-		*Vertex = OutPatch->Vertices[i * (PATCH_SIZE+1) + PATCH_SIZE];
+		*Vertex = OutVertices[i * (PATCH_SIZE+1) + PATCH_SIZE];
 		// Skirt jest tylko jeli to nie brzeg caej heightmapy, w przeciwnym wypadku jest degenerowany.
 		if (x2 < m_CX)
 			Vertex->Pos.y = m_MinY;
@@ -760,7 +860,7 @@ void Terrain_pimpl::GeneratePatch(PATCH *OutPatch, uint StartX, uint StartZ, con
 	// - Bliski
 	for (x = x1, i = 0; x < x2; x++, i++)
 	{
-		*Vertex = OutPatch->Vertices[i];
+		*Vertex = OutVertices[i];
 		// Skirt jest tylko jeli to nie brzeg caej heightmapy, w przeciwnym wypadku jest degenerowany.
 		if (z1 > 0)
 			Vertex->Pos.y = m_MinY;
@@ -770,7 +870,7 @@ void Terrain_pimpl::GeneratePatch(PATCH *OutPatch, uint StartX, uint StartZ, con
 	for (x = x1, i = PATCH_SIZE * (PATCH_SIZE+1); x < x2; x++, i++)
 	{
 		// Skirt jest tylko jeli to nie brzeg caej heightmapy, w przeciwnym wypadku jest degenerowany.
-		*Vertex = OutPatch->Vertices[i];
+		*Vertex = OutVertices[i];
 		if (z2 < m_CZ)
 			Vertex->Pos.y = m_MinY;
 		Vertex++;
@@ -912,7 +1012,7 @@ uint Terrain_pimpl::LoadPatch(uint PatchIndex)
 	// Nadpisz go nowym patchem
 	{
 		VertexBufferLock vb_lock(m_VB.get(), 0, Found_i * PATCH_VERTEX_COUNT * sizeof(VERTEX), PATCH_VERTEX_COUNT * sizeof(VERTEX));
-		CopyMem(vb_lock.GetData(), &m_Patches[PatchIndex].Vertices[0], PATCH_VERTEX_COUNT * sizeof(VERTEX));
+		CopyMem(vb_lock.GetData(), m_Patches[PatchIndex].Vertices, PATCH_VERTEX_COUNT * sizeof(VERTEX));
 	}
 
 	PatchesInVb[Found_i] = PatchIndex;
@@ -926,7 +1026,7 @@ void Terrain_pimpl::LoadFormDesc()
 
 	LOG(0x08, Format("Terrain: Loading form description from \"#\".") % m_FormDescFileName);
 
-	FileStream File(m_FormDescFileName, FM_READ);
+	VfsFileStream File(m_FormDescFileName);
 	Tokenizer Tok(&File, 0);
 	Tok.Next();
 
@@ -1070,7 +1170,7 @@ void Terrain_pimpl::LoadFormDesc_Data(Tokenizer &Tok, FORM_DESC_DATA *OutData)
 	Tok.Next();
 }
 
-void Terrain_pimpl::WritePatchesToCache()
+void Terrain_pimpl::WritePatchesToCache(const HASH128 &SourceHash)
 {
 	ERR_TRY;
 
@@ -1078,39 +1178,56 @@ void Terrain_pimpl::WritePatchesToCache()
 
 	// Nagwek
 	F.WriteStringF(CACHE_FILE_HEADER);
+	F.WriteEx(SourceHash);
 
-	// Patche
+	// Patche - wszystkie kawaki jednym WriteV, czyli kilkoma wywoaniami systemowymi
+	std::vector<STREAM_WRITE_BUF> Bufs(m_Patches.size() * 4);
 	for (uint pi = 0; pi < m_Patches.size(); pi++)
 	{
 		const PATCH &Patch = m_Patches[pi];
+		STREAM_WRITE_BUF *PatchBufs = &Bufs[pi * 4];
 
 		// Zakres wysokoci
-		F.WriteEx(Patch.MinY);
-		F.WriteEx(Patch.MaxY);
+		PatchBufs[0].Data = &Patch.MinY; PatchBufs[0].Size = sizeof(Patch.MinY);
+		PatchBufs[1].Data = &Patch.MaxY; PatchBufs[1].Size = sizeof(Patch.MaxY);
 
 		// Formy terenu
-		F.Write(Patch.TerrainForms, TERRAIN_FORMS_PER_PATCH * sizeof(uint));
+		PatchBufs[2].Data = Patch.TerrainForms; PatchBufs[2].Size = TERRAIN_FORMS_PER_PATCH * sizeof(uint);
 		
 		// Wierzchoki
-		F.Write(Patch.Vertices, PATCH_VERTEX_COUNT * sizeof(VERTEX));
+		PatchBufs[3].Data = Patch.Vertices; PatchBufs[3].Size = PATCH_VERTEX_COUNT * sizeof(VERTEX);
 	}
+	if (!Bufs.empty())
+		F.WriteV(&Bufs[0], Bufs.size());
 
 	ERR_CATCH(Format("Nie mona zapisa pliku tymczasowego terenu \"#\".") % m_CacheFileName);
 }
 
-void Terrain_pimpl::LoadPatchesFromCache()
+bool Terrain_pimpl::LoadPatchesFromCache(const HASH128 &SourceHash)
 {
 	ERR_TRY;
 
 	LOG(0x08, Format("Terrain: Loading patches from cache \"#\".") % m_CacheFileName);
 
-	FileStream F(m_CacheFileName, FM_READ);
+	// Wierzchoki nie s kopiowane - patche wskazuj prosto do odwzorowanego pliku
+	m_CacheMapping.reset(new VfsFileStream(m_CacheFileName));
+	VfsFileStream &F = *m_CacheMapping.get();
 
 	// Nagwek
 	string Header;
-	F.ReadStringF(&Header, CACHE_FILE_HEADER.length());
-	if (Header != CACHE_FILE_HEADER)
-		throw Error("Bdny nagwek lub wersja pliku.");
+	HASH128 FileSourceHash;
+	if (F.GetSize() >= CACHE_FILE_HEADER.length() + sizeof(HASH128))
+	{
+		F.ReadStringF(&Header, CACHE_FILE_HEADER.length());
+		F.ReadEx(&FileSourceHash);
+	}
+	if (Header != CACHE_FILE_HEADER || FileSourceHash != SourceHash)
+	{
+		LOG(0x08, "Terrain: Cache is out of date.");
+		// Zwolnij plik, eby mona go byo nadpisa
+		m_CacheMapping.reset();
+		return false;
+	}
 
 	// Patche
 	for (uint pi = 0; pi < m_Patches.size(); pi++)
@@ -1125,9 +1242,11 @@ void Terrain_pimpl::LoadPatchesFromCache()
 		F.MustRead(Patch.TerrainForms, TERRAIN_FORMS_PER_PATCH * sizeof(uint));
 
 		// Wierzchoki
-		F.MustRead(Patch.Vertices, PATCH_VERTEX_COUNT * sizeof(VERTEX));
+		Patch.Vertices = F.MustReadView<VERTEX>(PATCH_VERTEX_COUNT);
 	}
 
+	return true;
+
 	ERR_CATCH(Format("Nie mona wczyta pliku tymczasowego terenu \"#\".") % m_CacheFileName);
 }
 
@@ -1553,15 +1672,7 @@ float Terrain::ValueToHeight(uint1 Value)
 
 void Terrain::CalcPatchBoundingBox(BOX *OutBox, uint PatchIndex)
 {
-	uint x = PatchIndex % pimpl->m_PatchCX;
-	uint z = PatchIndex / pimpl->m_PatchCX;
-
-	OutBox->p1.x = x * PATCH_SIZE * pimpl->m_VertexDistance;
-	OutBox->p1.z = z * PATCH_SIZE * pimpl->m_VertexDistance;
-	OutBox->p1.y = pimpl->m_Patches[PatchIndex].MinY;
-	OutBox->p2.x = (x+1) * PATCH_SIZE * pimpl->m_VertexDistance;
-	OutBox->p2.z = (z+1) * PATCH_SIZE * pimpl->m_VertexDistance;
-	OutBox->p2.y = pimpl->m_Patches[PatchIndex].MaxY;
+	pimpl->m_PatchBoxes.Get(OutBox, PatchIndex);
 }
 
 void Terrain::GetPatchFormTextureNames(uint PatchIndex, string OutTextureNames[TERRAIN_FORMS_PER_PATCH])
@@ -1588,16 +1699,25 @@ void Terrain::CalcVisiblePatches(std::vector<uint> *OutPatchIndices, const FRUST
 	int z1 = minmax(0, roundo(floorf(FrustumBox.p1.z / PatchCZ)), (int)pimpl->m_PatchCZ-1);
 	int x2 = minmax(0, roundo(ceilf(FrustumBox.p2.x / PatchCX)), (int)pimpl->m_PatchCX-1);
 	int z2 = minmax(0, roundo(ceilf(FrustumBox.p2.z / PatchCZ)), (int)pimpl->m_PatchCZ-1);
-	int x, z, pi;
-	BOX PatchBox;
+	// Kady wiersz patchw to cigy zakres w m_PatchBoxes - testowany wsadowo
+	const BOX_SOA &Boxes = pimpl->m_PatchBoxes;
+	uint4 *Mask = &pimpl->m_VisibilityMask[0];
+	uint RowCount = (uint)(x2 - x1 + 1);
+	int z;
+	uint i, pi;
 	for (z = z1; z <= z2; z++)
 	{
-		for (x = x1; x <= x2; x++)
+		pi = z * pimpl->m_PatchCX + x1;
+		if (BoxArrayToFrustum_Fast(Mask,
+			&Boxes.MinX[pi], &Boxes.MinY[pi], &Boxes.MinZ[pi],
+			&Boxes.MaxX[pi], &Boxes.MaxY[pi], &Boxes.MaxZ[pi],
+			RowCount, FrustumPlanes) > 0)
 		{
-			pi = z * pimpl->m_PatchCX + x;
-			CalcPatchBoundingBox(&PatchBox, pi);
-			if (BoxToFrustum_Fast(PatchBox, FrustumPlanes))
-				OutPatchIndices->push_back(pi);
+			for (i = 0; i < RowCount; i++)
+			{
+				if (VisibilityMaskGet(Mask, i))
+					OutPatchIndices->push_back(pi + i);
+			}
 		}
 	}
 }
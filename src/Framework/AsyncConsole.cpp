@@ -5,7 +5,6 @@
  * License: GNU GPL
  */
 #include "..\Framework\pch.hpp"
-#include <queue>
 #include "AsyncConsole.hpp"
 
 
@@ -19,11 +18,12 @@ public:
 	AsyncConsole_pimpl();
 
 	static const DWORD BUFFER_SIZE = 1024;
+	// Pojemno kolejki polece w bajtach
+	static const size_t QUEUE_SIZE = 16 * 1024;
 
 	HANDLE m_HandleIn;
 	HANDLE m_HandleOut;
 	CRITICAL_SECTION m_CS;
-	CRITICAL_SECTION m_ReadCS;
 	// Niesygnalizowany = kolejka pusta
 	// Sygnalizowany = kolejka niepusta
 	HANDLE m_Event;
@@ -31,10 +31,14 @@ public:
 	WORD m_InputColor;
 	WORD m_OutputColor;
 	std::vector<char> m_Buffer;
-	std::queue<string> m_Queue;
+	// Kolejka polece - pisze tylko wtek czytajcy konsol, czyta jeden wtek uytkownika.
+	// Kade polecenie jest zapisane przez WriteString2.
+	scoped_ptr<SpscRingBuffer> m_Queue;
 
 	static DWORD WINAPI ReadThreadProc_s(void *This);
 	DWORD ReadThreadProc();
+	// Pobiera z kolejki jedno polecenie, czekajc na nie w razie potrzeby
+	void PopInput(string *s);
 };
 
 DWORD WINAPI AsyncConsole_pimpl::ReadThreadProc_s(void *This)
@@ -51,19 +55,29 @@ DWORD AsyncConsole_pimpl::ReadThreadProc()
 	{
 		ReadConsole(m_HandleIn, &m_Buffer[0], BUFFER_SIZE, &CharactersRead, 0);
 
-		EnterCriticalSection(&m_ReadCS);
 		s1.assign(&m_Buffer[0], CharactersRead-2); // -2, bo bez koca wiersza
 		Charset_Convert(&s2, s1, CHARSET_IBM, CHARSET_WINDOWS);
-		m_Queue.push(s2);
+		// Jeli kolejka jest pena, czeka a kto odbierze polecenia
+		m_Queue->WriteString2(s2);
 		SetEvent(m_Event);
 		s1.clear();
 		s2.clear();
-		LeaveCriticalSection(&m_ReadCS);
 	}
 
 	return 0;
 }
 
+void AsyncConsole_pimpl::PopInput(string *s)
+{
+	m_Queue->ReadString2(s);
+
+	// Najpierw Reset, potem sprawdzenie - jeli w midzyczasie wtek czytajcy
+	// dopisa polecenie, zdarzenie zostanie ustawione z powrotem.
+	ResetEvent(m_Event);
+	if (!m_Queue->IsEmpty())
+		SetEvent(m_Event);
+}
+
 AsyncConsole_pimpl::AsyncConsole_pimpl() :
 	m_HandleIn(0),
 	m_HandleOut(0),
@@ -76,6 +90,7 @@ AsyncConsole::AsyncConsole() :
 	pimpl(new AsyncConsole_pimpl())
 {
 	pimpl->m_Buffer.resize(pimpl->BUFFER_SIZE+1);
+	pimpl->m_Queue.reset(new SpscRingBuffer(pimpl->QUEUE_SIZE, true));
 
 	AllocConsole();
 
@@ -83,7 +98,6 @@ AsyncConsole::AsyncConsole() :
 	pimpl->m_HandleOut = GetStdHandle(STD_OUTPUT_HANDLE);
 
 	InitializeCriticalSection(&pimpl->m_CS);
-	InitializeCriticalSection(&pimpl->m_ReadCS);
 	pimpl->m_Event = CreateEvent(0, TRUE, FALSE, 0);
 
 	SetInputColor(FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE);
@@ -96,7 +110,6 @@ AsyncConsole::~AsyncConsole()
 {
 	TerminateThread(pimpl->m_ThreadHandle, 0);
 	CloseHandle(pimpl->m_Event);
-	DeleteCriticalSection(&pimpl->m_ReadCS);
 	DeleteCriticalSection(&pimpl->m_CS);
 	FreeConsole();
 }
@@ -165,42 +178,23 @@ void AsyncConsole::Writeln(const string &s)
 
 bool AsyncConsole::InputQueueEmpty()
 {
-	EnterCriticalSection(&pimpl->m_ReadCS);
-	bool R = pimpl->m_Queue.empty();
-	LeaveCriticalSection(&pimpl->m_ReadCS);
-	return R;
+	return pimpl->m_Queue->IsEmpty();
 }
 
 bool AsyncConsole::GetInput(string *s)
 {
-	EnterCriticalSection(&pimpl->m_ReadCS);
-	bool R = pimpl->m_Queue.empty();
-	if (!R)
-	{
-		*s = pimpl->m_Queue.front();
-		pimpl->m_Queue.pop();
-		if (pimpl->m_Queue.empty())
-			ResetEvent(pimpl->m_Event);
-	}
-	LeaveCriticalSection(&pimpl->m_ReadCS);
-
-	return !R;
+	if (pimpl->m_Queue->IsEmpty())
+		return false;
+	// Dugo i tre s dopisywane osobno - jeli wida ju dugo, reszta
+	// zaraz bdzie, wic ewentualne czekanie w PopInput jest krtkie.
+	pimpl->PopInput(s);
+	return true;
 }
 
 void AsyncConsole::WaitForInput(string *s)
 {
-	WaitForSingleObject(pimpl->m_Event, INFINITE);
-
-	EnterCriticalSection(&pimpl->m_ReadCS);
-	assert(!pimpl->m_Queue.empty());
-	*s = pimpl->m_Queue.front();
-	pimpl->m_Queue.pop();
-	if (pimpl->m_Queue.empty())
-		ResetEvent(pimpl->m_Event);
-	LeaveCriticalSection(&pimpl->m_ReadCS);
-
-//	WaitForSingleObject(pimpl->m_Event, INFINITE);
-//	assert(GetInput(s));
+	// Czekanie odbywa si w SpscRingBuffer
+	pimpl->PopInput(s);
 }
 
 HANDLE AsyncConsole::GetWaitEvent()
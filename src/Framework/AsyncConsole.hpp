@@ -42,6 +42,9 @@ public:
 	// Zapisuje linijk tekstu na wyjcie konsoli
 	void Writeln(const string &s);
 
+	// ======== Wejcie ========
+	// Polecenia odbiera tylko z jednego wtku (kolejka to SpscRingBuffer).
+
 	// Zwraca true jeli kolejka polece jest pusta
 	bool InputQueueEmpty();
 	// Zwraca true i pierwsze polecenie z kolejki, jeli nie jest pusta
@@ -197,10 +197,11 @@ MemoryTexture::MemoryTexture(const string &FileName)
 {
 	ERR_TRY;
 
+	VfsFileStream File(FileName);
 	IDirect3DTexture9 *TexturePtr;
-	HRESULT hr = D3DXCreateTextureFromFileEx(
+	HRESULT hr = D3DXCreateTextureFromFileInMemoryEx(
 		frame::Dev, // Device
-		FileName.c_str(), // SrcFile
+		File.GetData(), File.GetSize(), // SrcData, SrcDataSize
 		D3DX_DEFAULT_NONPOW2, D3DX_DEFAULT_NONPOW2, // Width, Height
 		D3DX_FROM_FILE, // MipLevels
 		0, // Usage
@@ -213,7 +214,7 @@ MemoryTexture::MemoryTexture(const string &FileName)
 		NULL, // Palette
 		&TexturePtr); // Texture
 	if (FAILED(hr))
-		throw DirectXError(hr, "D3DXCreateTextureFromFileEx", __FILE__, __LINE__);
+		throw DirectXError(hr, "D3DXCreateTextureFromFileInMemoryEx", __FILE__, __LINE__);
 	m_Texture.reset(TexturePtr);
 
 	D3DSURFACE_DESC Desc; m_Texture->GetLevelDesc(0, &Desc);
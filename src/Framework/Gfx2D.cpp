@@ -546,8 +546,9 @@ void SpriteRepository::CreateSpritesFromFile(const string &FileName)
 {
 	ERR_TRY;
 
-	FileStream file(FileName, FM_READ);
-	Tokenizer t(&file, 0);
+	string Doc;
+	VfsLoadStringFromFile(FileName, &Doc);
+	Tokenizer t(&Doc, 0);
 	t.Next();
 
 	string Name;
@@ -17,11 +17,53 @@ namespace res
 //HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
 // Klasa Multishader
 
+// Nagwek pliku z cache efektu. Po nim jest klucz (uint8) i skompilowany efekt.
+const string CACHE_FILE_HEADER = "TFQFXC10";
+
+// Znajduje w kodzie nazwy plikw z dyrektyw #include "plik" i #include <plik>
+// Nie interpretuje #if ani komentarzy - lepiej znale za duo ni za mao.
+static void FindIncludes(STRING_VECTOR *Out, const char *Code, size_t Length)
+{
+	size_t i = 0;
+	while (i < Length)
+	{
+		while (i < Length && (Code[i] == ' ' || Code[i] == '\t'))
+			i++;
+		if (i < Length && Code[i] == '#')
+		{
+			i++;
+			while (i < Length && (Code[i] == ' ' || Code[i] == '\t'))
+				i++;
+			if (Length - i >= 7 && strncmp(Code + i, "include", 7) == 0)
+			{
+				i += 7;
+				while (i < Length && (Code[i] == ' ' || Code[i] == '\t'))
+					i++;
+				if (i < Length && (Code[i] == '"' || Code[i] == '<'))
+				{
+					char EndCh = (Code[i] == '"' ? '"' : '>');
+					size_t NameBegin = ++i;
+					while (i < Length && Code[i] != EndCh && Code[i] != '\n')
+						i++;
+					if (i < Length && Code[i] == EndCh)
+						Out->push_back(string(Code + NameBegin, i - NameBegin));
+				}
+			}
+		}
+		// Nastpna linia
+		while (i < Length && Code[i] != '\n')
+			i++;
+		i++;
+	}
+}
+
 class Multishader_pimpl
 {
 public:
 	// Hash => Dane wczytanego efektu
 	typedef std::unordered_map<uint4, Multishader::SHADER_INFO> SHADER_MAP;
+	// Nazwa z dyrektywy #include => Tre pliku
+	typedef std::map<string, string> INCLUDE_MAP;
 
 	string m_SourceFileName;
 	string m_CacheFileNameMask;
@@ -35,11 +77,45 @@ public:
 	// Wczytany do pamici plik rdowy MainShader.fx lub NULL jeli nie wczytany
 	// Jest wczytywany przy pierwszym uyciu.
 	scoped_ptr<MemoryStream> m_ShaderSource;
+	// Pliki doczane przez rdo (take porednio), wczytywane razem z nim.
+	// Nazwy s wzgldne wobec katalogu pliku rdowego. Tych, ktrych nie ma, tu nie ma.
+	INCLUDE_MAP m_Includes;
+	// Hash zawartoci m_ShaderSource i m_Includes, liczony razem z ich wczytaniem
+	uint8 m_SourceHash;
 
 	// Zwalanie wszystkie wczytane efekty
 	void FreeEffects();
-	// Wczytuje do pamici m_ShaderSource, jeli jeszcze nie wczytane
+	// Wczytuje do pamici m_ShaderSource i m_Includes, jeli jeszcze nie wczytane
 	void EnsureShaderSource();
+	void GetIncludeFileName(string *Out, const string &IncludeName);
+
+private:
+	// Wczytuje do m_Includes pliki doczane przez podany kod, rekurencyjnie
+	void LoadIncludes(const char *Code, size_t Length);
+};
+
+// Podaje kompilatorowi efektw pliki doczane z pamici - te same, ktre weszy do hasha
+class MultishaderInclude : public ID3DXInclude
+{
+private:
+	const Multishader_pimpl::INCLUDE_MAP &m_Includes;
+
+public:
+	MultishaderInclude(const Multishader_pimpl::INCLUDE_MAP &Includes) : m_Includes(Includes) { }
+
+	STDMETHOD(Open)(D3DXINCLUDE_TYPE IncludeType, LPCSTR pFileName, LPCVOID pParentData, LPCVOID *ppData, UINT *pBytes)
+	{
+		Multishader_pimpl::INCLUDE_MAP::const_iterator it = m_Includes.find(pFileName);
+		if (it == m_Includes.end())
+			return E_FAIL;
+		*ppData = it->second.data();
+		*pBytes = (UINT)it->second.size();
+		return S_OK;
+	}
+	STDMETHOD(Close)(LPCVOID pData)
+	{
+		return S_OK;
+	}
 };
 
 
@@ -58,14 +134,55 @@ void Multishader_pimpl::EnsureShaderSource()
 	{
 		LOG(LOG_RESMNGR, "Multishader: Loading shader source: " + m_SourceFileName);
 
-		FileStream File(m_SourceFileName, FM_READ, false);
+		VfsFileStream File(m_SourceFileName);
 		m_ShaderSource.reset(new MemoryStream(File.GetSize()));
 		m_ShaderSource->CopyFromToEnd(&File);
+
+		m_Includes.clear();
+		LoadIncludes(m_ShaderSource->Data(), m_ShaderSource->GetSize());
+
+		FastHash_Calc Hash;
+		Hash.Write(m_ShaderSource->Data(), m_ShaderSource->GetSize());
+		for (INCLUDE_MAP::iterator it = m_Includes.begin(); it != m_Includes.end(); ++it)
+		{
+			Hash.WriteString4(it->first);
+			Hash.WriteString4(it->second);
+		}
+		m_SourceHash = Hash.GetResult();
 	}
 
 	ERR_CATCH_FUNC;
 }
 
+void Multishader_pimpl::GetIncludeFileName(string *Out, const string &IncludeName)
+{
+	string Dir;
+	ExtractFilePath(&Dir, m_SourceFileName);
+	NormalizePath(Out, Dir + IncludeName);
+}
+
+void Multishader_pimpl::LoadIncludes(const char *Code, size_t Length)
+{
+	STRING_VECTOR Names;
+	FindIncludes(&Names, Code, Length);
+
+	string FileName;
+	for (size_t i = 0; i < Names.size(); i++)
+	{
+		if (m_Includes.find(Names[i]) != m_Includes.end())
+			continue;
+		// Brakujcy plik moe by w nieaktywnym #if. Jeli jest potrzebny, bd zgosi kompilator.
+		GetIncludeFileName(&FileName, Names[i]);
+		if (!VfsFileExists(FileName))
+			continue;
+
+		LOG(LOG_RESMNGR, "Multishader: Loading shader include: " + FileName);
+		string &Content = m_Includes[Names[i]];
+		VfsLoadStringFromFile(FileName, &Content);
+		LoadIncludes(Content.data(), Content.size());
+	}
+}
+
 
 Multishader::SHADER_INFO::SHADER_INFO(ID3DXEffect *Effect, uint4 ParamCount, const STRING_VECTOR &ParamNames) :
 	Effect(Effect)
@@ -178,6 +295,8 @@ Multishader::Multishader(
 	}
 	for (uint i = 0; i < ParamCount; i++)
 		pimpl->m_ParamNames.push_back(ParamNames[i]);
+
+	WatchFile(SourceFileName);
 }
 
 Multishader::Multishader(
@@ -203,6 +322,8 @@ Multishader::Multishader(
 	for (uint i = 0; i < ParamNames.size(); i++)
 		pimpl->m_ParamNames.push_back(ParamNames[i]);
 
+	WatchFile(SourceFileName);
+
 	ERR_CATCH_FUNC;
 }
 
@@ -247,31 +368,54 @@ const Multishader::SHADER_INFO & Multishader::GetShader(uint Macros[])
 		{
 			assert(!frame::GetDeviceLost() && "Multishader::GetShader podczas gry urzdzenie D3D jest utracone.");
 
-			// Skonstruuj nazw pliku z cache efektu
+			if (pimpl->m_ShaderSource == NULL)
+			{
+				pimpl->EnsureShaderSource();
+				// Zmiana pliku doczanego te przeadowuje shader
+				string IncludeFileName;
+				for (Multishader_pimpl::INCLUDE_MAP::iterator it = pimpl->m_Includes.begin(); it != pimpl->m_Includes.end(); ++it)
+				{
+					pimpl->GetIncludeFileName(&IncludeFileName, it->first);
+					WatchFile(IncludeFileName);
+				}
+			}
+
+			// Nazwa pliku z cache efektu pochodzi z wartoci makr, wic jest jeden plik na kombinacj
+			// i nowa wersja nadpisuje star. W pliku jest klucz - hash rda shadera (z plikami
+			// doczanymi) i wartoci makr. Jeli si zgadza, plik jest aktualny.
 			string HashHexStr; UintToStr2(&HashHexStr, Hash, 8, 16);
+			string MacrosStr; MacrosToStr(&MacrosStr, Macros);
+			uint8 CacheKey = FastHash_Calc::Calc(MacrosStr, pimpl->m_SourceHash);
 			string CacheFileName = Format(pimpl->m_CacheFileNameMask) % HashHexStr;
 
 			bool ReadFromCache = false;
 			// Plik z z cache efektu istnieje
 			if (GetFileItemType(CacheFileName) == IT_FILE)
 			{
-				// Pobierz dat modyfikacji shadera
-				DATETIME ShaderFileTime;
-				MustGetFileItemInfo(pimpl->m_SourceFileName, NULL, NULL, &ShaderFileTime, NULL, NULL);
-				// Pobierz dat modyfikacji pliku cache
-				DATETIME CacheFileTime;
-				MustGetFileItemInfo(CacheFileName, NULL, NULL, &CacheFileTime, NULL, NULL);
-				// Porwnaj daty
-				if (ShaderFileTime < CacheFileTime)
+				// Plik jest zamykany przed ewentualnym nadpisaniem poniej
+				VfsFileStream F(CacheFileName);
+
+				string Header;
+				uint8 FileCacheKey = 0;
+				if (F.GetSize() > CACHE_FILE_HEADER.length() + sizeof(uint8))
+				{
+					F.ReadStringF(&Header, CACHE_FILE_HEADER.length());
+					F.ReadEx(&FileCacheKey);
+				}
+				if (Header != CACHE_FILE_HEADER || FileCacheKey != CacheKey)
+					LOG(LOG_RESMNGR, Format("Multishader: Cache is out of date. Shader=#, Hash=#") % GetName() % HashHexStr);
+				else
 				{
 					LOG(LOG_RESMNGR, Format("Multishader: Loading from cache. Shader=#, Hash=#") % GetName() % HashHexStr);
 
 					// Wczytaj go
+					size_t EffectSize = F.GetSize() - F.GetPos();
 					ID3DXBuffer *ErrBufPtr;
 					ID3DXEffect *Effect;
-					HRESULT hr = D3DXCreateEffectFromFile(
+					HRESULT hr = D3DXCreateEffect(
 						frame::Dev,
-						CacheFileName.c_str(),
+						F.GetView(F.GetPos(), EffectSize),
+						(UINT)EffectSize,
 						NULL,
 						NULL,
 						D3DXFX_DONOTSAVESTATE,
@@ -297,12 +441,9 @@ const Multishader::SHADER_INFO & Multishader::GetShader(uint Macros[])
 					ReadFromCache = true;
 				}
 			}
-			// Plik z cache efektu nie istnieje lub jest przestarzay - skompiluj od nowa
+			// Plik z cache efektu nie istnieje albo jest nieaktualny - skompiluj od nowa
 			if (!ReadFromCache)
 			{
-				// Wczytaj rdo shadera
-				pimpl->EnsureShaderSource();
-
 				LOG(LOG_RESMNGR, Format("Multishader: Compiling. Shader=#, Hash=#") % GetName() % HashHexStr);
 
 				// Sformuuj makra
@@ -323,13 +464,14 @@ const Multishader::SHADER_INFO & Multishader::GetShader(uint Macros[])
 				// Utwrz "kompilator"
 				scoped_ptr<ID3DXEffectCompiler, ReleasePolicy> Compiler;
 				{
+					MultishaderInclude Include(pimpl->m_Includes);
 					ID3DXBuffer *ErrBufPtr;
 					ID3DXEffectCompiler *CompilerPtr;
 					HRESULT hr = D3DXCreateEffectCompiler(
 						pimpl->m_ShaderSource->Data(),
 						pimpl->m_ShaderSource->GetSize(),
 						&D3dMacros[0],
-						NULL,
+						&Include,
 						0,
 						&CompilerPtr,
 						&ErrBufPtr);
@@ -374,8 +516,13 @@ const Multishader::SHADER_INFO & Multishader::GetShader(uint Macros[])
 					EffectBuf.reset(new D3dxBufferWrapper(EffectBufPtr));
 				}
 
-				// Zapisz skompilowany efekt do pliku cache
-				SaveDataToFile(CacheFileName, EffectBuf->GetData(), EffectBuf->GetNumBytes());
+				// Zapisz skompilowany efekt do pliku cache - nadpisuje poprzedni wersj
+				{
+					FileStream F(CacheFileName, FM_WRITE);
+					F.WriteStringF(CACHE_FILE_HEADER);
+					F.WriteEx(CacheKey);
+					F.Write(EffectBuf->GetData(), EffectBuf->GetNumBytes());
+				}
 
 				// Wczytaj skompilowany efekt jako efekt
 				ID3DXEffect *Effect;
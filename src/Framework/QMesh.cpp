@@ -33,6 +33,10 @@ struct QMSH_HEADER
 	uint4 SubmeshesOffset;
 	uint4 BonesOffset;
 	uint4 AnimationsOffset;
+	// Tylko jeli Flags & 0x04, inaczej wyliczane z BoundingBox
+	VEC3 MinBoundingSphereCenter;
+	float MinBoundingSphereRadius;
+	OBB BoundingObb;
 };
 
 struct QMSH_KEYFRAME_BONE
@@ -54,7 +58,11 @@ class QMesh::Animation_pimpl
 public:
 	string Name;
 	float Length;
+	uint BoneCount;
 	std::vector< shared_ptr<QMSH_KEYFRAME> > Keyframes;
+	// To samo co Keyframes, jako pene pozy w ukadzie SoA do interpolacji wszystkich koci na raz.
+	// Element 0 kadej pozy to ko gwna - przeksztacenie tosamociowe.
+	std::vector<POSE_SOA> KeyframePoses;
 
 	void LoadFromFile(common::Stream &File, uint BoneCount);
 };
@@ -63,9 +71,11 @@ void QMesh::Animation_pimpl::LoadFromFile(common::Stream &File, uint BoneCount)
 {
 	File.ReadString1(&Name);
 	File.ReadEx(&Length);
+	this->BoneCount = BoneCount;
 
 	uint2 KeyframeCount;
 	File.ReadEx(&KeyframeCount);
+	KeyframePoses.resize(KeyframeCount);
 
 	for (uint2 ki = 0; ki < KeyframeCount; ki++)
 	{
@@ -73,13 +83,13 @@ void QMesh::Animation_pimpl::LoadFromFile(common::Stream &File, uint BoneCount)
 		Keyframes.push_back(Keyframe);
 
 		File.ReadEx(&Keyframe->Time);
-		Keyframe->Bones.resize(BoneCount);
+		File.ReadArray(&Keyframe->Bones, BoneCount);
+
+		POSE_SOA &Pose = KeyframePoses[ki];
+		Pose.Resize(BoneCount + 1);
+		Pose.SetIdentity(0);
 		for (uint bi = 0; bi < BoneCount; bi++)
-		{
-			File.ReadEx(&Keyframe->Bones[bi].Translation);
-			File.ReadEx(&Keyframe->Bones[bi].Rotation);
-			File.ReadEx(&Keyframe->Bones[bi].Scaling);
-		}
+			Pose.Set(bi + 1, Keyframe->Bones[bi].Rotation, Keyframe->Bones[bi].Translation, Keyframe->Bones[bi].Scaling);
 	}
 }
 
@@ -251,6 +261,46 @@ void QMesh::Animation::GetTimeScaling(float *Out, uint BoneIndex, float Time)
 	}
 }
 
+void QMesh::Animation::GetTimePose(common::POSE_SOA *Out, float Time, common::POSE_BLEND_MODE BlendMode)
+{
+	const std::vector<POSE_SOA> &Poses = pimpl->KeyframePoses;
+
+	if (Poses.empty())
+	{
+		Out->Resize(pimpl->BoneCount + 1);
+		for (uint i = 0; i <= pimpl->BoneCount; i++)
+			Out->SetIdentity(i);
+	}
+	else if (Poses.size() == 1)
+		*Out = Poses[0];
+	// Czas jeszcze przed pierwsz klatk
+	else if (Time < pimpl->Keyframes[0]->Time)
+		*Out = Poses[0];
+	else
+	{
+		for (uint ki = 0; ki < pimpl->Keyframes.size(); ki++)
+		{
+			float Time2 = pimpl->Keyframes[ki]->Time;
+
+			if (Time2 > Time)
+			{
+				// To jest dokadnie ta klatka lub ta jest pierwsza - pobierz z tej
+				if (float_equal(Time2, Time) || ki == 0)
+					*Out = Poses[ki];
+				// Zinterpoluj midzy t a poprzedni
+				else
+				{
+					float Time1 = pimpl->Keyframes[ki-1]->Time;
+					BlendPoses(Out, Poses[ki-1], Poses[ki], (Time - Time1) / (Time2 - Time1), BlendMode);
+				}
+				return;
+			}
+		}
+		// Jestemy za ostatni klatk
+		*Out = Poses[Poses.size()-1];
+	}
+}
+
 typedef std::vector<MATRIX> MATRIX_VECTOR;
 
 struct BoneMatrixCacheEntry
@@ -344,6 +394,7 @@ void SOFTWARE_SKINNING_VB::Clear()
 struct QMesh_pimpl
 {
 	string FileName;
+	POSE_BLEND_MODE PoseBlendMode;
 
 	// Ustawione midzy Load i Unload
 	uint FVF;
@@ -352,8 +403,12 @@ struct QMesh_pimpl
 	std::vector< shared_ptr<QMesh::SUBMESH> > Submeshes;
 	std::vector< shared_ptr<QMesh::BONE> > Bones;
 	std::vector< shared_ptr<QMesh::Animation> > Animations;
-	std::vector<char> VB_Data;
-	std::vector<uint2> IB_Data;
+	// Plik odwzorowany w pamici (albo skopiowany, jeli wczone jest przeadowywanie na gorco)
+	// lub z paczki. VB_Data i IB_Data wskazuj prosto do niego.
+	scoped_ptr<common::VfsFileStream> FileMapping;
+	// Uwaga! Dane w pliku nie s wyrwnane.
+	const char *VB_Data;
+	const uint2 *IB_Data;
 
 	// Ustawione midzy OnDeviceCreate a OnDeviceDestroy
 	scoped_ptr<IDirect3DVertexBuffer9, ReleasePolicy> VB;
@@ -365,6 +420,8 @@ struct QMesh_pimpl
 	// Zawsze posortowany rosnco wg numeru klatki
 	BONE_MATRIX_CACHE_ENTRY_LIST BoneMatrixCache;
 	SOFTWARE_SKINNING_VB SoftwareSkinningVb;
+	// Pozy pomocnicze dla GetBoneMatrices - eby nie alokowa ich za kadym razem
+	POSE_SOA TmpPose1, TmpPose2;
 
 	// Jeli istnieje w cache tablica macierzy dla podanych parametrw z podan dokadnoci w sekundach,
 	// zwraca wskanik do niej i aktualizuje jej znacznik czasu.
@@ -430,8 +487,12 @@ QMesh::QMesh(const string &Name, const string &Group, const string &FileName) :
 	pimpl(new QMesh_pimpl)
 {
 	pimpl->FileName = FileName;
+	pimpl->PoseBlendMode = POSE_BLEND_SLERP;
 	pimpl->FVF = 0;
 	pimpl->VertexSize = 0;
+	pimpl->VB_Data = NULL;
+	pimpl->IB_Data = NULL;
+	WatchFile(FileName);
 }
 
 QMesh::~QMesh()
@@ -443,7 +504,9 @@ void QMesh::OnLoad()
 {
 	ERR_TRY;
 	{
-		common::FileStream File(pimpl->FileName, common::FM_READ);
+		// Przy przeadowywaniu na gorco kopia w pamici - eby plik dao si nadpisa
+		pimpl->FileMapping.reset(new common::VfsFileStream(pimpl->FileName, g_Manager->GetHotReload()));
+		common::VfsFileStream &File = *pimpl->FileMapping.get();
 
 		LOG(LOG_RESMNGR, Format("QMesh: \"#\" Loading header from \"#\"") % GetName() % GetFileName());
 
@@ -475,6 +538,27 @@ void QMesh::OnLoad()
 				throw Error("Bdny nagwek.");
 			if (strncmp(pimpl->Header->Version, "10", 2) != 0)
 				throw Error("Bdna wersja.");
+
+			if ((h.Flags & 0x04) != 0)
+			{
+				File.ReadEx(&h.MinBoundingSphereCenter);
+				File.ReadEx(&h.MinBoundingSphereRadius);
+				File.ReadEx(&h.BoundingObb.Center);
+				File.ReadEx(&h.BoundingObb.Axes[0]);
+				File.ReadEx(&h.BoundingObb.Axes[1]);
+				File.ReadEx(&h.BoundingObb.Axes[2]);
+				File.ReadEx(&h.BoundingObb.HalfSize);
+			}
+			else
+			{
+				BoxBoundingSphere(&h.MinBoundingSphereCenter, &h.MinBoundingSphereRadius, h.BoundingBox);
+				h.BoundingBox.CalcCenter(&h.BoundingObb.Center);
+				h.BoundingObb.Axes[0] = VEC3::POSITIVE_X;
+				h.BoundingObb.Axes[1] = VEC3::POSITIVE_Y;
+				h.BoundingObb.Axes[2] = VEC3::POSITIVE_Z;
+				h.BoundingBox.GetSize(&h.BoundingObb.HalfSize);
+				h.BoundingObb.HalfSize *= 0.5f;
+			}
 		}
 
 		// Wylicz format i rozmiar wierzchoka
@@ -499,8 +583,7 @@ void QMesh::OnLoad()
 			uint1 ZeroByte; File.ReadEx(&ZeroByte); if (ZeroByte != 0) throw Error("Bd w pliku.");
 
 			uint vb_size = pimpl->Header->NumVertices * pimpl->VertexSize;
-			pimpl->VB_Data.resize(vb_size);
-			File.MustRead(&pimpl->VB_Data[0], vb_size);
+			pimpl->VB_Data = File.MustReadView(vb_size);
 		}
 
 		// Wczytaj dane IB
@@ -509,8 +592,7 @@ void QMesh::OnLoad()
 			uint1 ZeroByte; File.ReadEx(&ZeroByte); if (ZeroByte != 0) throw Error("Bd w pliku.");
 
 			uint index_count = pimpl->Header->NumTriangles * 3;
-			pimpl->IB_Data.resize(index_count);
-			File.MustRead(&pimpl->IB_Data[0], index_count * sizeof(uint2));
+			pimpl->IB_Data = File.MustReadView<uint2>(index_count);
 		}
 
 		// Wczytaj info o podsiatkach
@@ -601,8 +683,9 @@ void QMesh::OnUnload()
 	pimpl->SoftwareSkinningVb.Clear();
 	pimpl->BoneMatrixCache.clear();
 
-	pimpl->IB_Data.clear();
-	pimpl->VB_Data.clear();
+	pimpl->IB_Data = NULL;
+	pimpl->VB_Data = NULL;
+	pimpl->FileMapping.reset();
 	pimpl->FVF = 0;
 	pimpl->VertexSize = 0;
 	pimpl->Header.reset();
@@ -634,7 +717,7 @@ void QMesh::OnDeviceCreate()
 
 	{
 		VertexBufferLock vb_lock(vb, 0);
-		CopyMem(vb_lock.GetData(), &pimpl->VB_Data[0], vb_size);
+		CopyMem(vb_lock.GetData(), pimpl->VB_Data, vb_size);
 	}
 
 	// Indeksy
@@ -655,7 +738,7 @@ void QMesh::OnDeviceCreate()
 
 	{
 		IndexBufferLock ib_lock(ib, 0);
-		CopyMem(ib_lock.GetData(), &pimpl->IB_Data[0], ib_size);
+		CopyMem(ib_lock.GetData(), pimpl->IB_Data, ib_size);
 	}
 
 	ERR_CATCH("Nie mona wczyta siatki z pliku \"" + pimpl->FileName + "\"");
@@ -723,6 +806,20 @@ const MATRIX * QMesh::GetModelToBoneMatrices()
 	return &pimpl->ModelToBoneMatrices[0];
 }
 
+POSE_BLEND_MODE QMesh::GetPoseBlendMode()
+{
+	return pimpl->PoseBlendMode;
+}
+
+void QMesh::SetPoseBlendMode(POSE_BLEND_MODE PoseBlendMode)
+{
+	if (PoseBlendMode != pimpl->PoseBlendMode)
+	{
+		pimpl->PoseBlendMode = PoseBlendMode;
+		pimpl->BoneMatrixCache.clear();
+	}
+}
+
 const MATRIX * QMesh::GetBoneMatrices(float Accuracy, uint Animation, float Time)
 {
 	return GetBoneMatrices(Accuracy, Animation, Time, MAXUINT4, 0.f, 0.f);
@@ -749,91 +846,46 @@ const MATRIX * QMesh::GetBoneMatrices(float Accuracy, uint Animation1, float Tim
 	Entry->LastUseFrameNumber = frame::GetFrameNumber();
 	Entry->BoneMatrices.resize(GetBoneCount());
 
-	// Macierze przeksztacajce ze wsp. danej koci do wsp. koci nadrzdnej w ustalonej pozycji
-	MATRIX BoneToParentPoseMat[32];
-	Identity(&BoneToParentPoseMat[0]);
+	// Przeksztacenia wszystkich koci wzgldem nadrzdnych w ustalonej pozycji
+	POSE_SOA &Pose = pimpl->TmpPose1;
 
 	// Tylko jedna animacja
 	if (Animation2 == MAXUINT4 || LerpT < 0.001f || LerpT >= 0.999f)
 	{
-		uint AnimIndex;
-		float AnimTime;
 		if (Animation2 == MAXUINT4 || LerpT < 0.001f)
-		{
-			AnimIndex = Animation1;
-			AnimTime = Time1;
-		}
+			GetAnimation(Animation1).GetTimePose(&Pose, Time1, pimpl->PoseBlendMode);
 		else // (LerpT >= 0.999f)
-		{
-			AnimIndex = Animation2;
-			AnimTime = Time2;
-		}
-
-		Animation & Anim = GetAnimation(AnimIndex);
-
-		for (uint i = 1; i < GetBoneCount(); i++)
-		{
-			float Scal; Anim.GetTimeScaling(&Scal, i, AnimTime);
-			MATRIX ScalMat; Scaling(&ScalMat, Scal);
-
-			QUATERNION Rot; Anim.GetTimeRotation(&Rot, i, AnimTime);
-			MATRIX RotMat; QuaternionToRotationMatrix(&RotMat, Rot);
-
-			VEC3 Trans; Anim.GetTimeTranslation(&Trans, i, AnimTime);
-			MATRIX TransMat; Translation(&TransMat, Trans);
-
-			BoneToParentPoseMat[i] = ScalMat * RotMat * TransMat;
-
-			// Do tego oryginalne przeksztacenie do nadrzdnej
-			BoneToParentPoseMat[i] *= GetBone(i).Matrix;
-		}
+			GetAnimation(Animation2).GetTimePose(&Pose, Time2, pimpl->PoseBlendMode);
 	}
 	// Dwie animacje
 	else
 	{
-		QMesh::Animation & Anim1 = GetAnimation(Animation1);
-		QMesh::Animation & Anim2 = GetAnimation(Animation2);
-		float AnimTime1 = Time1; // Alias, tak dla jaj, bo to stary kod
-		float AnimTime2 = Time2; // Alias, tak dla jaj, bo to stary kod
-
-		for (uint i = 1; i < GetBoneCount(); i++)
-		{
-			float Scal1; Anim1.GetTimeScaling(&Scal1, i, AnimTime1);
-			float Scal2; Anim2.GetTimeScaling(&Scal2, i, AnimTime2);
-			float Scal = Lerp(Scal1, Scal2, LerpT);
-			MATRIX ScalMat; Scaling(&ScalMat, Scal);
-
-			QUATERNION Rot1; Anim1.GetTimeRotation(&Rot1, i, AnimTime1);
-			QUATERNION Rot2; Anim2.GetTimeRotation(&Rot2, i, AnimTime2);
-			QUATERNION Rot; Slerp(&Rot, Rot1, Rot2, LerpT);
-			MATRIX RotMat; QuaternionToRotationMatrix(&RotMat, Rot);
-
-			VEC3 Trans1; Anim1.GetTimeTranslation(&Trans1, i, AnimTime1);
-			VEC3 Trans2; Anim2.GetTimeTranslation(&Trans2, i, AnimTime2);
-			VEC3 Trans; Lerp(&Trans, Trans1, Trans2, LerpT);
-			MATRIX TransMat; Translation(&TransMat, Trans);
-
-			BoneToParentPoseMat[i] = ScalMat * RotMat * TransMat;
-
-			// Do tego oryginalne przeksztacenie do nadrzdnej
-			BoneToParentPoseMat[i] *= GetBone(i).Matrix;
-		}
+		GetAnimation(Animation1).GetTimePose(&Pose, Time1, pimpl->PoseBlendMode);
+		GetAnimation(Animation2).GetTimePose(&pimpl->TmpPose2, Time2, pimpl->PoseBlendMode);
+		BlendPoses(&Pose, Pose, pimpl->TmpPose2, LerpT, pimpl->PoseBlendMode);
 	}
 
+	// Macierze przeksztacajce ze wsp. danej koci do wsp. koci nadrzdnej w ustalonej pozycji
+	MATRIX BoneToParentPoseMat[32];
+	PoseToMatrices(BoneToParentPoseMat, Pose);
+	Identity(&BoneToParentPoseMat[0]);
+	// Do tego oryginalne przeksztacenie do nadrzdnej
+	for (uint i = 1; i < GetBoneCount(); i++)
+		BoneToParentPoseMat[i] *= GetBone(i).Matrix;
+
 	// Macierze przeksztacajce ze wsp. danej koci do wsp. modelu w ustalonej pozycji
 	// (To obliczenie naleaoby poczy z poprzednim)
+	// Jeli to ko gwna, przeksztacenie z danej koci do nadrzdnej = z danej koci do modelu
+	// Jeli to nie ko gwna, przeksztacenie z danej koci do modelu = z danej koci do nadrzdnej * z nadrzdnej do modelu
 	MATRIX BoneToModelPoseMat[32];
-	Identity(&BoneToModelPoseMat[0]);
+	uint BoneParentIndices[32];
+	BoneParentIndices[0] = MAXUINT4;
 	for (uint i = 1; i < GetBoneCount(); i++)
 	{
-		const QMesh::BONE & Bone = GetBone(i);
-		// Jeli to ko gwna, przeksztacenie z danej koci do nadrzdnej = z danej koci do modelu
-		// Jeli to nie ko gwna, przeksztacenie z danej koci do modelu = z danej koci do nadrzdnej * z nadrzdnej do modelu
-		if (Bone.ParentIndex == 0)
-			BoneToModelPoseMat[i] = BoneToParentPoseMat[i];
-		else
-			BoneToModelPoseMat[i] = BoneToParentPoseMat[i] * BoneToModelPoseMat[Bone.ParentIndex];
+		uint ParentIndex = GetBone(i).ParentIndex;
+		BoneParentIndices[i] = (ParentIndex == 0 ? MAXUINT4 : ParentIndex);
 	}
+	ConcatHierarchy(BoneToModelPoseMat, BoneToParentPoseMat, BoneParentIndices, GetBoneCount());
 
 	// Macierze zebrane koci - przeksztacajce z modelu do koci w pozycji spoczynkowej * z koci do modelu w pozycji biecej
 	Identity(&Entry->BoneMatrices[0]);
@@ -846,31 +898,38 @@ const MATRIX * QMesh::GetBoneMatrices(float Accuracy, uint Animation1, float Tim
 
 bool QMesh::RayCollision(float *OutT, const VEC3 &RayOrig, const VEC3 &RayDir, bool TwoSided, uint TriangleBegin, uint TriangleEnd)
 {
-	float t;
 	*OutT = MAXFLOAT;
 	bool Found = false;
 
 	uint VertexStride = pimpl->VertexSize;
 	uint NumTriangles = pimpl->Header->NumTriangles;
-	uint2 *IB_Data = &pimpl->IB_Data[0];
-	char *VB_Data = &pimpl->VB_Data[0];
+	const uint2 *IB_Data = pimpl->IB_Data;
+	const char *VB_Data = pimpl->VB_Data;
 	uint IndexBegin = TriangleBegin * 3;
 	uint IndexEnd = (TriangleEnd == MAXUINT4 ? (pimpl->Header->NumTriangles * 3) : (TriangleEnd * 3));
 
-	for (uint vi = IndexBegin; vi < IndexEnd; vi += 3)
+	// Trjkty testowane paczkami po 8
+	TRIANGLE_PACKET8 Packet;
+	float PacketT[8];
+	uint vi = IndexBegin, PacketSize, HitMask, ti;
+	while (vi < IndexEnd)
 	{
-		if (RayToTriangle(
-			RayOrig,
-			RayDir,
-			*(const VEC3*)&VB_Data[IB_Data[vi  ]*VertexStride],
-			*(const VEC3*)&VB_Data[IB_Data[vi+1]*VertexStride],
-			*(const VEC3*)&VB_Data[IB_Data[vi+2]*VertexStride],
-			!TwoSided,
-			&t))
+		for (PacketSize = 0; PacketSize < 8 && vi < IndexEnd; PacketSize++, vi += 3)
 		{
-			if (t >= 0.f && t < *OutT)
+			Packet.Set(PacketSize,
+				*(const VEC3*)&VB_Data[IB_Data[vi  ]*VertexStride],
+				*(const VEC3*)&VB_Data[IB_Data[vi+1]*VertexStride],
+				*(const VEC3*)&VB_Data[IB_Data[vi+2]*VertexStride]);
+		}
+		for (ti = PacketSize; ti < 8; ti++)
+			Packet.SetDegenerate(ti);
+
+		HitMask = RayToTriangle8(PacketT, RayOrig, RayDir, Packet, !TwoSided);
+		for (ti = 0; HitMask != 0; ti++, HitMask >>= 1)
+		{
+			if ((HitMask & 1) != 0 && PacketT[ti] >= 0.f && PacketT[ti] < *OutT)
 			{
-				*OutT = t;
+				*OutT = PacketT[ti];
 				Found = true;
 			}
 		}
@@ -913,7 +972,7 @@ bool QMesh::RayCollision_Bones(float *OutT, const VEC3 &RayOrig, const VEC3 &Ray
 		uint VertexCount = pimpl->Header->NumVertices;
 		uint VertexStride = pimpl->VertexSize;
 		uint BoneInfoOffset = sizeof(VEC3); // Pos
-		const char *VB_Data = &pimpl->VB_Data[0];
+		const char *VB_Data = pimpl->VB_Data;
 		VEC3 TempPos;
 		for (uint vi = 0; vi < VertexCount; vi++)
 		{
@@ -932,31 +991,32 @@ bool QMesh::RayCollision_Bones(float *OutT, const VEC3 &RayOrig, const VEC3 &Ray
 
 	// Testuj!
 
-	float t;
 	*OutT = MAXFLOAT;
 	bool Found = false;
 
 	uint NumTriangles = pimpl->Header->NumTriangles;
-	uint2 *IB_Data = &pimpl->IB_Data[0];
+	const uint2 *IB_Data = pimpl->IB_Data;
 	const VEC3 *VB_Data = &pimpl->SoftwareSkinningVb.Vertices[0];
 	uint IndexBegin = TriangleBegin * 3;
 	uint IndexEnd = (TriangleEnd == MAXUINT4 ? (pimpl->Header->NumTriangles * 3) : (TriangleEnd * 3));
 
-	// Przejrzyj wszystkie trjkty
-	for (uint vi = IndexBegin; vi < IndexEnd; vi += 3)
+	// Przejrzyj wszystkie trjkty, paczkami po 8
+	TRIANGLE_PACKET8 Packet;
+	float PacketT[8];
+	uint vi = IndexBegin, PacketSize, HitMask, ti;
+	while (vi < IndexEnd)
 	{
-		if (RayToTriangle(
-			RayOrig,
-			RayDir,
-			VB_Data[IB_Data[vi  ]],
-			VB_Data[IB_Data[vi+1]],
-			VB_Data[IB_Data[vi+2]],
-			!TwoSided,
-			&t))
+		for (PacketSize = 0; PacketSize < 8 && vi < IndexEnd; PacketSize++, vi += 3)
+			Packet.Set(PacketSize, VB_Data[IB_Data[vi]], VB_Data[IB_Data[vi+1]], VB_Data[IB_Data[vi+2]]);
+		for (ti = PacketSize; ti < 8; ti++)
+			Packet.SetDegenerate(ti);
+
+		HitMask = RayToTriangle8(PacketT, RayOrig, RayDir, Packet, !TwoSided);
+		for (ti = 0; HitMask != 0; ti++, HitMask >>= 1)
 		{
-			if (t >= 0.f && t < *OutT)
+			if ((HitMask & 1) != 0 && PacketT[ti] >= 0.f && PacketT[ti] < *OutT)
 			{
-				*OutT = t;
+				*OutT = PacketT[ti];
 				Found = true;
 			}
 		}
@@ -973,6 +1033,9 @@ uint QMesh::GetVertexSize()         { return pimpl->VertexSize; }
 uint QMesh::GetSubmeshCount()       { return pimpl->Submeshes.size(); }
 float QMesh::GetBoundingSphereRadius() { assert(pimpl->Header != NULL); return pimpl->Header->BoundingSphereRadius; }
 const BOX & QMesh::GetBoundingBox() { assert(pimpl->Header != NULL); return pimpl->Header->BoundingBox; }
+const VEC3 & QMesh::GetMinBoundingSphereCenter() { assert(pimpl->Header != NULL); return pimpl->Header->MinBoundingSphereCenter; }
+float QMesh::GetMinBoundingSphereRadius() { assert(pimpl->Header != NULL); return pimpl->Header->MinBoundingSphereRadius; }
+const OBB & QMesh::GetBoundingObb() { assert(pimpl->Header != NULL); return pimpl->Header->BoundingObb; }
 uint QMesh::GetVertexCount()        { assert(pimpl->Header != NULL); return pimpl->Header->NumVertices; }
 uint QMesh::GetTriangleCount()      { assert(pimpl->Header != NULL); return pimpl->Header->NumTriangles; }
 uint QMesh::GetBoneCount()          { assert(pimpl->Header != NULL); return pimpl->Header->NumBones + 1; }
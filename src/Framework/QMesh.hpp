@@ -64,6 +64,9 @@ public:
 		void GetTimeTranslation(common::VEC3       *Out, uint BoneIndex, float Time);
 		void GetTimeRotation   (common::QUATERNION *Out, uint BoneIndex, float Time);
 		void GetTimeScaling    (float              *Out, uint BoneIndex, float Time);
+		// Oblicza zinterpolowane przeksztacenia wszystkich koci na raz (element 0 to ko gwna).
+		// BlendMode mwi, jak s interpolowane obroty.
+		void GetTimePose(common::POSE_SOA *Out, float Time, common::POSE_BLEND_MODE BlendMode = common::POSE_BLEND_SLERP);
 
 	private:
 		scoped_ptr<Animation_pimpl> pimpl;
@@ -87,8 +90,12 @@ public:
 	uint GetSubmeshCount();
 	uint GetVertexCount();
 	uint GetTriangleCount();
-	float GetBoundingSphereRadius();
+	float GetBoundingSphereRadius(); // Sfera o rodku w (0,0,0)
 	const BOX & GetBoundingBox();
+	// Najmniejsza sfera otaczajca i OBB. Dla plikw bez nich wyliczane z AABB.
+	const VEC3 & GetMinBoundingSphereCenter();
+	float GetMinBoundingSphereRadius();
+	const OBB & GetBoundingObb();
 	const SUBMESH & GetSubmesh(uint Index);
 	IDirect3DVertexBuffer9 * GetVB();
 	IDirect3DIndexBuffer9 * GetIB();
@@ -107,6 +114,10 @@ public:
 	// do lokalnych danej koci w Bind Pose. Macierzy w tablicy jest tyle, ile koci.
 	// Jeli nie ma skinningu albo jest 0 koci, zwraca NULL.
 	const MATRIX * GetModelToBoneMatrices();
+	// Sposb interpolacji obrotw koci w GetBoneMatrices i RayCollision_Bones. Domylnie POSE_BLEND_SLERP.
+	// Zmiana czyci cache macierzy koci.
+	POSE_BLEND_MODE GetPoseBlendMode();
+	void SetPoseBlendMode(POSE_BLEND_MODE PoseBlendMode);
 	// Zwraca macierze koci dla podanej pozycji.
 	// One s wyliczane na danie, cache'owane, ale mog znikn - nie zapamitywa wskanika ani
 	// referencji do tej tablicy, mog si uniewani po jakim ponownym uyciu obiektu tej klasy.
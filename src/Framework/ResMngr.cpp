@@ -37,6 +37,12 @@ const float GC_ALERT_OLD_RES_TIME = 3.0f;
 // Ile zasobw na raz co najwyej usuwa w ramach wymiany pilnej
 const uint4 GC_ALERT_RES_COUNT = 10;
 
+// == PRZEADOWYWANIE NA GORCO ==
+
+// Ile sekund od ostatniej zmiany pliku odczeka z przeadowaniem
+// Edytory zapisuj plik kilkoma operacjami, a eksport zwykle dotyczy wielu plikw naraz.
+const float HOT_RELOAD_DEBOUNCE_TIME = 0.25f;
+
 
 //HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
 // Klasa ResManager_pimpl
@@ -46,12 +52,19 @@ class ResManager_pimpl
 private:
 	void GarbageCollect2(bool Alert);
 	static bool ResourceOlderCompare(IResource *r1, IResource *r2);
+	// Zwraca katalog do obserwowania dla pliku o podanym kluczu
+	static void WatchedFileDir(string *Out, const string &Key);
+	// Zaczyna obserwowa katalog pliku o podanym kluczu
+	// Bd tylko loguje - katalogu moe nie by, jeli pliki s w paczce.
+	void WatchFileDir(const string &Key);
 
 public:
 	typedef std::map<string, RES_CREATE_FUNC> RESOURCE_TYPE_MAP;
 	typedef std::vector<IResource*> RESOURCE_VECTOR;
 	typedef std::set<IResource*> RESOURCE_SET;
 	typedef std::map<string, IResource*> RESOURCE_MAP;
+	typedef std::multimap<string, IResource*> WATCHED_FILE_MAP;
+	typedef std::map<string, float> CHANGE_TIME_MAP;
 
 	// Zarejestrowane typy zasobw
 	RESOURCE_TYPE_MAP m_ResourceTypes;
@@ -68,6 +81,13 @@ public:
 	float m_GC_LastCheckTime;
 	float m_GC_LastCollectTime;
 
+	// Obserwowane pliki: Klucz pliku => Zasb
+	WATCHED_FILE_MAP m_WatchedFiles;
+	// Istnieje tylko jeli przeadowywanie na gorco jest wczone
+	scoped_ptr<FileWatcher> m_FileWatcher;
+	// Zmienione pliki czekajce na przeadowanie: Klucz pliku => Czas ostatniej zmiany
+	CHANGE_TIME_MAP m_PendingChanges;
+
 	ResManager_pimpl();
 	~ResManager_pimpl();
 
@@ -82,6 +102,11 @@ public:
 	void GetResourcesFromGroup(RESOURCE_VECTOR *V, const string &Group);
 	// Wymiana
 	void GarbageCollect();
+	// Przeadowywanie na gorco
+	void EnableHotReload(bool Enable);
+	void HotReload();
+	// Zamienia ciek pliku na klucz, pod ktrym jest obserwowany
+	static void MakeWatchedFileKey(string *Out, const string &FileName);
 
 	// Wywouje IResource po zmianie stanu
 	void OnResourceStateChange(IResource *Res);
@@ -89,6 +114,7 @@ public:
 	// ======== Dla IResource ========
 	void AddResource(IResource *Res);
 	void RemoveResource(IResource *Res);
+	void WatchFile(IResource *Res, const string &Key);
 };
 
 
@@ -249,11 +275,123 @@ void ResManager_pimpl::GarbageCollect()
 }
 
 
+void ResManager_pimpl::MakeWatchedFileKey(string *Out, const string &FileName)
+{
+	NormalizePath(Out, FileName);
+#ifdef WIN32
+	// System plikw Windows nie rozrnia wielkoci liter
+	LowerCase(Out);
+#endif
+}
+
+void ResManager_pimpl::WatchedFileDir(string *Out, const string &Key)
+{
+	ExtractFilePath(Out, Key);
+	if (Out->empty())
+		*Out = ".";
+}
+
+void ResManager_pimpl::WatchFileDir(const string &Key)
+{
+	string Dir;
+	WatchedFileDir(&Dir, Key);
+	try
+	{
+		m_FileWatcher->AddDir(Dir);
+	}
+	catch (const Error &e)
+	{
+		string Msg;
+		e.GetMessage_(&Msg);
+		LOG(0x08, "ResManager: Cannot watch directory \"" + Dir + "\": " + Msg);
+	}
+}
+
+void ResManager_pimpl::EnableHotReload(bool Enable)
+{
+	if (!Enable)
+	{
+		m_FileWatcher.reset();
+		m_PendingChanges.clear();
+		return;
+	}
+	if (m_FileWatcher != NULL)
+		return;
+
+	m_FileWatcher.reset(new FileWatcher());
+	// Katalogi wszystkich plikw ju obserwowanych przez zasoby
+	string Dir, LastDir;
+	for (WATCHED_FILE_MAP::iterator it = m_WatchedFiles.begin(); it != m_WatchedFiles.end(); ++it)
+	{
+		WatchedFileDir(&Dir, it->first);
+		if (Dir != LastDir)
+		{
+			WatchFileDir(it->first);
+			LastDir = Dir;
+		}
+	}
+}
+
+void ResManager_pimpl::HotReload()
+{
+	if (m_FileWatcher == NULL)
+		return;
+
+	float Time = frame::Timer1.GetTime();
+
+	// Nowe zmiany - tylko te dotyczce obserwowanych plikw
+	STRING_VECTOR Changes;
+	if (m_FileWatcher->GetChanges(&Changes))
+	{
+		string Key;
+		for (size_t i = 0; i < Changes.size(); i++)
+		{
+			MakeWatchedFileKey(&Key, Changes[i]);
+			if (m_WatchedFiles.find(Key) != m_WatchedFiles.end())
+				m_PendingChanges[Key] = Time;
+		}
+	}
+
+	if (m_PendingChanges.empty())
+		return;
+
+	// Zbierz zasoby plikw, ktre od duszej chwili si nie zmieniaj.
+	// Zbir, eby zasb z kilkoma zmienionymi plikami przeadowa raz.
+	RESOURCE_SET ToReload;
+	for (CHANGE_TIME_MAP::iterator it = m_PendingChanges.begin(); it != m_PendingChanges.end(); )
+	{
+		if (it->second + HOT_RELOAD_DEBOUNCE_TIME <= Time)
+		{
+			std::pair<WATCHED_FILE_MAP::iterator, WATCHED_FILE_MAP::iterator> Range = m_WatchedFiles.equal_range(it->first);
+			for (WATCHED_FILE_MAP::iterator wit = Range.first; wit != Range.second; ++wit)
+				ToReload.insert(wit->second);
+			m_PendingChanges.erase(it++);
+		}
+		else
+			++it;
+	}
+
+	for (RESOURCE_SET::iterator it = ToReload.begin(); it != ToReload.end(); ++it)
+		(*it)->Reload();
+}
+
+void ResManager_pimpl::WatchFile(IResource *Res, const string &Key)
+{
+	m_WatchedFiles.insert(WATCHED_FILE_MAP::value_type(Key, Res));
+
+	if (m_FileWatcher != NULL)
+		WatchFileDir(Key);
+}
+
 void ResManager_pimpl::Event(uint4 Type, void *Params)
 {
 	// Powiadom wszystkie zasoby
+	// (oprcz tych, ktre po nieudanym przeadowaniu nie maj danych)
 	for (RESOURCE_SET::iterator it = m_AllResources.begin(); it != m_AllResources.end(); ++it)
-		(*it)->OnEvent(Type, Params);
+	{
+		if (!(*it)->m_ReloadFailed)
+			(*it)->OnEvent(Type, Params);
+	}
 }
 
 void ResManager_pimpl::OnResourceStateChange(IResource *Res)
@@ -328,6 +466,18 @@ void ResManager_pimpl::RemoveResource(IResource *Res)
 		m_AllResources.erase(it);
 	}
 
+	for (size_t i = 0; i < Res->m_WatchedFiles.size(); i++)
+	{
+		std::pair<WATCHED_FILE_MAP::iterator, WATCHED_FILE_MAP::iterator> Range = m_WatchedFiles.equal_range(Res->m_WatchedFiles[i]);
+		for (WATCHED_FILE_MAP::iterator it = Range.first; it != Range.second; )
+		{
+			if (it->second == Res)
+				m_WatchedFiles.erase(it++);
+			else
+				++it;
+		}
+	}
+
 	ERR_CATCH_FUNC;
 }
 
@@ -340,7 +490,8 @@ IResource::IResource(const string &Name, const string &Group) :
 	m_Name(Name),
 	m_Group(Group),
 	m_LockCount(0),
-	m_LastUseTime(frame::Timer1.GetTime())
+	m_LastUseTime(frame::Timer1.GetTime()),
+	m_ReloadFailed(false)
 {
 	assert(g_Manager != NULL);
 	g_Manager->pimpl->AddResource(this);
@@ -358,6 +509,84 @@ void IResource::Unloaded()
 	g_Manager->pimpl->OnResourceStateChange(this);
 }
 
+void IResource::WatchFile(const string &FileName)
+{
+	if (FileName.empty())
+		return;
+
+	string Key;
+	ResManager_pimpl::MakeWatchedFileKey(&Key, FileName);
+	if (std::find(m_WatchedFiles.begin(), m_WatchedFiles.end(), Key) != m_WatchedFiles.end())
+		return;
+	m_WatchedFiles.push_back(Key);
+	g_Manager->pimpl->WatchFile(this, Key);
+}
+
+void IResource::Reload()
+{
+	if (GetState() == ST_UNLOADED)
+		return;
+
+	LOG(0x08, "ResManager: Reloading resource: " + GetName());
+
+	// Stan (i licznik zablokowa) zostaje bez zmian - dla uytkownikw zasobu to przezroczyste
+	// Po nieudanym przeadowaniu nie ma czego odadowywa.
+	if (!m_ReloadFailed)
+	{
+		try
+		{
+			OnUnload();
+		}
+		catch (...) { }
+	}
+
+	string ErrorMsg;
+	try
+	{
+		OnLoad();
+	}
+	catch (const Error &e)
+	{
+		e.GetMessage_(&ErrorMsg);
+		if (ErrorMsg.empty())
+			ErrorMsg = "Nieznany bd";
+	}
+	catch (...)
+	{
+		ErrorMsg = "Nieznany bd";
+	}
+
+	if (ErrorMsg.empty())
+	{
+		m_ReloadFailed = false;
+		return;
+	}
+
+	// Plik moe by zapisany do poowy albo bdny.
+	LOG(0x08, "ResManager: Reloading resource \"" + GetName() + "\" failed: " + ErrorMsg);
+	if (GetState() == ST_LOCKED)
+	{
+		// Kto trzyma zasb zablokowany, wic stan i licznik zablokowa zostaj. Nastpna zmiana
+		// pliku albo Load/Lock sprbuje go wczyta jeszcze raz, a odadowanie czeka na ostatnie Unlock.
+		m_ReloadFailed = true;
+	}
+	else
+	{
+		// Nikt go nie trzyma - nastpne Load albo Lock wczyta go jeszcze raz albo zgosi bd.
+		m_State = ST_UNLOADED;
+		g_Manager->pimpl->OnResourceStateChange(this);
+	}
+}
+
+void IResource::RetryFailedReload()
+{
+	if (m_ReloadFailed)
+	{
+		OnLoad();
+		m_ReloadFailed = false;
+	}
+}
+
 void IResource::Load()
 {
 	ERR_TRY;
@@ -368,6 +597,8 @@ void IResource::Load()
 		m_State = ST_LOADED;
 		g_Manager->pimpl->OnResourceStateChange(this);
 	}
+	else
+		RetryFailedReload();
 	m_LastUseTime = frame::Timer1.GetTime();
 
 	ERR_CATCH_FUNC;
@@ -402,6 +633,8 @@ void IResource::Lock()
 		m_State = ST_LOCKED;
 		g_Manager->pimpl->OnResourceStateChange(this);
 	}
+	else
+		RetryFailedReload();
 	m_LockCount++;
 	m_LastUseTime = frame::Timer1.GetTime();
 
@@ -415,7 +648,14 @@ void IResource::Unlock()
 		m_LockCount--;
 		if (m_LockCount == 0)
 		{
-			m_State = ST_LOADED;
+			// Po nieudanym przeadowaniu zasb nie ma danych - dopiero teraz mona go odadowa
+			if (m_ReloadFailed)
+			{
+				m_ReloadFailed = false;
+				m_State = ST_UNLOADED;
+			}
+			else
+				m_State = ST_LOADED;
 			g_Manager->pimpl->OnResourceStateChange(this);
 		}
 	}
@@ -449,10 +689,26 @@ void ResManager::OnFrame()
 
 	// Wymiana
 	pimpl->GarbageCollect();
+	// Przeadowywanie na gorco
+	pimpl->HotReload();
 
 	ERR_CATCH_FUNC;
 }
 
+void ResManager::SetHotReload(bool HotReload)
+{
+	ERR_TRY;
+
+	pimpl->EnableHotReload(HotReload);
+
+	ERR_CATCH_FUNC;
+}
+
+bool ResManager::GetHotReload()
+{
+	return (pimpl->m_FileWatcher != NULL);
+}
+
 void ResManager::GetStats(STATS *Stats)
 {
 	// Pami systemowa
@@ -485,8 +741,9 @@ void ResManager::CreateFromFile(const string &FileName, const string &Group)
 {
 	ERR_TRY;
 
-	FileStream file(FileName, FM_READ);
-	Tokenizer tokenizer(&file, 0);
+	string Doc;
+	VfsLoadStringFromFile(FileName, &Doc);
+	Tokenizer tokenizer(&Doc, 0);
 	tokenizer.Next();
 
 	while (tokenizer.GetToken() != Tokenizer::TOKEN_EOF)
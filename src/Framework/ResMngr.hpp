@@ -31,9 +31,18 @@ private:
 	string m_Group;
 	uint4 m_LockCount;
 	float m_LastUseTime;
+	// Pliki obserwowane dla przeadowywania na gorco (znormalizowane)
+	STRING_VECTOR m_WatchedFiles;
+	// True, jeli przeadowanie zablokowanego zasobu si nie udao i nie ma on teraz danych
+	bool m_ReloadFailed;
 
 	// Dla Managera do realizowania wymiany
 	float GetLastUseTime() { return m_LastUseTime; }
+	// Dla Managera - przeadowuje zasb, ktrego plik si zmieni
+	// Jeli nie jest zaadowany, nic nie robi.
+	void Reload();
+	// Jeli poprzednie przeadowanie si nie udao, wczytuje zasb jeszcze raz, a jak si nie uda - rzuca wyjtek
+	void RetryFailedReload();
 
 protected:
 	IResource(const string &Name, const string &Group = "");
@@ -46,6 +55,10 @@ protected:
 	// Wywoa jeli zasb odadowa sam siebie
 	// Wolno to robi tylko jeli jest w stanie ST_LOADED i wewntrz metody OnEvent.
 	void Unloaded();
+	// Wywoa (najlepiej w konstruktorze) dla kadego pliku, z ktrego zasb si wczytuje
+	// Jeli przeadowywanie na gorco jest wczone, zmiana pliku spowoduje OnUnload + OnLoad.
+	// Pusta nazwa jest ignorowana.
+	void WatchFile(const string &FileName);
 
 public:
 	virtual ~IResource();
@@ -117,6 +130,10 @@ public:
 
 	void RegisterResourceType(const string &TypeName, RES_CREATE_FUNC CreateFunc);
 	void OnFrame();
+	// Przeadowywanie na gorco - zasoby, ktrych pliki zmieniy si na dysku,
+	// s przeadowywane w OnFrame. Domylnie wyczone.
+	void SetHotReload(bool HotReload);
+	bool GetHotReload();
 	void GetStats(STATS *Stats);
 	void Event(uint4 Type, void *Params);
 
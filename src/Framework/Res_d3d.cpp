@@ -106,9 +106,10 @@ void D3dTexture::OnDeviceCreate()
 
 	LOG(LOG_RESMNGR, Format("D3dTexture: Loading \"#\" from: #") % GetName() % GetFileName());
 
-	HRESULT hr = D3DXCreateTextureFromFileEx(
+	VfsFileStream File(GetFileName());
+	HRESULT hr = D3DXCreateTextureFromFileInMemoryEx(
 		frame::Dev, // Device
-		GetFileName().c_str(), // SrcFile
+		File.GetData(), File.GetSize(), // SrcData, SrcDataSize
 		D3DX_DEFAULT, D3DX_DEFAULT, // Width, Height
 		GetDisableMipMapping() ? 1 : D3DX_DEFAULT, // MipLevels
 		0, // Usage
@@ -207,9 +208,10 @@ void D3dCubeTexture::OnDeviceCreate()
 
 	LOG(LOG_RESMNGR, Format("D3dCubeTexture: Loading \"#\" from: #") % GetName() % GetFileName());
 
-	HRESULT hr = D3DXCreateCubeTextureFromFile(
+	VfsFileStream File(GetFileName());
+	HRESULT hr = D3DXCreateCubeTextureFromFileInMemory(
 		frame::Dev,
-		GetFileName().c_str(),
+		File.GetData(), File.GetSize(),
 		&m_CubeTexture);
 	if (FAILED(hr))
 		throw DirectXError(hr, "Nie mona wczyta tekstury szeciennej z pliku: " + GetFileName(), __FILE__, __LINE__);
@@ -351,8 +353,9 @@ void D3dEffect::OnDeviceCreate()
 {
 	LOG(LOG_RESMNGR, Format("D3dEffect: Loading \"#\" from: #") % GetName() % GetFileName());
 
+	VfsFileStream File(GetFileName());
 	ID3DXBuffer *ErrBufPtr;
-	HRESULT hr = D3DXCreateEffectFromFile(frame::Dev, GetFileName().c_str(), 0, 0, D3DXFX_DONOTSAVESTATE, 0, &m_Effect, &ErrBufPtr);
+	HRESULT hr = D3DXCreateEffect(frame::Dev, File.GetData(), File.GetSize(), 0, 0, D3DXFX_DONOTSAVESTATE, 0, &m_Effect, &ErrBufPtr);
 	scoped_ptr<ID3DXBuffer, ReleasePolicy> ErrBuf(ErrBufPtr);
 	if (FAILED(hr))
 	{
@@ -454,6 +457,7 @@ D3dEffect::D3dEffect(const string &Name, const string &Group, const string &File
 {
 	m_ParamHandles.resize(m_ParamNames.size());
 	ClearParamHandles();
+	WatchFile(FileName);
 }
 
 void D3dEffect::SetParamNames(const STRING_VECTOR *ParamNames)
@@ -657,7 +661,7 @@ void Font::LoadDef()
 		CharExists[i] = false;
 	
 	string Doc;
-	LoadStringFromFile(m_DefFileName, &Doc);
+	VfsLoadStringFromFile(m_DefFileName, &Doc);
 	
 	FontDefParser parser(&Doc);
 	
@@ -834,7 +838,8 @@ void Font::OnDeviceCreate()
 {
 	m_Texture = 0;
 
-	HRESULT hr = D3DXCreateTextureFromFile(frame::Dev, m_TextureFileName.c_str(), &m_Texture);
+	VfsFileStream File(m_TextureFileName);
+	HRESULT hr = D3DXCreateTextureFromFileInMemory(frame::Dev, File.GetData(), File.GetSize(), &m_Texture);
 	if (FAILED(hr))
 		throw DirectXError(hr, "Nie mona wczyta tekstury czcionki z pliku: " + m_TextureFileName, __FILE__, __LINE__);
 }
@@ -882,6 +887,8 @@ Font::Font(const string &Name, const string &Group, const string &DefFileName, c
 {
 	LOG(LOG_RESMNGR, Format("Font: Creating \"#\"") % GetName());
 	LoadDef();
+	// Plik definicji jest wczytywany tylko tutaj, wic przy zmianie wystarczy przeadowa tekstur
+	WatchFile(m_TextureFileName);
 }
 
 float Font::GetTextWidth(const string &Text, size_t TextBegin, size_t TextEnd, float Size)
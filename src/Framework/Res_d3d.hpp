@@ -71,7 +71,7 @@ protected:
 	void SetBaseTexture(IDirect3DBaseTexture9 *BaseTexture) { m_BaseTexture = BaseTexture; }
 
 public:
-	D3dBaseTexture(const string &Name, const string &Group, const string &FileName, bool DisableMipMapping = false) : D3dResource(Name, Group), m_BaseTexture(0), m_FileName(FileName), m_DisableMipMapping(DisableMipMapping) { }
+	D3dBaseTexture(const string &Name, const string &Group, const string &FileName, bool DisableMipMapping = false) : D3dResource(Name, Group), m_BaseTexture(0), m_FileName(FileName), m_DisableMipMapping(DisableMipMapping) { WatchFile(FileName); }
 
 	// Zwraca tekstur lub 0 jeli aktualnie nie wczytana
 	IDirect3DBaseTexture9 * GetBaseTexture() { return m_BaseTexture; }
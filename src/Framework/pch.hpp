@@ -23,6 +23,7 @@
 #include "..\Common\FreeList.hpp"
 #include "..\Common\Logger.hpp"
 #include "..\Common\Math.hpp"
+#include "..\Common\PackFile.hpp"
 #include "..\Common\Profiler.hpp"
 #include "..\Common\Stream.hpp"
 #include "..\Common\Threads.hpp"
@@ -0,0 +1,845 @@
+/*
+ * The Final Quest - 3D Graphics Engine
+ * Copyright (C) 2007  Adam Sawicki
+ * http://regedit.gamedev.pl, sawickiap@poczta.onet.pl
+ * License: GNU GPL
+ */
+#include "PCH.hpp"
+#include <numeric>
+#include "BenchTask.hpp"
+
+
+//HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
+// Sumy kontrolne
+
+// Rozmiar bufora do pomiaru przepustowoci
+const uint HASH_BENCH_SIZE = 64 * 1024 * 1024;
+const uint HASH_BENCH_REPEATS = 3;
+
+// Poprzednie implementacje z moduu Stream (liczenie bajt po bajcie, MD5 blok po bloku
+// ze stanem w polach obiektu) - punkt odniesienia dla pomiaru i dla sprawdzenia wynikw
+
+static uint4 g_OldCrc32Table[256];
+
+static void OldCrc32Init()
+{
+	for (uint4 i = 0; i < 256; i++)
+	{
+		uint4 c = i;
+		for (uint k = 0; k < 8; k++)
+			c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
+		g_OldCrc32Table[i] = c;
+	}
+}
+
+static uint4 OldCrc32Calc(const void *Data, size_t DataLength)
+{
+	uint4 crc = 0xFFFFFFFF;
+	const uint1 *DataBytes = (const uint1*)Data;
+	for (size_t i = 0; i < DataLength; i++)
+		crc = ((crc >> 8) & 0x00FFFFFF) ^ g_OldCrc32Table[(crc ^ DataBytes[i]) & 0x000000FF];
+	return ~crc;
+}
+
+static uint4 OldHashCalc(const void *Data, size_t DataLength)
+{
+	uint4 Hash = 0;
+	const uint1 *ByteData = (const uint1*)Data;
+	for (size_t i = 0; i < DataLength; i++)
+	{
+		Hash += ByteData[i];
+		Hash += (Hash << 10);
+		Hash ^= (Hash >> 6);
+	}
+	Hash += (Hash << 3);
+	Hash ^= (Hash >> 11);
+	Hash += (Hash << 15);
+	return Hash;
+}
+
+#define OLD_MD5_GET_UINT32_LE(n,b,i)            \
+{                                               \
+    (n) = ( (uint4) (b)[(i)    ]       )        \
+        | ( (uint4) (b)[(i) + 1] <<  8 )        \
+        | ( (uint4) (b)[(i) + 2] << 16 )        \
+        | ( (uint4) (b)[(i) + 3] << 24 );       \
+}
+
+#define OLD_MD5_PUT_UINT32_LE(n,b,i)            \
+{                                               \
+    (b)[(i)    ] = (uint1) ( (n)       );       \
+    (b)[(i) + 1] = (uint1) ( (n) >>  8 );       \
+    (b)[(i) + 2] = (uint1) ( (n) >> 16 );       \
+    (b)[(i) + 3] = (uint1) ( (n) >> 24 );       \
+}
+
+class OldMD5
+{
+private:
+	uint4 total[2];
+	uint4 state[4];
+	uint1 buffer[64];
+
+	void Process(const uint1 data[64]);
+
+public:
+	OldMD5();
+	void Write(const void *Buf, size_t BufLen);
+	void Finish(MD5_SUM *Out);
+};
+
+OldMD5::OldMD5()
+{
+	total[0] = 0;
+	total[1] = 0;
+	state[0] = 0x67452301;
+	state[1] = 0xEFCDAB89;
+	state[2] = 0x98BADCFE;
+	state[3] = 0x10325476;
+}
+
+void OldMD5::Process(const uint1 data[64])
+{
+    uint4 X[16], A, B, C, D;
+
+    OLD_MD5_GET_UINT32_LE( X[0],  data,  0 );
+    OLD_MD5_GET_UINT32_LE( X[1],  data,  4 );
+    OLD_MD5_GET_UINT32_LE( X[2],  data,  8 );
+    OLD_MD5_GET_UINT32_LE( X[3],  data, 12 );
+    OLD_MD5_GET_UINT32_LE( X[4],  data, 16 );
+    OLD_MD5_GET_UINT32_LE( X[5],  data, 20 );
+    OLD_MD5_GET_UINT32_LE( X[6],  data, 24 );
+    OLD_MD5_GET_UINT32_LE( X[7],  data, 28 );
+    OLD_MD5_GET_UINT32_LE( X[8],  data, 32 );
+    OLD_MD5_GET_UINT32_LE( X[9],  data, 36 );
+    OLD_MD5_GET_UINT32_LE( X[10], data, 40 );
+    OLD_MD5_GET_UINT32_LE( X[11], data, 44 );
+    OLD_MD5_GET_UINT32_LE( X[12], data, 48 );
+    OLD_MD5_GET_UINT32_LE( X[13], data, 52 );
+    OLD_MD5_GET_UINT32_LE( X[14], data, 56 );
+    OLD_MD5_GET_UINT32_LE( X[15], data, 60 );
+
+#define S(x,n) ((x << n) | ((x & 0xFFFFFFFF) >> (32 - n)))
+
+#define P(a,b,c,d,k,s,t)                                \
+{                                                       \
+    a += F(b,c,d) + X[k] + t; a = S(a,s) + b;           \
+}
+
+    A = state[0];
+    B = state[1];
+    C = state[2];
+    D = state[3];
+
+#define F(x,y,z) (z ^ (x & (y ^ z)))
+    P( A, B, C, D,  0,  7, 0xD76AA478 );
+    P( D, A, B, C,  1, 12, 0xE8C7B756 );
+    P( C, D, A, B,  2, 17, 0x242070DB );
+    P( B, C, D, A,  3, 22, 0xC1BDCEEE );
+    P( A, B, C, D,  4,  7, 0xF57C0FAF );
+    P( D, A, B, C,  5, 12, 0x4787C62A );
+    P( C, D, A, B,  6, 17, 0xA8304613 );
+    P( B, C, D, A,  7, 22, 0xFD469501 );
+    P( A, B, C, D,  8,  7, 0x698098D8 );
+    P( D, A, B, C,  9, 12, 0x8B44F7AF );
+    P( C, D, A, B, 10, 17, 0xFFFF5BB1 );
+    P( B, C, D, A, 11, 22, 0x895CD7BE );
+    P( A, B, C, D, 12,  7, 0x6B901122 );
+    P( D, A, B, C, 13, 12, 0xFD987193 );
+    P( C, D, A, B, 14, 17, 0xA679438E );
+    P( B, C, D, A, 15, 22, 0x49B40821 );
+#undef F
+
+#define F(x,y,z) (y ^ (z & (x ^ y)))
+    P( A, B, C, D,  1,  5, 0xF61E2562 );
+    P( D, A, B, C,  6,  9, 0xC040B340 );
+    P( C, D, A, B, 11, 14, 0x265E5A51 );
+    P( B, C, D, A,  0, 20, 0xE9B6C7AA );
+    P( A, B, C, D,  5,  5, 0xD62F105D );
+    P( D, A, B, C, 10,  9, 0x02441453 );
+    P( C, D, A, B, 15, 14, 0xD8A1E681 );
+    P( B, C, D, A,  4, 20, 0xE7D3FBC8 );
+    P( A, B, C, D,  9,  5, 0x21E1CDE6 );
+    P( D, A, B, C, 14,  9, 0xC33707D6 );
+    P( C, D, A, B,  3, 14, 0xF4D50D87 );
+    P( B, C, D, A,  8, 20, 0x455A14ED );
+    P( A, B, C, D, 13,  5, 0xA9E3E905 );
+    P( D, A, B, C,  2,  9, 0xFCEFA3F8 );
+    P( C, D, A, B,  7, 14, 0x676F02D9 );
+    P( B, C, D, A, 12, 20, 0x8D2A4C8A );
+#undef F
+
+#define F(x,y,z) (x ^ y ^ z)
+    P( A, B, C, D,  5,  4, 0xFFFA3942 );
+    P( D, A, B, C,  8, 11, 0x8771F681 );
+    P( C, D, A, B, 11, 16, 0x6D9D6122 );
+    P( B, C, D, A, 14, 23, 0xFDE5380C );
+    P( A, B, C, D,  1,  4, 0xA4BEEA44 );
+    P( D, A, B, C,  4, 11, 0x4BDECFA9 );
+    P( C, D, A, B,  7, 16, 0xF6BB4B60 );
+    P( B, C, D, A, 10, 23, 0xBEBFBC70 );
+    P( A, B, C, D, 13,  4, 0x289B7EC6 );
+    P( D, A, B, C,  0, 11, 0xEAA127FA );
+    P( C, D, A, B,  3, 16, 0xD4EF3085 );
+    P( B, C, D, A,  6, 23, 0x04881D05 );
+    P( A, B, C, D,  9,  4, 0xD9D4D039 );
+    P( D, A, B, C, 12, 11, 0xE6DB99E5 );
+    P( C, D, A, B, 15, 16, 0x1FA27CF8 );
+    P( B, C, D, A,  2, 23, 0xC4AC5665 );
+#undef F
+
+#define F(x,y,z) (y ^ (x | ~z))
+    P( A, B, C, D,  0,  6, 0xF4292244 );
+    P( D, A, B, C,  7, 10, 0x432AFF97 );
+    P( C, D, A, B, 14, 15, 0xAB9423A7 );
+    P( B, C, D, A,  5, 21, 0xFC93A039 );
+    P( A, B, C, D, 12,  6, 0x655B59C3 );
+    P( D, A, B, C,  3, 10, 0x8F0CCC92 );
+    P( C, D, A, B, 10, 15, 0xFFEFF47D );
+    P( B, C, D, A,  1, 21, 0x85845DD1 );
+    P( A, B, C, D,  8,  6, 0x6FA87E4F );
+    P( D, A, B, C, 15, 10, 0xFE2CE6E0 );
+    P( C, D, A, B,  6, 15, 0xA3014314 );
+    P( B, C, D, A, 13, 21, 0x4E0811A1 );
+    P( A, B, C, D,  4,  6, 0xF7537E82 );
+    P( D, A, B, C, 11, 10, 0xBD3AF235 );
+    P( C, D, A, B,  2, 15, 0x2AD7D2BB );
+    P( B, C, D, A,  9, 21, 0xEB86D391 );
+#undef F
+
+#undef P
+#undef S
+
+    state[0] += A;
+    state[1] += B;
+    state[2] += C;
+    state[3] += D;
+}
+
+
+void OldMD5::Write(const void *Buf, size_t BufLen)
+{
+	const uint1 *ByteBuf = (const uint1*)Buf;
+
+	int fill;
+	uint4 left;
+
+	if(BufLen == 0)
+		return;
+
+	left = total[0] & 0x3F;
+	fill = 64 - left;
+
+	total[0] += (uint4)BufLen;
+	total[0] &= 0xFFFFFFFF;
+
+	if(total[0] < BufLen)
+		total[1]++;
+
+	if(left && (int)BufLen >= fill)
+	{
+		memcpy((void*)(buffer + left), (const void*)ByteBuf, fill);
+		Process(buffer);
+		ByteBuf += fill;
+		BufLen -= fill;
+		left = 0;
+	}
+
+	while(BufLen >= 64)
+	{
+		Process(ByteBuf);
+		ByteBuf += 64;
+		BufLen -= 64;
+	}
+
+	if(BufLen > 0)
+		memcpy((void*)(buffer + left), (const void*)ByteBuf, BufLen);
+}
+
+void OldMD5::Finish(MD5_SUM *Out)
+{
+	static const uint1 md5_padding[64] = { 0x80 };
+	uint4 last, padn;
+	uint4 high, low;
+	uint1 msglen[8];
+
+	high = (total[0] >> 29) | (total[1] <<  3);
+	low  = (total[0] <<  3);
+
+	OLD_MD5_PUT_UINT32_LE(low,  msglen, 0);
+	OLD_MD5_PUT_UINT32_LE(high, msglen, 4);
+
+	last = total[0] & 0x3F;
+	padn = (last < 56) ? (56 - last) : (120 - last);
+
+	Write(md5_padding, padn);
+	Write(msglen, 8);
+
+	OLD_MD5_PUT_UINT32_LE(state[0], Out->Data,  0);
+	OLD_MD5_PUT_UINT32_LE(state[1], Out->Data,  4);
+	OLD_MD5_PUT_UINT32_LE(state[2], Out->Data,  8);
+	OLD_MD5_PUT_UINT32_LE(state[3], Out->Data, 12);
+}
+
+#undef OLD_MD5_GET_UINT32_LE
+#undef OLD_MD5_PUT_UINT32_LE
+
+// Cay wynik sumy kontrolnej do porwnania - krtsze sumy zajmuj pocztek, reszta to zera
+struct HASH_BENCH_RESULT
+{
+	uint1 Data[16];
+};
+
+// Funkcje liczce sum caego bufora
+static void BenchCrc32New(const char *Data, size_t Size, HASH_BENCH_RESULT *Out) { uint4 R = CRC32_Calc::Calc(Data, Size); memcpy(Out->Data, &R, sizeof(R)); }
+static void BenchCrc32Old(const char *Data, size_t Size, HASH_BENCH_RESULT *Out) { uint4 R = OldCrc32Calc(Data, Size); memcpy(Out->Data, &R, sizeof(R)); }
+static void BenchHashNew(const char *Data, size_t Size, HASH_BENCH_RESULT *Out) { uint4 R = Hash_Calc::Calc(Data, (uint4)Size); memcpy(Out->Data, &R, sizeof(R)); }
+static void BenchHashOld(const char *Data, size_t Size, HASH_BENCH_RESULT *Out) { uint4 R = OldHashCalc(Data, Size); memcpy(Out->Data, &R, sizeof(R)); }
+static void BenchMd5New(const char *Data, size_t Size, HASH_BENCH_RESULT *Out)
+{
+	MD5_SUM Sum;
+	MD5_Calc::Calc(&Sum, Data, (uint4)Size);
+	memcpy(Out->Data, Sum.Data, sizeof(Out->Data));
+}
+static void BenchMd5Old(const char *Data, size_t Size, HASH_BENCH_RESULT *Out)
+{
+	MD5_SUM Sum;
+	OldMD5 Md5;
+	Md5.Write(Data, Size);
+	Md5.Finish(&Sum);
+	memcpy(Out->Data, Sum.Data, sizeof(Out->Data));
+}
+
+typedef void (*HASH_BENCH_FUNC)(const char *Data, size_t Size, HASH_BENCH_RESULT *Out);
+
+// Zwraca przepustowo w MB/s - najlepsz z kilku przebiegw
+static double MeasureHash(HASH_BENCH_FUNC Func, const std::vector<char> &Buf, HASH_BENCH_RESULT *OutResult)
+{
+	double BestTime = 0.0;
+	for (uint Repeat = 0; Repeat < HASH_BENCH_REPEATS; Repeat++)
+	{
+		TimeMeasurer Timer;
+		ZeroMem(OutResult, sizeof(*OutResult));
+		Func(&Buf[0], Buf.size(), OutResult);
+		double Time = Timer.GetTimeD();
+		if (Repeat == 0 || Time < BestTime)
+			BestTime = Time;
+	}
+	return Buf.size() / (1024.0 * 1024.0) / BestTime;
+}
+
+static void BenchHashPair(const string &Name, HASH_BENCH_FUNC NewFunc, HASH_BENCH_FUNC OldFunc, const std::vector<char> &Buf)
+{
+	HASH_BENCH_RESULT NewResult, OldResult;
+	double NewSpeed = MeasureHash(NewFunc, Buf, &NewResult);
+	double OldSpeed = MeasureHash(OldFunc, Buf, &OldResult);
+	if (memcmp(NewResult.Data, OldResult.Data, sizeof(NewResult.Data)) != 0)
+		throw Error(Format("Hash test \"#\" failed: current and previous implementation give different results.") % Name);
+	Writeln(Format("  #: # MB/s (previous: # MB/s, x#)") % Name % NewSpeed % OldSpeed % (NewSpeed / OldSpeed));
+}
+
+static void HashBenchmark()
+{
+	Writeln(Format("Checksum throughput on # MB buffer...") % (HASH_BENCH_SIZE / (1024 * 1024)));
+
+	OldCrc32Init();
+
+	// Dane pseudolosowe (xorshift), zawsze te same
+	std::vector<char> Buf(HASH_BENCH_SIZE);
+	uint4 x = 2463534242u;
+	for (size_t i = 0; i < Buf.size(); i++)
+	{
+		x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+		Buf[i] = (char)(x >> 24);
+	}
+
+	BenchHashPair("CRC32_Calc", &BenchCrc32New, &BenchCrc32Old, Buf);
+	BenchHashPair("MD5_Calc", &BenchMd5New, &BenchMd5Old, Buf);
+	BenchHashPair("Hash_Calc", &BenchHashNew, &BenchHashOld, Buf);
+}
+
+
+//HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
+// JobScheduler
+
+// Liczba przebiegw testw obcieniowych - kady z inn liczb wtkw
+const uint JOB_STRESS_ITERATIONS = 16;
+const int JOB_FIB_N = 20;
+const uint JOB_SMALL_COUNT = 100000;
+const uint JOB_EXTERNAL_THREADS = 3;
+const uint JOB_EXTERNAL_COUNT = 20000;
+// Pomiar skalowania: tyle elementw, po tyle w zadaniu
+const uint JOB_SCALING_ITEMS = 400000;
+const uint JOB_SCALING_CHUNK = 1000;
+const uint JOB_SCALING_REPEATS = 5;
+const uint JOB_OVERHEAD_COUNT = 1000000;
+
+static int4 Fib(int4 n)
+{
+	return n < 2 ? n : Fib(n-1) + Fib(n-2);
+}
+
+// Rekurencyjny podzia z czekaniem na grup wewntrz zadania
+class FibJob : public Job
+{
+private:
+	JobScheduler *m_Scheduler;
+	int4 m_N;
+
+public:
+	int4 Result;
+
+	FibJob(JobScheduler *Scheduler, int4 N) : m_Scheduler(Scheduler), m_N(N), Result(0) { }
+
+	virtual void Execute()
+	{
+		if (m_N < 2)
+		{
+			Result = m_N;
+			return;
+		}
+		FibJob j1(m_Scheduler, m_N-1), j2(m_Scheduler, m_N-2);
+		JobGroup Group(m_Scheduler);
+		Group.Run(&j1);
+		j2.Execute();
+		Group.Wait();
+		Result = j1.Result + j2.Result;
+	}
+};
+
+// Zaznacza, e si wykonao - kade zadanie ma wasny licznik, wic nie trzeba operacji atomowych.
+// Licznik rny od 1 oznacza zadanie zgubione albo wykonane dwa razy.
+class MarkJob : public Job
+{
+private:
+	uint *m_Counter;
+
+public:
+	MarkJob(uint *Counter) : m_Counter(Counter) { }
+	virtual void Execute() { (*m_Counter)++; delete this; }
+};
+
+class ThrowJob : public Job
+{
+public:
+	virtual void Execute() { throw Error("Test error"); }
+};
+
+// Troch oblicze, eby zadanie trwao kilkadziesit mikrosekund
+class WorkJob : public Job
+{
+private:
+	uint m_Begin, m_End;
+	double *m_Out;
+
+public:
+	WorkJob() : m_Begin(0), m_End(0), m_Out(NULL) { }
+	void Set(uint Begin, uint End, double *Out) { m_Begin = Begin; m_End = End; m_Out = Out; }
+
+	virtual void Execute()
+	{
+		double Sum = 0.0;
+		for (uint i = m_Begin; i < m_End; i++)
+		{
+			double x = (double)i;
+			for (uint k = 0; k < 200; k++)
+				x = sqrt(x + k);
+			Sum += x;
+		}
+		*m_Out = Sum;
+	}
+};
+
+// Zleca zadania z wtku, ktry nie naley do planisty
+class ExternalJobThread : public Thread
+{
+private:
+	JobScheduler *m_Scheduler;
+	uint *m_Counters;
+	uint m_Count;
+
+protected:
+	virtual void Run()
+	{
+		JobGroup Group(m_Scheduler);
+		for (uint i = 0; i < m_Count; i++)
+			Group.Run(new MarkJob(&m_Counters[i]));
+		Group.Wait();
+	}
+
+public:
+	ExternalJobThread(JobScheduler *Scheduler, uint *Counters, uint Count) : m_Scheduler(Scheduler), m_Counters(Counters), m_Count(Count) { }
+};
+
+static void CheckCounters(const std::vector<uint> &Counters, const string &TestName)
+{
+	for (size_t i = 0; i < Counters.size(); i++)
+		if (Counters[i] != 1)
+			throw Error(Format("JobScheduler test \"#\" failed: job # executed # times.") % TestName % i % Counters[i]);
+}
+
+static void JobStressTests()
+{
+	Writeln("JobScheduler stress tests...");
+
+	int4 FibExpected = Fib(JOB_FIB_N);
+
+	for (uint Iteration = 0; Iteration < JOB_STRESS_ITERATIONS; Iteration++)
+	{
+		uint ThreadCount = 1 + Iteration % 8;
+		JobScheduler Scheduler(ThreadCount);
+
+		// Zagniedone Wait
+		{
+			FibJob Root(&Scheduler, JOB_FIB_N);
+			JobGroup Group(&Scheduler);
+			Group.Run(&Root);
+			Group.Wait();
+			if (Root.Result != FibExpected)
+				throw Error(Format("JobScheduler test \"Fib\" failed: # instead of #.") % Root.Result % FibExpected);
+		}
+
+		// Duo maych zada - rozrastanie si kolejki
+		{
+			std::vector<uint> Counters(JOB_SMALL_COUNT, 0);
+			JobGroup Group(&Scheduler);
+			for (uint i = 0; i < JOB_SMALL_COUNT; i++)
+				Group.Run(new MarkJob(&Counters[i]));
+			Group.Wait();
+			CheckCounters(Counters, "Small");
+		}
+
+		// Zlecanie z wtkw spoza planisty rwnoczenie ze zlecaniem z wtku planisty
+		{
+			std::vector<uint> Counters(JOB_EXTERNAL_COUNT * (JOB_EXTERNAL_THREADS + 1), 0);
+			std::vector< shared_ptr<ExternalJobThread> > Threads;
+			for (uint ti = 0; ti < JOB_EXTERNAL_THREADS; ti++)
+			{
+				Threads.push_back(shared_ptr<ExternalJobThread>(new ExternalJobThread(&Scheduler, &Counters[(ti+1) * JOB_EXTERNAL_COUNT], JOB_EXTERNAL_COUNT)));
+				Threads.back()->Start();
+			}
+			{
+				JobGroup Group(&Scheduler);
+				for (uint i = 0; i < JOB_EXTERNAL_COUNT; i++)
+					Group.Run(new MarkJob(&Counters[i]));
+				Group.Wait();
+			}
+			for (uint ti = 0; ti < JOB_EXTERNAL_THREADS; ti++)
+				Threads[ti]->Join();
+			CheckCounters(Counters, "External");
+		}
+
+		// Wyjtek z zadania wychodzi z Wait, a pozostae zadania i tak si wykonuj
+		{
+			std::vector<uint> Counters(100, 0);
+			ThrowJob Throwing;
+			JobGroup Group(&Scheduler);
+			Group.Run(&Throwing);
+			for (uint i = 0; i < Counters.size(); i++)
+				Group.Run(new MarkJob(&Counters[i]));
+			bool Caught = false;
+			try
+			{
+				Group.Wait();
+			}
+			catch (const Error &e)
+			{
+				string Msg;
+				e.GetMessage_(&Msg);
+				Caught = (Msg.find("Test error") != string::npos);
+			}
+			if (!Caught)
+				throw Error("JobScheduler test \"Exception\" failed: error not rethrown from Wait.");
+			CheckCounters(Counters, "Exception");
+			// Bd jest zgaszany tylko raz
+			Group.Wait();
+		}
+
+		Writeln(Format("  # threads: OK") % ThreadCount);
+	}
+
+	// Grupa bez planisty
+	{
+		std::vector<uint> Counters(10, 0);
+		JobGroup Group(NULL);
+		for (uint i = 0; i < Counters.size(); i++)
+			Group.Run(new MarkJob(&Counters[i]));
+		Group.Wait();
+		CheckCounters(Counters, "NULL scheduler");
+	}
+}
+
+static void JobScalingBenchmark(uint MaxThreads)
+{
+	if (MaxThreads == 0)
+		MaxThreads = GetCpuCount();
+	Writeln(Format("JobScheduler scaling (CPUs: #, cores: #)...") % GetCpuCount() % GetCpuCoreCount());
+
+	uint JobCount = JOB_SCALING_ITEMS / JOB_SCALING_CHUNK;
+	std::vector<WorkJob> Jobs(JobCount);
+	std::vector<double> Results(JobCount);
+	double BaseTime = 0.0;
+
+	for (uint ThreadCount = 1; ThreadCount <= MaxThreads; ThreadCount++)
+	{
+		JobScheduler Scheduler(ThreadCount);
+		double BestTime = 0.0;
+		for (uint Repeat = 0; Repeat < JOB_SCALING_REPEATS; Repeat++)
+		{
+			TimeMeasurer Timer;
+			JobGroup Group(&Scheduler);
+			for (uint i = 0; i < JobCount; i++)
+			{
+				Jobs[i].Set(i * JOB_SCALING_CHUNK, (i+1) * JOB_SCALING_CHUNK, &Results[i]);
+				Group.Run(&Jobs[i]);
+			}
+			Group.Wait();
+			double Time = Timer.GetTimeD();
+			if (Repeat == 0 || Time < BestTime)
+				BestTime = Time;
+		}
+		if (ThreadCount == 1)
+			BaseTime = BestTime;
+		Writeln(Format("  # threads: # ms, speedup #") % ThreadCount % (BestTime * 1000.0) % (BaseTime / BestTime));
+	}
+
+	// Koszt samego zlecenia i wykonania pustego zadania, razem z new i delete
+	{
+		JobScheduler Scheduler(1);
+		std::vector<uint> Counters(JOB_OVERHEAD_COUNT, 0);
+		TimeMeasurer Timer;
+		JobGroup Group(&Scheduler);
+		for (uint i = 0; i < JOB_OVERHEAD_COUNT; i++)
+			Group.Run(new MarkJob(&Counters[i]));
+		Group.Wait();
+		double Time = Timer.GetTimeD();
+		Writeln(Format("  Overhead: # ns per job") % (Time * 1e9 / JOB_OVERHEAD_COUNT));
+	}
+}
+
+
+//HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
+// Algorytmy rwnolege
+
+// Rozmiary danych - puste, mniejsze od progw i wiksze od nich (nie wielokrotnoci kawakw)
+const uint PARALLEL_TEST_SIZES[] = { 0, 1, 100, 8193, 100000, 1000003 };
+const uint PARALLEL_TEST_SIZE_COUNT = sizeof(PARALLEL_TEST_SIZES) / sizeof(PARALLEL_TEST_SIZES[0]);
+// Liczba wtkw sprawdzana od 0 (bez planisty) do tylu
+const uint PARALLEL_TEST_MAX_THREADS = 8;
+const size_t PARALLEL_TEST_REDUCE_GRAIN = 1000;
+
+struct SORT_ITEM
+{
+	uint4 Key;
+	uint4 Index;
+};
+
+// Porwnuje tylko klucze - kolejno elementw o rwnych kluczach zaley od sortowania
+class SortItemKeyLess
+{
+public:
+	bool operator () (const SORT_ITEM &a, const SORT_ITEM &b) const { return a.Key < b.Key; }
+};
+
+// Porwnuje cae elementy
+class SortItemLess
+{
+public:
+	bool operator () (const SORT_ITEM &a, const SORT_ITEM &b) const { return a.Key < b.Key || (a.Key == b.Key && a.Index < b.Index); }
+};
+
+static bool SortItemsEqual(const std::vector<SORT_ITEM> &A, const std::vector<SORT_ITEM> &B)
+{
+	if (A.size() != B.size())
+		return false;
+	for (size_t i = 0; i < A.size(); i++)
+		if (A[i].Key != B[i].Key || A[i].Index != B[i].Index)
+			return false;
+	return true;
+}
+
+// Funktory dla ParallelReduce - sumy czciowe [b, e)
+class SumUintFunc
+{
+private:
+	const std::vector<uint4> &m_Data;
+
+public:
+	SumUintFunc(const std::vector<uint4> &Data) : m_Data(Data) { }
+
+	uint8 operator () (size_t b, size_t e) const
+	{
+		uint8 Sum = 0;
+		for (size_t i = b; i < e; i++)
+			Sum += m_Data[i];
+		return Sum;
+	}
+};
+
+class SumFloatFunc
+{
+private:
+	const std::vector<float> &m_Data;
+
+public:
+	SumFloatFunc(const std::vector<float> &Data) : m_Data(Data) { }
+
+	float operator () (size_t b, size_t e) const
+	{
+		float Sum = 0.f;
+		for (size_t i = b; i < e; i++)
+			Sum += m_Data[i];
+		return Sum;
+	}
+};
+
+// Wyniki dla jednego rozmiaru danych, z ktrymi porwnywane s przebiegi z inn liczb wtkw
+struct PARALLEL_TEST_DATA
+{
+	std::vector<uint4> Values;
+	std::vector<float> Floats;
+	// Oczekiwane wyniki: std::stable_sort, std::accumulate
+	std::vector<uint4> SortedValues;
+	std::vector<SORT_ITEM> SortedItems;
+	uint8 UintSum;
+	// Pierwsze wyniki (bez planisty) - dla sprawdzenia, e nie zale od liczby wtkw
+	std::vector<SORT_ITEM> FirstKeySortedItems;
+	float FirstFloatSum;
+};
+
+static void ParallelTestFailed(const string &TestName, uint ThreadCount, size_t Size)
+{
+	throw Error(Format("Parallel algorithms test \"#\" failed: # threads, # elements.") % TestName % ThreadCount % Size);
+}
+
+static void CheckParallelAlgorithms(PARALLEL_TEST_DATA &Data, uint ThreadCount)
+{
+	size_t Size = Data.Values.size();
+
+	// ParallelSort wg operatora <
+	{
+		std::vector<uint4> V = Data.Values;
+		ParallelSort(V.begin(), V.end());
+		if (V != Data.SortedValues)
+			ParallelTestFailed("Sort", ThreadCount, Size);
+	}
+
+	// ParallelSort wg samych kluczy - nie jest stabilne, wic porwnanie z std::stable_sort
+	// dopiero po uporzdkowaniu rwnych kluczy, a kolejno musi by ta sama dla kadej liczby wtkw
+	{
+		std::vector<SORT_ITEM> Items(Size);
+		for (size_t i = 0; i < Size; i++)
+		{
+			Items[i].Key = Data.Values[i];
+			Items[i].Index = (uint4)i;
+		}
+		ParallelSort(Items.begin(), Items.end(), SortItemKeyLess());
+
+		if (ThreadCount == 0)
+			Data.FirstKeySortedItems = Items;
+		else if (!SortItemsEqual(Items, Data.FirstKeySortedItems))
+			ParallelTestFailed("Sort determinism", ThreadCount, Size);
+
+		for (size_t i = 0; i < Size; i++)
+			if (Items[i].Key != Data.SortedItems[i].Key)
+				ParallelTestFailed("Sort by key", ThreadCount, Size);
+		std::sort(Items.begin(), Items.end(), SortItemLess());
+		if (!SortItemsEqual(Items, Data.SortedItems))
+			ParallelTestFailed("Sort by key (permutation)", ThreadCount, Size);
+	}
+
+	// ParallelReduce - suma cakowita musi by dokadna
+	{
+		uint8 Sum = ParallelReduce(0, Size, PARALLEL_TEST_REDUCE_GRAIN, (uint8)0, SumUintFunc(Data.Values), std::plus<uint8>());
+		if (Sum != Data.UintSum)
+			ParallelTestFailed("Reduce", ThreadCount, Size);
+	}
+
+	// ParallelReduce - suma zmiennoprzecinkowa bit w bit taka sama dla kadej liczby wtkw
+	// i bliska std::accumulate (dodajcej w innej kolejnoci)
+	{
+		float Sum = ParallelReduce(0, Size, PARALLEL_TEST_REDUCE_GRAIN, 0.f, SumFloatFunc(Data.Floats), std::plus<float>());
+		if (ThreadCount == 0)
+		{
+			Data.FirstFloatSum = Sum;
+			float Expected = std::accumulate(Data.Floats.begin(), Data.Floats.end(), 0.f);
+			if (fabsf(Sum - Expected) > 1e-3f * std::max(1.f, fabsf(Expected)))
+				ParallelTestFailed("Reduce float", ThreadCount, Size);
+		}
+		else if (memcmp(&Sum, &Data.FirstFloatSum, sizeof(Sum)) != 0)
+			ParallelTestFailed("Reduce float determinism", ThreadCount, Size);
+	}
+}
+
+static void ParallelTestsImpl()
+{
+	// Dane pseudolosowe, zawsze te same. Klucze z maego zakresu, eby byo duo rwnych.
+	std::vector<PARALLEL_TEST_DATA> Data(PARALLEL_TEST_SIZE_COUNT);
+	RandomGenerator Rand(2463534242u);
+	for (uint si = 0; si < PARALLEL_TEST_SIZE_COUNT; si++)
+	{
+		PARALLEL_TEST_DATA &D = Data[si];
+		uint Size = PARALLEL_TEST_SIZES[si];
+		D.Values.resize(Size);
+		D.Floats.resize(Size);
+		D.SortedItems.resize(Size);
+		for (uint i = 0; i < Size; i++)
+		{
+			D.Values[i] = Rand.RandUint(Size / 4 + 1);
+			D.Floats[i] = Rand.RandFloat();
+			D.SortedItems[i].Key = D.Values[i];
+			D.SortedItems[i].Index = i;
+		}
+		D.SortedValues = D.Values;
+		std::stable_sort(D.SortedValues.begin(), D.SortedValues.end());
+		std::stable_sort(D.SortedItems.begin(), D.SortedItems.end(), SortItemKeyLess());
+		D.UintSum = std::accumulate(D.Values.begin(), D.Values.end(), (uint8)0);
+		D.FirstFloatSum = 0.f;
+	}
+
+	for (uint ThreadCount = 0; ThreadCount <= PARALLEL_TEST_MAX_THREADS; ThreadCount++)
+	{
+		g_JobScheduler.reset(ThreadCount == 0 ? NULL : new JobScheduler(ThreadCount));
+		for (uint si = 0; si < PARALLEL_TEST_SIZE_COUNT; si++)
+			CheckParallelAlgorithms(Data[si], ThreadCount);
+		Writeln(Format("  # threads: OK") % ThreadCount);
+	}
+}
+
+static void ParallelTests()
+{
+	Writeln("ParallelSort and ParallelReduce tests...");
+
+	// Testy podmieniaj globalny planista na wasne, z rn liczb wtkw
+	scoped_ptr<JobScheduler> SavedScheduler;
+	SavedScheduler.swap(g_JobScheduler);
+	try
+	{
+		ParallelTestsImpl();
+	}
+	catch (...)
+	{
+		g_JobScheduler.swap(SavedScheduler);
+		throw;
+	}
+	g_JobScheduler.swap(SavedScheduler);
+}
+
+
+//HHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHHH
+// Gwna funkcja
+
+void DoBenchJob(BenchJob &Job)
+{
+	bool All = !Job.Hash && !Job.Jobs && !Job.Parallel;
+
+	if (All || Job.Hash)
+		HashBenchmark();
+	if (All || Job.Jobs)
+	{
+		JobStressTests();
+		JobScalingBenchmark(Job.MaxThreads);
+	}
+	if (All || Job.Parallel)
+		ParallelTests();
+}
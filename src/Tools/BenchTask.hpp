@@ -0,0 +1,25 @@
+/*
+ * The Final Quest - 3D Graphics Engine
+ * Copyright (C) 2007  Adam Sawicki
+ * http://regedit.gamedev.pl, sawickiap@poczta.onet.pl
+ * License: GNU GPL
+ */
+#pragma once
+
+struct BenchJob
+{
+	// Przepustowo CRC32_Calc, MD5_Calc i Hash_Calc w porwnaniu z ich poprzednimi implementacjami
+	bool Hash;
+	// Testy obcieniowe JobScheduler i pomiar jego skalowania
+	bool Jobs;
+	// Poprawno ParallelSort i ParallelReduce w porwnaniu z std::stable_sort i std::accumulate
+	bool Parallel;
+	// Najwiksza liczba wtkw w pomiarze skalowania. 0 - GetCpuCount().
+	uint MaxThreads;
+
+	BenchJob() : Hash(false), Jobs(false), Parallel(false), MaxThreads(0) { }
+};
+
+// Jeli aden test nie zosta wybrany, wykonuje wszystkie.
+// Niepoprawny wynik testu zgasza jako bd.
+void DoBenchJob(BenchJob &Job);
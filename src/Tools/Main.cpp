@@ -8,6 +8,8 @@
 #include "MeshTask.hpp"
 #include "MapTask.hpp"
 #include "TextureTask.hpp"
+#include "PackTask.hpp"
+#include "BenchTask.hpp"
 
 
 void PrintIntro()
@@ -23,11 +25,16 @@ int main(int argc, char **argv)
 {
 	try
 	{
+		// Planista zada dla ptli rwnolegych (ParallelFor itp.)
+		g_JobScheduler.reset(new JobScheduler());
+
 		CmdLineParser Parser(argc, argv);
 
 		Parser.RegisterOpt(1, "Mesh", false);
 		Parser.RegisterOpt(2, "Map", false);
 		Parser.RegisterOpt(3, "Texture", false);
+		Parser.RegisterOpt(4, "Pack", false);
+		Parser.RegisterOpt(5, "Bench", false);
 		Parser.RegisterOpt(1001, 'i', true);
 		Parser.RegisterOpt(1002, 'o', true);
 		Parser.RegisterOpt(1003, 'I', false);
@@ -81,6 +88,13 @@ int main(int argc, char **argv)
 		Parser.RegisterOpt(7002, "Swizzle", true);
 		Parser.RegisterOpt(7003, "SharpenAlpha", true);
 		Parser.RegisterOpt(7004, "ClampTransparent", false);
+		Parser.RegisterOpt(8001, "Compress", true);
+		Parser.RegisterOpt(9001, "Cache", true);
+		Parser.RegisterOpt(9002, "CacheSize", true);
+		Parser.RegisterOpt(10001, "Jobs", false);
+		Parser.RegisterOpt(10002, "Hash", false);
+		Parser.RegisterOpt(10003, "Threads", true);
+		Parser.RegisterOpt(10004, "Parallel", false);
 
 		CmdLineParser::RESULT R = Parser.ReadNext();
 		if (R == CmdLineParser::RESULT_END)
@@ -102,6 +116,8 @@ int main(int argc, char **argv)
 						break;
 					else if (R == CmdLineParser::RESULT_OPT)
 					{
+						if (Job.Cache.ParseOpt(Parser))
+							continue;
 						switch (Parser.GetOptId())
 						{
 						case 1001:
@@ -264,6 +280,8 @@ int main(int argc, char **argv)
 						break;
 					else if (R == CmdLineParser::RESULT_OPT)
 					{
+						if (Job.Cache.ParseOpt(Parser))
+							continue;
 						switch (Parser.GetOptId())
 						{
 						case 1001:
@@ -332,6 +350,8 @@ int main(int argc, char **argv)
 						break;
 					else if (R == CmdLineParser::RESULT_OPT)
 					{
+						if (Job.Cache.ParseOpt(Parser))
+							continue;
 						switch (Parser.GetOptId())
 						{
 						case 2009: // /AlphaThreshold
@@ -388,17 +408,86 @@ int main(int argc, char **argv)
 				}
 				DoTextureJob(Job);
 			}
+			// /Pack
+			else if (Parser.GetOptId() == 4)
+			{
+				PackJob Job;
+
+				for (;;)
+				{
+					R = Parser.ReadNext();
+					if (R == CmdLineParser::RESULT_END)
+						break;
+					else if (R == CmdLineParser::RESULT_OPT)
+					{
+						switch (Parser.GetOptId())
+						{
+						case 1001: // /i
+							Job.InputDirs.push_back(Parser.GetParameter());
+							break;
+						case 1002: // /o
+							Job.OutputFileName = Parser.GetParameter();
+							break;
+						case 8001: // /Compress
+							Job.CompressMasks.push_back(Parser.GetParameter());
+							break;
+						default:
+							ThrowCmdLineSyntaxError();
+						}
+					}
+					else
+						ThrowCmdLineSyntaxError();
+				}
+				DoPackJob(Job);
+			}
+			// /Bench
+			else if (Parser.GetOptId() == 5)
+			{
+				BenchJob Job;
+
+				for (;;)
+				{
+					R = Parser.ReadNext();
+					if (R == CmdLineParser::RESULT_END)
+						break;
+					else if (R == CmdLineParser::RESULT_OPT)
+					{
+						switch (Parser.GetOptId())
+						{
+						case 10001: // /Jobs
+							Job.Jobs = true;
+							break;
+						case 10002: // /Hash
+							Job.Hash = true;
+							break;
+						case 10003: // /Threads
+							MustStrToSth<uint>(&Job.MaxThreads, Parser.GetParameter());
+							break;
+						case 10004: // /Parallel
+							Job.Parallel = true;
+							break;
+						default:
+							ThrowCmdLineSyntaxError();
+						}
+					}
+					else
+						ThrowCmdLineSyntaxError();
+				}
+				DoBenchJob(Job);
+			}
 			else
 				ThrowCmdLineSyntaxError();
 		}
 		else
 			ThrowCmdLineSyntaxError();
 
+		g_JobScheduler.reset();
 		Writeln("Done.");
 		return 0;
 	}
 	catch (const Error &e)
 	{
+		g_JobScheduler.reset();
 		string Msg;
 		e.GetMessage_(&Msg, "  ");
 		Writeln("ERROR:");
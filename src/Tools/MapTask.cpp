@@ -423,7 +423,8 @@ void LoadQmapTmpFile(TMP_QMAP *Out, const string &FileName)
 	Writeln("Loading QMAP TMP file \"" + FileName + "\"...");
 
 	FileStream input_file(FileName, FM_READ);
-	Tokenizer tokenizer(&input_file, 0);
+	BufferedReadStream buffered_input(&input_file);
+	Tokenizer tokenizer(&buffered_input, 0);
 
 	tokenizer.RegisterKeyword(1, "objects");
 	tokenizer.RegisterKeyword(2, "mesh");
@@ -535,7 +536,8 @@ void LoadDescFile(QMAP_DESC *Out, const string &FileName)
 	Writeln("Loading QMAP DESC file \"" + FileName + "\"...");
 
 	FileStream input_file(FileName, FM_READ);
-	Tokenizer tokenizer(&input_file, 0);
+	BufferedReadStream buffered_input(&input_file);
+	Tokenizer tokenizer(&buffered_input, 0);
 	tokenizer.Next();
 
 	// Nagwek
@@ -958,40 +960,68 @@ void CreateCollisionFragment(QMAP_COLLISION_NODE &OutNode, const INTER_FACE_DEQU
 	OutNode.IndexEnd = Qmap.CollisionIB.size();
 }
 
-// Funkcja rekurencyjna, budujca Draw Octree
-void ProcessDrawNode(uint Level, QMAP_DRAW_NODE &DrawNode, INTER_FACE_COLLECTION &FaceCollection, QMAP &Qmap, const MapJob &Job)
+// Poniej tylu cianek w wle rozdzielanie na podwzy idzie szeregowo - zadania kosztowayby wicej ni praca
+const size_t DRAW_NODE_PARALLEL_MIN_FACES = 4096;
+
+// Funktor dla ParallelFor - rozdziela midzy podwzy cianki materiaw [mi1, mi2)
+// Kady materia ma osobne listy cianek, wic materiay mog by przetwarzane rwnolegle.
+class DrawNodeSplitFunc
 {
-	// S podwzy
-	if (Level < Job.MaxOctreeDepth && DrawNodeRequiresSubdivide(FaceCollection))
-	{
-		// cianki dla wzw potomnych - pocztkowo puste listy
-		INTER_FACE_COLLECTION FaceCollectionSub[8];
-		for (uint si = 0; si < 8; si++)
-			FaceCollectionSub[si].resize(FaceCollection.size());
+private:
+	INTER_FACE_COLLECTION &m_FaceCollection;
+	INTER_FACE_COLLECTION *m_FaceCollectionSub;
+	const BOX *m_SubBounds;
 
-		// Granice wzw potomnych
-		BOX SubBounds[8];
-		BuildSubBounds(SubBounds, DrawNode.Bounds, Job.OctreeK);
+public:
+	DrawNodeSplitFunc(INTER_FACE_COLLECTION &FaceCollection, INTER_FACE_COLLECTION FaceCollectionSub[8], const BOX SubBounds[8]) : m_FaceCollection(FaceCollection), m_FaceCollectionSub(FaceCollectionSub), m_SubBounds(SubBounds) { }
 
-		// Dla kadego materiau
-		for (uint mi = 0; mi < FaceCollection.size(); mi++)
+	void operator () (size_t mi1, size_t mi2) const
+	{
+		for (uint mi = (uint)mi1; mi < (uint)mi2; mi++)
 		{
 			// Dla kadej cianki
-			for (uint fi = 0; fi < FaceCollection[mi].size(); fi++)
+			for (uint fi = 0; fi < m_FaceCollection[mi].size(); fi++)
 			{
 				// Dla kadego podwza
 				for (uint si = 0; si < 8; si++)
 				{
 					// Jeli cianka zawiera si w caoci w tym podwle, przenie j do niego
-					if (InterFaceInBox(*FaceCollection[mi][fi], SubBounds[si]))
+					if (InterFaceInBox(*m_FaceCollection[mi][fi], m_SubBounds[si]))
 					{
-						FaceCollectionSub[si][mi].push_back(FaceCollection[mi][fi]);
-						FaceCollection[mi][fi] = NULL;
+						m_FaceCollectionSub[si][mi].push_back(m_FaceCollection[mi][fi]);
+						m_FaceCollection[mi][fi] = NULL;
 						break;
 					}
 				}
 			}
 		}
+	}
+};
+
+// Funkcja rekurencyjna, budujca Draw Octree
+void ProcessDrawNode(uint Level, QMAP_DRAW_NODE &DrawNode, INTER_FACE_COLLECTION &FaceCollection, QMAP &Qmap, const MapJob &Job)
+{
+	// S podwzy
+	if (Level < Job.MaxOctreeDepth && DrawNodeRequiresSubdivide(FaceCollection))
+	{
+		// cianki dla wzw potomnych - pocztkowo puste listy
+		INTER_FACE_COLLECTION FaceCollectionSub[8];
+		for (uint si = 0; si < 8; si++)
+			FaceCollectionSub[si].resize(FaceCollection.size());
+
+		// Granice wzw potomnych
+		BOX SubBounds[8];
+		BuildSubBounds(SubBounds, DrawNode.Bounds, Job.OctreeK);
+
+		// Dla kadego materiau - rwnolegle, jeli cianek jest duo
+		size_t FaceC = 0;
+		for (uint mi = 0; mi < FaceCollection.size(); mi++)
+			FaceC += FaceCollection[mi].size();
+		DrawNodeSplitFunc SplitFunc(FaceCollection, FaceCollectionSub, SubBounds);
+		if (FaceC >= DRAW_NODE_PARALLEL_MIN_FACES)
+			ParallelFor(0, FaceCollection.size(), 1, SplitFunc);
+		else
+			SplitFunc(0, FaceCollection.size());
 
 		// Jeli jakie cianki zostay odesane do podwzw
 		uint SubFaceC = 0;
@@ -1352,6 +1382,22 @@ void InfoTask(QMAP &Qmap, MapJob &Job, InfoMapTask &Task)
 
 void DoMapJob(MapJob &Job)
 {
+	OutputCache Cache(Job.Cache, "Map");
+	if (!Job.DescFileName.empty())
+		Cache.AddInputFile(Job.DescFileName);
+	for (uint ti = 0; ti < Job.Tasks.size(); ti++)
+	{
+		MapTask &t = *Job.Tasks[ti].get();
+		if (typeid(t) == typeid(InputMapTask))
+			Cache.AddInputFile(((InputMapTask&)t).FileName);
+		else if (typeid(t) == typeid(OutputMapTask))
+			Cache.AddOutputFile(((OutputMapTask&)t).FileName);
+		else if (typeid(t) == typeid(InfoMapTask))
+			Cache.Disable();
+	}
+	if (Cache.Restore())
+		return;
+
 	scoped_ptr<QMAP> Map;
 
 	for (uint ti = 0; ti < Job.Tasks.size(); ti++)
@@ -1378,4 +1424,6 @@ void DoMapJob(MapJob &Job)
 		else
 			throw Error("Nienznany typ zadania.");
 	}
+
+	Cache.Store();
 }
@@ -6,6 +6,8 @@
  */
 #pragma once
 
+#include "OutputCache.hpp"
+
 // Abstrakcyjna klasa bazowa dla zada
 struct MapTask : public Task
 {
@@ -42,6 +44,8 @@ struct MapJob
 	float OctreeK;
 	uint MaxOctreeDepth;
 
+	OutputCacheParams Cache;
+
 	MapJob();
 	~MapJob();
 };
@@ -274,6 +274,8 @@ struct QMSH
 {
 	static const uint FLAG_TANGENTS = 0x01;
 	static const uint FLAG_SKINNING = 0x02;
+	// Tylko w pliku - za nagwkiem zapisane s dodatkowe bryy otaczajce
+	static const uint FLAG_EXTRA_BOUNDING_VOLUMES = 0x04;
 
 	uint Flags;
 	std::vector<QMSH_VERTEX> Vertices;
@@ -285,10 +287,16 @@ struct QMSH
 	// Bryy otaczajce
 	// Dotycz wierzchokw w pozycji spoczynkowej.
 	bool BoundingVolumesCalculated;
-	float BoundingSphereRadius;
+	float BoundingSphereRadius; // Sfera o rodku w (0,0,0)
 	BOX BoundingBox;
-
-	QMSH() : BoundingVolumesCalculated(false) { }
+	// Dodatkowe bryy otaczajce - mog by niewyliczone, mimo e powysze s (plik bez FLAG_EXTRA_BOUNDING_VOLUMES)
+	bool ExtraBoundingVolumesCalculated;
+	// Najmniejsza sfera otaczajca
+	VEC3 MinBoundingSphereCenter;
+	float MinBoundingSphereRadius;
+	OBB BoundingObb;
+
+	QMSH() : BoundingVolumesCalculated(false), ExtraBoundingVolumesCalculated(false) { }
 };
 
 
@@ -627,14 +635,40 @@ void CalcBoundingVolumes(const QMSH &Qmsh, float *OutSphereRadius, BOX *OutBox)
 	}
 }
 
+// Wylicza najmniejsz sfer otaczajc i OBB
+void CalcExtraBoundingVolumes(const QMSH &Qmsh, VEC3 *OutSphereCenter, float *OutSphereRadius, OBB *OutObb)
+{
+	if (Qmsh.Vertices.empty())
+	{
+		*OutSphereCenter = VEC3::ZERO;
+		*OutSphereRadius = 0.f;
+		OutObb->Center = VEC3::ZERO;
+		OutObb->Axes[0] = VEC3::POSITIVE_X;
+		OutObb->Axes[1] = VEC3::POSITIVE_Y;
+		OutObb->Axes[2] = VEC3::POSITIVE_Z;
+		OutObb->HalfSize = VEC3::ZERO;
+	}
+	else
+	{
+		std::vector<VEC3> Points(Qmsh.Vertices.size());
+		for (uint i = 0; i < Qmsh.Vertices.size(); i++)
+			Points[i] = Qmsh.Vertices[i].Pos;
+
+		SphereBoundingPoints_Exact(OutSphereCenter, OutSphereRadius, &Points[0], Points.size());
+		ObbBoundingPoints(OutObb, &Points[0], Points.size());
+	}
+}
+
 // Wylicza parametry bry otaczajcych siatk
 void CalcBoundingVolumes(QMSH &Qmsh)
 {
 	Writeln("Calculating bounding volumes...");
 
 	CalcBoundingVolumes(Qmsh, &Qmsh.BoundingSphereRadius, &Qmsh.BoundingBox);
+	CalcExtraBoundingVolumes(Qmsh, &Qmsh.MinBoundingSphereCenter, &Qmsh.MinBoundingSphereRadius, &Qmsh.BoundingObb);
 
 	Qmsh.BoundingVolumesCalculated = true;
+	Qmsh.ExtraBoundingVolumesCalculated = true;
 }
 
 // Wylicza w razie potrzeby parametry bry otaczajcych siatk
@@ -642,12 +676,19 @@ void EnsureBoundingVolumes(QMSH &Qmsh)
 {
 	if (!Qmsh.BoundingVolumesCalculated)
 		CalcBoundingVolumes(Qmsh);
+	else if (!Qmsh.ExtraBoundingVolumesCalculated)
+	{
+		Writeln("Calculating extra bounding volumes...");
+		CalcExtraBoundingVolumes(Qmsh, &Qmsh.MinBoundingSphereCenter, &Qmsh.MinBoundingSphereRadius, &Qmsh.BoundingObb);
+		Qmsh.ExtraBoundingVolumesCalculated = true;
+	}
 }
 
 // Uniewania bryy otaczajce siatk
 void InvalidateBoundingVolumes(QMSH &Qmsh)
 {
 	Qmsh.BoundingVolumesCalculated = false;
+	Qmsh.ExtraBoundingVolumesCalculated = false;
 }
 
 // Liczy kolizj punktu z bry wyznaczon przez dwie poczone kule, kada ma swj rodek i promie
@@ -701,7 +742,8 @@ float PointToBone(
 void LoadQmshTmpFile(tmp::QMSH *Out, const string &FileName)
 {
 	FileStream input_file(FileName, FM_READ);
-	Tokenizer tokenizer(&input_file, 0);
+	BufferedReadStream buffered_input(&input_file);
+	Tokenizer tokenizer(&buffered_input, 0);
 
 	tokenizer.RegisterKeyword( 1, "objects");
 	tokenizer.RegisterKeyword( 2, "mesh");
@@ -1510,6 +1552,124 @@ struct INTERMEDIATE_VERTEX_SKIN_DATA
 	float Weight1;
 };
 
+// Typ reprezentuje dla danej koci grup wierzchokw: Indeks wierzchoka => Waga
+typedef std::map<uint, float> VERTEX_INFLUENCE_MAP;
+
+// Funktor dla ParallelFor - liczy wpyw koci na wierzchoki [vi1, vi2) przez Vertex Groups lub Envelopes.
+// Dane wejciowe tylko czyta, a pisze wycznie do elementw Out tych wierzchokw.
+class VertexSkinDataFunc
+{
+private:
+	std::vector<INTERMEDIATE_VERTEX_SKIN_DATA> *m_Out;
+	const tmp::MESH &m_TmpMesh;
+	const QMSH &m_Qmsh;
+	const tmp::QMSH &m_QmshTmp;
+	const std::vector<tmp::BONE_INTER_DATA> &m_BoneInterData;
+	const std::vector<VERTEX_INFLUENCE_MAP> &m_BoneInfluences;
+
+public:
+	VertexSkinDataFunc(
+		std::vector<INTERMEDIATE_VERTEX_SKIN_DATA> *Out,
+		const tmp::MESH &TmpMesh,
+		const QMSH &Qmsh,
+		const tmp::QMSH &QmshTmp,
+		const std::vector<tmp::BONE_INTER_DATA> &BoneInterData,
+		const std::vector<VERTEX_INFLUENCE_MAP> &BoneInfluences)
+	: m_Out(Out), m_TmpMesh(TmpMesh), m_Qmsh(Qmsh), m_QmshTmp(QmshTmp), m_BoneInterData(BoneInterData), m_BoneInfluences(BoneInfluences)
+	{
+	}
+
+	void operator () (size_t vi1, size_t vi2) const;
+};
+
+void VertexSkinDataFunc::operator () (size_t vi1, size_t vi2) const
+{
+	for (uint vi = (uint)vi1; vi < (uint)vi2; vi++)
+	{
+		// Zbierz wszystkie wpywajce na niego koci
+		struct INFLUENCE
+		{
+			uint BoneIndex; // Uwaga! Wyej byo VertexIndex -> Weight, a tutaj jest BoneIndex -> Weight - ale masakra !!!
+			float Weight;
+
+			bool operator > (const INFLUENCE &Influence) const { return Weight > Influence.Weight; }
+		};
+		std::vector<INFLUENCE> VertexInfluences;
+
+		// Wpyw przez Vertex Groups
+		if (m_QmshTmp.Armature->VertexGroups)
+		{
+			for (uint bi = 0; bi < m_Qmsh.Bones.size(); bi++)
+			{
+				VERTEX_INFLUENCE_MAP::const_iterator biit = m_BoneInfluences[bi].find(vi);
+				if (biit != m_BoneInfluences[bi].end())
+				{
+					INFLUENCE Influence = { bi + 1, biit->second };
+					VertexInfluences.push_back(Influence);
+				}
+			}
+		}
+
+		// adna ko na niego nie wpywa - wypyw z Envelopes
+		if (VertexInfluences.empty() && m_QmshTmp.Armature->Envelopes)
+		{
+			// U list wpywajcych koci
+			for (uint bi = 0; bi < m_Qmsh.Bones.size(); bi++)
+			{
+				// Nie jestem pewny czy to jest dokadnie algorytm uywany przez Blender,
+				// nie jest nigdzie dokadnie opisany, ale z eksperymentw podejrzewam, e tak.
+				// Ko w promieniu - wpyw maksymalny.
+				// Ko w zakresie czego co nazwaem Extra Envelope te jest wpyw (podejrzewam e sabnie z odlegoci)
+				// Promie Extra Envelope, jak udao mi si wreszcie ustali, jest niezaleny od Radius w sensie
+				// e rozciga si ponad Radius zawsze na tyle ile wynosi (BoneLength / 4)
+
+				// Dodatkowy promie zewntrzny
+				float ExtraEnvelopeRadius = m_BoneInterData[bi].Length * 0.25f;
+
+				// Pozycja wierzchoka ju jest w ukadzie globalnym modelu i w konwencji DirectX
+				float W = PointToBone(
+					m_TmpMesh.Vertices[vi].Pos,
+					m_BoneInterData[bi].HeadPos, m_BoneInterData[bi].HeadRadius, m_BoneInterData[bi].HeadRadius + ExtraEnvelopeRadius,
+					m_BoneInterData[bi].TailPos, m_BoneInterData[bi].TailRadius, m_BoneInterData[bi].TailRadius + ExtraEnvelopeRadius);
+
+				if (W > 0.f)
+				{
+					INFLUENCE Influence = { bi + 1, W };
+					VertexInfluences.push_back(Influence);
+				}
+			}
+		}
+		// Jakie koci na niego wpywaj - we z tych koci
+
+		// Zero koci
+		if (VertexInfluences.empty())
+		{
+			(*m_Out)[vi].Index1 = 0;
+			(*m_Out)[vi].Index2 = 0;
+			(*m_Out)[vi].Weight1 = 1.f;
+		}
+		// Tylko jedna ko
+		else if (VertexInfluences.size() == 1)
+		{
+			(*m_Out)[vi].Index1 = VertexInfluences[0].BoneIndex;
+			(*m_Out)[vi].Index2 = VertexInfluences[0].BoneIndex;
+			(*m_Out)[vi].Weight1 = 1.f;
+		}
+		// Dwie lub wicej koci na licie wpywajcych na ten wierzchoek
+		else
+		{
+			// Posortuj wpywy na wierzchoek malejco, czyli od najwikszej wagi
+			std::sort(VertexInfluences.begin(), VertexInfluences.end(), std::greater<INFLUENCE>());
+			// We dwie najwaniejsze koci
+			(*m_Out)[vi].Index1 = VertexInfluences[0].BoneIndex;
+			(*m_Out)[vi].Index2 = VertexInfluences[1].BoneIndex;
+			// Oblicz wag pierwszej
+			// WANY WZR NA ZNORMALIZOWAN WAG PIERWSZ Z DWCH DOWOLNYCH WAG !!!
+			(*m_Out)[vi].Weight1 = VertexInfluences[0].Weight / (VertexInfluences[0].Weight + VertexInfluences[1].Weight);
+		}
+	}
+}
+
 void CalcVertexSkinData(
 	std::vector<INTERMEDIATE_VERTEX_SKIN_DATA> *Out,
 	const tmp::MESH &TmpMesh,
@@ -1561,9 +1721,7 @@ void CalcVertexSkinData(
 	{
 		// U szybk list wierzchokw z wagami dla kadej koci
 
-		// Typ reprezentuje dla danej koci grup wierzchokw: Indeks wierzchoka => Waga
-		typedef std::map<uint, float> INFLUENCE_MAP;
-		std::vector<INFLUENCE_MAP> BoneInfluences;
+		std::vector<VERTEX_INFLUENCE_MAP> BoneInfluences;
 		BoneInfluences.resize(Qmsh.Bones.size());
 		// Dla kadej koci
 		for (uint bi = 0; bi < Qmsh.Bones.size(); bi++)
@@ -1584,98 +1742,15 @@ void CalcVertexSkinData(
 				const tmp::VERTEX_GROUP & VertexGroup = *TmpMesh.VertexGroups[VertexGroupIndex].get();
 				for (uint vi = 0; vi < VertexGroup.VerticesInGroup.size(); vi++)
 				{
-					BoneInfluences[bi].insert(INFLUENCE_MAP::value_type(
+					BoneInfluences[bi].insert(VERTEX_INFLUENCE_MAP::value_type(
 						VertexGroup.VerticesInGroup[vi].Index,
 						VertexGroup.VerticesInGroup[vi].Weight));
 				}
 			}
 		}
 
-		// Dla kadego wierzchoka
-		for (uint vi = 0; vi < TmpMesh.Vertices.size(); vi++)
-		{
-			// Zbierz wszystkie wpywajce na niego koci
-			struct INFLUENCE
-			{
-				uint BoneIndex; // Uwaga! Wyej byo VertexIndex -> Weight, a tutaj jest BoneIndex -> Weight - ale masakra !!!
-				float Weight;
-
-				bool operator > (const INFLUENCE &Influence) const { return Weight > Influence.Weight; }
-			};
-			std::vector<INFLUENCE> VertexInfluences;
-
-			// Wpyw przez Vertex Groups
-			if (QmshTmp.Armature->VertexGroups)
-			{
-				for (uint bi = 0; bi < Qmsh.Bones.size(); bi++)
-				{
-					INFLUENCE_MAP::iterator biit = BoneInfluences[bi].find(vi);
-					if (biit != BoneInfluences[bi].end())
-					{
-						INFLUENCE Influence = { bi + 1, biit->second };
-						VertexInfluences.push_back(Influence);
-					}
-				}
-			}
-
-			// adna ko na niego nie wpywa - wypyw z Envelopes
-			if (VertexInfluences.empty() && QmshTmp.Armature->Envelopes)
-			{
-				// U list wpywajcych koci
-				for (uint bi = 0; bi < Qmsh.Bones.size(); bi++)
-				{
-					// Nie jestem pewny czy to jest dokadnie algorytm uywany przez Blender,
-					// nie jest nigdzie dokadnie opisany, ale z eksperymentw podejrzewam, e tak.
-					// Ko w promieniu - wpyw maksymalny.
-					// Ko w zakresie czego co nazwaem Extra Envelope te jest wpyw (podejrzewam e sabnie z odlegoci)
-					// Promie Extra Envelope, jak udao mi si wreszcie ustali, jest niezaleny od Radius w sensie
-					// e rozciga si ponad Radius zawsze na tyle ile wynosi (BoneLength / 4)
-
-					// Dodatkowy promie zewntrzny
-					float ExtraEnvelopeRadius = BoneInterData[bi].Length * 0.25f;
-
-					// Pozycja wierzchoka ju jest w ukadzie globalnym modelu i w konwencji DirectX
-					float W = PointToBone(
-						TmpMesh.Vertices[vi].Pos,
-						BoneInterData[bi].HeadPos, BoneInterData[bi].HeadRadius, BoneInterData[bi].HeadRadius + ExtraEnvelopeRadius,
-						BoneInterData[bi].TailPos, BoneInterData[bi].TailRadius, BoneInterData[bi].TailRadius + ExtraEnvelopeRadius);
-
-					if (W > 0.f)
-					{
-						INFLUENCE Influence = { bi + 1, W };
-						VertexInfluences.push_back(Influence);
-					}
-				}
-			}
-			// Jakie koci na niego wpywaj - we z tych koci
-
-			// Zero koci
-			if (VertexInfluences.empty())
-			{
-				(*Out)[vi].Index1 = 0;
-				(*Out)[vi].Index2 = 0;
-				(*Out)[vi].Weight1 = 1.f;
-			}
-			// Tylko jedna ko
-			else if (VertexInfluences.size() == 1)
-			{
-				(*Out)[vi].Index1 = VertexInfluences[0].BoneIndex;
-				(*Out)[vi].Index2 = VertexInfluences[0].BoneIndex;
-				(*Out)[vi].Weight1 = 1.f;
-			}
-			// Dwie lub wicej koci na licie wpywajcych na ten wierzchoek
-			else
-			{
-				// Posortuj wpywy na wierzchoek malejco, czyli od najwikszej wagi
-				std::sort(VertexInfluences.begin(), VertexInfluences.end(), std::greater<INFLUENCE>());
-				// We dwie najwaniejsze koci
-				(*Out)[vi].Index1 = VertexInfluences[0].BoneIndex;
-				(*Out)[vi].Index2 = VertexInfluences[1].BoneIndex;
-				// Oblicz wag pierwszej
-				// WANY WZR NA ZNORMALIZOWAN WAG PIERWSZ Z DWCH DOWOLNYCH WAG !!!
-				(*Out)[vi].Weight1 = VertexInfluences[0].Weight / (VertexInfluences[0].Weight + VertexInfluences[1].Weight);
-			}
-		}
+		// Dla kadego wierzchoka - niezalenie, rwnolegle
+		ParallelFor(0, TmpMesh.Vertices.size(), 256, VertexSkinDataFunc(Out, TmpMesh, Qmsh, QmshTmp, BoneInterData, BoneInfluences));
 	}
 }
 
@@ -1885,7 +1960,8 @@ void LoadQmsh(QMSH &Qmsh, const string &FileName, const MeshJob &Job)
 
 	ERR_TRY;
 
-	FileStream F(FileName, FM_READ);
+	FileStream File(FileName, FM_READ);
+	PrefetchStream F(&File);
 
 	// Nagwek
 	uint2 VertexCount, TriangleCount, SubmeshCount, BoneCount, AnimationCount;
@@ -1893,7 +1969,7 @@ void LoadQmsh(QMSH &Qmsh, const string &FileName, const MeshJob &Job)
 	F.ReadStringF(&Header, 8);
 	if (Header != "TFQMSH10")
 		throw Error("Invalid file header.");
-	uint1 Flags; F.ReadEx(&Flags); Qmsh.Flags = Flags;
+	uint1 Flags; F.ReadEx(&Flags); Qmsh.Flags = Flags & ~QMSH::FLAG_EXTRA_BOUNDING_VOLUMES;
 	F.ReadEx(&VertexCount);
 	F.ReadEx(&TriangleCount);
 	F.ReadEx(&SubmeshCount);
@@ -1908,6 +1984,21 @@ void LoadQmsh(QMSH &Qmsh, const string &FileName, const MeshJob &Job)
 	// Offsety - pomi
 	F.Skip(5 * sizeof(uint4));
 
+	// Dodatkowe bryy otaczajce - jeli ich nie ma, zostan wyliczone w razie potrzeby
+	if ((Flags & QMSH::FLAG_EXTRA_BOUNDING_VOLUMES) != 0)
+	{
+		F.ReadEx(&Qmsh.MinBoundingSphereCenter);
+		F.ReadEx(&Qmsh.MinBoundingSphereRadius);
+		F.ReadEx(&Qmsh.BoundingObb.Center);
+		F.ReadEx(&Qmsh.BoundingObb.Axes[0]);
+		F.ReadEx(&Qmsh.BoundingObb.Axes[1]);
+		F.ReadEx(&Qmsh.BoundingObb.Axes[2]);
+		F.ReadEx(&Qmsh.BoundingObb.HalfSize);
+		Qmsh.ExtraBoundingVolumesCalculated = true;
+	}
+	else
+		Qmsh.ExtraBoundingVolumesCalculated = false;
+
 	// Wierzchoki
 	Qmsh.Vertices.resize(VertexCount);
 	{ uint1 Zero; F.ReadEx(&Zero); if (Zero != 0) throw Error("File is corrupted at vertex buffer beginning."); }
@@ -1934,9 +2025,8 @@ void LoadQmsh(QMSH &Qmsh, const string &FileName, const MeshJob &Job)
 	}
 
 	// Indeksy (trjkty)
-	Qmsh.Indices.resize(TriangleCount * 3);
 	{ uint1 Zero; F.ReadEx(&Zero); if (Zero != 0) throw Error("File is corrupted at vertex buffer beginning."); }
-	F.MustRead(&Qmsh.Indices[0], sizeof(uint2)*Qmsh.Indices.size());
+	F.ReadArray(&Qmsh.Indices, TriangleCount * 3);
 
 	// Podsiatki
 	{ uint1 Zero; F.ReadEx(&Zero); if (Zero != 0) throw Error("File is corrupted at vertex buffer beginning."); }
@@ -2012,13 +2102,7 @@ void LoadQmsh(QMSH &Qmsh, const string &FileName, const MeshJob &Job)
 				QMSH_KEYFRAME &Keyframe = *KeyframePtr.get();
 
 				F.ReadEx(&Keyframe.Time);
-				Keyframe.Bones.resize(Qmsh.Bones.size());
-				for (uint bi = 0; bi < Qmsh.Bones.size(); bi++)
-				{
-					F.ReadEx(&Keyframe.Bones[bi].Translation);
-					F.ReadEx(&Keyframe.Bones[bi].Rotation);
-					F.ReadEx(&Keyframe.Bones[bi].Scaling);
-				}
+				F.ReadArray(&Keyframe.Bones, Qmsh.Bones.size());
 			}
 		}
 	}
@@ -2045,7 +2129,7 @@ void SaveQmsh(const QMSH &Qmsh, const string &FileName)
 
 	// Nagwek
 	F.WriteStringF("TFQMSH10");
-	F.WriteEx((uint1)Qmsh.Flags);
+	F.WriteEx((uint1)(Qmsh.Flags | QMSH::FLAG_EXTRA_BOUNDING_VOLUMES));
 	F.WriteEx((uint2)Qmsh.Vertices.size());
 	F.WriteEx((uint2)(Qmsh.Indices.size()/3));
 	F.WriteEx((uint2)Qmsh.Submeshes.size());
@@ -2053,7 +2137,7 @@ void SaveQmsh(const QMSH &Qmsh, const string &FileName)
 	F.WriteEx((uint2)Qmsh.Animations.size());
 
 	// Bryy otaczajce
-	assert(Qmsh.BoundingVolumesCalculated);
+	assert(Qmsh.BoundingVolumesCalculated && Qmsh.ExtraBoundingVolumesCalculated);
 	F.WriteEx(Qmsh.BoundingSphereRadius);
 	F.WriteEx(Qmsh.BoundingBox);
 
@@ -2065,35 +2149,57 @@ void SaveQmsh(const QMSH &Qmsh, const string &FileName)
 	F.WriteEx(0xDEADC0DE);
 	F.WriteEx(0xDEADC0DE);
 
+	// Dodatkowe bryy otaczajce
+	F.WriteEx(Qmsh.MinBoundingSphereCenter);
+	F.WriteEx(Qmsh.MinBoundingSphereRadius);
+	F.WriteEx(Qmsh.BoundingObb.Center);
+	F.WriteEx(Qmsh.BoundingObb.Axes[0]);
+	F.WriteEx(Qmsh.BoundingObb.Axes[1]);
+	F.WriteEx(Qmsh.BoundingObb.Axes[2]);
+	F.WriteEx(Qmsh.BoundingObb.HalfSize);
+
 	// Wierzchoki
 	int VerticesPos = F.GetPos();
 	F.WriteEx((uint1)0);
+	// Pola wszystkich wierzchokw s pakowane do jednego bufora i zapisywane na raz
+	bool Skinning = (Qmsh.Flags & QMSH::FLAG_SKINNING) != 0;
+	bool Tangents = (Qmsh.Flags & QMSH::FLAG_TANGENTS) != 0;
+	const QMSH_VERTEX *V0 = NULL;
+	size_t VertexSize = sizeof(V0->Pos) + sizeof(V0->Normal) + sizeof(V0->Tex);
+	if (Skinning)
+		VertexSize += sizeof(V0->Weight1) + sizeof(V0->BoneIndices);
+	if (Tangents)
+		VertexSize += sizeof(V0->Tangent) + sizeof(V0->Binormal);
+	std::vector<char> VertexData(Qmsh.Vertices.size() * VertexSize);
+	char *VertexPtr = VertexData.empty() ? NULL : &VertexData[0];
 	for (uint vi = 0; vi < Qmsh.Vertices.size(); vi++)
 	{
 		const QMSH_VERTEX & v = Qmsh.Vertices[vi];
 
-		F.WriteEx(v.Pos);
+		memcpy(VertexPtr, &v.Pos, sizeof(v.Pos)); VertexPtr += sizeof(v.Pos);
 
-		if ((Qmsh.Flags & QMSH::FLAG_SKINNING) != 0)
+		if (Skinning)
 		{
-			F.WriteEx(v.Weight1);
-			F.WriteEx(v.BoneIndices);
+			memcpy(VertexPtr, &v.Weight1, sizeof(v.Weight1)); VertexPtr += sizeof(v.Weight1);
+			memcpy(VertexPtr, &v.BoneIndices, sizeof(v.BoneIndices)); VertexPtr += sizeof(v.BoneIndices);
 		}
 
-		F.WriteEx(v.Normal);
-		F.WriteEx(v.Tex);
+		memcpy(VertexPtr, &v.Normal, sizeof(v.Normal)); VertexPtr += sizeof(v.Normal);
+		memcpy(VertexPtr, &v.Tex, sizeof(v.Tex)); VertexPtr += sizeof(v.Tex);
 
-		if ((Qmsh.Flags & QMSH::FLAG_TANGENTS) != 0)
+		if (Tangents)
 		{
-			F.WriteEx(v.Tangent);
-			F.WriteEx(v.Binormal);
+			memcpy(VertexPtr, &v.Tangent, sizeof(v.Tangent)); VertexPtr += sizeof(v.Tangent);
+			memcpy(VertexPtr, &v.Binormal, sizeof(v.Binormal)); VertexPtr += sizeof(v.Binormal);
 		}
 	}
+	if (!VertexData.empty())
+		F.Write(&VertexData[0], VertexData.size());
 
 	// Indeksy (trjkty)
 	int TrianglesPos = F.GetPos();
 	F.WriteEx((uint1)0);
-	F.Write(&Qmsh.Indices[0], sizeof(uint2)*Qmsh.Indices.size());
+	F.WriteArray(Qmsh.Indices);
 
 	// Podsiatki
 	int SubmeshesPos = F.GetPos();
@@ -2159,12 +2265,7 @@ void SaveQmsh(const QMSH &Qmsh, const string &FileName)
 
 				F.WriteEx(Keyframe.Time);
 
-				for (uint bi = 0; bi < Qmsh.Bones.size(); bi++)
-				{
-					F.WriteEx(Keyframe.Bones[bi].Translation);
-					F.WriteEx(Keyframe.Bones[bi].Rotation);
-					F.WriteEx(Keyframe.Bones[bi].Scaling);
-				}
+				F.WriteArray(Keyframe.Bones);
 			}
 		}
 	}
@@ -2223,6 +2324,9 @@ void InfoTask(QMSH &Qmsh, MeshJob &Job, InfoMeshTask &Task)
 		(Qmsh.Indices.size() / 3));
 	Writeln(Format("  BoundingSphereRadius=#") % Qmsh.BoundingSphereRadius);
 	Writeln(Format("  BoundingBox=#") % Qmsh.BoundingBox);
+	Writeln(Format("  MinBoundingSphere: Center=#, Radius=#") % Qmsh.MinBoundingSphereCenter % Qmsh.MinBoundingSphereRadius);
+	Writeln(Format("  BoundingObb: Center=#, Axes=#;#;#, HalfSize=#") % Qmsh.BoundingObb.Center %
+		Qmsh.BoundingObb.Axes[0] % Qmsh.BoundingObb.Axes[1] % Qmsh.BoundingObb.Axes[2] % Qmsh.BoundingObb.HalfSize);
 	if ((Qmsh.Flags & QMSH::FLAG_SKINNING) != 0)
 	{
 		Writeln(Format("  Skinning: Bones=#, Animations=#") %
@@ -2382,12 +2486,12 @@ void TransformTask(QMSH &Qmsh, MeshJob &Job, TransformMeshTask &Task)
 
 	// Wprowad przeksztacenie do wierzchokw
 	Writeln("Transforming vertex positions...");
+	// Pozycja
+	if (VertexEnd > VertexBeg)
+		TransformCoordArray_Strided(&Qmsh.Vertices[VertexBeg].Pos, sizeof(QMSH_VERTEX), VertexEnd - VertexBeg, TransformMatrix);
 	VEC3 TmpVec;
 	for (uint vi = VertexBeg; vi < VertexEnd; vi++)
 	{
-		// Pozycja
-		TransformCoord(&TmpVec, Qmsh.Vertices[vi].Pos, TransformMatrix);
-		Qmsh.Vertices[vi].Pos = TmpVec;
 		// Normalna
 		TransformNormal(&TmpVec, Qmsh.Vertices[vi].Normal, TransformInverseTranspose);
 		Qmsh.Vertices[vi].Normal;
@@ -2936,10 +3040,29 @@ void ValidateTask(QMSH &Qmsh, MeshJob &Job, ValidateMeshTask &Task)
 		if (!VecEqual(OldBoundingBox.p1, NewBoundingBox.p1) ||
 			!VecEqual(OldBoundingBox.p2, NewBoundingBox.p2))
 			InvalidBox = true;
-		if (InvalidSphere || InvalidBox)
+		// Najmniejsza sfera jest jednoznaczna, OBB nie - sprawdzane jest tylko, czy otacza wszystkie wierzchoki
+		bool InvalidMinSphere = false, InvalidObb = false;
+		if (Qmsh.ExtraBoundingVolumesCalculated)
+		{
+			VEC3 NewMinSphereCenter;
+			float NewMinSphereRadius;
+			OBB NewObb;
+			CalcExtraBoundingVolumes(Qmsh, &NewMinSphereCenter, &NewMinSphereRadius, &NewObb);
+			InvalidMinSphere = !float_equal(Qmsh.MinBoundingSphereRadius, NewMinSphereRadius) ||
+				!VecEqual(Qmsh.MinBoundingSphereCenter, NewMinSphereCenter);
+			for (uint vi = 0; vi < Qmsh.Vertices.size() && !InvalidObb; vi++)
+			{
+				VEC3 v = Qmsh.Vertices[vi].Pos - Qmsh.BoundingObb.Center;
+				for (uint a = 0; a < 3; a++)
+					if (fabsf(Dot(v, Qmsh.BoundingObb.Axes[a])) > Qmsh.BoundingObb.HalfSize[a] + 1e-3f)
+						InvalidObb = true;
+			}
+		}
+		if (InvalidSphere || InvalidBox || InvalidMinSphere || InvalidObb)
 		{
 			Problems++;
-			Writeln(Format("  BoundingSphereCorrect=#, BoundingBoxCorrect=#") % (!InvalidSphere) % (!InvalidBox));
+			Writeln(Format("  BoundingSphereCorrect=#, BoundingBoxCorrect=#, MinBoundingSphereCorrect=#, BoundingObbCorrect=#") %
+				(!InvalidSphere) % (!InvalidBox) % (!InvalidMinSphere) % (!InvalidObb));
 		}
 	}
 
@@ -3189,6 +3312,21 @@ void MendTask(QMSH &Qmsh, MeshJob &Job, MendMeshTask &Task)
 
 void DoMeshJob(MeshJob &Job)
 {
+	OutputCache Cache(Job.Cache, "Mesh");
+	for (uint ti = 0; ti < Job.Tasks.size(); ti++)
+	{
+		MeshTask &t = *Job.Tasks[ti].get();
+		if (typeid(t) == typeid(InputMeshTask))
+			Cache.AddInputFile(((InputMeshTask&)t).FileName);
+		else if (typeid(t) == typeid(OutputMeshTask))
+			Cache.AddOutputFile(((OutputMeshTask&)t).FileName);
+		// Wynikiem tych zada s te komunikaty na konsoli
+		else if (typeid(t) == typeid(InfoMeshTask) || typeid(t) == typeid(ValidateMeshTask))
+			Cache.Disable();
+	}
+	if (Cache.Restore())
+		return;
+
 	scoped_ptr<QMSH> Mesh;
 
 	for (uint ti = 0; ti < Job.Tasks.size(); ti++)
@@ -3263,4 +3401,6 @@ void DoMeshJob(MeshJob &Job)
 				throw Error("Nienznany typ zadania.");
 		}
 	}
+
+	Cache.Store();
 }
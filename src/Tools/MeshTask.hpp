@@ -6,6 +6,8 @@
  */
 #pragma once
 
+#include "OutputCache.hpp"
+
 // Abstrakcyjna klasa bazowa dla zada
 struct MeshTask : public Task
 {
@@ -161,6 +163,8 @@ struct MeshJob
 	bool RespectExistingSplits;
 	bool FixCylindricalWrapping;
 
+	OutputCacheParams Cache;
+
 	MeshJob();
 	~MeshJob();
 };
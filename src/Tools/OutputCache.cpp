@@ -0,0 +1,226 @@
+/*
+ * The Final Quest - 3D Graphics Engine
+ * Copyright (C) 2007  Adam Sawicki
+ * http://regedit.gamedev.pl, sawickiap@poczta.onet.pl
+ * License: GNU GPL
+ */
+#include "PCH.hpp"
+#include "OutputCache.hpp"
+
+
+// Zmieni przy zmianie formatu wpisu albo sposobu liczenia klucza
+const char * const OUTPUT_CACHE_VERSION = "TFQ Tools Output Cache 1";
+const char OUTPUT_CACHE_ENTRY_HEADER[8] = { 'T', 'F', 'Q', 'C', 'A', 'C', 'H', '1' };
+const char * const OUTPUT_CACHE_ENTRY_EXT = ".tfqcache";
+const uint8 OUTPUT_CACHE_DEFAULT_SIZE_LIMIT = 1024 * 1024 * 1024;
+
+// Dopisuje do sumy dugo i zawarto pliku
+static void HashFile(FastHash_Calc &Hash, const string &FileName)
+{
+	MappedFileStream File(FileName);
+	uint8 Size = File.GetSize();
+	Hash.WriteEx(Size);
+	if (Size > 0)
+		Hash.Write(File.GetData(), (size_t)Size);
+}
+
+static bool ScanItemTimeLess(const DIR_SCAN_ITEM &i1, const DIR_SCAN_ITEM &i2)
+{
+	if (i1.ModificationTime != i2.ModificationTime)
+		return i1.ModificationTime < i2.ModificationTime;
+	return i1.Path < i2.Path;
+}
+
+
+OutputCacheParams::OutputCacheParams() :
+	SizeLimit(OUTPUT_CACHE_DEFAULT_SIZE_LIMIT)
+{
+}
+
+bool OutputCacheParams::ParseOpt(CmdLineParser &Parser)
+{
+	switch (Parser.GetOptId())
+	{
+	case 9001: // /Cache
+		Dir = Parser.GetParameter();
+		return true;
+	case 9002: // /CacheSize
+		{
+			uint SizeInMB;
+			MustStrToSth<uint>(&SizeInMB, Parser.GetParameter());
+			SizeLimit = (uint8)SizeInMB * 1024 * 1024;
+		}
+		return true;
+	}
+
+	// Dugo parametru przed nim - eby rne cigi opcji nie day tego samego zapisu
+	const string &Param = Parser.GetParameter();
+	Recipe += Format("# # #\n") % Parser.GetOptId() % (uint)Param.length() % Param;
+	return false;
+}
+
+
+OutputCache::OutputCache(const OutputCacheParams &Params, const string &JobType) :
+	m_Params(Params),
+	m_JobType(JobType),
+	m_Disabled(false)
+{
+}
+
+bool OutputCache::IsEnabled()
+{
+	return !m_Disabled && !m_Params.Dir.empty() && !m_OutputFiles.empty();
+}
+
+bool OutputCache::CalcEntryFileName()
+{
+	if (!m_EntryFileName.empty())
+		return true;
+
+	// Brakujcy plik wejciowy - niech bd zgosi samo zadanie
+	for (size_t i = 0; i < m_InputFiles.size(); i++)
+		if (GetFileItemType(m_InputFiles[i]) != IT_FILE)
+			return false;
+
+	ERR_TRY;
+
+	FastHash_Calc Hash;
+	Hash.WriteString1(OUTPUT_CACHE_VERSION);
+
+	// Plik wykonywalny - kada nowa wersja narzdzi uniewania stare wpisy
+	char ExeFileName[MAX_PATH];
+	::GetModuleFileNameA(NULL, ExeFileName, MAX_PATH);
+	HashFile(Hash, ExeFileName);
+
+	Hash.WriteString1(m_JobType);
+	Hash.WriteString4(m_Params.Recipe);
+	Hash.WriteEx((uint4)m_InputFiles.size());
+	for (size_t i = 0; i < m_InputFiles.size(); i++)
+		HashFile(Hash, m_InputFiles[i]);
+
+	HASH128 Key;
+	Hash.GetResult128(&Key);
+	string KeyStr;
+	Hash128ToStr(&KeyStr, Key);
+
+	IncludeTrailingPathDelimiter(&m_EntryFileName, m_Params.Dir);
+	m_EntryFileName += KeyStr;
+	m_EntryFileName += OUTPUT_CACHE_ENTRY_EXT;
+
+	ERR_CATCH("Cannot calculate output cache key.");
+
+	return true;
+}
+
+void OutputCache::Trim()
+{
+	std::vector<DIR_SCAN_ITEM> Items;
+	ScanDirectory(&Items, m_Params.Dir, string("*") + OUTPUT_CACHE_ENTRY_EXT, DSF_FILES | DSF_INFO);
+
+	uint8 TotalSize = 0;
+	for (size_t i = 0; i < Items.size(); i++)
+		TotalSize += Items[i].Size;
+	if (TotalSize <= m_Params.SizeLimit)
+		return;
+
+	// Usuwanie od najdawniej uytych
+	std::sort(Items.begin(), Items.end(), ScanItemTimeLess);
+	uint DeletedCount = 0;
+	for (size_t i = 0; i < Items.size() && TotalSize > m_Params.SizeLimit; i++)
+	{
+		if (::DeleteFileA(Items[i].Path.c_str()) != FALSE)
+		{
+			TotalSize -= Items[i].Size;
+			DeletedCount++;
+		}
+	}
+	Writeln(Format("Output cache trimmed, # entries deleted.") % DeletedCount);
+}
+
+bool OutputCache::Restore()
+{
+	if (!IsEnabled() || !CalcEntryFileName())
+		return false;
+	if (GetFileItemType(m_EntryFileName) != IT_FILE)
+		return false;
+
+	try
+	{
+		MappedFileStream Entry(m_EntryFileName);
+
+		char Header[8];
+		Entry.MustRead(Header, 8);
+		if (memcmp(Header, OUTPUT_CACHE_ENTRY_HEADER, 8) != 0)
+			throw Error("Invalid header.");
+		uint4 Count;
+		Entry.ReadEx(&Count);
+		if (Count != m_OutputFiles.size())
+			throw Error("Invalid number of output files.");
+
+		for (uint4 i = 0; i < Count; i++)
+		{
+			uint4 Size;
+			Entry.ReadEx(&Size);
+			const char *Data = Entry.MustReadView(Size);
+			Writeln("Restoring file \"" + m_OutputFiles[i] + "\" from output cache...");
+			SaveDataToFile(m_OutputFiles[i], Data, Size);
+		}
+
+		if (!Entry.End())
+			throw Error("Unexpected data at the end.");
+	}
+	catch (const Error &e)
+	{
+		// Wpis uszkodzony - zadanie wykona si normalnie i zapisze go na nowo
+		string Msg;
+		e.GetMessage_(&Msg, "  ");
+		Warning("Invalid output cache entry \"" + m_EntryFileName + "\":\n" + Msg);
+		::DeleteFileA(m_EntryFileName.c_str());
+		return false;
+	}
+
+	// Trafienie - wpis staje si najwieszy dla Trim
+	UpdateFileTimeToNow(m_EntryFileName);
+	return true;
+}
+
+void OutputCache::Store()
+{
+	if (!IsEnabled() || !CalcEntryFileName())
+		return;
+
+	string TmpFileName = Format("#.#.tmp") % m_EntryFileName % (uint)GetCurrentProcessId();
+
+	// Bd zapisu do pamici podrcznej nie jest bdem zadania - pliki wyjciowe ju s
+	try
+	{
+		MustCreateDirectoryChain(m_Params.Dir);
+
+		{
+			FileStream Entry(TmpFileName, FM_WRITE);
+			Entry.Write(OUTPUT_CACHE_ENTRY_HEADER, 8);
+			Entry.WriteEx((uint4)m_OutputFiles.size());
+			for (size_t i = 0; i < m_OutputFiles.size(); i++)
+			{
+				MappedFileStream Output(m_OutputFiles[i]);
+				uint4 Size = (uint4)Output.GetSize();
+				Entry.WriteEx(Size);
+				if (Size > 0)
+					Entry.Write(Output.GetData(), Size);
+			}
+		}
+
+		// Inny proces mg w midzyczasie zapisa ten sam wpis - ma t sam tre
+		if (!MoveItem(TmpFileName, m_EntryFileName))
+			::DeleteFileA(TmpFileName.c_str());
+
+		Trim();
+	}
+	catch (const Error &e)
+	{
+		::DeleteFileA(TmpFileName.c_str());
+		string Msg;
+		e.GetMessage_(&Msg, "  ");
+		Warning("Cannot store outputs in cache:\n" + Msg);
+	}
+}
@@ -0,0 +1,64 @@
+/*
+ * The Final Quest - 3D Graphics Engine
+ * Copyright (C) 2007  Adam Sawicki
+ * http://regedit.gamedev.pl, sawickiap@poczta.onet.pl
+ * License: GNU GPL
+ */
+#pragma once
+
+// Parametry pamici podrcznej wynikw, wsplne dla zada Mesh, Map i Texture
+struct OutputCacheParams
+{
+	// Katalog pamici podrcznej. Pusty - pami podrczna wyczona.
+	string Dir;
+	// Maksymalny czny rozmiar wpisw w katalogu, w bajtach
+	uint8 SizeLimit;
+	// Opcje zadania w kolejnoci podania w wierszu polece (bez opcji samej pamici podrcznej).
+	// Lista zada i parametry zadania powstaj wycznie z nich, wic to jest ich zapis.
+	string Recipe;
+
+	OutputCacheParams();
+	// Jeli bieca opcja parsera dotyczy pamici podrcznej (/Cache, /CacheSize),
+	// obsuguje j i zwraca true. W przeciwnym razie dopisuje j do Recipe i zwraca false.
+	bool ParseOpt(CmdLineParser &Parser);
+};
+
+// Wpis pamici podrcznej dla jednego wykonania zadania
+/*
+- Klucz to suma FastHash_Calc z zawartoci pliku Tools.exe, rodzaju zadania,
+  Recipe oraz zawartoci wszystkich plikw wejciowych.
+- Wpis to jeden plik w katalogu pamici podrcznej, zawierajcy wszystkie pliki
+  wyjciowe. Powstaje przez plik tymczasowy, wic przerwany zapis nie zostawia
+  uszkodzonego wpisu.
+- Nadmiar ponad SizeLimit jest usuwany od wpisw najdawniej uytych - trafienie
+  odwiea dat modyfikacji wpisu.
+*/
+class OutputCache
+{
+private:
+	const OutputCacheParams &m_Params;
+	string m_JobType;
+	STRING_VECTOR m_InputFiles;
+	STRING_VECTOR m_OutputFiles;
+	bool m_Disabled;
+	// Pusta, jeli jeszcze nie policzona albo nie da si jej policzy
+	string m_EntryFileName;
+
+	bool IsEnabled();
+	bool CalcEntryFileName();
+	void Trim();
+
+public:
+	OutputCache(const OutputCacheParams &Params, const string &JobType);
+
+	void AddInputFile(const string &FileName) { m_InputFiles.push_back(FileName); }
+	void AddOutputFile(const string &FileName) { m_OutputFiles.push_back(FileName); }
+	// Wycza pami podrczn dla tego zadania - np. kiedy jego wynikiem
+	// jest te co innego ni pliki wyjciowe albo kiedy wynik jest losowy
+	void Disable() { m_Disabled = true; }
+
+	// Jeli w pamici podrcznej s wyniki, odtwarza z nich pliki wyjciowe i zwraca true
+	bool Restore();
+	// Zapisuje pliki wyjciowe do pamici podrcznej. Wywoywa po udanym wykonaniu zadania.
+	void Store();
+};
@@ -13,6 +13,7 @@
 #include "Error.hpp"
 #include "Stream.hpp"
 #include "Files.hpp"
+#include "Threads.hpp"
 #include "Profiler.hpp"
 #include "Tokenizer.hpp"
 
@@ -0,0 +1,51 @@
+/*
+ * The Final Quest - 3D Graphics Engine
+ * Copyright (C) 2007  Adam Sawicki
+ * http://regedit.gamedev.pl, sawickiap@poczta.onet.pl
+ * License: GNU GPL
+ */
+#include "PCH.hpp"
+#include "GlobalCode.hpp"
+#include "PackTask.hpp"
+#include "..\Common\PackFile.hpp"
+
+
+static bool ScanItemPathLess(const DIR_SCAN_ITEM &i1, const DIR_SCAN_ITEM &i2)
+{
+	return i1.Path < i2.Path;
+}
+
+static bool ShouldCompress(const PackJob &Job, const string &Path)
+{
+	string FileName;
+	ExtractFileName(&FileName, Path);
+	for (size_t i = 0; i < Job.CompressMasks.size(); i++)
+		if (ValidateWildcard(Job.CompressMasks[i], FileName, false))
+			return true;
+	return false;
+}
+
+void DoPackJob(PackJob &Job)
+{
+	if (Job.OutputFileName.empty())
+		throw Error("Nie podano pliku wyjciowego (/o).");
+	if (Job.InputDirs.empty())
+		throw Error("Nie podano adnego katalogu wejciowego (/i).");
+
+	// Lista plikw - posortowana, eby paczka z tych samych plikw bya zawsze taka sama
+	std::vector<DIR_SCAN_ITEM> Items;
+	for (size_t i = 0; i < Job.InputDirs.size(); i++)
+	{
+		Writeln("Scanning directory \"" + Job.InputDirs[i] + "\"...");
+		ScanDirectory(&Items, Job.InputDirs[i], "*", DSF_FILES);
+	}
+	std::sort(Items.begin(), Items.end(), ScanItemPathLess);
+
+	Writeln("Saving pack file \"" + Job.OutputFileName + "\"...");
+	PackWriter Writer(Job.OutputFileName);
+	for (size_t i = 0; i < Items.size(); i++)
+		Writer.AddFile(Items[i].Path, Items[i].Path, ShouldCompress(Job, Items[i].Path));
+	Writer.Finish();
+
+	Writeln(Format("Files: #, compressed: #") % Writer.GetFileCount() % Writer.GetCompressedCount());
+}
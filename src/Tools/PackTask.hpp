@@ -0,0 +1,19 @@
+/*
+ * The Final Quest - 3D Graphics Engine
+ * Copyright (C) 2007  Adam Sawicki
+ * http://regedit.gamedev.pl, sawickiap@poczta.onet.pl
+ * License: GNU GPL
+ */
+#pragma once
+
+struct PackJob
+{
+	// Plik paczki do utworzenia
+	string OutputFileName;
+	// Katalogi, ktrych pliki (razem z podkatalogami) trafi do paczki
+	STRING_VECTOR InputDirs;
+	// Maski nazw plikw, ktre maj by kompresowane
+	STRING_VECTOR CompressMasks;
+};
+
+void DoPackJob(PackJob &Job);
@@ -512,6 +512,21 @@ void Texture::GenRand()
 
 void DoTextureJob(TextureJob &Job)
 {
+	OutputCache Cache(Job.Cache, "Texture");
+	for (uint ti = 0; ti < Job.Tasks.size(); ti++)
+	{
+		TextureTask *task = Job.Tasks[ti].get();
+		if ((dynamic_cast<InputTextureTask*>(task)) != NULL)
+			Cache.AddInputFile(static_cast<InputTextureTask*>(task)->FileName);
+		else if ((dynamic_cast<OutputTextureTask*>(task)) != NULL)
+			Cache.AddOutputFile(static_cast<OutputTextureTask*>(task)->FileName);
+		// Info wypisuje na konsol, a tekstura losowa za kadym razem jest inna
+		else if ((dynamic_cast<InfoTextureTask*>(task)) != NULL || (dynamic_cast<GenRandTextureTask*>(task)) != NULL)
+			Cache.Disable();
+	}
+	if (Cache.Restore())
+		return;
+
 	scoped_ptr<Texture> t;
 
 	for (uint ti = 0; ti < Job.Tasks.size(); ti++)
@@ -535,4 +550,6 @@ void DoTextureJob(TextureJob &Job)
 		else
 			throw Error("Unknown texture task type.");
 	}
+
+	Cache.Store();
 }
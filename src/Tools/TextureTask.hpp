@@ -6,6 +6,8 @@
  */
 #pragma once
 
+#include "OutputCache.hpp"
+
 // Abstrakcyjna klasa bazowa dla zada
 struct TextureTask : public Task
 {
@@ -63,6 +65,8 @@ struct TextureJob
 
 	std::vector< common::shared_ptr<TextureTask> > Tasks;
 
+	OutputCacheParams Cache;
+
 	TextureJob();
 	~TextureJob();
 };